@@ -15,9 +15,11 @@
 
 #include <goptical/core/trace/tracer.hpp>
 
+#include <goptical/core/analysis/field_sweep.hpp>
 #include <goptical/core/analysis/focus.hpp>
 #include <goptical/core/analysis/rayfan.hpp>
 #include <goptical/core/analysis/spot.hpp>
+#include <goptical/core/analysis/through_focus.hpp>
 #include <goptical/core/data/plot.hpp>
 
 #include <goptical/core/io/renderer_svg.hpp>
@@ -57,6 +59,12 @@ struct Args
 	std::string input_file;
 	bool refocus;
 	unsigned scenario;
+	unsigned threads;
+	bool batch;
+	bool plan;
+	double spot_tolerance;
+	bool field_sweep;
+	bool through_focus;
 };
 
 void analysis_fan (std::shared_ptr<sys::System> &sys,
@@ -65,7 +73,9 @@ void analysis_fan (std::shared_ptr<sys::System> &sys,
 void analysis_spot (std::shared_ptr<sys::System> &sys,
                     std::shared_ptr<sys::SourcePoint> &source_point,
                     const struct BaseFileNames &base_file_names,
-                    bool skew = false);
+                    bool skew = false, double tolerance = 0.);
+void analysis_field_sweep (std::shared_ptr<sys::System> &sys,
+                           double angleOfView);
 void layout (const std::shared_ptr<sys::System> &sys,
              const std::shared_ptr<sys::SourcePoint> &source_point,
              const struct BaseFileNames &base_file_names, bool skew = false);
@@ -148,6 +158,12 @@ static bool get_arguments (int argc, const char *argv[], Args *args)
 {
 	args->refocus = false;
 	args->scenario = 0;
+	args->threads = 1;
+	args->batch = false;
+	args->plan = false;
+	args->spot_tolerance = 0.;
+	args->field_sweep = false;
+	args->through_focus = false;
 	if (argc < 2)
 	{
 		fprintf (stderr, "Please supply a data file\n");
@@ -164,6 +180,32 @@ static bool get_arguments (int argc, const char *argv[], Args *args)
 			i++;
 			args->scenario = (unsigned)atoi (argv[i]);
 		}
+		else if (strcmp (argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			i++;
+			args->threads = (unsigned)atoi (argv[i]);
+		}
+		else if (strcmp (argv[i], "--batch") == 0)
+		{
+			args->batch = true;
+		}
+		else if (strcmp (argv[i], "--plan") == 0)
+		{
+			args->plan = true;
+		}
+		else if (strcmp (argv[i], "--spot-tolerance") == 0 && i + 1 < argc)
+		{
+			i++;
+			args->spot_tolerance = atof (argv[i]);
+		}
+		else if (strcmp (argv[i], "--field-sweep") == 0)
+		{
+			args->field_sweep = true;
+		}
+		else if (strcmp (argv[i], "--through-focus") == 0)
+		{
+			args->through_focus = true;
+		}
 	}
 	args->input_file = std::string (argv[1]);
 	return true;
@@ -181,9 +223,30 @@ do_system_parallel_rays (io::BClaffLensImporter *importer,
 	/* anchor seq */
 	auto seq = std::make_shared<trace::Sequence> (*sys);
 	sys->get_tracer_params ().set_sequential_mode (seq);
+	sys->get_tracer_params ().set_thread_count (args.threads);
+	sys->get_tracer_params ().set_batch_mode (args.batch);
+	sys->get_tracer_params ().set_plan_mode (args.plan);
 	std::cout << "system:" << std::endl << *sys;
 	std::cout << "sequence:" << std::endl << *seq;
 	/* anchor end */
+	if (args.through_focus)
+	{
+		/* anchor through_focus */
+		analysis::ThroughFocus focus (sys);
+		double rms_focus = focus.get_min_rms_focus ();
+		double wavefront_focus = focus.get_min_wavefront_focus ();
+		std::cout << "Minimum rms spot radius " << focus.get_rms_radius (rms_focus)
+		          << " at defocus " << rms_focus << "\n";
+		std::cout << "Minimum rms wavefront error "
+		          << focus.get_rms_wavefront (wavefront_focus) << " waves at defocus "
+		          << wavefront_focus << "\n";
+		std::string filename = base_file_names.spot_file + "_through_focus.svg";
+		io::RendererSvg renderer (filename.c_str (), 640, 480);
+		double range = std::max (1e-3, 4. * fabs (rms_focus - wavefront_focus));
+		focus.get_rms_radius_plot (rms_focus - range, rms_focus + range)
+		->draw (renderer);
+		/* anchor end */
+	}
 	if (args.refocus)
 	{
 		/* anchor focus */
@@ -193,8 +256,13 @@ do_system_parallel_rays (io::BClaffLensImporter *importer,
 		importer->get_image ()->set_plane (best_focus);
 	}
 	layout (sys, source_point, base_file_names, false);
-	analysis_spot (sys, source_point, base_file_names, false);
+	analysis_spot (sys, source_point, base_file_names, false,
+	               args.spot_tolerance);
 	analysis_fan (sys, source_point, base_file_names);
+	if (args.field_sweep)
+	{
+		analysis_field_sweep (sys, angleOfView);
+	}
 }
 
 static void
@@ -208,6 +276,9 @@ do_skew_rays (io::BClaffLensImporter *importer,
 	/* anchor seq */
 	auto seq = std::make_shared<trace::Sequence> (*sys);
 	sys->get_tracer_params ().set_sequential_mode (seq);
+	sys->get_tracer_params ().set_thread_count (args.threads);
+	sys->get_tracer_params ().set_batch_mode (args.batch);
+	sys->get_tracer_params ().set_plan_mode (args.plan);
 	if (args.refocus)
 	{
 		/* anchor focus */
@@ -217,7 +288,8 @@ do_skew_rays (io::BClaffLensImporter *importer,
 		importer->get_image ()->set_plane (best_focus);
 	}
 	layout (sys, source_point, base_file_names, true);
-	analysis_spot (sys, source_point, base_file_names, true);
+	analysis_spot (sys, source_point, base_file_names, true,
+	               args.spot_tolerance);
 }
 
 int
@@ -280,7 +352,8 @@ layout (const std::shared_ptr<sys::System> &sys,
 void
 analysis_spot (std::shared_ptr<sys::System> &sys,
                std::shared_ptr<sys::SourcePoint> &source_point,
-               const struct BaseFileNames &base_file_names, bool skew)
+               const struct BaseFileNames &base_file_names, bool skew,
+               double tolerance)
 {
 	/* anchor spot */
 	sys->enable_single<sys::Source> (*source_point);
@@ -288,6 +361,16 @@ analysis_spot (std::shared_ptr<sys::System> &sys,
 	    trace::Distribution (trace::HexaPolarDist, 20));
 	analysis::Spot spot (sys);
 	/* anchor end */
+	if (tolerance > 0.)
+	{
+		// start from a coarse grid and refine until rms radius converges
+		spot.get_tracer ().get_params ().get_default_distribution ()
+		.set_radial_density (5);
+		spot.set_adaptive_sampling (tolerance);
+		std::cout << "Spot rms radius " << spot.get_rms_radius () << " +/- "
+		          << spot.get_rms_radius_error () << " with "
+		          << spot.get_ray_count () << " rays\n";
+	}
 	{
 		/* anchor spot */
 		std::string filename
@@ -307,6 +390,22 @@ analysis_spot (std::shared_ptr<sys::System> &sys,
 	}
 }
 void
+analysis_field_sweep (std::shared_ptr<sys::System> &sys, double angleOfView)
+{
+	/* anchor field_sweep */
+	analysis::FieldSweep sweep (sys);
+	// on axis, 70% and full field traced in a single pass
+	const double field = math::rad2degree (angleOfView);
+	sweep.add_field_angle (0.);
+	sweep.add_field_angle (0.7 * field);
+	sweep.add_field_angle (field);
+	sweep.add_wavelen (light::SpectralLine::d);
+	sweep.add_wavelen (light::SpectralLine::C);
+	sweep.add_wavelen (light::SpectralLine::F);
+	sweep.print_table (std::cout);
+	/* anchor end */
+}
+void
 analysis_fan (std::shared_ptr<sys::System> &sys,
               const std::shared_ptr<sys::SourcePoint> &source_point,
               const struct BaseFileNames &base_file_names)
@@ -0,0 +1,220 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_ANALYSIS_FIELD_SWEEP_HH_
+#define GOPTICAL_ANALYSIS_FIELD_SWEEP_HH_
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/error.hpp"
+#include "goptical/core/math/vector.hpp"
+
+#include "goptical/core/analysis/pointimage.hpp"
+
+namespace goptical
+{
+
+	namespace analysis
+	{
+
+		/**
+		   @short Multi field and multi wavelength spot analysis
+		   @header <goptical/core/analysis/FieldSweep
+		   @module {Core}
+		   @main
+
+		   This class computes spot statistics for a set of field
+		   points and wavelengths. A point source is created for each
+		   field with a spectral line for each wavelength. These
+		   sources are not added to the system, they replace system
+		   sources and all rays are propagated in a single ray trace,
+		   see @ref trace::Tracer::trace. The system is left untouched.
+
+		   Results are indexed by field and wavelength in insertion
+		   order. A ray aimed at the center of the entrance surface is
+		   traced along with distribution pattern rays for each field
+		   and wavelength. It is the chief ray only when the aperture
+		   stop lies on the entrance surface, no ray aiming is
+		   performed.
+		*/
+		class FieldSweep : public PointImage
+		{
+			public:
+				FieldSweep (std::shared_ptr<sys::System> &system);
+				~FieldSweep ();
+
+				/** Add a field at infinity, angle in degrees from the
+				    optical axis in the y/z plane */
+				void add_field_angle (double angle);
+
+				/** Add a field point source located at given position */
+				void add_field_point (const math::Vector3 &pos);
+
+				/** Add a wavelength. Fraunhofer d line is used if no
+				    wavelength is added */
+				void add_wavelen (double wavelen);
+
+				/** Remove all fields and wavelengths */
+				void clear ();
+
+				inline void invalidate ();
+
+				/** Get number of fields */
+				inline unsigned int get_field_count () const;
+
+				/** Get number of wavelengths */
+				inline unsigned int get_wavelen_count () const;
+
+				/** Get spot root mean square radius */
+				inline double get_rms_radius (unsigned int field, unsigned int wavelen);
+
+				/** Get spot centroid */
+				inline const math::Vector3 &get_centroid (unsigned int field,
+				        unsigned int wavelen);
+
+				/** Get number of pattern rays which reach the image */
+				inline unsigned int get_ray_count (unsigned int field,
+				                                   unsigned int wavelen);
+
+				/** Get image intercept point of the ray aimed at the
+				    center of the entrance surface, all components are NaN
+				    if this ray is vignetted. This is the chief ray
+				    intercept only when the aperture stop lies on the
+				    entrance surface. */
+				inline const math::Vector3 &get_chief_intercept (unsigned int field,
+				        unsigned int wavelen);
+
+				/** Get fraction of pattern rays lost before reaching the
+				    image */
+				inline double get_vignetting (unsigned int field, unsigned int wavelen);
+
+				/** Print a table with one line per field and wavelength */
+				void print_table (std::ostream &o);
+
+			private:
+				void process_trace ();
+
+				struct field_s
+				{
+					sys::SourceInfinityMode _mode;
+					math::Vector3 _pos_dir;
+					double _angle;
+				};
+
+				struct cell_s
+				{
+					math::Vector3 _centroid;
+					math::Vector3 _chief;
+					double _rms_radius;
+					double _generated;
+					double _intercepted;
+					unsigned int _ray_count;
+				};
+
+				inline const cell_s &get_cell (unsigned int field, unsigned int wavelen);
+
+				std::vector<field_s> _fields;
+				std::vector<double> _wavelens;
+				std::vector<cell_s> _cells;
+				// sources of last trace, not part of the system, rays
+				// keep pointers to them
+				std::vector<std::shared_ptr<sys::Source> > _sources;
+		};
+
+		void
+		FieldSweep::invalidate ()
+		{
+			_processed_trace = false;
+		}
+
+		unsigned int
+		FieldSweep::get_field_count () const
+		{
+			return _fields.size ();
+		}
+
+		unsigned int
+		FieldSweep::get_wavelen_count () const
+		{
+			return _wavelens.empty () ? 1 : _wavelens.size ();
+		}
+
+		const FieldSweep::cell_s &
+		FieldSweep::get_cell (unsigned int field, unsigned int wavelen)
+		{
+			process_trace ();
+			if (field >= _fields.size () || wavelen >= get_wavelen_count ())
+			{
+				throw Error ("field sweep index out of range");
+			}
+			return _cells[field * get_wavelen_count () + wavelen];
+		}
+
+		double
+		FieldSweep::get_rms_radius (unsigned int field, unsigned int wavelen)
+		{
+			return get_cell (field, wavelen)._rms_radius;
+		}
+
+		const math::Vector3 &
+		FieldSweep::get_centroid (unsigned int field, unsigned int wavelen)
+		{
+			return get_cell (field, wavelen)._centroid;
+		}
+
+		unsigned int
+		FieldSweep::get_ray_count (unsigned int field, unsigned int wavelen)
+		{
+			return get_cell (field, wavelen)._ray_count;
+		}
+
+		const math::Vector3 &
+		FieldSweep::get_chief_intercept (unsigned int field, unsigned int wavelen)
+		{
+			return get_cell (field, wavelen)._chief;
+		}
+
+		double
+		FieldSweep::get_vignetting (unsigned int field, unsigned int wavelen)
+		{
+			const cell_s &c = get_cell (field, wavelen);
+			return c._generated > 0. ? 1. - c._intercepted / c._generated : 1.;
+		}
+
+	}
+}
+
+namespace goptical
+{
+	namespace analysis
+	{
+		using goptical::analysis::FieldSweep;
+	}
+}
+#endif
@@ -25,6 +25,9 @@
 #ifndef GOPTICAL_ANALYSIS_SPOT_HH_
 #define GOPTICAL_ANALYSIS_SPOT_HH_
 
+#include <utility>
+#include <vector>
+
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/data/plot.hpp"
@@ -69,6 +72,36 @@ namespace goptical
 				/** Get spot centroid */
 				inline const math::Vector3 &get_centroid ();
 
+				/** Enable adaptive pupil sampling. Rays are first
+				    distributed on a coarse grid over the entrance surface,
+				    then pupil regions where image points vary the most are
+				    refined until estimated errors on rms radius and
+				    centroid are below @tt tolerance times the rms radius
+				    or sample count exceeds @tt max_samples. Initial grid
+				    density and scaling are taken from the entrance surface
+				    distribution. Only samples of refined regions are
+				    traced at each step, rays of retained samples are then
+				    merged in the tracer result. Intercept sinks of the
+				    tracer result are not fed in this mode. A null
+				    tolerance disables adaptive sampling. */
+				inline void set_adaptive_sampling (double tolerance,
+				                                   unsigned int max_samples = 16384);
+
+				/** Get number of rays used for analysis */
+				inline unsigned int get_ray_count ();
+
+				/** Get estimated error on rms radius, only available
+				    with adaptive sampling. This is the absolute change
+				    of rms radius between the last two refinement steps,
+				    @tt{fabs (rms - rms_prev)}. */
+				inline double get_rms_radius_error ();
+
+				/** Get estimated error on centroid position, only
+				    available with adaptive sampling. This is the
+				    distance between centroids of the last two
+				    refinement steps. */
+				inline double get_centroid_error ();
+
 				/** Get spot window center */
 				math::Vector3 get_center ();
 
@@ -76,6 +109,10 @@ namespace goptical
 				 * center */
 				double get_encircled_intensity (double radius);
 
+				/** Get amount of light intensity which falls in a square
+				    of given half width centered on spot centroid */
+				double get_ensquared_intensity (double half_width);
+
 				/** Get encircled energy plot */
 				std::shared_ptr<data::Plot> get_encircled_intensity_plot (int zones = 100);
 
@@ -97,8 +134,31 @@ namespace goptical
 			private:
 				void process_trace ();
 				void process_analysis ();
+				void adaptive_trace ();
+
+				/** rays distances to centroid in ascending order along
+				    with cumulative intensity */
+				struct energy_s
+				{
+					void set (const std::vector<std::pair<double, const trace::Ray *> > &
+					          sorted);
+					void add (double radius, double intensity);
+					double get (double radius) const;
+
+					std::vector<double> _radius;
+					std::vector<double> _cumulative;
+				};
 
 				math::Vector3 _centroid;
+				// analysis weight of intercepted rays, adaptive sampling only
+				std::vector<double> _weights;
+				double _adaptive_tolerance;
+				unsigned int _adaptive_max_samples;
+				double _rms_error;
+				double _centroid_error;
+				energy_s _encircled;
+				energy_s _ensquared;
+				std::vector<std::pair<double, energy_s> > _encircled_wavelen;
 
 				bool _processed_analysis;
 				double _max_radius;
@@ -144,6 +204,35 @@ namespace goptical
 			return _centroid;
 		}
 
+		void
+		Spot::set_adaptive_sampling (double tolerance, unsigned int max_samples)
+		{
+			_adaptive_tolerance = tolerance;
+			_adaptive_max_samples = max_samples;
+			invalidate ();
+		}
+
+		unsigned int
+		Spot::get_ray_count ()
+		{
+			process_trace ();
+			return _intercepts->size ();
+		}
+
+		double
+		Spot::get_rms_radius_error ()
+		{
+			process_analysis ();
+			return _rms_error;
+		}
+
+		double
+		Spot::get_centroid_error ()
+		{
+			process_analysis ();
+			return _centroid_error;
+		}
+
 		void
 		Spot::set_useful_radius (double radius)
 		{
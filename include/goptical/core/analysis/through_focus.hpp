@@ -0,0 +1,166 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_ANALYSIS_THROUGH_FOCUS_HH_
+#define GOPTICAL_ANALYSIS_THROUGH_FOCUS_HH_
+
+#include <utility>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/data/plot.hpp"
+#include "goptical/core/math/vector.hpp"
+#include "goptical/core/math/vector_pair.hpp"
+
+#include "goptical/core/analysis/pointimage.hpp"
+
+namespace goptical
+{
+
+	namespace analysis
+	{
+
+		/**
+		   @short Through focus analysis
+		   @header <goptical/core/analysis/ThroughFocus
+		   @module {Core}
+		   @main
+
+		   This class evaluates spot size and wavefront error on
+		   planes parallel to the image, using rays intercepted by
+		   the image in a single ray trace. System is left untouched.
+
+		   Defocus is measured along the image local z axis from the
+		   image origin. Rays propagate along straight lines in image
+		   space, so the mean square spot radius and wavefront error
+		   are quadratic in defocus. They are evaluated from ray
+		   moments for any number of planes without propagating rays.
+		*/
+		class ThroughFocus : public PointImage
+		{
+			public:
+				ThroughFocus (std::shared_ptr<sys::System> &system);
+
+				inline void invalidate ();
+
+				/** Get spot root mean square radius on plane at given defocus */
+				double get_rms_radius (double defocus);
+
+				/** Get spot centroid on plane at given defocus, in image
+				    coordinates */
+				math::Vector3 get_centroid (double defocus);
+
+				/** Get defocus of plane with smallest rms spot radius */
+				inline double get_min_rms_focus ();
+
+				/** Get root mean square wavefront error in waves on plane
+				    at given defocus. Reference sphere is centered on the
+				    plane at the point which minimizes wavefront error.
+				    Piston is removed for each wavelength. Requires ray
+				    genealogy. */
+				double get_rms_wavefront (double defocus);
+
+				/** Get defocus of plane with smallest rms wavefront error */
+				inline double get_min_wavefront_focus ();
+
+				/** Get focus plane at given defocus in system global
+				    coordinates, suitable for @ref sys::Image::set_plane */
+				math::VectorPair3 get_focus_plane (double defocus);
+
+				/** Get rms spot radius and rms wavefront error plots for
+				    planes evenly spaced in [from, to] defocus range */
+				std::shared_ptr<data::Plot> get_rms_radius_plot (double from, double to,
+				        int count = 100);
+				std::shared_ptr<data::Plot> get_rms_wavefront_plot (double from, double to,
+				        int count = 100);
+
+			private:
+				void process_focus ();
+				void process_wavefront ();
+
+				/** coefficients of a quadratic in defocus */
+				struct quadratic_s
+				{
+					inline double get (double z) const;
+					inline double get_min () const;
+
+					double _c0, _c1, _c2;
+				};
+
+				bool _processed_focus;
+				bool _processed_wavefront;
+				// centroid on plane z is _centroid_a + _centroid_b * z
+				math::Vector2 _centroid_a;
+				math::Vector2 _centroid_b;
+				quadratic_s _spot_ms;
+				quadratic_s _wavefront_ms;
+		};
+
+		void
+		ThroughFocus::invalidate ()
+		{
+			_processed_trace = false;
+			_processed_focus = false;
+			_processed_wavefront = false;
+		}
+
+		double
+		ThroughFocus::get_min_rms_focus ()
+		{
+			process_focus ();
+			return _spot_ms.get_min ();
+		}
+
+		double
+		ThroughFocus::get_min_wavefront_focus ()
+		{
+			process_wavefront ();
+			return _wavefront_ms.get_min ();
+		}
+
+		double
+		ThroughFocus::quadratic_s::get (double z) const
+		{
+			return std::max (0., _c0 + z * (_c1 + z * _c2));
+		}
+
+		double
+		ThroughFocus::quadratic_s::get_min () const
+		{
+			return _c2 > 0. ? -_c1 / (2. * _c2) : 0.;
+		}
+
+	}
+}
+
+namespace goptical
+{
+	namespace analysis
+	{
+		using goptical::analysis::ThroughFocus;
+	}
+}
+#endif
@@ -164,8 +164,14 @@ namespace goptical
 		    TriangularDist,
 		    /** Hexapolar pattern, suitable for circular shapes */
 		    HexaPolarDist,
-		    /** Random distribution */
-		    RandomDist
+		    /** Random distribution, jittered square grid */
+		    RandomDist,
+		    /** Randomized Halton quasi random sequence mapped on disk */
+		    HaltonDist,
+		    /** Randomized Sobol quasi random sequence mapped on disk */
+		    SobolDist,
+		    /** Jittered samples in equal area stratas of the disk */
+		    StratifiedDist
 		};
 
 		/** Specifies light intensity calculation mode to use by light propagation
@@ -182,6 +188,37 @@ namespace goptical
 		    Polarizedtrace
 		};
 
+		/** Specifies formula used to compute refracted rays direction */
+		enum RefractionLaw
+		{
+		    /** Feder refraction formula, default */
+		    RefractionFeder,
+		    /** Vector form of Snell law, from Bram de Greve article
+		        "Reflections & Refractions in Raytracing" */
+		    RefractionDeGreve,
+		};
+
+		/** Specifies which links between traced rays are maintained by
+		    light propagation algorithms. */
+		enum GenealogyMode
+		{
+		    /** Each ray knows its parent ray and the list of rays it
+		        generated, default */
+		    GenealogyFull,
+		    /** Only rays which are part of a saved rays list are allocated
+		        by sequential ray traces. Each ray knows the closest
+		        allocated ray it descends from but no children list is
+		        maintained. With a saved image intercepts list, a ray trace
+		        through N surfaces allocates 2 rays per source ray instead
+		        of N + 1 while the source ray stays reachable with @ref
+		        trace::Ray::get_parent. */
+		    GenealogyCompact,
+		    /** No link between rays is maintained. Rays objects which are
+		        not part of a saved rays list may not be allocated at all,
+		        this reduces the rays count but not the size of a ray */
+		    GenealogyNone,
+		};
+
 		/** @experimental @hidden
 		    Specifies physical light propagation algorithm/model */
 		enum PropagationMode
@@ -461,6 +498,7 @@ namespace goptical
 	{
 		using namespace goptical::sys;
 
+		class CompiledSystem;
 		class Container;
 		class System;
 		class Element;
@@ -484,14 +522,21 @@ namespace goptical
 		using namespace goptical::trace;
 
 		class Distribution;
+		class IndexTable;
 		class Tracer;
 		class Params;
+		class Plan;
 		class Ray;
+		class RayBatch;
+		class RefractionStats;
 		class Result;
+		class ResultSink;
 		class Element;
 		class Sequence;
 
-		typedef std::deque<Ray *> rays_queue_t;
+		/** Rays list, storage is kept on clear so that lists can be
+		    reused across ray traces */
+		typedef std::vector<Ray *> rays_queue_t;
 
 	}
 
@@ -612,6 +657,9 @@ namespace goptical
 		class Conic;
 		class Foucault;
 		class Array;
+		class IntersectStats;
+		class Tabulated;
+		class Zernike;
 	}
 
 	/** @module {Core}
@@ -622,6 +670,8 @@ namespace goptical
 		class Spot;
 		class Focus;
 		class RayFan;
+		class FieldSweep;
+		class ThroughFocus;
 	}
 
 	namespace util
@@ -63,6 +63,8 @@ namespace goptical
 				double sagitta (const math::Vector2 &xy) const;
 				/** @override */
 				void derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const;
+				/** @override */
+				unsigned int get_version () const;
 
 			private:
 				typedef math::Vector2 (Array::*transform_t) (const math::Vector2 &v) const;
@@ -54,6 +54,7 @@ namespace goptical
 		class Base
 		{
 			public:
+				inline Base ();
 				virtual inline ~Base ();
 
 				/** Get curve sagitta (z) at specified point */
@@ -63,19 +64,78 @@ namespace goptical
 				 * point */
 				virtual void derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const;
 
+				/** Get both curve sagitta and gradient at specified
+				    point. The default implementation calls @ref sagitta
+				    and @ref derivative, curves which can share work between
+				    both evaluations should override it. This is used by the
+				    default @ref intersect implementation. */
+				virtual void sagitta_derivative (const math::Vector2 &xy, double &z,
+				                                 math::Vector2 &dxdy) const;
+
 				/** Get intersection point between curve and 3d ray. Return
 				    false if no intersection occurred. ray must have a position vector and
-				    direction vector (cosines). */
+				    direction vector (cosines).
+
+				    The default implementation starts from the sphere
+				    tangent to the z=0 plane at origin which goes through the
+				    curve point above the ray intersection with this plane.
+				    It then runs Newton iterations along the ray, using the
+				    curve gradient, and falls back to bisection over a
+				    bracketing interval when Newton iterations fail. */
 				virtual bool intersect (math::Vector3 &point,
 				                        const math::VectorPair3 &ray) const;
 
+				GOPTICAL_ACCESSORS (double, intersect_tolerance,
+				                    "distance along the ray below which the generic "
+				                    "intersection solver stops iterating, default is 1e-10");
+
+				GOPTICAL_ACCESSORS (IntersectStats *, intersect_stats,
+				                    "when not null, the generic intersection solver "
+				                    "records its iterations in this object, default is null");
+
 				/** Get normal to curve surface at specified point. */
 				virtual void normal (math::Vector3 &normal,
 				                     const math::Vector3 &point) const;
+
+				/** Get a range of z values which contains all intersection
+				    points found by @ref intersect at a distance to the z axis
+				    lower than radius. Return false if no such range is
+				    known for the curve. */
+				virtual bool get_intersect_z_range (double radius, double &zmin,
+				                                    double &zmax) const;
+
+				/** Get curve version. It changes each time curve
+				    parameters are modified, curves built from other curves
+				    include versions of their base curves. */
+				virtual inline unsigned int get_version () const;
+
+			protected:
+				/** Must be called by functions which modify curve
+				    parameters */
+				inline void update_version ();
+
+			private:
+				double _intersect_tolerance;
+				IntersectStats *_intersect_stats;
+				unsigned int _version;
 		};
 
+		Base::Base () : _intersect_tolerance (1e-10), _intersect_stats (0), _version (0) {}
+
 		Base::~Base () {}
 
+		unsigned int
+		Base::get_version () const
+		{
+			return _version;
+		}
+
+		void
+		Base::update_version ()
+		{
+			_version++;
+		}
+
 	}
 }
 
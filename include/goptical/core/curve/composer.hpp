@@ -76,6 +76,8 @@ namespace goptical
 
 					private:
 						std::shared_ptr<Base> _curve;
+						/* changes count of transforms */
+						unsigned int _version;
 						math::Transform<2> _transform;
 						math::Transform<2> _inv_transform;
 
@@ -93,6 +95,9 @@ namespace goptical
 				double sagitta (const math::Vector2 &xy) const;
 				void derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const;
 
+				/** @override */
+				unsigned int get_version () const;
+
 			private:
 				std::list<Attributes> _list;
 		};
@@ -101,6 +106,7 @@ namespace goptical
 		Composer::Attributes::z_scale (double zfactor)
 		{
 			_z_scale *= zfactor;
+			_version++;
 			return *this;
 		}
 
@@ -108,6 +114,7 @@ namespace goptical
 		Composer::Attributes::z_offset (double zoffset)
 		{
 			_z_offset += zoffset;
+			_version++;
 			return *this;
 		}
 
@@ -116,6 +123,7 @@ namespace goptical
 		{
 			_transform.affine_scaling (factor);
 			_inv_transform = _transform.inverse ();
+			_version++;
 			return *this;
 		}
 
@@ -124,6 +132,7 @@ namespace goptical
 		{
 			_transform.affine_rotation (0, angle);
 			_inv_transform = _transform.inverse ();
+			_version++;
 			return *this;
 		}
 
@@ -132,6 +141,7 @@ namespace goptical
 		{
 			_transform.apply_translation (offset);
 			_inv_transform = _transform.inverse ();
+			_version++;
 			return *this;
 		}
 
@@ -83,12 +83,14 @@ namespace goptical
 		Conic::set_eccentricity (double e)
 		{
 			_sh = -math::square (e) + 1.0;
+			update_version ();
 		}
 
 		void
 		Conic::set_schwarzschild (double sc)
 		{
 			_sh = sc + 1.0;
+			update_version ();
 		}
 	}
 
@@ -59,6 +59,9 @@ namespace goptical
 				/** get eccentricity */
 				inline double get_eccentricity () const;
 
+				/** get Schwarzschild constant + 1 as used in curve equations */
+				inline double get_sh () const;
+
 				/** Adjust radius of curvature to best fit given
 				    curve. Deformation Won't be changed by this function. See
 				    Conic::fit() to adjust deformation too.
@@ -71,12 +74,19 @@ namespace goptical
 
 				virtual bool intersect (math::Vector3 &point,
 				                        const math::VectorPair3 &ray) const = 0;
+				/** @override Intersection points lie on the quadric
+				    surface, both sheets are covered. */
+				bool get_intersect_z_range (double radius, double &zmin,
+				                            double &zmax) const;
 				virtual double sagitta (double r) const = 0;
 				virtual double derivative (double r) const = 0;
 
 			protected:
 				inline ConicBase (double roc, double sc);
 
+				/** @override */
+				void roc_changed ();
+
 				double _sh; // Schwarzschild constant + 1
 		};
 
@@ -88,6 +98,12 @@ namespace goptical
 			return sqrt (-_sh + 1.0);
 		}
 
+		double
+		ConicBase::get_sh () const
+		{
+			return _sh;
+		}
+
 		double
 		ConicBase::get_schwarzschild () const
 		{
@@ -49,16 +49,23 @@ namespace goptical
 
 			protected:
 				inline curveRoc (double roc);
+				virtual inline ~curveRoc ();
+
+				/** Called when radius of curvature is changed */
+				virtual void roc_changed () = 0;
 
 				double _roc;
 		};
 
 		curveRoc::curveRoc (double roc) : _roc (roc) {}
 
+		curveRoc::~curveRoc () {}
+
 		void
 		curveRoc::set_roc (double roc)
 		{
 			_roc = roc;
+			roc_changed ();
 		}
 
 		double
@@ -0,0 +1,112 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_CURVE_DUAL_HH_
+#define GOPTICAL_CURVE_DUAL_HH_
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/curve/base.hpp"
+#include "goptical/core/curve/rotational.hpp"
+#include "goptical/core/math/dual.hpp"
+#include "goptical/core/math/vector.hpp"
+
+namespace goptical
+{
+
+	namespace curve
+	{
+
+		/**
+		   @short Rotationally symmetric curve with automatic derivative
+		   @header <goptical/core/curve/dual.hpp>
+		   @module {Core}
+
+		   This class template can be used as base class for user
+		   defined rotationally symmetric curves. The derived class @tt
+		   X must provide a public @tt {template <typename T> T
+		   sagitta_t (T r) const} function.
+
+		   This function is instantiated with @tt double to compute
+		   the sagitta and with @ref math::Dual to compute the exact
+		   derivative, instead of using numerical differentiation.
+		 */
+		template <class X> class DualRotational : public Rotational
+		{
+			public:
+				double sagitta (double r) const
+				{
+					return static_cast<const X *> (this)->sagitta_t (r);
+				}
+
+				double derivative (double r) const
+				{
+					return static_cast<const X *> (this)
+					       ->sagitta_t (math::Dual (r, 1.0))
+					       .get_derivative ();
+				}
+
+				using Rotational::sagitta;
+				using Rotational::derivative;
+		};
+
+		/**
+		   @short Curve with automatic derivatives
+		   @header <goptical/core/curve/dual.hpp>
+		   @module {Core}
+
+		   This class template can be used as base class for user
+		   defined non symmetric curves. The derived class @tt X must
+		   provide a public @tt {template <typename T> T sagitta_t (T x,
+		   T y) const} function.
+
+		   Partial derivatives are computed exactly by evaluating this
+		   function with @ref math::Dual arguments.
+
+		   @see DualRotational
+		 */
+		template <class X> class DualBase : public Base
+		{
+			public:
+				double sagitta (const math::Vector2 &xy) const
+				{
+					return static_cast<const X *> (this)->sagitta_t (xy.x (), xy.y ());
+				}
+
+				void derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const
+				{
+					const X *c = static_cast<const X *> (this);
+					dxdy.x () = c->sagitta_t (math::Dual (xy.x (), 1.0),
+					                          math::Dual (xy.y ()))
+					            .get_derivative ();
+					dxdy.y () = c->sagitta_t (math::Dual (xy.x ()),
+					                          math::Dual (xy.y (), 1.0))
+					            .get_derivative ();
+				}
+		};
+
+	}
+}
+
+#endif
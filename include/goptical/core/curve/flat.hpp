@@ -53,6 +53,8 @@ namespace goptical
 
 				bool intersect (math::Vector3 &point, const math::VectorPair3 &ray) const;
 				void normal (math::Vector3 &normal, const math::Vector3 &point) const;
+				bool get_intersect_z_range (double radius, double &zmin,
+				                            double &zmax) const;
 
 				double sagitta (double r) const;
 				double derivative (double r) const;
@@ -34,6 +34,7 @@
 #include "curve_roc.hpp"
 #include "goptical/core/curve/rotational.hpp"
 #include "goptical/core/data/discrete_set.hpp"
+#include "goptical/core/prepare_flag.hpp"
 
 namespace goptical
 {
@@ -148,6 +149,10 @@ namespace goptical
 				double derivative (double r) const;
 
 			private:
+				/** @override */
+				void roc_changed ();
+
+				void prepare () const;
 				void update ();
 				void init ();
 
@@ -161,13 +166,14 @@ namespace goptical
 				double _ode_step;
 				data::DiscreteSet _reading;
 				data::DiscreteSet _sagitta;
-				bool _updated;
+				util::PrepareFlag _prepared;
 		};
 
 		void
 		Foucault::set_moving_source (double offset)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			_moving_source = true;
 			_offset = offset;
 			clear ();
@@ -176,7 +182,8 @@ namespace goptical
 		void
 		Foucault::set_fixed_source (double source_to_surface)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			_moving_source = false;
 			_offset = source_to_surface;
 			clear ();
@@ -185,7 +192,8 @@ namespace goptical
 		void
 		Foucault::set_radius (double radius)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			_radius = radius;
 		}
 
@@ -198,7 +206,8 @@ namespace goptical
 		void
 		Foucault::set_ode_stepsize (double step)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			_ode_step = step;
 		}
 
@@ -211,6 +220,8 @@ namespace goptical
 		void
 		Foucault::set_knife_offset (unsigned int zone_number, double knife_offset)
 		{
+			_prepared.reset ();
+			update_version ();
 			_reading.get_y_value (zone_number) = knife_offset;
 		}
 
@@ -63,7 +63,8 @@ namespace goptical
 				/** Get embedded sagitta/gradient data container */
 				inline const data::Grid &get_data () const;
 
-				/** Get embedded sagitta/gradient data container */
+				/** Get embedded sagitta/gradient data container. Curve
+				    version is updated as data may be modified. */
 				inline data::Grid &get_data ();
 
 				/** Set grid values to best fit an other curve. Gradient data
@@ -73,6 +74,8 @@ namespace goptical
 
 				double sagitta (const math::Vector2 &xy) const;
 				void derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const;
+				void sagitta_derivative (const math::Vector2 &xy, double &z,
+				                         math::Vector2 &dxdy) const;
 
 			protected:
 				data::Grid _data;
@@ -87,6 +90,7 @@ namespace goptical
 		data::Grid &
 		Grid::get_data ()
 		{
+			update_version ();
 			return _data;
 		}
 
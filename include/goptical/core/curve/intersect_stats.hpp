@@ -0,0 +1,132 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_CURVE_INTERSECT_STATS_HH_
+#define GOPTICAL_CURVE_INTERSECT_STATS_HH_
+
+#include <atomic>
+
+#include "goptical/core/common.hpp"
+
+namespace goptical
+{
+
+	namespace curve
+	{
+
+		/**
+		   @short Curve intersection solver statistics
+		   @header <goptical/core/curve/intersect_stats.hpp>
+		   @module {Core}
+
+		   When attached to a curve, the generic iterative intersection
+		   solver of @ref Base::intersect records its iteration counts,
+		   bracketed fallbacks and failures in this object. Several
+		   curves may share the same stats object.
+
+		   This object may be updated concurrently by tracer threads.
+
+		   @see Base::set_intersect_stats
+		 */
+		class IntersectStats
+		{
+			public:
+				IntersectStats ();
+
+				/** Reset counters */
+				void clear ();
+
+				/** Record a solver run */
+				void add (unsigned int iterations, bool bracketed, bool converged);
+
+				/** Get number of solver runs */
+				inline unsigned long get_count () const;
+
+				/** Get total number of iterations, each iteration evaluates
+				    curve sagitta and gradient once */
+				inline unsigned long get_iteration_count () const;
+
+				/** Get largest number of iterations of a single run */
+				inline unsigned int get_max_iterations () const;
+
+				/** Get mean number of iterations per run */
+				inline double get_mean_iterations () const;
+
+				/** Get number of runs where Newton iterations did not
+				    converge and the bracketed solver was used */
+				inline unsigned long get_bracketed_count () const;
+
+				/** Get number of runs which did not converge to an
+				    intersection point */
+				inline unsigned long get_failure_count () const;
+
+			private:
+				std::atomic<unsigned long> _count;
+				std::atomic<unsigned long> _iteration_count;
+				std::atomic<unsigned int> _max_iterations;
+				std::atomic<unsigned long> _bracketed_count;
+				std::atomic<unsigned long> _failure_count;
+		};
+
+		unsigned long
+		IntersectStats::get_count () const
+		{
+			return _count;
+		}
+
+		unsigned long
+		IntersectStats::get_iteration_count () const
+		{
+			return _iteration_count;
+		}
+
+		unsigned int
+		IntersectStats::get_max_iterations () const
+		{
+			return _max_iterations;
+		}
+
+		double
+		IntersectStats::get_mean_iterations () const
+		{
+			unsigned long count = _count;
+			return count ? (double)_iteration_count / count : 0.0;
+		}
+
+		unsigned long
+		IntersectStats::get_bracketed_count () const
+		{
+			return _bracketed_count;
+		}
+
+		unsigned long
+		IntersectStats::get_failure_count () const
+		{
+			return _failure_count;
+		}
+
+	}
+}
+
+#endif
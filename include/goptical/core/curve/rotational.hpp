@@ -47,6 +47,8 @@ namespace goptical
 		   provide default implementation as generic non symmetric curve.
 		   A derived curve need only implement the sagitta(double r) method.
 		   In this case the derivatives will be computed numerically.
+
+		   @see DualRotational
 		 */
 		class Rotational : public Base
 		{
@@ -60,7 +60,8 @@ namespace goptical
 				/** Get sagitta/derivative data container */
 				inline const data::DiscreteSet &get_data () const;
 
-				/** get sagitta/derivative data container */
+				/** Get sagitta/derivative data container. Curve version is
+				    updated as data may be modified. */
 				inline data::DiscreteSet &get_data ();
 
 				/** Clear all points and fit to an other rotationally symmetric curve.
@@ -86,6 +87,7 @@ namespace goptical
 		data::DiscreteSet &
 		Spline::get_data ()
 		{
+			update_version ();
 			return _data;
 		}
 
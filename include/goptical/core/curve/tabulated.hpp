@@ -0,0 +1,197 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_CURVE_TABULATED_HH_
+#define GOPTICAL_CURVE_TABULATED_HH_
+
+#include <algorithm>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/curve/rotational.hpp"
+#include "goptical/core/data/sample_set.hpp"
+
+namespace goptical
+{
+
+	namespace curve
+	{
+
+		/**
+		   @short Tabulated approximation of a rotationally symmetric curve
+		   @header <goptical/core/curve/Tabulated
+		   @module {Core}
+		   @main
+
+		   This class samples sagitta and derivative of an other
+		   rotationally symmetric curve once on uniformly spaced radii
+		   and uses piecewise cubic hermite interpolation to evaluate
+		   the curve. Each cubic is evaluated in its own interval
+		   coordinate so that accuracy is preserved with many samples.
+		   It can be used in place of curves which are expensive to
+		   evaluate, like high order @ref Asphere or @ref Polynomial
+		   curves.
+
+		   The number of samples is chosen so that the interpolated
+		   sagitta and derivative differ from the original curve by
+		   less than the requested bounds. Beyond the tabulated radius,
+		   the original curve is used.
+
+		   The original curve is also used when it has been modified
+		   since it was sampled, until @ref update is called.
+
+		   @see Spline
+		*/
+		class Tabulated : public Rotational
+		{
+			public:
+				/** Create a tabulated version of a curve.
+				    @param curve Curve to tabulate
+				    @param radius Maximum radius where the curve is tabulated
+				    @param max_sag_error Maximum allowed sagitta error
+				    @param max_slope_error Maximum allowed derivative error
+				*/
+				Tabulated (const std::shared_ptr<Rotational> &curve, double radius,
+				           double max_sag_error = 1e-9, double max_slope_error = 1e-9);
+				~Tabulated ();
+
+				/** Get original curve */
+				inline const Rotational &get_curve () const;
+
+				/** Get maximum tabulated radius */
+				inline double get_radius () const;
+
+				/** Get sagitta/derivative samples container */
+				inline const data::SampleSet &get_data () const;
+
+				/** Get largest sagitta error measured between samples */
+				inline double get_sag_error () const;
+
+				/** Get largest derivative error measured between samples */
+				inline double get_slope_error () const;
+
+				/** Sample original curve again if it has been modified
+				    since last tabulation */
+				void update ();
+
+				unsigned int get_version () const;
+
+				inline double sagitta (double r) const;
+				inline double derivative (double r) const;
+
+				bool get_intersect_z_range (double radius, double &zmin,
+				                            double &zmax) const;
+
+			private:
+				/* cubic polynomial of interval coordinate in [0, 1] */
+				struct poly_s
+				{
+					double c[4];
+				};
+
+				void tabulate ();
+				void sample (unsigned int intervals);
+				void measure_error ();
+				inline const poly_s &get_poly (double r, double &t) const;
+
+				std::shared_ptr<Rotational> _curve;
+				unsigned int _curve_version;
+				double _radius;
+				double _max_sag_error;
+				double _max_slope_error;
+				double _inv_step;
+				data::SampleSet _data;
+				std::vector<poly_s> _poly;
+				double _sag_error;
+				double _slope_error;
+		};
+
+		const Rotational &
+		Tabulated::get_curve () const
+		{
+			return *_curve;
+		}
+
+		double
+		Tabulated::get_radius () const
+		{
+			return _radius;
+		}
+
+		const data::SampleSet &
+		Tabulated::get_data () const
+		{
+			return _data;
+		}
+
+		double
+		Tabulated::get_sag_error () const
+		{
+			return _sag_error;
+		}
+
+		double
+		Tabulated::get_slope_error () const
+		{
+			return _slope_error;
+		}
+
+		const Tabulated::poly_s &
+		Tabulated::get_poly (double r, double &t) const
+		{
+			double u = std::max (r * _inv_step, 0.0);
+			unsigned int i = std::min ((unsigned int)u, (unsigned int)_poly.size () - 1);
+			t = u - i;
+			return _poly[i];
+		}
+
+		double
+		Tabulated::sagitta (double r) const
+		{
+			if (r > _radius || _curve->get_version () != _curve_version)
+			{
+				return _curve->sagitta (r);
+			}
+			double t;
+			const poly_s &p = get_poly (r, t);
+			return ((p.c[3] * t + p.c[2]) * t + p.c[1]) * t + p.c[0];
+		}
+
+		double
+		Tabulated::derivative (double r) const
+		{
+			if (r > _radius || _curve->get_version () != _curve_version)
+			{
+				return _curve->derivative (r);
+			}
+			double t;
+			const poly_s &p = get_poly (r, t);
+			return ((3.0 * p.c[3] * t + 2.0 * p.c[2]) * t + p.c[1]) * _inv_step;
+		}
+
+	}
+}
+
+#endif
@@ -119,6 +119,8 @@ namespace goptical
 
 				double sagitta (const math::Vector2 &xy) const;
 				void derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const;
+				void sagitta_derivative (const math::Vector2 &xy, double &z,
+				                         math::Vector2 &dxdy) const;
 
 				/** Evaluate zernike polynomial n */
 				static double zernike_poly (unsigned int n, const math::Vector2 &xy);
@@ -129,18 +131,26 @@ namespace goptical
 			private:
 				void update_threshold_state ();
 
+				template <bool deriv>
+				inline double evaluate (const math::Vector2 &xy,
+				                        math::Vector2 &dxdy) const;
+
 				double _scale;
 				double _threshold;
 				double _radius;
 				double _coeff[term_count];
 				unsigned int _enabled_count;
 				unsigned char _enabled_list[term_count];
+				/* highest radial index needed by enabled terms for each
+				   azimuthal order, -1 if none */
+				signed char _max_k[6];
 		};
 
 		void
 		Zernike::set_radius (double radius)
 		{
 			_radius = radius;
+			update_version ();
 		}
 
 		double
@@ -154,6 +164,7 @@ namespace goptical
 		{
 			assert (n < term_count);
 			_coeff[n] = c;
+			update_version ();
 			set_term_state (n, fabs (c) >= _threshold);
 		}
 
@@ -168,6 +179,7 @@ namespace goptical
 		Zernike::set_coefficients_threshold (double t)
 		{
 			_threshold = t;
+			update_version ();
 			update_threshold_state ();
 		}
 
@@ -175,6 +187,7 @@ namespace goptical
 		Zernike::set_coefficients_scale (double s)
 		{
 			_scale = s;
+			update_version ();
 		}
 	}
 }
@@ -29,6 +29,8 @@
 
 #include "goptical/core/common.hpp"
 
+#include "goptical/core/prepare_flag.hpp"
+
 namespace goptical
 {
 
@@ -59,6 +61,12 @@ namespace goptical
 
 				void set_interpolation (Interpolation i);
 
+				/** Compute interpolation data for current data set content.
+				    This is done on first interpolation, preparing early
+				    makes the data set read only before sharing it between
+				    threads. */
+				void prepare () const;
+
 			private:
 				/** quadratic and cubic polynomial coefficients */
 				struct poly_s
@@ -100,36 +108,41 @@ namespace goptical
 				void compute_cubic_2nd_deriv (unsigned int n, double dd[], double d0,
 				                              double dn) const;
 
-				double update_nearest (unsigned int d, double x) const;
+				void update_nearest () const;
 				double interpolate_nearest (unsigned int d, double x) const;
 
-				double update_linear (unsigned int d, double x) const;
+				void update_linear () const;
 				double interpolate_linear (unsigned int d, double x) const;
 
-				double update_quadratic (unsigned int d, double x) const;
+				void update_quadratic () const;
 				double interpolate_quadratic (unsigned int d, double x) const;
 
-				double update_cubic (unsigned int d, double x) const;
-				double update_cubic2 (unsigned int d, double x) const;
-				double update_cubic_deriv (unsigned int d, double x) const;
-				double update_cubic2_deriv (unsigned int d, double x) const;
-				double update_cubic_simple (unsigned int d, double x) const;
-				double update_cubic_deriv_init (unsigned int d, double x) const;
-				double update_cubic2_deriv_init (unsigned int d, double x) const;
+				void update_cubic () const;
+				void update_cubic2 () const;
+				void update_cubic_deriv () const;
+				void update_cubic2_deriv () const;
+				void update_cubic_simple () const;
+				void update_cubic_deriv_init () const;
+				void update_cubic2_deriv_init () const;
 				double interpolate_cubic (unsigned int d, double x) const;
 
 				void invalidate ();
 
-				double (Interpolate1d::*_update) (unsigned int d, double x) const;
+				void (Interpolate1d::*_update) () const;
 				double (Interpolate1d::*_interpolate) (unsigned int d, double x) const;
 
 				std::vector<struct poly_s> _poly;
+				util::PrepareFlag _prepared;
 		};
 
 		template <class X>
 		double
 		Interpolate1d<X>::interpolate (double x) const
 		{
+			if (!_prepared.is_prepared ())
+			{
+				prepare ();
+			}
 			return (this->*_interpolate) (0, x);
 		}
 
@@ -137,6 +150,10 @@ namespace goptical
 		double
 		Interpolate1d<X>::interpolate (double x, unsigned int d) const
 		{
+			if (!_prepared.is_prepared ())
+			{
+				prepare ();
+			}
 			return (this->*_interpolate) (d, x);
 		}
 
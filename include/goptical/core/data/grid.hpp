@@ -31,6 +31,7 @@
 
 #include "goptical/core/data/set.hpp"
 #include "goptical/core/math/vector.hpp"
+#include "goptical/core/prepare_flag.hpp"
 
 namespace goptical
 {
@@ -127,6 +128,25 @@ namespace goptical
 				    currently selected interpolation algorithm */
 				inline math::Vector2 interpolate_deriv (const math::Vector2 &v) const;
 
+				/** Interpolate both data and gradient at given 2d vector
+				    point on grid using currently selected interpolation
+				    algorithm. This is faster than separate calls to @ref
+				    interpolate and @ref interpolate_deriv with bicubic
+				    interpolation as the grid cell is looked up once and
+				    the patch polynomial is evaluated in a single pass. */
+				inline double interpolate (const math::Vector2 &v,
+				                           math::Vector2 &deriv) const;
+
+				/** Set whether bicubic patch polynomial coefficients are
+				    precomputed for all grid cells when the grid is prepared
+				    (default). When disabled, only knot derivatives are
+				    stored and coefficients are computed on each
+				    interpolation, using 4 times less memory at the expense
+				    of slower interpolation. */
+				inline void set_patch_table (bool enable);
+				/** Get bicubic patch coefficients table state, see @ref set_patch_table */
+				inline bool get_patch_table () const;
+
 				// inherited from Set
 				inline unsigned int get_dimensions () const;
 				inline unsigned int get_count (unsigned int dimension) const;
@@ -138,17 +158,28 @@ namespace goptical
 				math::range_t get_x_range (unsigned int dimension) const;
 				void set_interpolation (Interpolation i);
 
+				/** Compute interpolation data for current grid content.
+				    This is done on first interpolation, preparing early
+				    makes the grid read only before sharing it between
+				    threads. */
+				void prepare () const;
+
 			private:
 				struct poly_t
 				{
 					double p[16];
 				};
 
-				void update_nearest (unsigned int x[2], const math::Vector2 &v) const;
-				void update_linear (unsigned int x[2], const math::Vector2 &v) const;
-				void update_bicubic (unsigned int x[2], const math::Vector2 &v) const;
-				void update_bicubic_diff (unsigned int x[2], const math::Vector2 &v) const;
-				void update_bicubic_deriv (unsigned int x[2], const math::Vector2 &v) const;
+				struct knot_t
+				{
+					double d[3];
+				};
+
+				void update_nearest () const;
+				void update_linear () const;
+				void update_bicubic () const;
+				void update_bicubic_diff () const;
+				void update_bicubic_deriv () const;
 
 				void lookup_nearest (unsigned int x[2], const math::Vector2 &v) const;
 				void lookup_interval (unsigned int x[2], const math::Vector2 &v) const;
@@ -167,6 +198,11 @@ namespace goptical
 				void interpolate_bicubic_d (const unsigned int x[2], math::Vector2 &d,
 				                            const math::Vector2 &v) const;
 
+				double interpolate_bicubic_yd (const unsigned int x[2], math::Vector2 &d,
+				                               const math::Vector2 &v) const;
+				double interpolate_generic_yd (const unsigned int x[2], math::Vector2 &d,
+				                               const math::Vector2 &v) const;
+
 				void resize_y (unsigned int x1, unsigned int x2);
 				void resize_yd (unsigned int x1, unsigned int x2);
 
@@ -183,23 +219,34 @@ namespace goptical
 
 				/** set bicubic polynomial coefficients */
 				static void set_poly (poly_t &p, const double t[16]);
+				/** fill patch table or knot table from knot derivatives
+				    scaled to grid steps */
+				void set_patches (const math::Vector2 d[], const double cd[]) const;
+				/** get bicubic polynomial coefficients of grid cell */
+				const poly_t &get_patch (const unsigned int x[2], poly_t &tmp) const;
 
 				unsigned int _size[2];
 
 				std::vector<double> _y_data;
 				std::vector<math::Vector2> _d_data;
 				std::vector<poly_t> _poly;
+				std::vector<knot_t> _knot;
 
-				void (Grid::*_update) (unsigned int x[2], const math::Vector2 &v) const;
+				void (Grid::*_update) () const;
 				void (Grid::*_lookup) (unsigned int x[2], const math::Vector2 &v) const;
 				double (Grid::*_interpolate_y) (const unsigned int x[2],
 				                                const math::Vector2 &v) const;
 				void (Grid::*_interpolate_d) (const unsigned int x[2], math::Vector2 &d,
 				                              const math::Vector2 &v) const;
+				double (Grid::*_interpolate_yd) (const unsigned int x[2],
+				                                 math::Vector2 &d,
+				                                 const math::Vector2 &v) const;
 				void (Grid::*_resize) (unsigned int x1, unsigned int x2);
+				util::PrepareFlag _prepared;
 
 				math::Vector2 _origin;
 				math::Vector2 _step;
+				bool _patch_table;
 		};
 
 		//     double & Grid::get_nearest_y_value(double x1, double x2)
@@ -292,6 +339,10 @@ namespace goptical
 		Grid::interpolate (const math::Vector2 &v) const
 		{
 			unsigned int x[2];
+			if (!_prepared.is_prepared ())
+			{
+				prepare ();
+			}
 			(this->*_lookup) (x, v);
 			return (this->*_interpolate_y) (x, v);
 		}
@@ -301,11 +352,40 @@ namespace goptical
 		{
 			math::Vector2 res;
 			unsigned int x[2];
+			if (!_prepared.is_prepared ())
+			{
+				prepare ();
+			}
 			(this->*_lookup) (x, v);
 			(this->*_interpolate_d) (x, res, v);
 			return res;
 		}
 
+		double
+		Grid::interpolate (const math::Vector2 &v, math::Vector2 &deriv) const
+		{
+			unsigned int x[2];
+			if (!_prepared.is_prepared ())
+			{
+				prepare ();
+			}
+			(this->*_lookup) (x, v);
+			return (this->*_interpolate_yd) (x, deriv, v);
+		}
+
+		void
+		Grid::set_patch_table (bool enable)
+		{
+			_patch_table = enable;
+			invalidate ();
+		}
+
+		bool
+		Grid::get_patch_table () const
+		{
+			return _patch_table;
+		}
+
 		void
 		Grid::set_metrics (const math::Vector2 &origin, const math::Vector2 &step)
 		{
@@ -350,7 +430,7 @@ namespace goptical
 		void
 		Grid::invalidate ()
 		{
-			_lookup = _update;
+			_prepared.reset ();
 		}
 
 	}
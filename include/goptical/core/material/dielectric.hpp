@@ -157,9 +157,6 @@ namespace goptical
 
 				/** medium used during refractive index measurement */
 				std::shared_ptr<Base> _measurement_medium;
-
-				mutable double _last_wavelen;
-				mutable double _last_get_refractive_index;
 		};
 
 		void
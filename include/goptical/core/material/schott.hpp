@@ -74,8 +74,6 @@ namespace goptical
 
 				std::vector<double> _coeff;
 				int _first;
-				mutable double _last_wavelen;
-				mutable double _last_wavelen_val;
 		};
 		void
 		Schott::set_term (int term, double K)
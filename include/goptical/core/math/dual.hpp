@@ -0,0 +1,374 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_MATH_DUAL_HH_
+#define GOPTICAL_MATH_DUAL_HH_
+
+#include <cmath>
+
+#include "goptical/core/common.hpp"
+
+namespace goptical
+{
+
+	namespace math
+	{
+
+		/**
+		   @short Dual number class
+		   @header <goptical/core/math/Dual
+		   @module {Core}
+
+		   This class holds a value along with its derivative with
+		   respect to a single variable. Arithmetic operators and
+		   elementary functions propagate the derivative with the
+		   chain rule (forward mode automatic differentiation).
+
+		   A function written as a template of its argument type can be
+		   evaluated with @tt double arguments to get its value or with
+		   a Dual seeded with a unit derivative to get both its value
+		   and its exact derivative.
+
+		   @see curve::DualRotational
+		 */
+		class Dual
+		{
+			public:
+				/** Create a dual number with zero value and derivative */
+				inline Dual ();
+
+				/** Create a dual number, a constant by default */
+				inline Dual (double value, double derivative = 0.0);
+
+				/** Get value */
+				inline double get_value () const;
+				/** Get derivative */
+				inline double get_derivative () const;
+
+				inline Dual operator- () const;
+				inline Dual &operator+= (const Dual &d);
+				inline Dual &operator-= (const Dual &d);
+				inline Dual &operator*= (const Dual &d);
+				inline Dual &operator/= (const Dual &d);
+
+			private:
+				double _value;
+				double _derivative;
+		};
+
+		Dual::Dual () : _value (0.0), _derivative (0.0) {}
+
+		Dual::Dual (double value, double derivative)
+			: _value (value), _derivative (derivative)
+		{
+		}
+
+		double
+		Dual::get_value () const
+		{
+			return _value;
+		}
+
+		double
+		Dual::get_derivative () const
+		{
+			return _derivative;
+		}
+
+		Dual
+		Dual::operator- () const
+		{
+			return Dual (-_value, -_derivative);
+		}
+
+		Dual &
+		Dual::operator+= (const Dual &d)
+		{
+			_value += d._value;
+			_derivative += d._derivative;
+			return *this;
+		}
+
+		Dual &
+		Dual::operator-= (const Dual &d)
+		{
+			_value -= d._value;
+			_derivative -= d._derivative;
+			return *this;
+		}
+
+		Dual &
+		Dual::operator*= (const Dual &d)
+		{
+			_derivative = _derivative * d._value + _value * d._derivative;
+			_value *= d._value;
+			return *this;
+		}
+
+		Dual &
+		Dual::operator/= (const Dual &d)
+		{
+			_derivative = (_derivative * d._value - _value * d._derivative)
+			              / (d._value * d._value);
+			_value /= d._value;
+			return *this;
+		}
+
+		static inline Dual
+		operator+ (Dual a, const Dual &b)
+		{
+			return a += b;
+		}
+
+		static inline Dual
+		operator- (Dual a, const Dual &b)
+		{
+			return a -= b;
+		}
+
+		static inline Dual
+		operator* (Dual a, const Dual &b)
+		{
+			return a *= b;
+		}
+
+		static inline Dual
+		operator/ (Dual a, const Dual &b)
+		{
+			return a /= b;
+		}
+
+		static inline Dual
+		operator+ (Dual a, double b)
+		{
+			return a += Dual (b);
+		}
+
+		static inline Dual
+		operator+ (double a, const Dual &b)
+		{
+			return Dual (a) + b;
+		}
+
+		static inline Dual
+		operator- (Dual a, double b)
+		{
+			return a -= Dual (b);
+		}
+
+		static inline Dual
+		operator- (double a, const Dual &b)
+		{
+			return Dual (a) - b;
+		}
+
+		static inline Dual
+		operator* (const Dual &a, double b)
+		{
+			return Dual (a.get_value () * b, a.get_derivative () * b);
+		}
+
+		static inline Dual
+		operator* (double a, const Dual &b)
+		{
+			return b * a;
+		}
+
+		static inline Dual
+		operator/ (const Dual &a, double b)
+		{
+			return Dual (a.get_value () / b, a.get_derivative () / b);
+		}
+
+		static inline Dual
+		operator/ (double a, const Dual &b)
+		{
+			return Dual (a) / b;
+		}
+
+		/* comparisons only involve values so that piecewise functions
+		   can be written as usual */
+		static inline bool
+		operator< (const Dual &a, const Dual &b)
+		{
+			return a.get_value () < b.get_value ();
+		}
+
+		static inline bool
+		operator> (const Dual &a, const Dual &b)
+		{
+			return a.get_value () > b.get_value ();
+		}
+
+		static inline bool
+		operator<= (const Dual &a, const Dual &b)
+		{
+			return a.get_value () <= b.get_value ();
+		}
+
+		static inline bool
+		operator>= (const Dual &a, const Dual &b)
+		{
+			return a.get_value () >= b.get_value ();
+		}
+
+		static inline bool
+		operator== (const Dual &a, const Dual &b)
+		{
+			return a.get_value () == b.get_value ();
+		}
+
+		static inline bool
+		operator!= (const Dual &a, const Dual &b)
+		{
+			return a.get_value () != b.get_value ();
+		}
+
+		// keep double overloads visible along with dual ones
+		using std::sqrt;
+		using std::pow;
+		using std::exp;
+		using std::log;
+		using std::sin;
+		using std::cos;
+		using std::tan;
+		using std::asin;
+		using std::acos;
+		using std::atan;
+		using std::sinh;
+		using std::cosh;
+		using std::tanh;
+		using std::fabs;
+
+		/** Compute square */
+		static inline Dual
+		square (const Dual &x)
+		{
+			return x * x;
+		}
+
+		static inline Dual
+		sqrt (const Dual &x)
+		{
+			double v = std::sqrt (x.get_value ());
+			return Dual (v, x.get_derivative () / (2.0 * v));
+		}
+
+		static inline Dual
+		pow (const Dual &x, double n)
+		{
+			double v = std::pow (x.get_value (), n - 1.0);
+			return Dual (v * x.get_value (), n * v * x.get_derivative ());
+		}
+
+		static inline Dual
+		exp (const Dual &x)
+		{
+			double v = std::exp (x.get_value ());
+			return Dual (v, v * x.get_derivative ());
+		}
+
+		static inline Dual
+		log (const Dual &x)
+		{
+			return Dual (std::log (x.get_value ()),
+			             x.get_derivative () / x.get_value ());
+		}
+
+		static inline Dual
+		sin (const Dual &x)
+		{
+			return Dual (std::sin (x.get_value ()),
+			             std::cos (x.get_value ()) * x.get_derivative ());
+		}
+
+		static inline Dual
+		cos (const Dual &x)
+		{
+			return Dual (std::cos (x.get_value ()),
+			             -std::sin (x.get_value ()) * x.get_derivative ());
+		}
+
+		static inline Dual
+		tan (const Dual &x)
+		{
+			double v = std::tan (x.get_value ());
+			return Dual (v, (1.0 + v * v) * x.get_derivative ());
+		}
+
+		static inline Dual
+		asin (const Dual &x)
+		{
+			return Dual (std::asin (x.get_value ()),
+			             x.get_derivative ()
+			             / std::sqrt (1.0 - x.get_value () * x.get_value ()));
+		}
+
+		static inline Dual
+		acos (const Dual &x)
+		{
+			return Dual (std::acos (x.get_value ()),
+			             -x.get_derivative ()
+			             / std::sqrt (1.0 - x.get_value () * x.get_value ()));
+		}
+
+		static inline Dual
+		atan (const Dual &x)
+		{
+			return Dual (std::atan (x.get_value ()),
+			             x.get_derivative () / (1.0 + x.get_value () * x.get_value ()));
+		}
+
+		static inline Dual
+		sinh (const Dual &x)
+		{
+			return Dual (std::sinh (x.get_value ()),
+			             std::cosh (x.get_value ()) * x.get_derivative ());
+		}
+
+		static inline Dual
+		cosh (const Dual &x)
+		{
+			return Dual (std::cosh (x.get_value ()),
+			             std::sinh (x.get_value ()) * x.get_derivative ());
+		}
+
+		static inline Dual
+		tanh (const Dual &x)
+		{
+			double v = std::tanh (x.get_value ());
+			return Dual (v, (1.0 - v * v) * x.get_derivative ());
+		}
+
+		static inline Dual
+		fabs (const Dual &x)
+		{
+			return x.get_value () < 0 ? -x : x;
+		}
+
+	}
+
+}
+
+#endif
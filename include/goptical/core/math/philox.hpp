@@ -0,0 +1,146 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_MATH_PHILOX_HH_
+#define GOPTICAL_MATH_PHILOX_HH_
+
+#include <cstdint>
+
+#include "goptical/core/common.hpp"
+
+namespace goptical
+{
+
+	namespace math
+	{
+
+		/**
+		   @short Counter based random number generator
+		   @header <goptical/core/math/Philox
+		   @module {Core}
+
+		   This class implements the Philox4x32-10 generator. Random
+		   values are a pure function of a seed, a stream number and a
+		   counter; the generator has no internal state which changes
+		   between calls.
+
+		   This makes random sequences reproducible regardless of
+		   evaluation order or thread count: the value for a given ray
+		   only depends on its index.
+		 */
+		class Philox
+		{
+			public:
+				/** Create a generator for given seed and stream */
+				inline Philox (uint64_t seed = 0, uint64_t stream = 0);
+
+				/** Compute four random 32 bits words for given counter */
+				inline void block (uint64_t counter, uint32_t out[4]) const;
+
+				/** Compute two uniform values in [0, 1) with 53 bits
+				    resolution for given counter */
+				inline void uniform2 (uint64_t counter, double &u0, double &u1) const;
+
+				/** Compute a uniform value in [0, 1) for given counter */
+				inline double uniform (uint64_t counter) const;
+
+			private:
+				static inline uint32_t mulhilo (uint32_t a, uint32_t b, uint32_t &hi);
+				static inline double to_double (uint32_t a, uint32_t b);
+
+				uint32_t _key[2];
+				uint32_t _stream[2];
+		};
+
+		Philox::Philox (uint64_t seed, uint64_t stream)
+		{
+			_key[0] = (uint32_t)seed;
+			_key[1] = (uint32_t) (seed >> 32);
+			_stream[0] = (uint32_t)stream;
+			_stream[1] = (uint32_t) (stream >> 32);
+		}
+
+		uint32_t
+		Philox::mulhilo (uint32_t a, uint32_t b, uint32_t &hi)
+		{
+			uint64_t p = (uint64_t)a * b;
+			hi = (uint32_t) (p >> 32);
+			return (uint32_t)p;
+		}
+
+		void
+		Philox::block (uint64_t counter, uint32_t out[4]) const
+		{
+			uint32_t c[4] = { (uint32_t)counter, (uint32_t) (counter >> 32), _stream[0],
+			                  _stream[1]
+			                };
+			uint32_t k0 = _key[0], k1 = _key[1];
+
+			for (unsigned int i = 0; i < 10; i++)
+			{
+				uint32_t hi0, hi1;
+				uint32_t lo0 = mulhilo (0xD2511F53, c[0], hi0);
+				uint32_t lo1 = mulhilo (0xCD9E8D57, c[2], hi1);
+				c[0] = hi1 ^ c[1] ^ k0;
+				c[1] = lo1;
+				c[2] = hi0 ^ c[3] ^ k1;
+				c[3] = lo0;
+				k0 += 0x9E3779B9;
+				k1 += 0xBB67AE85;
+			}
+
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				out[i] = c[i];
+			}
+		}
+
+		double
+		Philox::to_double (uint32_t a, uint32_t b)
+		{
+			return ((a >> 5) * 67108864.0 + (b >> 6)) * (1.0 / 9007199254740992.0);
+		}
+
+		void
+		Philox::uniform2 (uint64_t counter, double &u0, double &u1) const
+		{
+			uint32_t r[4];
+			block (counter, r);
+			u0 = to_double (r[0], r[1]);
+			u1 = to_double (r[2], r[3]);
+		}
+
+		double
+		Philox::uniform (uint64_t counter) const
+		{
+			uint32_t r[4];
+			block (counter, r);
+			return to_double (r[0], r[1]);
+		}
+
+	}
+}
+
+#endif
@@ -74,6 +74,9 @@ namespace goptical
 				/** get linear transform matrix */
 				inline Matrix<N> &get_linear ();
 
+				/** test if linear transform is not identity */
+				inline bool has_linear () const;
+
 				/** set current translation */
 				inline void set_translation (const Vector<N> &v);
 
@@ -348,6 +351,13 @@ namespace goptical
 			return _linear;
 		}
 
+		template <int N>
+		bool
+		TransformBase<N>::has_linear () const
+		{
+			return _use_linear;
+		}
+
 		template <int N>
 		void
 		TransformBase<N>::linear_reset ()
@@ -0,0 +1,145 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_PREPARE_FLAG_HH_
+#define GOPTICAL_PREPARE_FLAG_HH_
+
+#include <atomic>
+#include <mutex>
+
+namespace goptical
+{
+
+	namespace util
+	{
+
+		/**
+		   @short Thread safe lazy initialization flag
+		   @module {Core}
+		   @internal
+
+		   This class is used by objects which compute some internal
+		   data on first use, like interpolation coefficients. Once
+		   prepared, such objects are read only and can be shared by
+		   tracing threads without locking.
+
+		   The flag is cleared by the owner object when its content
+		   changes. Copies get the state of the original flag as
+		   prepared data are copied along.
+		*/
+		class PrepareFlag
+		{
+			public:
+				inline PrepareFlag ();
+				inline PrepareFlag (const PrepareFlag &f);
+				inline PrepareFlag &operator= (const PrepareFlag &f);
+
+				/** Test if prepared data are available */
+				inline bool is_prepared () const;
+
+				/** Call given function unless already prepared, concurrent
+				    callers wait for completion. The flag remains cleared if
+				    the function throws. */
+				template <class F> inline void prepare (F f) const;
+
+				/** Same as @ref prepare but the function is also called
+				    when the stale predicate reports outdated prepared
+				    data. */
+				template <class F, class S> inline void prepare (F f, S stale) const;
+
+				/** Clear flag, must not be used concurrently with @ref prepare */
+				inline void reset ();
+
+			private:
+				static inline std::recursive_mutex &get_lock ();
+
+				mutable std::atomic<bool> _prepared;
+		};
+
+		PrepareFlag::PrepareFlag ()
+			: _prepared (false)
+		{
+		}
+
+		PrepareFlag::PrepareFlag (const PrepareFlag &f)
+			: _prepared (f.is_prepared ())
+		{
+		}
+
+		PrepareFlag &
+		PrepareFlag::operator= (const PrepareFlag &f)
+		{
+			_prepared.store (f.is_prepared (), std::memory_order_relaxed);
+			return *this;
+		}
+
+		bool
+		PrepareFlag::is_prepared () const
+		{
+			return _prepared.load (std::memory_order_acquire);
+		}
+
+		template <class F>
+		void
+		PrepareFlag::prepare (F f) const
+		{
+			// preparation is rare, a single lock is shared by all objects
+			std::lock_guard<std::recursive_mutex> lock (get_lock ());
+			if (!_prepared.load (std::memory_order_relaxed))
+			{
+				f ();
+				_prepared.store (true, std::memory_order_release);
+			}
+		}
+
+		template <class F, class S>
+		void
+		PrepareFlag::prepare (F f, S stale) const
+		{
+			std::lock_guard<std::recursive_mutex> lock (get_lock ());
+			if (!_prepared.load (std::memory_order_relaxed) || stale ())
+			{
+				_prepared.store (false, std::memory_order_relaxed);
+				f ();
+				_prepared.store (true, std::memory_order_release);
+			}
+		}
+
+		void
+		PrepareFlag::reset ()
+		{
+			_prepared.store (false, std::memory_order_relaxed);
+		}
+
+		std::recursive_mutex &
+		PrepareFlag::get_lock ()
+		{
+			static std::recursive_mutex lock;
+			return lock;
+		}
+
+	}
+}
+
+#endif
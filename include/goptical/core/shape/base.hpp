@@ -92,8 +92,33 @@ namespace goptical
 				/** Get shape teselation triangles */
 				virtual void get_triangles (const math::Triangle<2>::put_delegate_t &f,
 				                            double resolution) const = 0;
+
+				/** Get shape version. It changes each time shape
+				    parameters are modified, shapes built from other shapes
+				    include versions of their base shapes. */
+				virtual inline unsigned int get_version () const;
+
+			protected:
+				/** Must be called by functions which modify shape
+				    parameters */
+				inline void update_version ();
+
+			private:
+				unsigned int _version;
 		};
-		Base::Base () {}
+		Base::Base () : _version (0) {}
+
+		unsigned int
+		Base::get_version () const
+		{
+			return _version;
+		}
+
+		void
+		Base::update_version ()
+		{
+			_version++;
+		}
 	}
 }
 
@@ -30,6 +30,7 @@
 #include "base.hpp"
 #include "goptical/core/math/transform.hpp"
 #include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/prepare_flag.hpp"
 
 namespace goptical
 {
@@ -81,6 +82,8 @@ namespace goptical
 				/** @override */
 				void get_triangles (const math::Triangle<2>::put_delegate_t &f,
 				                    double resolution) const;
+				/** @override */
+				unsigned int get_version () const;
 
 				/** Add a new shape to shape composer.
 
@@ -113,7 +116,8 @@ namespace goptical
 				{
 						friend class Composer;
 
-						Attributes (const std::shared_ptr<Base> &shape);
+						Attributes (const std::shared_ptr<Base> &shape,
+						            util::PrepareFlag *prepared);
 
 					public:
 						/** Apply scaling affine transform using scale factors (xscale, yscale) */
@@ -129,34 +133,80 @@ namespace goptical
 						Attributes &exclude (const std::shared_ptr<Base> &shape);
 
 					private:
-						bool inside (const math::Vector2 &point) const;
+						/* sum of versions of this node and sub tree */
+						unsigned int get_version () const;
 
 						std::shared_ptr<Base> _shape;
+						/* changes count of transforms and children list */
+						unsigned int _version;
 						bool _exclude;
 						std::list<Attributes> _list;
 						math::Transform<2> _transform;
 						math::Transform<2> _inv_transform;
+						/* prepare flag of owning composer */
+						util::PrepareFlag *_prepared;
 				};
 
 				Composer ();
 
+				/** Compute radius and bounding box for current shapes.
+				    This is done on first use and again when the composer
+				    version changes, which includes changes of child
+				    shapes. Preparing early makes the shape read only
+				    before sharing it between threads. */
+				void prepare () const;
+
 			private:
+				/** flattened shape tree node, children of a node follow it
+				    and sub trees are skipped using _end */
+				struct node_s
+				{
+					node_s ()
+						: _shape (0), _exclude (false), _bounded (false),
+						  _bbox (math::vector2_pair_00), _end (0)
+					{
+						_inv_transform.reset ();
+					}
+
+					const Base *_shape;
+					bool _exclude;
+					/* node shape can not contain points outside this box,
+					   in parent coordinates */
+					bool _bounded;
+					math::VectorPair2 _bbox;
+					math::Transform<2> _inv_transform;
+					/* index of first node after this sub tree */
+					unsigned int _end;
+				};
+
 				void update ();
-				void update () const;
+				inline bool is_prepared () const;
+				void flatten (const Attributes &a);
+				bool inside (unsigned int node, const math::Vector2 &point) const;
 
 				std::list<Attributes> _list;
-				bool _update;
+				std::vector<node_s> _nodes;
+				util::PrepareFlag _prepared;
+				/* composer version when prepared */
+				unsigned int _prepared_version;
 				bool _global_dist;
 				double _max_radius;
 				double _min_radius;
 				math::VectorPair2 _bbox;
 				unsigned int _contour_cnt;
 		};
+		bool
+		Composer::is_prepared () const
+		{
+			return _prepared.is_prepared () && _prepared_version == get_version ();
+		}
+
 		Composer::Attributes &
 		Composer::Attributes::scale (const math::Vector2 &factor)
 		{
 			_transform.affine_scaling (factor);
 			_inv_transform = _transform.inverse ();
+			_prepared->reset ();
 			return *this;
 		}
 
@@ -165,6 +215,7 @@ namespace goptical
 		{
 			_transform.affine_rotation (0, angle);
 			_inv_transform = _transform.inverse ();
+			_prepared->reset ();
 			return *this;
 		}
 
@@ -173,6 +224,7 @@ namespace goptical
 		{
 			_transform.apply_translation (offset);
 			_inv_transform = _transform.inverse ();
+			_prepared->reset ();
 			return *this;
 		}
 
@@ -180,6 +232,7 @@ namespace goptical
 		Composer::use_global_distribution (bool use_global)
 		{
 			_global_dist = use_global;
+			update_version ();
 		}
 
 	}
@@ -93,6 +93,7 @@ namespace goptical
 		void DiskBase::set_radius (double r)
 		{
 			_radius = r;
+			update_version ();
 		}
 
 		double DiskBase::get_radius (void) const
@@ -29,6 +29,7 @@
 
 #include "base.hpp"
 #include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/prepare_flag.hpp"
 
 namespace goptical
 {
@@ -63,6 +64,11 @@ namespace goptical
 				inline unsigned int get_vertices_count () const;
 				inline const math::Vector2 &get_vertex (unsigned int id);
 
+				/** Compute radius and bounding box for current vertices.
+				    This is done on first use, preparing early makes the
+				    shape read only before sharing it between threads. */
+				void prepare () const;
+
 			private:
 				/** @override */
 				double max_radius () const;
@@ -84,16 +90,31 @@ namespace goptical
 				void get_triangles (const math::Triangle<2>::put_delegate_t &f,
 				                    double resolution) const;
 
-				/** update _min_radius and bounding box */
+				/** update _min_radius, bounding box and edge bins */
 				void update ();
+				/** update edge bins used by inside test */
+				void update_bins ();
 
 				typedef std::vector<math::Vector2> vertices_t;
 
-				bool _updated;
+				/** polygon edge, from vertex v to vertex w */
+				struct edge_s
+				{
+					math::Vector2 v, w;
+				};
+
+				util::PrepareFlag _prepared;
 				vertices_t _vertices;
 				math::VectorPair2 _bbox;
 				double _max_radius;
 				double _min_radius;
+
+				/* edges crossing each horizontal slab of the bounding
+				   box, slab i edges are in _bin_edges [_bins[i],
+				   _bins[i+1]) */
+				std::vector<unsigned int> _bins;
+				std::vector<edge_s> _bin_edges;
+				double _bin_scale;
 		};
 		unsigned int
 		Polygon::get_vertices_count () const
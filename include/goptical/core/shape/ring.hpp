@@ -101,6 +101,7 @@ namespace goptical
 			assert (radius > hole_radius);
 			_radius = radius;
 			_hole_radius = hole_radius;
+			update_version ();
 		}
 
 		double
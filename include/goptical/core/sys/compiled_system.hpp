@@ -0,0 +1,185 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_COMPILED_SYSTEM_HH_
+#define GOPTICAL_COMPILED_SYSTEM_HH_
+
+#include <iostream>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/transform.hpp"
+#include "goptical/core/sys/element.hpp"
+
+namespace goptical
+{
+
+	namespace sys
+	{
+
+		/**
+		   @short Immutable snapshot of optical system transforms
+		   @header <goptical/core/sys/CompiledSystem
+		   @module {Core}
+
+		   This class stores the 3d transforms of all system elements in
+		   contiguous tables. It is prepared by the @ref trace::Tracer
+		   so that transforms can be looked up from many threads without
+		   going through the lazy @ref System transform cache.
+
+		   Local to global and global to local transforms are stored for
+		   all elements. Element to element transforms are stored for
+		   successive elements of a sequence in sequential mode, other
+		   transforms are composed on lookup. Transforms are bitwise
+		   identical to those provided by the @ref System cache.
+
+		   The snapshot must be discarded when the system version
+		   changes, the tracer reuses it across traces until then.
+		*/
+		class CompiledSystem
+		{
+			public:
+				/** Take a snapshot of system transforms for non sequential
+				    ray tracing */
+				CompiledSystem (const System &system);
+
+				/** Take a snapshot of system transforms for sequential ray
+				    tracing through the given elements list */
+				CompiledSystem (const System &system,
+				                const std::vector<const Element *> &sequence);
+
+				/** Get snapshot system */
+				inline const System &get_system () const;
+
+				/** Get system version when snapshot was taken */
+				inline unsigned int get_version () const;
+
+				/** Test if snapshot is still valid for non sequential
+				    ray tracing in given system */
+				bool is_valid (const System &system) const;
+
+				/** Test if snapshot is still valid for sequential ray
+				    tracing through the given elements list */
+				bool is_valid (const System &system,
+				               const std::vector<const Element *> &sequence) const;
+
+				/** Get transform from element local to global coordinates */
+				inline const math::Transform<3> &
+				get_global_transform (const Element &from) const;
+
+				/** Get transform from global to element local coordinates */
+				inline const math::Transform<3> &
+				get_local_transform (const Element &to) const;
+
+				/** Get transform between two elements local coordinates */
+				inline math::Transform<3> get_transform (const Element &from,
+				        const Element &to) const;
+
+				/** Get number of stored element to element transforms */
+				inline unsigned int get_transform_count () const;
+
+				/** Dump stored element to element transforms */
+				void dump (std::ostream &o) const;
+
+			private:
+				void init (const System &system);
+				void add (const Element &from, const Element &to);
+
+				/** stored element to element transform */
+				struct link_s
+				{
+					// destination element id
+					unsigned int _to;
+					// next link index plus one from same element, 0 if none
+					unsigned int _next;
+					math::Transform<3> _t;
+				};
+
+				const System *_system;
+				unsigned int _version;
+				bool _sequential;
+				// Sequence used to build the snapshot in sequential mode
+				std::vector<const Element *> _sequence;
+				// Count of element ids, including id 0 of global coordinates
+				unsigned int _e_count;
+				// Element transforms indexed by element id
+				std::vector<math::Transform<3> > _global;
+				std::vector<math::Transform<3> > _local;
+				// Index of first link plus one indexed by element id, 0 when
+				// no transform is stored from this element
+				std::vector<unsigned int> _first;
+				std::vector<link_s> _links;
+		};
+
+		const System &
+		CompiledSystem::get_system () const
+		{
+			return *_system;
+		}
+
+		unsigned int
+		CompiledSystem::get_version () const
+		{
+			return _version;
+		}
+
+		const math::Transform<3> &
+		CompiledSystem::get_global_transform (const Element &from) const
+		{
+			assert (from.id () < _e_count);
+			return _global[from.id ()];
+		}
+
+		const math::Transform<3> &
+		CompiledSystem::get_local_transform (const Element &to) const
+		{
+			assert (to.id () < _e_count);
+			return _local[to.id ()];
+		}
+
+		math::Transform<3>
+		CompiledSystem::get_transform (const Element &from, const Element &to) const
+		{
+			assert (from.id () < _e_count && to.id () < _e_count);
+			for (unsigned int i = _first[from.id ()]; i; i = _links[i - 1]._next)
+				if (_links[i - 1]._to == to.id ())
+				{
+					return _links[i - 1]._t;
+				}
+			math::Transform<3> t (_global[from.id ()]);
+			t.compose (_local[to.id ()]);
+			return t;
+		}
+
+		unsigned int
+		CompiledSystem::get_transform_count () const
+		{
+			return _links.size ();
+		}
+
+	}
+}
+
+#endif
@@ -55,6 +55,7 @@ namespace goptical
 
 		class Element
 		{
+				friend class CompiledSystem;
 				friend class Container;
 				friend class System;
 				friend class Group;
@@ -134,6 +135,15 @@ namespace goptical
 				    paramter is 0. */
 				const math::Transform<3> &get_transform_from (const Element *e) const;
 
+				/** Get transform from this element to given element coordinate
+				    system, taken from the system snapshot of the current ray
+				    trace when available. This is safe to use from tracer
+				    threads. One of both elements may not be part of a
+				    system, its transform is then relative to global
+				    coordinates. */
+				math::Transform<3> get_transform_to (const Element &e,
+				                                     const trace::Params &params) const;
+
 				/** Get transform from this element local to global coordinates */
 				const math::Transform<3> &get_global_transform () const;
 
@@ -174,6 +184,14 @@ namespace goptical
 				inline void process_rays (trace::Result &result,
 				                          trace::rays_queue_t *input) const;
 
+				/** Process a batch of light rays interacting with element in
+				    simple ray trace mode. Rays are expressed in the batch frame
+				    element coordinates and are expressed in this element
+				    coordinates on return. This function is only used in
+				    sequential ray trace mode. @see trace::RayBatch */
+				inline void process_rays (trace::RayBatch &batch,
+				                          const trace::Params &params) const;
+
 				/** Draw element 2d layout using the given renderer in given
 				    element coordinates. */
 				virtual void draw_2d_e (io::Renderer &r, const Element *ref) const;
@@ -211,6 +229,13 @@ namespace goptical
 				virtual void process_rays_polarized (trace::Result &result,
 				                                     trace::rays_queue_t *input) const;
 
+				/** This function process a batch of incoming light rays. It
+				    must be reimplemented in subclasses if the element can
+				    interact with light in batch ray trace mode.
+				    This function is only used in sequential ray trace mode. */
+				virtual void process_rays_batch (trace::RayBatch &batch,
+				                                 const trace::Params &params) const;
+
 				/** This function is called from the @ref Element base class
 				    when the local 3d transform has been updated. */
 				virtual void system_moved ();
@@ -325,6 +350,13 @@ namespace goptical
 			}
 		}
 
+		void
+		Element::process_rays (trace::RayBatch &batch,
+		                       const trace::Params &params) const
+		{
+			process_rays_batch (batch, params);
+		}
+
 		std::ostream &
 		operator<< (std::ostream &o, const Element &e)
 		{
@@ -65,6 +65,8 @@ namespace goptical
 				void trace_ray_polarized (trace::Result &result, trace::Ray &incident,
 				                          const math::VectorPair3 &local,
 				                          const math::VectorPair3 &intersect) const;
+				void trace_rays_batch (trace::RayBatch &batch,
+				                       const trace::Params &params) const;
 		};
 
 	}
@@ -58,6 +58,8 @@ namespace goptical
 
 		class OpticalSurface : public Surface
 		{
+				friend class trace::Plan;
+
 			public:
 				/** Create an optical surface at specified location. */
 				OpticalSurface (const math::VectorPair3 &p,
@@ -104,6 +106,10 @@ namespace goptical
 				                          const math::VectorPair3 &local,
 				                          const math::VectorPair3 &intersect) const;
 
+				/** @override */
+				void trace_rays_batch (trace::RayBatch &batch,
+				                       const trace::Params &params) const;
+
 				/** @override */
 				virtual void system_register (System *s) override;
 
@@ -113,9 +119,17 @@ namespace goptical
 				/** @override */
 				void print (std::ostream &o) const;
 
-				/** compute refracted ray direction according to fresnel law */
-				bool refract (const math::VectorPair3 &ray, math::Vector3 &direction,
-				              const math::Vector3 &normal, double refract_index) const;
+				/** compute refracted ray direction according to fresnel law,
+				    using formula selected in tracer parameters. Return false on
+				    total internal reflection */
+				bool refract (const trace::Params &params, const math::VectorPair3 &ray,
+				              math::Vector3 &direction, const math::Vector3 &normal,
+				              double refract_index) const;
+
+				/** get ratio of incident to outgoing refractive index, from
+				    the tracer index table when available */
+				double get_index_ratio (const trace::Params &params, bool right_to_left,
+				                        double wavelen) const;
 
 				/** compute reflected ray direction according to fresnel law */
 				void reflect (const math::VectorPair3 &ray, math::Vector3 &direction,
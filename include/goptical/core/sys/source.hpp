@@ -82,6 +82,14 @@ namespace goptical
 				inline void generate_rays (trace::Result &result,
 				                           const targets_t &entry) const;
 
+				/** Get number of samples used to generate rays toward
+				    entry targets. When not null, rays are only generated
+				    for samples in the range set on the @ref trace::Result
+				    so that the tracer can generate rays by parts. The
+				    default implementation returns 0. */
+				virtual size_t get_sample_count (const trace::Params &params,
+				                                 const targets_t &entry) const;
+
 			protected:
 				/** This function generate light rays from source. Target entry
 				    surfaces may be used depending on source model. It must be
@@ -46,7 +46,8 @@ namespace goptical
 		   located at a given position but without direction.
 
 		   A ray is generated for each defined spectrum line for each
-		   distribution pattern point on target surface.
+		   distribution pattern point on target surface. Pattern points
+		   are the source samples, see @ref Source::get_sample_count.
 
 		   Default wavelen list contains a single 550nm entry.
 		*/
@@ -69,6 +70,11 @@ namespace goptical
 				/** Change current point source infinity mode */
 				inline void set_mode (SourceInfinityMode mode);
 
+				/** @override Samples are distribution pattern points on
+				    target surfaces */
+				size_t get_sample_count (const trace::Params &params,
+				                         const targets_t &entry) const;
+
 			private:
 				void generate_rays_simple (trace::Result &result,
 				                           const targets_t &entry) const;
@@ -77,7 +83,8 @@ namespace goptical
 
 				template <SourceInfinityMode mode>
 				inline void get_lightrays_ (trace::Result &result,
-				                            const Element &target) const;
+				                            const Element &target,
+				                            size_t &sample) const;
 
 				SourceInfinityMode _mode;
 		};
@@ -65,8 +65,13 @@ namespace goptical
 				    radius. */
 				Stop (const math::VectorPair3 &p, double radius);
 
-				GOPTICAL_ACCESSORS (double, external_radius,
-				                    "stop external radius. @see Stop");
+				GOPTICAL_GET_ACCESSOR (double, external_radius,
+				                       "stop external radius. @see Stop");
+				/** @see get_external_radius Set stop external radius. @see Stop */
+				inline void set_external_radius (double external_radius);
+
+				/** @override */
+				bool get_intersect_bounding_box (math::VectorPair3 &box) const;
 
 				GOPTICAL_ACCESSORS (bool, intercept_reemit,
 				                    "intercept and reemit enabled. @see Stop");
@@ -95,6 +100,14 @@ namespace goptical
 				                          const math::VectorPair3 &local,
 				                          const math::VectorPair3 &intersect) const;
 
+				/** @override */
+				void intersect_batch (trace::RayBatch &batch,
+				                      const trace::Params &params) const;
+
+				/** @override */
+				void trace_rays_batch (trace::RayBatch &batch,
+				                       const trace::Params &params) const;
+
 				/** @override */
 				void process_rays_simple (trace::Result &result,
 				                          trace::rays_queue_t *input) const;
@@ -111,6 +124,13 @@ namespace goptical
 				bool _intercept_reemit;
 		};
 
+		void
+		Stop::set_external_radius (double external_radius)
+		{
+			_external_radius = external_radius;
+			update_version ();
+		}
+
 	}
 }
 
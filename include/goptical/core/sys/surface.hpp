@@ -26,12 +26,15 @@
 #define GOPTICAL_SURFACE_HH_
 
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/curve/base.hpp"
 #include "goptical/core/shape/base.hpp"
 #include "goptical/core/sys/element.hpp"
+#include "goptical/core/trace/distribution.hpp"
 
 namespace goptical
 {
@@ -88,6 +91,19 @@ namespace goptical
 				                  const trace::Distribution &d,
 				                  bool unobstructed = false) const;
 
+				/** Get distribution pattern points projected on the surface
+				    as a contiguous array. Patterns are computed once and
+				    kept in a small cache which is invalidated when the
+				    surface, curve or shape version changes, @see
+				    clear_pattern_cache. */
+				std::shared_ptr<const std::vector<math::Vector3>>
+				        get_pattern_points (const trace::Distribution &d,
+				                            bool unobstructed = false) const;
+
+				/** Discard cached pattern points. Only needed to release
+				    memory, modified curve and shape objects are detected. */
+				void clear_pattern_cache () const;
+
 				/** trace a single ray through the surface */
 				template <trace::IntensityMode m>
 				void trace_ray (trace::Result &result, trace::Ray &incident,
@@ -105,6 +121,11 @@ namespace goptical
 
 				math::VectorPair3 get_bounding_box () const;
 
+				/** Get a box in local coordinates which contains all
+				    intersection points found by @ref intersect when not in
+				    unobstructed mode. Return false if no such box is known. */
+				virtual bool get_intersect_bounding_box (math::VectorPair3 &box) const;
+
 			protected:
 				/** This function must be reimplemented by subclasses to handle
 				    incoming rays and generate new ones when in simple ray trace mode. */
@@ -126,6 +147,25 @@ namespace goptical
 				                                  const math::VectorPair3 &local,
 				                                  const math::VectorPair3 &intersect) const;
 
+				/** Compute intersection points and normals of active rays in
+				    batch, rays which miss the surface are marked as lost. Origin
+				    field is replaced by intersection point and length field is set
+				    to propagation distance. The default implementation relies on
+				    the @ref intersect function. */
+				virtual void intersect_batch (trace::RayBatch &batch,
+				                              const trace::Params &params) const;
+
+				/** This function must be reimplemented by subclasses to handle
+				    incoming rays in batch ray trace mode. Intercepted rays must
+				    either be updated with outgoing ray direction and material or
+				    be deactivated. */
+				virtual void trace_rays_batch (trace::RayBatch &batch,
+				                               const trace::Params &params) const;
+
+				/** @override */
+				void process_rays_batch (trace::RayBatch &batch,
+				                         const trace::Params &params) const;
+
 				/** @override */
 				void draw_2d_e (io::Renderer &r, const Element *ref) const;
 				/** @override */
@@ -149,14 +189,31 @@ namespace goptical
 				virtual void process_rays_polarized (trace::Result &result,
 				                                     trace::rays_queue_t *input) const;
 
+				struct pattern_cache_s
+				{
+					trace::Distribution _dist;
+					bool _unobstructed;
+					unsigned int _version;
+					const curve::Base *_curve;
+					const shape::Base *_shape;
+					unsigned int _curve_version;
+					unsigned int _shape_version;
+					std::shared_ptr<const std::vector<math::Vector3>> _points;
+				};
+
+				/** Test if cached pattern matches current surface state */
+				bool is_pattern_valid (const pattern_cache_s &c) const;
+
 				double _discard_intensity;
 				std::shared_ptr<curve::Base> _curve;
 				std::shared_ptr<shape::Base> _shape;
+				mutable std::vector<pattern_cache_s> _pattern_cache;
 		};
 		void
 		Surface::set_curve (const std::shared_ptr<curve::Base> &c)
 		{
 			_curve = c;
+			update_version ();
 		}
 
 		const curve::Base &
@@ -169,6 +226,7 @@ namespace goptical
 		Surface::set_shape (const std::shared_ptr<shape::Base> &s)
 		{
 			_shape = s;
+			update_version ();
 		}
 
 		const shape::Base &
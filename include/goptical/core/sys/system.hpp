@@ -25,7 +25,10 @@
 #ifndef GOPTICAL_SYSTEM_HH_
 #define GOPTICAL_SYSTEM_HH_
 
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 #include "goptical/core/common.hpp"
 
@@ -43,6 +46,8 @@ namespace goptical
 	namespace sys
 	{
 
+		struct colide_bvh_s;
+
 		/**
 		   @short Optical system
 		   @header <goptical/core/sys/system
@@ -57,6 +62,7 @@ namespace goptical
 		*/
 		class System : public Container
 		{
+				friend class CompiledSystem;
 				friend class Element;
 
 			public:
@@ -114,7 +120,11 @@ namespace goptical
 				inline void update_version ();
 
 				/** Find surface which colides with the given ray and update intersection
-				 * point */
+				 * point. Surfaces are looked up in a bounding volume
+				 * hierarchy of their global bounding boxes which is rebuilt
+				 * when the system version changes. The ray is moved to
+				 * global coordinates once, then to each candidate surface
+				 * local coordinates. */
 				Surface *colide_next (const trace::Params &params,
 				                      math::VectorPair3 &intersect,
 				                      const trace::Ray &ray) const;
@@ -133,6 +143,10 @@ namespace goptical
 
 				void add (std::shared_ptr<Element> e);
 
+				/** Remove an element previously added to the system and
+				    release its identifier */
+				void remove (const std::shared_ptr<Element> &e);
+
 			private:
 				/** get an new element identifier */
 				unsigned int index_get (Element &element);
@@ -166,6 +180,10 @@ namespace goptical
 				/** Resize transform cache size */
 				void transform_cache_resize (unsigned int newsize);
 
+				/** Get bounding volume hierarchy used by colide_next, rebuild it
+				    if the system version has changed */
+				const colide_bvh_s &colide_bvh_get () const;
+
 				unsigned int _version;
 
 				std::shared_ptr<Surface> _entrance;
@@ -181,6 +199,10 @@ namespace goptical
 				// transforming from element to element using element id as row and
 				// column indices
 				std::vector<math::Transform<3> *> _transform_cache;
+				// Surfaces bounding volume hierarchy, shared between tracer threads
+				mutable std::unique_ptr<colide_bvh_s> _colide_bvh;
+				mutable std::atomic<unsigned int> _colide_version;
+				mutable std::mutex _colide_lock;
 		};
 
 		void
@@ -64,15 +64,27 @@ namespace goptical
 				    not. */
 				inline void set_uniform_pattern ();
 
+				/** Set seed used by random and quasi random patterns.
+				    Patterns generated with the same seed are identical. */
+				inline void set_seed (unsigned int seed);
+
+				/** Get random pattern seed */
+				inline unsigned int get_seed () const;
+
+				/** Compare pattern, radial density, scaling and seed */
+				inline bool operator== (const Distribution &d) const;
+
 			private:
 				Pattern _pattern;
 				unsigned int _radial_density;
 				double _scaling;
+				unsigned int _seed;
 		};
 
 		Distribution::Distribution (Pattern pattern, unsigned int radial_density,
 		                            double scaling)
-			: _pattern (pattern), _radial_density (radial_density), _scaling (scaling)
+			: _pattern (pattern), _radial_density (radial_density), _scaling (scaling),
+			  _seed (0)
 		{
 			if (radial_density < 1)
 			{
@@ -130,6 +142,25 @@ namespace goptical
 			}
 		}
 
+		void
+		Distribution::set_seed (unsigned int seed)
+		{
+			_seed = seed;
+		}
+
+		unsigned int
+		Distribution::get_seed () const
+		{
+			return _seed;
+		}
+
+		bool
+		Distribution::operator== (const Distribution &d) const
+		{
+			return _pattern == d._pattern && _radial_density == d._radial_density
+			       && _scaling == d._scaling && _seed == d._seed;
+		}
+
 	}
 }
 
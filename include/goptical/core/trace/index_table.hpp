@@ -0,0 +1,143 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_INDEX_TABLE_HH_
+#define GOPTICAL_TRACE_INDEX_TABLE_HH_
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/sys/optical_surface.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Immutable table of refractive indices
+		   @header <goptical/core/trace/IndexTable
+		   @module {Core}
+
+		   This class stores refractive index ratios of all optical
+		   surfaces of a system for a set of wavelengths. It is prepared
+		   by the @ref Tracer for wavelengths found in @ref
+		   Result::get_ray_wavelen_set once source rays have been
+		   generated, so that surfaces do not evaluate material
+		   dispersion formulas for every ray.
+
+		   Wavelengths are looked up by index, a wavelength which is not
+		   part of the table has an index equal to @ref
+		   get_wavelen_count. Stored ratios are bitwise identical to those
+		   computed from materials.
+
+		   The table may be shared by tracing threads. It must be
+		   discarded when surfaces materials change.
+		*/
+		class IndexTable
+		{
+			public:
+				/** Tabulate index ratios of all system optical surfaces for
+				    given wavelengths */
+				IndexTable (const sys::System &system,
+				            const std::set<double> &wavelengths);
+
+				/** Test if table was built for given wavelengths */
+				inline bool is_valid (const std::set<double> &wavelengths) const;
+
+				/** Get number of tabulated wavelengths */
+				inline unsigned int get_wavelen_count () const;
+
+				/** Get index of wavelength in table, returns @ref
+				    get_wavelen_count if not found */
+				inline unsigned int get_wavelen_index (double wavelen) const;
+
+				/** Get ratio of incident to outgoing refractive index of
+				    an optical surface for light going in given direction.
+				    Returns false if not tabulated. */
+				inline bool get_index_ratio (const sys::OpticalSurface &surface,
+				                             bool right_to_left, unsigned int wl_index,
+				                             double &ratio) const;
+
+			private:
+				static const unsigned int none = ~0u;
+
+				std::vector<double> _wavelengths;
+				// offsets in _ratios indexed by element id, none if not tabulated
+				std::vector<unsigned int> _offsets;
+				// left to right then right to left ratios of each surface
+				std::vector<double> _ratios;
+		};
+
+		bool
+		IndexTable::is_valid (const std::set<double> &wavelengths) const
+		{
+			return wavelengths.size () == _wavelengths.size ()
+			       && std::equal (_wavelengths.begin (), _wavelengths.end (),
+			                      wavelengths.begin ());
+		}
+
+		unsigned int
+		IndexTable::get_wavelen_count () const
+		{
+			return _wavelengths.size ();
+		}
+
+		unsigned int
+		IndexTable::get_wavelen_index (double wavelen) const
+		{
+			// few wavelengths are used, linear search is fine
+			unsigned int i;
+			for (i = 0; i < _wavelengths.size (); i++)
+				if (_wavelengths[i] == wavelen)
+				{
+					break;
+				}
+			return i;
+		}
+
+		bool
+		IndexTable::get_index_ratio (const sys::OpticalSurface &surface,
+		                             bool right_to_left, unsigned int wl_index,
+		                             double &ratio) const
+		{
+			unsigned int id = surface.id ();
+			if (wl_index >= _wavelengths.size () || id >= _offsets.size ()
+			        || _offsets[id] == none)
+			{
+				return false;
+			}
+			ratio = _ratios[_offsets[id] + right_to_left * _wavelengths.size ()
+			                + wl_index];
+			return true;
+		}
+
+	}
+}
+
+#endif
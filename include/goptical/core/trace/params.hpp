@@ -26,9 +26,12 @@
 #define GOPTICAL_TRACER_PARAMS_HH_
 
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "goptical/core/common.hpp"
 
+#include "goptical/core/math/vector.hpp"
 #include "goptical/core/trace/distribution.hpp"
 #include "goptical/core/trace/result.hpp"
 #include "goptical/core/trace/sequence.hpp"
@@ -67,9 +70,35 @@ namespace goptical
 
 				GOPTICAL_ACCESSORS (double, lost_ray_length, "lost ray length");
 
+				GOPTICAL_ACCESSORS (unsigned int, thread_count,
+				                    "number of worker threads used to trace rays, "
+				                    "0 selects the hardware thread count, default is 1");
+
+				GOPTICAL_ACCESSORS (bool, batch_mode,
+				                    "sequential simple ray trace propagates rays as "
+				                    "trace::RayBatch arrays, default is false");
+
+				GOPTICAL_ACCESSORS (bool, plan_mode,
+				                    "sequential simple ray trace compiles the sequence "
+				                    "to a trace::Plan and traces rays one by one through "
+				                    "it, default is false");
+
+				GOPTICAL_ACCESSORS (GenealogyMode, genealogy_mode,
+				                    "links maintained between traced rays, "
+				                    "default is GenealogyFull");
+
 				GOPTICAL_ACCESSORS (IntensityMode, intensity_mode,
 				                    "raytracing intensity mode");
 
+				GOPTICAL_ACCESSORS (RefractionLaw, refraction_law,
+				                    "formula used to compute refracted rays "
+				                    "direction, default is RefractionFeder");
+
+				GOPTICAL_ACCESSORS (RefractionStats *, refraction_stats,
+				                    "when not null, refracted directions are computed with "
+				                    "all formulas and disagreements are recorded, "
+				                    "default is null");
+
 				GOPTICAL_ACCESSORS (bool, unobstructed,
 				                    "unobstructed raytracing mode. Surface shapes are "
 				                    "ignored, no rays are stopped");
@@ -87,6 +116,9 @@ namespace goptical
 				/** Test if in sequential ray tracing mode */
 				inline bool is_sequential () const;
 
+				/** Get sequence used in sequential ray tracing mode */
+				inline const std::shared_ptr<Sequence> &get_sequence () const;
+
 				/** Set distribution pattern for a given surface */
 				inline void set_distribution (const sys::Surface &s,
 				                              const Distribution &dist);
@@ -97,25 +129,75 @@ namespace goptical
 				/** Get distribution pattern for a given surface */
 				inline const Distribution &get_distribution (const sys::Surface &s) const;
 
+				/** Use given points, in surface local coordinates, instead
+				    of distribution pattern for rays generated by point
+				    sources toward surface @tt s. When weights are given,
+				    intensity of generated rays is scaled by the weight of
+				    their point. Passing null points restores the
+				    distribution pattern. */
+				inline void set_pattern_points (
+				    const sys::Surface &s,
+				    const std::shared_ptr<const std::vector<math::Vector3>> &points,
+				    const std::shared_ptr<const std::vector<double>> &weights
+				    = std::shared_ptr<const std::vector<double>> ());
+
+				/** Reset all surface specific pattern points */
+				inline void reset_pattern_points ();
+
+				/** Get pattern points and optional weights defined for a
+				    given surface. Return false if none are defined. */
+				inline bool get_pattern_points (const sys::Surface &s,
+				                                const std::vector<math::Vector3> *&points,
+				                                const std::vector<double> *&weights) const;
+
+				/** @internal Get system transforms snapshot prepared by the
+				    tracer for the current ray trace, may be null */
+				inline const sys::CompiledSystem *get_compiled_system () const;
+
+				/** @internal Get refractive index table prepared by the
+				    tracer once source rays are generated, may be null */
+				inline const IndexTable *get_index_table () const;
+
 			private:
 				typedef std::map<const sys::Surface *, Distribution> _s_distribution_map_t;
 
+				struct pattern_points_s
+				{
+					std::shared_ptr<const std::vector<math::Vector3>> _points;
+					std::shared_ptr<const std::vector<double>> _weights;
+				};
+				typedef std::map<const sys::Surface *, pattern_points_s>
+				_s_pattern_points_map_t;
+
 				std::shared_ptr<Sequence> _sequence;
+				std::shared_ptr<const sys::CompiledSystem> _compiled_system;
+				std::shared_ptr<const IndexTable> _index_table;
 				Distribution _default_distribution;
 				_s_distribution_map_t _s_distribution;
+				_s_pattern_points_map_t _s_pattern_points;
 				unsigned int _max_bounce;
+				GenealogyMode _genealogy_mode;
 				IntensityMode _intensity_mode;
+				RefractionLaw _refraction_law;
+				RefractionStats *_refraction_stats;
 				bool _sequential_mode;
 				PropagationMode _propagation_mode;
 				bool _unobstructed;
 				double _lost_ray_length;
+				unsigned int _thread_count;
+				bool _batch_mode;
+				bool _plan_mode;
 		};
 
 		Params::Params ()
-			: _default_distribution (), _s_distribution (), _max_bounce (50),
-			  _intensity_mode (Simpletrace), _sequential_mode (false),
+			: _compiled_system (), _index_table (), _default_distribution (), _s_distribution (),
+			  _s_pattern_points (),
+			  _max_bounce (50), _genealogy_mode (GenealogyFull),
+			  _intensity_mode (Simpletrace), _refraction_law (RefractionFeder),
+			  _refraction_stats (0), _sequential_mode (false),
 			  _propagation_mode (RayPropagation), _unobstructed (false),
-			  _lost_ray_length (1000)
+			  _lost_ray_length (1000), _thread_count (1),
+			  _batch_mode (false), _plan_mode (false)
 		{
 		}
 
@@ -138,6 +220,12 @@ namespace goptical
 			return _sequential_mode;
 		}
 
+		const std::shared_ptr<Sequence> &
+		Params::get_sequence () const
+		{
+			return _sequence;
+		}
+
 		void
 		Params::set_distribution (const sys::Surface &s, const Distribution &dist)
 		{
@@ -157,6 +245,59 @@ namespace goptical
 			return i == _s_distribution.end () ? _default_distribution : i->second;
 		}
 
+		void
+		Params::set_pattern_points (
+		    const sys::Surface &s,
+		    const std::shared_ptr<const std::vector<math::Vector3>> &points,
+		    const std::shared_ptr<const std::vector<double>> &weights)
+		{
+			if (!points)
+			{
+				_s_pattern_points.erase (&s);
+				return;
+			}
+			if (weights && weights->size () != points->size ())
+			{
+				throw Error ("pattern points and weights count mismatch");
+			}
+			pattern_points_s &p = _s_pattern_points[&s];
+			p._points = points;
+			p._weights = weights;
+		}
+
+		void
+		Params::reset_pattern_points ()
+		{
+			_s_pattern_points.clear ();
+		}
+
+		bool
+		Params::get_pattern_points (const sys::Surface &s,
+		                            const std::vector<math::Vector3> *&points,
+		                            const std::vector<double> *&weights) const
+		{
+			_s_pattern_points_map_t::const_iterator i = _s_pattern_points.find (&s);
+			if (i == _s_pattern_points.end ())
+			{
+				return false;
+			}
+			points = i->second._points.get ();
+			weights = i->second._weights.get ();
+			return true;
+		}
+
+		const sys::CompiledSystem *
+		Params::get_compiled_system () const
+		{
+			return _compiled_system.get ();
+		}
+
+		const IndexTable *
+		Params::get_index_table () const
+		{
+			return _index_table.get ();
+		}
+
 	}
 }
 
@@ -0,0 +1,172 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_PLAN_HH_
+#define GOPTICAL_TRACE_PLAN_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/transform.hpp"
+#include "goptical/core/math/vector_pair.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Sequential ray trace plan
+		   @header <goptical/core/trace/Plan
+		   @module {Core}
+
+		   This class holds a compiled form of a @ref Sequence used by
+		   the @ref Tracer in sequential simple ray trace mode when
+		   enabled with @ref Params::set_plan_mode.
+
+		   Each sequence element is compiled to a flat record which
+		   holds the curve and aperture kinds, materials and the
+		   transform from the previous element. Refractive indices are
+		   read from the tracer @ref IndexTable. Rays are then traced
+		   one by one through all records by a single loop, without
+		   going through element virtual functions. Common curves and
+		   shapes are called directly.
+
+		   Only optical surfaces, mirrors, stops and images can be
+		   compiled. Results are the same as with the element by element
+		   ray trace.
+
+		   A plan is no longer valid when the system version changes,
+		   which includes surface material changes, or when the version
+		   of a compiled shape changes. Curves are not cached in records
+		   so that in place curve changes are always taken into account.
+		*/
+		class Plan
+		{
+			public:
+				/** Compile a plan for all enabled elements of the
+				    sequence. */
+				Plan (const Sequence &seq);
+
+				/** Test if all enabled sequence elements could be compiled,
+				    rays can only be traced with a complete plan */
+				inline bool is_complete () const;
+
+				/** Test if the plan still matches sequence content and
+				    system version */
+				bool is_valid (const Sequence &seq) const;
+
+				/** Get number of compiled records, including sources */
+				inline unsigned int get_record_count () const;
+
+				/** Trace rays through compiled elements, starting at given
+				    element up to next source or end of sequence. */
+				void trace (Result &result, const rays_queue_t &input,
+				            const sys::Element &first) const;
+
+			private:
+				enum record_kind_e
+				{
+				    RecordSource,
+				    RecordOptical,
+				    RecordStop,
+				    RecordImage,
+				};
+
+				enum curve_kind_e
+				{
+				    CurveFlat,
+				    CurveSphere,
+				    CurveConic,
+				    CurveOther,
+				};
+
+				enum aperture_kind_e
+				{
+				    ApertureDisk,
+				    ApertureRectangle,
+				    ApertureOther,
+				};
+
+				struct record_s
+				{
+					record_kind_e _kind;
+					curve_kind_e _curve_kind;
+					aperture_kind_e _aperture_kind;
+					const sys::Element *_element;
+					// element which generates incoming rays
+					const sys::Element *_prev;
+					const curve::Base *_curve;
+					const shape::Base *_shape;
+					// disk aperture radius
+					double _aperture_radius;
+					// shape version when _aperture_radius was read
+					unsigned int _shape_version;
+					// stop external radius
+					double _radius;
+					// optical surface left and right materials
+					const material::Base *_mat[2];
+					bool _opaque[2];
+					bool _reflecting[2];
+					// transform from _prev local coordinates
+					math::Transform<3> _transform;
+				};
+
+				inline bool curve_intersect (const record_s &r, math::Vector3 &point,
+				                             const math::VectorPair3 &ray) const;
+				inline void curve_normal (const record_s &r, math::Vector3 &normal,
+				                          const math::Vector3 &point) const;
+				inline bool shape_inside (const record_s &r,
+				                          const math::Vector2 &point) const;
+
+				template <bool save>
+				void trace_ray (Result &result, Ray &ray, unsigned int first,
+				                rays_queue_t *const *generated,
+				                const char *allocate) const;
+
+				const sys::System *_system;
+				unsigned int _version;
+				std::vector<const sys::Element *> _sequence;
+				std::vector<record_s> _records;
+				bool _complete;
+		};
+
+		bool
+		Plan::is_complete () const
+		{
+			return _complete;
+		}
+
+		unsigned int
+		Plan::get_record_count () const
+		{
+			return _records.size ();
+		}
+
+	}
+}
+
+#endif
@@ -73,6 +73,9 @@ namespace goptical
 
 				/** Define a new child generated ray */
 				inline void add_generated (trace::Ray *r);
+				/** Define ray this one descends from without adding it to
+				    the children list of this ray */
+				inline void set_parent (trace::Ray *r);
 
 				/** Set light ray interception point and element */
 				inline void set_intercept (const sys::Element &e,
@@ -138,6 +141,13 @@ namespace goptical
 			_child = r;
 		}
 
+		void
+		Ray::set_parent (Ray *r)
+		{
+			assert (!_parent);
+			_parent = r;
+		}
+
 		void
 		Ray::set_intercept (const sys::Element &e, const math::Vector3 &point)
 		{
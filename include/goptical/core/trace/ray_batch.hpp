@@ -0,0 +1,349 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_RAY_BATCH_HH_
+#define GOPTICAL_TRACE_RAY_BATCH_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/transform.hpp"
+#include "goptical/core/math/vector.hpp"
+#include "goptical/core/math/vector_pair.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Structure of arrays storage for a batch of rays
+		   @header <goptical/core/trace/RayBatch
+		   @module {Core}
+
+		   This class stores a set of light rays propagated together
+		   through a sequence of elements. Ray fields are stored in
+		   separate arrays so that per surface processing loops work on
+		   contiguous data.
+
+		   All rays in a batch are expressed in the local coordinates of
+		   the same element, see @ref set_frame. When processed by a
+		   surface, rays are moved to the intersection point and take the
+		   outgoing direction. Rays which miss the surface are marked as
+		   lost. Rays which hit the surface but are not propagated further
+		   are deactivated and keep the intersection point as origin.
+
+		   No @ref Ray object is involved unless a @ref Result object is
+		   attached with @ref set_result. In this case, a @ref Ray object
+		   is allocated for each ray leaving a surface and linked to its
+		   parent as in the regular sequential ray trace. Allocation can
+		   be skipped for surfaces whose outgoing rays are not saved, see
+		   @ref set_allocate.
+
+		   @see sys::Element::process_rays
+		 */
+		class RayBatch
+		{
+			public:
+				/** Ray fields stored as double arrays */
+				enum Field
+				{
+				    OriginX,
+				    OriginY,
+				    OriginZ,
+				    DirectionX,
+				    DirectionY,
+				    DirectionZ,
+				    /** surface normal at last intersection point */
+				    NormalX,
+				    NormalY,
+				    NormalZ,
+				    Wavelen,
+				    Intensity,
+				    /** length of last propagation step */
+				    Length,
+				    FieldCount
+				};
+
+				/** Ray propagation states */
+				enum State
+				{
+				    /** ray missed a surface */
+				    StateLost,
+				    /** ray still propagating */
+				    StateActive,
+				    /** ray intercepted but not propagated further */
+				    StateStopped,
+				};
+
+				/** Create an empty ray batch */
+				RayBatch ();
+
+				/** Remove all rays from batch */
+				void clear ();
+
+				/** Reserve storage for the given ray count */
+				void reserve (unsigned int count);
+
+				/** Add a ray to batch. The ray must be expressed in frame
+				    element coordinates. Return ray index. */
+				unsigned int add (const math::VectorPair3 &ray, double wavelen,
+				                  double intensity, const material::Base *material);
+
+				/** Add a traced ray to batch. If the batch frame is not set yet,
+				    it is set to the ray creator element. The ray is used as
+				    parent of the next generated ray when a result object is
+				    attached. Return ray index. */
+				unsigned int add (Ray &ray);
+
+				/** Get number of rays in batch */
+				inline unsigned int size () const;
+
+				/** Get number of rays still propagating */
+				unsigned int get_active_count () const;
+
+				GOPTICAL_ACCESSORS (const sys::Element *, frame,
+				                    "element which defines rays coordinates, rays are already in local coordinates of next processing element if null");
+
+				GOPTICAL_ACCESSORS (Result *, result,
+				                    "result object used to record rays tree, may be null");
+
+				GOPTICAL_ACCESSORS (Result *, sink_result,
+				                    "result object notified of surface intercepts, may be null");
+
+				GOPTICAL_ACCESSORS (bool, allocate,
+				                    "allocate ray objects for rays leaving the next processed surface when a result object is attached, default is true");
+
+				GOPTICAL_ACCESSORS (bool, traced_incident,
+				                    "traced rays are incident rays of the next processed surface, they are their closest allocated ancestors otherwise");
+
+				/** Apply transform to origin and direction of active rays */
+				void transform (const math::Transform<3> &t);
+
+				/** Get field array */
+				inline double *get_data (Field f);
+				/** Get field array */
+				inline const double *get_data (Field f) const;
+				/** Get ray state array, values are from the @ref State enum */
+				inline unsigned char *get_state_data ();
+
+				/** Get ray origin */
+				inline math::Vector3 get_origin (unsigned int i) const;
+				/** Set ray origin */
+				inline void set_origin (unsigned int i, const math::Vector3 &v);
+				/** Get ray direction */
+				inline math::Vector3 get_direction (unsigned int i) const;
+				/** Set ray direction */
+				inline void set_direction (unsigned int i, const math::Vector3 &v);
+				/** Get ray origin and direction */
+				inline math::VectorPair3 get_ray (unsigned int i) const;
+				/** Get surface normal at last intersection */
+				inline math::Vector3 get_normal (unsigned int i) const;
+				/** Set surface normal at last intersection */
+				inline void set_normal (unsigned int i, const math::Vector3 &v);
+
+				/** Get ray wavelen */
+				inline double get_wavelen (unsigned int i) const;
+				/** Get ray intensity */
+				inline double get_intensity (unsigned int i) const;
+				/** Get length of last propagation step */
+				inline double get_len (unsigned int i) const;
+
+				/** Get material ray is propagated in */
+				inline const material::Base *get_material (unsigned int i) const;
+				/** Set material ray is propagated in */
+				inline void set_material (unsigned int i, const material::Base *m);
+
+				/** Test if ray is still propagating */
+				inline bool is_active (unsigned int i) const;
+				/** Test if ray missed a surface */
+				inline bool is_lost (unsigned int i) const;
+				/** Stop ray propagation at current origin */
+				inline void deactivate (unsigned int i);
+				/** Stop ray propagation because it missed a surface */
+				inline void set_lost (unsigned int i);
+
+				/** Get traced ray object associated with ray, may be null */
+				inline Ray *get_traced_ray (unsigned int i) const;
+				/** Set traced ray object associated with ray */
+				inline void set_traced_ray (unsigned int i, Ray *ray);
+
+			private:
+				std::vector<double> _data[FieldCount];
+				std::vector<const material::Base *> _material;
+				std::vector<unsigned char> _state;
+				std::vector<Ray *> _traced;
+				const sys::Element *_frame;
+				Result *_result;
+				Result *_sink_result;
+				bool _allocate;
+				bool _traced_incident;
+		};
+
+		unsigned int
+		RayBatch::size () const
+		{
+			return _state.size ();
+		}
+
+		double *
+		RayBatch::get_data (Field f)
+		{
+			return _data[f].data ();
+		}
+
+		const double *
+		RayBatch::get_data (Field f) const
+		{
+			return _data[f].data ();
+		}
+
+		unsigned char *
+		RayBatch::get_state_data ()
+		{
+			return _state.data ();
+		}
+
+		math::Vector3
+		RayBatch::get_origin (unsigned int i) const
+		{
+			return math::Vector3 (_data[OriginX][i], _data[OriginY][i],
+			                      _data[OriginZ][i]);
+		}
+
+		void
+		RayBatch::set_origin (unsigned int i, const math::Vector3 &v)
+		{
+			_data[OriginX][i] = v.x ();
+			_data[OriginY][i] = v.y ();
+			_data[OriginZ][i] = v.z ();
+		}
+
+		math::Vector3
+		RayBatch::get_direction (unsigned int i) const
+		{
+			return math::Vector3 (_data[DirectionX][i], _data[DirectionY][i],
+			                      _data[DirectionZ][i]);
+		}
+
+		void
+		RayBatch::set_direction (unsigned int i, const math::Vector3 &v)
+		{
+			_data[DirectionX][i] = v.x ();
+			_data[DirectionY][i] = v.y ();
+			_data[DirectionZ][i] = v.z ();
+		}
+
+		math::VectorPair3
+		RayBatch::get_ray (unsigned int i) const
+		{
+			return math::VectorPair3 (get_origin (i), get_direction (i));
+		}
+
+		math::Vector3
+		RayBatch::get_normal (unsigned int i) const
+		{
+			return math::Vector3 (_data[NormalX][i], _data[NormalY][i],
+			                      _data[NormalZ][i]);
+		}
+
+		void
+		RayBatch::set_normal (unsigned int i, const math::Vector3 &v)
+		{
+			_data[NormalX][i] = v.x ();
+			_data[NormalY][i] = v.y ();
+			_data[NormalZ][i] = v.z ();
+		}
+
+		double
+		RayBatch::get_wavelen (unsigned int i) const
+		{
+			return _data[Wavelen][i];
+		}
+
+		double
+		RayBatch::get_intensity (unsigned int i) const
+		{
+			return _data[Intensity][i];
+		}
+
+		double
+		RayBatch::get_len (unsigned int i) const
+		{
+			return _data[Length][i];
+		}
+
+		const material::Base *
+		RayBatch::get_material (unsigned int i) const
+		{
+			return _material[i];
+		}
+
+		void
+		RayBatch::set_material (unsigned int i, const material::Base *m)
+		{
+			_material[i] = m;
+		}
+
+		bool
+		RayBatch::is_active (unsigned int i) const
+		{
+			return _state[i] == StateActive;
+		}
+
+		bool
+		RayBatch::is_lost (unsigned int i) const
+		{
+			return _state[i] == StateLost;
+		}
+
+		void
+		RayBatch::deactivate (unsigned int i)
+		{
+			_state[i] = StateStopped;
+		}
+
+		void
+		RayBatch::set_lost (unsigned int i)
+		{
+			_state[i] = StateLost;
+		}
+
+		Ray *
+		RayBatch::get_traced_ray (unsigned int i) const
+		{
+			return _traced[i];
+		}
+
+		void
+		RayBatch::set_traced_ray (unsigned int i, Ray *ray)
+		{
+			_traced[i] = ray;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_REFRACTION_STATS_HH_
+#define GOPTICAL_TRACE_REFRACTION_STATS_HH_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Refraction formulas validation statistics
+		   @header <goptical/core/trace/RefractionStats
+		   @module {Core}
+
+		   When attached to tracer parameters, refracted directions are
+		   computed with both available formulas. The direction computed
+		   with the selected @ref RefractionLaw is used and disagreements
+		   between formulas are recorded in this object.
+
+		   This object may be updated concurrently by tracer threads.
+
+		   @see Params::set_refraction_stats
+		 */
+		class RefractionStats
+		{
+			public:
+				/** Refraction formulas disagreement record */
+				struct Mismatch
+				{
+					/** incident ray direction */
+					math::Vector3 _incident;
+					/** surface normal */
+					math::Vector3 _normal;
+					/** refractive index ratio */
+					double _index;
+					/** direction computed with selected formula */
+					math::Vector3 _selected;
+					/** direction computed with other formula */
+					math::Vector3 _other;
+				};
+
+				/** Create a stats object with 1e-14 tolerance */
+				RefractionStats ();
+
+				/** Reset counters and records */
+				void clear ();
+
+				/** Compare directions computed with both formulas */
+				void add (const math::Vector3 &incident, const math::Vector3 &normal,
+				          double index, const math::Vector3 &selected,
+				          const math::Vector3 &other);
+
+				GOPTICAL_ACCESSORS (double, tolerance,
+				                    "maximum difference between direction components");
+
+				GOPTICAL_ACCESSORS (unsigned int, record_limit,
+				                    "maximum number of recorded disagreements, default is 16");
+
+				/** Get number of compared refractions */
+				inline unsigned long get_count () const;
+
+				/** Get number of refractions where formulas disagree */
+				inline unsigned long get_mismatch_count () const;
+
+				/** Get largest difference between direction components */
+				inline double get_max_error () const;
+
+				/** Get first recorded disagreements */
+				inline const std::vector<Mismatch> &get_mismatches () const;
+
+			private:
+				// counters are updated without locking, the lock only guards
+				// disagreement records
+				std::mutex _lock;
+				double _tolerance;
+				unsigned int _record_limit;
+				std::atomic<unsigned long> _count;
+				std::atomic<unsigned long> _mismatch_count;
+				std::atomic<double> _max_error;
+				std::vector<Mismatch> _mismatches;
+		};
+
+		unsigned long
+		RefractionStats::get_count () const
+		{
+			return _count;
+		}
+
+		unsigned long
+		RefractionStats::get_mismatch_count () const
+		{
+			return _mismatch_count;
+		}
+
+		double
+		RefractionStats::get_max_error () const
+		{
+			return _max_error;
+		}
+
+		const std::vector<RefractionStats::Mismatch> &
+		RefractionStats::get_mismatches () const
+		{
+			return _mismatches;
+		}
+	}
+}
+
+#endif
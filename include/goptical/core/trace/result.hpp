@@ -2,6 +2,7 @@
 #define GOPTICAL_TRACE_RESULT_HH_
 
 #include <deque>
+#include <functional>
 #include <memory>
 #include <set>
 
@@ -10,6 +11,7 @@
 #include "goptical/core/sys/element.hpp"
 #include "goptical/core/sys/surface.hpp"
 #include "goptical/core/trace/ray.hpp"
+#include "goptical/core/trace/result_sink.hpp"
 
 namespace goptical
 {
@@ -36,6 +38,7 @@ namespace goptical
 		class Ray;
 		class Result
 		{
+				friend class Plan;
 				friend class Tracer;
 
 			public:
@@ -63,9 +66,39 @@ namespace goptical
 
 				std::vector<std::vector<double> > pixelate (const sys::Surface &s) const;
 
-				/** Clear all result data */
+				/** Clear all result data. Rays storage and rays lists are
+				    kept for reuse when memory retention is enabled. */
 				void clear ();
 
+				/** Keep rays storage, rays lists and worker thread shards
+				    allocated between ray traces. This avoids memory
+				    allocation when the same system is traced many times. */
+				inline void set_memory_retention (bool retain);
+				/** Return true if memory is retained between ray traces */
+				inline bool get_memory_retention () const;
+
+				/** Clear all result data and free all retained memory */
+				void release_memory ();
+
+				/** Append rays saved in lists of an other result of the
+				    same system to the saved rays lists of this result.
+				    Only rays accepted by the filter function are appended
+				    and only lists with enabled save state are updated.
+				    The other result is kept along with its rays until
+				    this result is cleared. Sinks are not involved. */
+				void merge (const std::shared_ptr<Result> &result,
+				            const std::function<bool (const Ray &)> &filter);
+
+				/** Get number of rays currently allocated by result,
+				    including worker thread shards */
+				size_t get_ray_count () const;
+				/** Get number of rays which fit in currently allocated
+				    storage, including worker thread shards */
+				size_t get_ray_capacity () const;
+				/** Get largest number of rays allocated by a single ray
+				    trace since creation or last call to @ref release_memory */
+				size_t get_ray_high_water_mark () const;
+
 				/** List of rays striking this surface must be saved when tracing rays */
 				void set_intercepted_save_state (const sys::Element &e, bool enabled = true);
 				/** Return true if generated rays must be saved for this element */
@@ -79,6 +112,16 @@ namespace goptical
 				/** Set all save states to false */
 				void clear_save_states ();
 
+				/** Attach a sink which is notified of all rays intercepted
+				    by a surface when tracing rays. The sink is cleared at
+				    the beginning of each ray trace. A null pointer detaches
+				    the current sink. */
+				void set_intercept_sink (const sys::Surface &s,
+				                         const std::shared_ptr<ResultSink> &sink);
+				/** Get sink attached to a surface, may be null */
+				const std::shared_ptr<ResultSink> &
+				get_intercept_sink (const sys::Surface &s) const;
+
 				/** Get maximum intensity for a single ray FIXME */
 				double get_max_ray_intensity () const;
 
@@ -91,10 +134,25 @@ namespace goptical
 				/** Allocate a new trace::Ray object from result */
 				inline Ray &new_ray (const light::Ray &r);
 
+				/** Declare a ray generated from an incident ray. Links
+				    between rays depend on the tracer genealogy mode. */
+				inline void link_generated (Ray &incident, Ray &ray);
+
 				/** Declare a new ray interception */
 				inline void add_intercepted (const sys::Surface &s, Ray &ray);
 				/** Declare a new ray generation */
 				inline void add_generated (const sys::Element &s, Ray &ray);
+				/** Notify surface intercept sink of a new ray interception */
+				inline void add_intercept_event (const sys::Surface &s,
+				                                 const math::Vector3 &point,
+				                                 const math::Vector3 &direction,
+				                                 double wavelen, double intensity);
+
+				/** Get range of source samples which must be used to
+				    generate rays, see @ref sys::Source::get_sample_count.
+				    All samples are used unless the tracer generates rays
+				    by parts. */
+				inline void get_sample_range (size_t &first, size_t &end) const;
 
 				/** Declare ray wavelen used for tracing */
 				inline void add_ray_wavelen (double wavelen);
@@ -102,6 +160,10 @@ namespace goptical
 				/** Get ray wavelen in use set */
 				inline const std::set<double> &get_ray_wavelen_set () const;
 
+				/** Get number of rays not traced further because maximum
+				    bounce count was reached */
+				inline unsigned int get_bounce_limit_count () const;
+
 				/** Get reference to tracer parameters used */
 				inline const Params &get_params () const;
 
@@ -121,7 +183,22 @@ namespace goptical
 				void init (const sys::Element &element);
 
 				void prepare ();
-				typedef std::deque<Ray *> rays_queue_t;
+
+				/** Allocate a result shard for use by a worker thread. Shard
+				    element lists follow save states of this result and
+				    rays allocated by the shard live as long as this
+				    result. Shard sinks are forked from this result sinks
+				    when @tt sinks is set. */
+				Result &new_shard (bool sinks = true);
+				/** Test if an intercept sink is attached to any surface */
+				bool has_sinks () const;
+				/** Test if any rays list is saved by the current trace */
+				bool has_saved_lists () const;
+				/** Allocate or reuse a rays list depending on save state */
+				void prepare_list (std::shared_ptr<rays_queue_t> &list, bool enabled);
+				/** Append shard saved rays lists to this result lists */
+				void merge_shard (Result &shard);
+
 				struct element_result_s
 				{
 					std::shared_ptr<rays_queue_t>
@@ -130,6 +207,7 @@ namespace goptical
 					_generated; // list of rays for each generator surfaces
 					bool _save_intercepted_list;
 					bool _save_generated_list;
+					std::shared_ptr<ResultSink> _sink;
 				};
 
 				inline struct element_result_s &get_element_result (const sys::Element &e);
@@ -144,6 +222,14 @@ namespace goptical
 				unsigned int _bounce_limit_count;
 				const sys::System *_system; /* warning System must be valid ! */
 				const trace::Params *_params;
+				GenealogyMode _genealogy;
+				std::vector<std::shared_ptr<Result> > _shards;
+				unsigned int _shard_count; // shards in use, others are retained
+				bool _memory_retention;
+				size_t _high_water_mark;
+				// source samples range used for ray generation
+				size_t _sample_first;
+				size_t _sample_end;
 				//  tracer::Mode          _mode;
 		};
 		Result::element_result_s &
@@ -180,6 +266,18 @@ namespace goptical
 			return *er._generated;
 		}
 
+		void
+		Result::set_memory_retention (bool retain)
+		{
+			_memory_retention = retain;
+		}
+
+		bool
+		Result::get_memory_retention () const
+		{
+			return _memory_retention;
+		}
+
 		const trace::Result::sources_t &
 		Result::get_source_list () const
 		{
@@ -206,6 +304,42 @@ namespace goptical
 			}
 		}
 
+		void
+		Result::link_generated (Ray &incident, Ray &ray)
+		{
+			switch (_genealogy)
+			{
+				case GenealogyFull:
+					incident.add_generated (&ray);
+					break;
+				case GenealogyCompact:
+					ray.set_parent (&incident);
+					break;
+				case GenealogyNone:
+					break;
+			}
+		}
+
+		void
+		Result::add_intercept_event (const sys::Surface &s,
+		                             const math::Vector3 &point,
+		                             const math::Vector3 &direction,
+		                             double wavelen, double intensity)
+		{
+			element_result_s &er = get_element_result (s);
+			if (er._sink)
+			{
+				er._sink->add_intercept (s, point, direction, wavelen, intensity);
+			}
+		}
+
+		void
+		Result::get_sample_range (size_t &first, size_t &end) const
+		{
+			first = _sample_first;
+			end = _sample_end;
+		}
+
 		void
 		Result::add_ray_wavelen (double wavelen)
 		{
@@ -240,6 +374,12 @@ namespace goptical
 			return r;
 		}
 
+		unsigned int
+		Result::get_bounce_limit_count () const
+		{
+			return _bounce_limit_count;
+		}
+
 		const Params &
 		Result::get_params () const
 		{
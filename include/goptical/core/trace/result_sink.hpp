@@ -0,0 +1,88 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_RESULT_SINK_HH_
+#define GOPTICAL_TRACE_RESULT_SINK_HH_
+
+#include <memory>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Ray intercepts accumulator interface
+		   @header <goptical/core/trace/ResultSink
+		   @module {Core}
+		   @main
+
+		   A sink can be attached to a surface with @ref
+		   Result::set_intercept_sink. It is then notified of all rays
+		   intercepted by the surface during ray trace. Unlike saved
+		   intercepted rays lists, sinks make it possible to compute
+		   statistics over many rays without keeping them, see @ref
+		   SinkStats and @ref SinkHistogram. In sequential mode, when
+		   no rays list is saved, source rays are generated block by
+		   block and memory use does not depend on the number of rays.
+
+		   In sequential mode, sinks obtained with @ref fork are fed
+		   with fixed blocks of source rays and merged back in block
+		   order. In non sequential mode, intercepts are replayed in
+		   source ray order once rays have been traced. In both cases
+		   results do not depend on the thread count.
+		*/
+		class ResultSink
+		{
+			public:
+				virtual ~ResultSink () {}
+
+				/** Accumulate a ray intercept. Intercept point and incident
+				    ray direction are expressed in surface local
+				    coordinates. */
+				virtual void add_intercept (const sys::Surface &s,
+				                            const math::Vector3 &point,
+				                            const math::Vector3 &direction,
+				                            double wavelen, double intensity) = 0;
+
+				/** Reset accumulated data, called before each ray trace */
+				virtual void clear () = 0;
+
+				/** Create an empty sink with same settings, used by
+				    tracing threads */
+				virtual std::shared_ptr<ResultSink> fork () const = 0;
+
+				/** Add data accumulated by a forked sink */
+				virtual void merge (const ResultSink &sink) = 0;
+		};
+
+	}
+}
+
+#endif
@@ -53,6 +53,7 @@ namespace goptical
 		class Sequence
 		{
 				friend std::ostream &operator<< (std::ostream &o, const Sequence &s);
+				friend class Plan;
 				friend class Tracer;
 
 			public:
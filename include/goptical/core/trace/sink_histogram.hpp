@@ -0,0 +1,131 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_SINK_HISTOGRAM_HH_
+#define GOPTICAL_TRACE_SINK_HISTOGRAM_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/trace/result_sink.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Binned ray intercepts intensity accumulator
+		   @header <goptical/core/trace/SinkHistogram
+		   @module {Core}
+		   @main
+
+		   This sink sums intensity of intercepted rays in a 2d grid of
+		   bins covering a fixed window in the surface plane. Rays which
+		   fall outside the window are only accounted in @ref
+		   get_outside_intensity.
+		*/
+		class SinkHistogram : public ResultSink
+		{
+			public:
+				/** Create an histogram covering given x/y window with
+				    given number of bins along each axis */
+				SinkHistogram (const math::VectorPair2 &window, unsigned int x_bins,
+				               unsigned int y_bins);
+
+				/** Get histogram window */
+				inline const math::VectorPair2 &get_window () const;
+
+				/** Get number of bins along x or y axis */
+				inline unsigned int get_bin_count (unsigned int axis) const;
+
+				/** Get intensity summed in a bin */
+				inline double get_value (unsigned int x, unsigned int y) const;
+
+				/** Get number of rays counted in a bin */
+				inline unsigned long get_ray_count (unsigned int x, unsigned int y) const;
+
+				/** Get summed intensity of rays outside window */
+				inline double get_outside_intensity () const;
+
+				/** @override */
+				void add_intercept (const sys::Surface &s, const math::Vector3 &point,
+				                    const math::Vector3 &direction, double wavelen,
+				                    double intensity);
+				/** @override */
+				void clear ();
+				/** @override */
+				std::shared_ptr<ResultSink> fork () const;
+				/** @override */
+				void merge (const ResultSink &sink);
+
+			private:
+				math::VectorPair2 _window;
+				unsigned int _bins[2];
+				math::Vector2 _scale;
+				std::vector<double> _values;
+				std::vector<unsigned long> _counts;
+				double _outside;
+		};
+
+		const math::VectorPair2 &
+		SinkHistogram::get_window () const
+		{
+			return _window;
+		}
+
+		unsigned int
+		SinkHistogram::get_bin_count (unsigned int axis) const
+		{
+			assert (axis < 2);
+			return _bins[axis];
+		}
+
+		double
+		SinkHistogram::get_value (unsigned int x, unsigned int y) const
+		{
+			assert (x < _bins[0] && y < _bins[1]);
+			return _values[x + _bins[0] * y];
+		}
+
+		unsigned long
+		SinkHistogram::get_ray_count (unsigned int x, unsigned int y) const
+		{
+			assert (x < _bins[0] && y < _bins[1]);
+			return _counts[x + _bins[0] * y];
+		}
+
+		double
+		SinkHistogram::get_outside_intensity () const
+		{
+			return _outside;
+		}
+
+	}
+}
+
+#endif
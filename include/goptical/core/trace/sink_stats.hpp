@@ -0,0 +1,122 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_SINK_STATS_HH_
+#define GOPTICAL_TRACE_SINK_STATS_HH_
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/trace/result_sink.hpp"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		/**
+		   @short Ray intercepts statistics accumulator
+		   @header <goptical/core/trace/SinkStats
+		   @module {Core}
+		   @main
+
+		   This sink computes intercepts count, centroid, root mean
+		   square radius in the surface plane, bounding window and
+		   intensity totals without storing rays. Mean and squared
+		   deviation are updated incrementally so that accuracy does not
+		   depend on distance to origin.
+		*/
+		class SinkStats : public ResultSink
+		{
+			public:
+				SinkStats ();
+
+				/** Get number of intercepted rays */
+				inline unsigned long get_count () const;
+
+				/** Get centroid of intercept points */
+				math::Vector3 get_centroid () const;
+
+				/** Get root mean square distance of intercept points to
+				    centroid in surface xy plane */
+				double get_rms_radius () const;
+
+				/** Get window which includes all intercept points */
+				math::VectorPair3 get_window () const;
+
+				/** Get center of window */
+				math::Vector3 get_center () const;
+
+				/** Get sum of intercepted rays intensity */
+				inline double get_total_intensity () const;
+
+				/** Get maximum intercepted ray intensity */
+				inline double get_max_intensity () const;
+
+				/** @override */
+				void add_intercept (const sys::Surface &s, const math::Vector3 &point,
+				                    const math::Vector3 &direction, double wavelen,
+				                    double intensity);
+				/** @override */
+				void clear ();
+				/** @override */
+				std::shared_ptr<ResultSink> fork () const;
+				/** @override */
+				void merge (const ResultSink &sink);
+
+			private:
+				void check_count () const;
+
+				unsigned long _count;
+				math::Vector3 _mean;
+				// sum of squared xy distances to mean
+				double _m2;
+				math::VectorPair3 _window;
+				double _intensity;
+				double _max_intensity;
+		};
+
+		unsigned long
+		SinkStats::get_count () const
+		{
+			return _count;
+		}
+
+		double
+		SinkStats::get_total_intensity () const
+		{
+			return _intensity;
+		}
+
+		double
+		SinkStats::get_max_intensity () const
+		{
+			return _max_intensity;
+		}
+
+	}
+}
+
+#endif
@@ -48,6 +48,20 @@ namespace goptical
 		   Propagation result is stored in a @ref Result object.
 		   Propagation parameters are stored in a @ref Params object.
 
+		   Rays can be split between worker threads as set by @ref
+		   Params::set_thread_count. Each worker uses its own result
+		   shard, which is merged back in ray order so that results do
+		   not depend on the thread count. In non sequential mode, the
+		   whole ray tree of a source ray is traced by a single worker and
+		   idle workers steal source rays from busy ones.
+
+		   Intercept sinks attached to the @ref Result are fed by blocks
+		   of source rays merged in a fixed order. In sequential mode,
+		   when no rays list is saved and all sources come first in the
+		   sequence, source rays are generated and traced block by
+		   block so that memory use does not depend on the number of
+		   rays, see @ref sys::Source::get_sample_count.
+
 		   @xsee {tuto_seqtrace}
 		 */
 		class Tracer
@@ -58,6 +72,7 @@ namespace goptical
 
 				~Tracer ();
 				Tracer ()
+					: _sources (0)
 				{
 					;
 				}
@@ -86,14 +101,53 @@ namespace goptical
 				/** Launch ray tracing operation */
 				void trace ();
 
+				/** Launch ray tracing operation with given light sources
+				    instead of system and sequence sources. Sources which
+				    are not part of the system are positioned relative to
+				    global coordinates and their generated rays lists are
+				    not saved. This allows tracing from temporary sources
+				    without changing the system. */
+				void trace (const std::vector<const sys::Source *> &sources);
+
+				/** Get surface source rays are distributed on with
+				    current parameters, may be null in sequential mode */
+				const sys::Surface *get_entrance () const;
+
 			private:
 				template <IntensityMode m> void trace_template ();
 				template <IntensityMode m> void trace_seq_template ();
+				template <IntensityMode m>
+				void trace_seq_elements (Result &result,
+				                         const std::vector<const sys::Element *> &run,
+				                         rays_queue_t *input);
+				bool trace_seq_batch (Result &result,
+				                      const std::vector<const sys::Element *> &run,
+				                      rays_queue_t *input);
+				template <IntensityMode m>
+				void trace_seq_parallel (Result &result,
+				                         const std::vector<const sys::Element *> &run,
+				                         rays_queue_t *input, unsigned int threads);
+				template <IntensityMode m>
+				bool trace_seq_stream (const std::vector<const sys::Element *> &seq,
+				                       const sys::Element *entrance, bool plan,
+				                       unsigned int threads);
+				template <IntensityMode m>
+				void trace_nonseq_parallel (Result &result,
+				                            const rays_queue_t &source_rays,
+				                            unsigned int threads);
+				template <IntensityMode m, class Event>
+				void trace_ray_tree (Result &result, Ray *ray, rays_queue_t &gqueue,
+				                     Event &event);
+				unsigned int get_thread_count () const;
+				void update_index_table (const Result &result);
 
 				const sys::System *_system; // Warning must be valid!
 				Params _params;
 				Result _result;
 				Result *_result_ptr;
+				std::shared_ptr<Plan> _plan;
+				// sources used instead of system sources, may be null
+				const std::vector<const sys::Source *> *_sources;
 		};
 		void
 		Tracer::set_trace_result (Result &res)
@@ -0,0 +1,384 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <unordered_map>
+
+#include <goptical/core/analysis/field_sweep.hpp>
+#include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/source.hpp>
+#include <goptical/core/sys/surface.hpp>
+#include <goptical/core/sys/system.hpp>
+
+#include <goptical/core/curve/base.hpp>
+
+#include <goptical/core/light/spectral_line.hpp>
+
+#include <goptical/core/material/base.hpp>
+
+#include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/result.hpp>
+
+namespace goptical
+{
+
+	namespace analysis
+	{
+
+		FieldSweep::FieldSweep (std::shared_ptr<sys::System> &system)
+			: PointImage (system), _fields (), _wavelens (), _cells (), _sources ()
+		{
+		}
+
+		FieldSweep::~FieldSweep () {}
+
+		void
+		FieldSweep::add_field_angle (double angle)
+		{
+			const double a = math::degree2rad (angle);
+			field_s f = { sys::SourceAtInfinity, math::Vector3 (0., sin (a), cos (a)),
+			              angle
+			            };
+			_fields.push_back (f);
+			invalidate ();
+		}
+
+		void
+		FieldSweep::add_field_point (const math::Vector3 &pos)
+		{
+			field_s f = { sys::SourceAtFiniteDistance, pos,
+			              std::numeric_limits<double>::quiet_NaN ()
+			            };
+			_fields.push_back (f);
+			invalidate ();
+		}
+
+		void
+		FieldSweep::add_wavelen (double wavelen)
+		{
+			_wavelens.push_back (wavelen);
+			invalidate ();
+		}
+
+		void
+		FieldSweep::clear ()
+		{
+			_fields.clear ();
+			_wavelens.clear ();
+			invalidate ();
+		}
+
+		// pattern sample of a generated ray
+		struct field_sample_s
+		{
+			unsigned int _cell;
+			double _weight;
+			bool _chief;
+			bool _pattern;
+		};
+
+		typedef std::unordered_map<const trace::Ray *, field_sample_s> field_samples_t;
+
+		/* Point source of a field, not part of the system. Rays are
+		   generated toward pattern points of the entrance surface as
+		   done by sys::SourcePoint, and their pattern sample is
+		   recorded. */
+		class FieldSweepSource : public sys::Source
+		{
+			public:
+				FieldSweepSource (sys::SourceInfinityMode m, const math::Vector3 &pos_dir,
+				                  const sys::Surface &entrance,
+				                  const std::shared_ptr<std::vector<math::Vector3>> &points,
+				                  const std::shared_ptr<std::vector<double>> &weights,
+				                  unsigned int pattern_first, unsigned int cell,
+				                  field_samples_t &samples);
+
+			private:
+				void generate_rays_simple (trace::Result &result,
+				                           const targets_t &entry) const;
+				void generate_rays_intensity (trace::Result &result,
+				                              const targets_t &entry) const;
+
+				sys::SourceInfinityMode _mode;
+				const sys::Surface &_entrance;
+				std::shared_ptr<std::vector<math::Vector3>> _points;
+				std::shared_ptr<std::vector<double>> _weights;
+				unsigned int _pattern_first;
+				// cell of first spectral line
+				unsigned int _cell;
+				// filled when generating rays, only valid during ray trace
+				field_samples_t &_samples;
+		};
+
+		FieldSweepSource::FieldSweepSource (sys::SourceInfinityMode m,
+		                                    const math::Vector3 &pos_dir,
+		                                    const sys::Surface &entrance,
+		                                    const std::shared_ptr<std::vector<math::Vector3>> &points,
+		                                    const std::shared_ptr<std::vector<double>> &weights,
+		                                    unsigned int pattern_first,
+		                                    unsigned int cell,
+		                                    field_samples_t &samples)
+			: Source (m == sys::SourceAtInfinity
+			          ? math::VectorPair3 (pos_dir * -1e9, pos_dir)
+			          : math::VectorPair3 (pos_dir, math::vector3_001)),
+			  _mode (m), _entrance (entrance), _points (points), _weights (weights),
+			  _pattern_first (pattern_first), _cell (cell), _samples (samples)
+		{
+		}
+
+		void
+		FieldSweepSource::generate_rays_simple (trace::Result &result,
+		                                        const targets_t &entry) const
+		{
+for (auto &l : _spectrum)
+			{
+				result.add_ray_wavelen (l.get_wavelen ());
+			}
+			const trace::Params &params = result.get_params ();
+			double rlen = params.get_lost_ray_length ();
+			const math::Transform<3> t (_entrance.get_transform_to (*this, params));
+			const material::Base *mat
+			    = _entrance.get_system ()->get_environment_proxy ().get ();
+			math::VectorPair3 plane (t.transform (math::vector3_0)
+			                         - math::vector3_001 * rlen,
+			                         math::vector3_001);
+			for (size_t k = 0; k < _points->size (); k++)
+			{
+				// pattern point on entrance surface
+				math::Vector3 r = t.transform ((*_points)[k]);
+				double w = (*_weights)[k];
+				math::Vector3 direction;
+				math::Vector3 position;
+				switch (_mode)
+				{
+					case (sys::SourceAtFiniteDistance):
+						position = math::vector3_0;
+						direction = r.normalized ();
+						break;
+					case (sys::SourceAtInfinity):
+						direction = math::vector3_001;
+						position = plane.pl_ln_intersect (math::VectorPair3 (r, direction));
+						break;
+				}
+				for (unsigned int l = 0; l < _spectrum.size (); l++)
+				{
+					trace::Ray &ray = result.new_ray ();
+					// generated rays use source coordinates
+					ray.direction () = direction;
+					ray.origin () = position;
+					ray.set_creator (this);
+					ray.set_intensity (_spectrum[l].get_intensity () * w);
+					ray.set_wavelen (_spectrum[l].get_wavelen ());
+					ray.set_material (mat);
+					field_sample_s s = { _cell + l, w, k == 0,
+					                     k >= _pattern_first
+					                   };
+					_samples[&ray] = s;
+				}
+			}
+		}
+
+		void
+		FieldSweepSource::generate_rays_intensity (trace::Result &result,
+		        const targets_t &entry) const
+		{
+			generate_rays_simple (result, entry);
+		}
+
+		void
+		FieldSweep::process_trace ()
+		{
+			if (_processed_trace)
+			{
+				return;
+			}
+			if (_fields.empty ())
+			{
+				throw Error ("no field defined for analysis");
+			}
+			get_default_image ();
+			const trace::Params &params = _tracer.get_params ();
+			if (params.get_genealogy_mode () == trace::GenealogyNone)
+			{
+				throw Error ("field sweep requires ray genealogy");
+			}
+			std::vector<double> wavelens (_wavelens);
+			if (wavelens.empty ())
+			{
+				wavelens.push_back (light::SpectralLine::d);
+			}
+			const unsigned int lines = wavelens.size ();
+			const sys::Surface *entrance = _tracer.get_entrance ();
+			if (!entrance)
+			{
+				throw Error ("no entrance surface found for analysis");
+			}
+			// pattern points with a ray aimed at the entrance surface
+			// center sampled first
+			const std::vector<math::Vector3> *p;
+			const std::vector<double> *w;
+			std::shared_ptr<const std::vector<math::Vector3>> cached;
+			if (!params.get_pattern_points (*entrance, p, w))
+			{
+				cached = entrance->get_pattern_points (params.get_distribution (*entrance),
+				                                       params.get_unobstructed ());
+				p = cached.get ();
+				w = 0;
+			}
+			auto points = std::make_shared<std::vector<math::Vector3>> ();
+			auto weights = std::make_shared<std::vector<double>> ();
+			unsigned int pattern_first = 0;
+			if (p->empty () || (*p)[0].x () != 0. || (*p)[0].y () != 0.)
+			{
+				points->push_back (math::Vector3 (
+				                       0., 0., entrance->get_curve ().sagitta (math::vector2_0)));
+				weights->push_back (1.);
+				pattern_first = 1;
+			}
+			points->insert (points->end (), p->begin (), p->end ());
+			double generated = 0.;
+			for (size_t i = 0; i < p->size (); i++)
+			{
+				weights->push_back (w ? (*w)[i] : 1.);
+				generated += weights->back ();
+			}
+			// sweep sources are not part of the system and replace
+			// system sources during ray trace
+			field_samples_t sample_of;
+			std::vector<const sys::Source *> sources;
+			_sources.clear ();
+			for (unsigned int f = 0; f < _fields.size (); f++)
+			{
+				auto s = std::make_shared<FieldSweepSource> (
+				             _fields[f]._mode, _fields[f]._pos_dir, *entrance, points, weights,
+				             pattern_first, f * lines, sample_of);
+				s->clear_spectrum ();
+for (auto wl : wavelens)
+				{
+					s->add_spectral_line (light::SpectralLine (wl, 1.0));
+				}
+				_sources.push_back (s);
+				sources.push_back (s.get ());
+			}
+			trace::Result &result = _tracer.get_trace_result ();
+			result.set_intercepted_save_state (*_image, true);
+			_tracer.trace (sources);
+			cell_s empty = { math::vector3_0,
+			                 math::Vector3 (std::numeric_limits<double>::quiet_NaN ()),
+			                 0., generated, 0., 0
+			               };
+			_cells.assign (_fields.size () * lines, empty);
+			_intercepts = &result.get_intercepted (*_image);
+			// weighted centroid then rms radius of each cell
+			std::vector<const field_sample_s *> samples (_intercepts->size (), 0);
+			for (size_t i = 0; i < _intercepts->size (); i++)
+			{
+				const trace::Ray *r = (*_intercepts)[i];
+				const trace::Ray *root = r;
+				while (root->get_parent ())
+				{
+					root = root->get_parent ();
+				}
+				auto j = sample_of.find (root);
+				if (j == sample_of.end ())
+				{
+					continue;
+				}
+				const field_sample_s &s = j->second;
+				cell_s &c = _cells[s._cell];
+				if (s._chief)
+				{
+					c._chief = r->get_intercept_point ();
+				}
+				if (!s._pattern)
+				{
+					continue;
+				}
+				samples[i] = &s;
+				c._intercepted += s._weight;
+				c._centroid += r->get_intercept_point () * s._weight;
+				c._ray_count++;
+			}
+for (auto &c : _cells)
+			{
+				if (c._intercepted > 0.)
+				{
+					c._centroid /= c._intercepted;
+				}
+			}
+			for (size_t i = 0; i < _intercepts->size (); i++)
+				if (const field_sample_s *s = samples[i])
+				{
+					cell_s &c = _cells[s->_cell];
+					c._rms_radius += s->_weight
+					                 * math::square (((*_intercepts)[i]->get_intercept_point ()
+					                                  - c._centroid).len ());
+				}
+for (auto &c : _cells)
+			{
+				if (c._intercepted > 0.)
+				{
+					c._rms_radius = sqrt (c._rms_radius / c._intercepted);
+				}
+			}
+			_processed_trace = true;
+		}
+
+		void
+		FieldSweep::print_table (std::ostream &o)
+		{
+			process_trace ();
+			const unsigned int lines = get_wavelen_count ();
+			o << std::setw (10) << "field" << std::setw (10) << "wavelen"
+			  << std::setw (14) << "rms radius" << std::setw (14) << "centroid x"
+			  << std::setw (14) << "centroid y" << std::setw (14) << "center y"
+			  << std::setw (12) << "vignetting" << std::endl;
+			for (unsigned int f = 0; f < _fields.size (); f++)
+				for (unsigned int l = 0; l < lines; l++)
+				{
+					const cell_s &c = get_cell (f, l);
+					if (_fields[f]._mode == sys::SourceAtInfinity)
+					{
+						o << std::setw (10) << _fields[f]._angle;
+					}
+					else
+					{
+						o << std::setw (10) << _fields[f]._pos_dir.y ();
+					}
+					o << std::setw (10) << (_wavelens.empty () ? light::SpectralLine::d
+					                        : _wavelens[l])
+					  << std::setw (14) << c._rms_radius << std::setw (14)
+					  << c._centroid.x () << std::setw (14) << c._centroid.y ()
+					  << std::setw (14) << c._chief.y () << std::setw (12)
+					  << get_vignetting (f, l) << std::endl;
+				}
+		}
+
+	}
+
+}
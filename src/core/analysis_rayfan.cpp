@@ -103,6 +103,8 @@ namespace goptical
 				result.set_intercepted_save_state (*_exit, true);
 				_tracer.get_params ().set_distribution (*_entrance, _dist);
 				_tracer.get_params ().set_unobstructed (true);
+				// aberrations are evaluated by walking the rays tree
+				_tracer.get_params ().set_genealogy_mode (trace::GenealogyFull);
 				_tracer.trace ();
 				_processed_trace = true;
 			}
@@ -22,10 +22,21 @@
 
 */
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
 #include <goptical/core/analysis/spot.hpp>
 #include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/source.hpp>
+#include <goptical/core/sys/surface.hpp>
+
+#include <goptical/core/curve/base.hpp>
+#include <goptical/core/shape/base.hpp>
 
 #include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/params.hpp>
 #include <goptical/core/trace/ray.hpp>
 #include <goptical/core/trace/result.hpp>
 #include <goptical/core/trace/tracer.hpp>
@@ -39,6 +50,8 @@
 
 #include <goptical/core/light/spectral_line.hpp>
 
+#include "shape_sampling_.hxx"
+
 namespace goptical
 {
 
@@ -46,7 +59,9 @@ namespace goptical
 	{
 
 		Spot::Spot (std::shared_ptr<sys::System> &system)
-			: PointImage (system), _processed_analysis (false)
+			: PointImage (system), _adaptive_tolerance (0.),
+			  _adaptive_max_samples (16384), _rms_error (0.), _centroid_error (0.),
+			  _processed_analysis (false)
 		{
 			_axes.set_show_axes (false, io::RendererAxes::XY);
 			_axes.set_label ("Saggital distance", io::RendererAxes::X);
@@ -61,8 +76,359 @@ namespace goptical
 			{
 				return;
 			}
+			if (_adaptive_tolerance > 0.)
+			{
+				adaptive_trace ();
+				return;
+			}
 			trace ();
-			_centroid = _tracer.get_trace_result ().get_intercepted_centroid (*_image);
+			_weights.clear ();
+			_rms_error = _centroid_error = 0.;
+		}
+
+		// group of 2x2 pupil samples covering [x, x+size]^2 in the unit
+		// square which is mapped on the entrance surface disk, samples
+		// which fall outside the entrance shape are not created
+		struct adaptive_group_s
+		{
+			double _x, _y, _size;
+			double _error;
+			// range of group samples
+			unsigned int _first, _end;
+		};
+
+		// pupil sample and statistics of its image points, kept as
+		// long as the sample group is not refined
+		struct adaptive_sample_s
+		{
+			math::Vector3 _point;
+			double _weight;
+			unsigned int _count;
+			// mean image point and sum of squared distances to mean
+			math::Vector3 _mean;
+			double _m2;
+		};
+
+		void
+		Spot::adaptive_trace ()
+		{
+			get_default_image ();
+			trace::Params &params = _tracer.get_params ();
+			const sys::Surface *entrance = _tracer.get_entrance ();
+			if (!entrance)
+			{
+				throw Error ("no entrance surface found for adaptive sampling");
+			}
+			if (params.get_genealogy_mode () == trace::GenealogyNone)
+			{
+				throw Error ("adaptive sampling requires ray genealogy");
+			}
+			const trace::Distribution &d = params.get_distribution (*entrance);
+			const double radius
+			    = entrance->get_shape ().max_radius () * d.get_scaling ();
+			const bool unobstructed = params.get_unobstructed ();
+			trace::Result &result = _tracer.get_trace_result ();
+			result.set_intercepted_save_state (*_image, true);
+			// source rays are used to find pupil sample of intercepted rays,
+			// caller parameters and save states are restored when done
+			const trace::Params saved (params);
+			std::vector<const sys::Source *> sources;
+			std::vector<bool> saved_states;
+			_system->get_elements<sys::Source> ([&] (const sys::Source &s)
+			{
+				sources.push_back (&s);
+				saved_states.push_back (result.get_generated_save_state (s));
+				result.set_generated_save_state (s, true);
+			});
+			auto restore = [&] ()
+			{
+				_tracer.set_trace_result (result);
+				params = saved;
+				for (size_t i = 0; i < sources.size (); i++)
+				{
+					result.set_generated_save_state (*sources[i], saved_states[i]);
+				}
+			};
+			// coarse grid with same density as distribution patterns,
+			// initial samples have unit weight
+			const unsigned int n = std::max (
+			                           1, (int)round (d.get_radial_density () * sqrt (M_PI) / 2.));
+			const double norm = math::square (2. * n);
+			std::vector<adaptive_group_s> groups;
+			std::vector<adaptive_sample_s> samples;
+			// samples not traced yet
+			std::vector<unsigned int> pending;
+			auto add_group = [&] (std::vector<adaptive_group_s> &list,
+			                      double x, double y, double size)
+			{
+				adaptive_group_s g = { x, y, size, 0., (unsigned int)samples.size (), 0 };
+				const double h = size / 2.;
+				for (unsigned int k = 0; k < 4; k++)
+				{
+					math::Vector2 v = shape::concentric_disk (x + ((k & 1) + .5) * h,
+					                  y + ((k >> 1) + .5) * h)
+					                  * radius;
+					if (!unobstructed && !entrance->get_shape ().inside (v))
+					{
+						continue;
+					}
+					adaptive_sample_s a;
+					a._point = math::Vector3 (v, entrance->get_curve ().sagitta (v));
+					a._weight = h * h * norm;
+					a._count = 0;
+					a._mean = math::vector3_0;
+					a._m2 = 0.;
+					pending.push_back (samples.size ());
+					samples.push_back (a);
+				}
+				g._end = samples.size ();
+				list.push_back (g);
+			};
+			for (unsigned int i = 0; i < n; i++)
+				for (unsigned int j = 0; j < n; j++)
+				{
+					add_group (groups, i / (double)n, j / (double)n, 1. / n);
+				}
+			// each step is traced in its own result so that rays of
+			// retained samples are kept, intercepts are mapped to sample
+			// index through their source ray
+			std::vector<std::shared_ptr<trace::Result> > traced;
+			std::unordered_map<const trace::Ray *, unsigned int> sample_of;
+			auto trace_samples = [&] (const std::vector<unsigned int> &list)
+			{
+				auto step = std::make_shared<trace::Result> ();
+				_system->get_elements<sys::Element> ([&] (const sys::Element &e)
+				{
+					step->set_intercepted_save_state (e, result.get_intercepted_save_state (e));
+					step->set_generated_save_state (e, result.get_generated_save_state (e));
+				});
+				traced.push_back (step);
+				auto points = std::make_shared<std::vector<math::Vector3>> ();
+				auto weights = std::make_shared<std::vector<double>> ();
+for (auto i : list)
+				{
+					points->push_back (samples[i]._point);
+					weights->push_back (samples[i]._weight);
+				}
+				params.set_pattern_points (*entrance, points, weights);
+				_tracer.set_trace_result (*step);
+				_tracer.trace ();
+				_intercepts = &step->get_intercepted (*_image);
+for (auto s : sources)
+				{
+					const trace::rays_queue_t &gen = step->get_generated (*s);
+					if (list.empty () || gen.size () % list.size ())
+					{
+						continue;
+					}
+					const size_t lines = gen.size () / list.size ();
+					for (size_t i = 0; i < gen.size (); i++)
+					{
+						sample_of[gen[i]] = list[i / lines];
+					}
+				}
+			};
+			auto sample_index = [&] (const trace::Ray *r)
+			{
+				while (r->get_parent ())
+				{
+					r = r->get_parent ();
+				}
+				auto j = sample_of.find (r);
+				return j == sample_of.end () ? -1 : (int)j->second;
+			};
+			// intercepts not related to a pupil sample, from first trace
+			adaptive_sample_s other = { math::vector3_0, 1., 0, math::vector3_0, 0. };
+			double rms_prev = 0.;
+			math::Vector3 centroid_prev (0., 0., 0.);
+			_rms_error = _centroid_error = std::numeric_limits<double>::infinity ();
+			try
+			{
+				for (unsigned int iter = 0;; iter++)
+				{
+					// only trace samples of new groups, image points
+					// statistics of other samples are kept
+					if (!pending.empty ())
+					{
+						trace_samples (pending);
+						for (int pass = 0; pass < 2; pass++)
+							for (size_t i = 0; i < _intercepts->size (); i++)
+							{
+								const trace::Ray *r = (*_intercepts)[i];
+								int j = sample_index (r);
+								if (j < 0 && iter > 0)
+								{
+									continue;
+								}
+								adaptive_sample_s &a = j < 0 ? other : samples[j];
+								const math::Vector3 &p = r->get_intercept_point ();
+								if (pass)
+								{
+									a._m2 += math::square ((p - a._mean).len ());
+								}
+								else
+								{
+									a._mean += p;
+									a._count++;
+								}
+							}
+						for (auto i : pending)
+							if (samples[i]._count)
+							{
+								samples[i]._mean /= samples[i]._count;
+							}
+						if (iter == 0 && other._count)
+						{
+							other._mean /= other._count;
+						}
+						pending.clear ();
+					}
+					// weighted centroid and rms radius from sample statistics
+					double wsum = 0.;
+					math::Vector3 c (0., 0., 0.);
+					auto each_sample = [&] (const std::function<void (const adaptive_sample_s &)> &f)
+					{
+for (auto &g : groups)
+							for (unsigned int a = g._first; a < g._end; a++)
+							{
+								f (samples[a]);
+							}
+						f (other);
+					};
+					each_sample ([&] (const adaptive_sample_s &a)
+					{
+						wsum += a._weight * a._count;
+						c += a._mean * (a._weight * a._count);
+					});
+					if (wsum > 0.)
+					{
+						c /= wsum;
+					}
+					double ms = 0.;
+					each_sample ([&] (const adaptive_sample_s &a)
+					{
+						ms += a._weight * (a._m2 + a._count * math::square ((a._mean - c).len ()));
+					});
+					const double rms = wsum > 0. ? sqrt (ms / wsum) : 0.;
+					_centroid = c;
+					if (iter > 0)
+					{
+						_rms_error = fabs (rms - rms_prev);
+						_centroid_error = (c - centroid_prev).len ();
+						if (_rms_error <= _adaptive_tolerance * rms
+						        && _centroid_error <= _adaptive_tolerance * rms)
+						{
+							break;
+						}
+					}
+					rms_prev = rms;
+					centroid_prev = c;
+					// error indicator: group area times image points spread,
+					// partially vignetted groups are refined along the edge
+					double total = 0.;
+					std::vector<unsigned int> order (groups.size ());
+					for (unsigned int i = 0; i < groups.size (); i++)
+					{
+						adaptive_group_s &g = groups[i];
+						double spread = 0.;
+						unsigned int valid = 0;
+						for (unsigned int a = g._first; a < g._end; a++)
+						{
+							if (!samples[a]._count)
+							{
+								continue;
+							}
+							valid++;
+							for (unsigned int b = g._first; b < a; b++)
+								if (samples[b]._count)
+								{
+									spread = std::max (spread,
+									                   (samples[a]._mean - samples[b]._mean).len ());
+								}
+						}
+						if (valid && valid < 4)
+						{
+							spread = std::max (spread, rms);
+						}
+						g._error = math::square (g._size) * spread;
+						total += g._error;
+						order[i] = i;
+					}
+					if (total == 0.)
+					{
+						break;
+					}
+					std::sort (order.begin (), order.end (),
+					           [&] (unsigned int a, unsigned int b)
+					{
+						return groups[a]._error > groups[b]._error;
+					});
+					// refine groups holding half of the estimated error
+					std::vector<adaptive_group_s> next;
+					std::vector<bool> refine (groups.size (), false);
+					size_t count = groups.size () * 4;
+					double acc = 0.;
+for (auto i : order)
+					{
+						if (acc >= total / 2. || count + 12 > _adaptive_max_samples)
+						{
+							break;
+						}
+						refine[i] = true;
+						acc += groups[i]._error;
+						count += 12;
+					}
+					for (unsigned int i = 0; i < groups.size (); i++)
+					{
+						const adaptive_group_s &g = groups[i];
+						if (!refine[i])
+						{
+							next.push_back (g);
+							continue;
+						}
+						const double h = g._size / 2.;
+						for (unsigned int k = 0; k < 4; k++)
+						{
+							add_group (next, g._x + (k & 1) * h, g._y + (k >> 1) * h, h);
+						}
+					}
+					if (next.size () == groups.size ())
+					{
+						break;
+					}
+					groups.swap (next);
+				}
+				// caller result gets rays of retained samples only
+				std::vector<bool> retained (samples.size (), false);
+for (auto &g : groups)
+					for (unsigned int a = g._first; a < g._end; a++)
+					{
+						retained[a] = true;
+					}
+				result.clear ();
+				for (size_t k = 0; k < traced.size (); k++)
+				{
+					result.merge (traced[k], [&] (const trace::Ray &r)
+					{
+						int j = sample_index (&r);
+						return j < 0 ? k == 0 : retained[j];
+					});
+				}
+				_intercepts = &result.get_intercepted (*_image);
+				_weights.resize (_intercepts->size ());
+				for (size_t i = 0; i < _intercepts->size (); i++)
+				{
+					int j = sample_index ((*_intercepts)[i]);
+					_weights[i] = j < 0 ? 1. : samples[j]._weight;
+				}
+			}
+			catch (...)
+			{
+				restore ();
+				throw;
+			}
+			restore ();
+			_processed_trace = true;
 		}
 
 		void
@@ -73,38 +439,117 @@ namespace goptical
 				return;
 			}
 			process_trace ();
-			double mean = 0;      // rms radius
-			double max = 0;       // max radius
+			const size_t count = _intercepts->size ();
+			if (!count)
+			{
+				throw Error ("no ray intercepts found on the surface");
+			}
+			// single pass, moments are accumulated relative to the first
+			// intercept to avoid cancellation on off axis spots
+			const math::Vector3 origin = (*_intercepts)[0]->get_intercept_point ();
+			math::Vector3 m1 (0., 0., 0.);
+			double m2 = 0.;       // weighted squared distance to origin
+			double wsum = 0.;     // analysis weights
 			double intensity = 0; // total intensity
-for (auto &i : *_intercepts)
+			for (size_t j = 0; j < count; j++)
 			{
-				double dist = (i->get_intercept_point () - _centroid).len ();
-				if (max < dist)
-				{
-					max = dist;
-				}
-				mean += math::square (dist);
+				const trace::Ray *i = (*_intercepts)[j];
+				math::Vector3 d = i->get_intercept_point () - origin;
+				double w = _weights.empty () ? 1.0 : _weights[j];
+				m1 += d * w;
+				m2 += w * (d * d);
+				wsum += w;
 				intensity += i->get_intensity ();
 			}
-			_useful_radius = _max_radius = max;
-			_rms_radius = sqrt (mean / _intercepts->size ());
+			m1 /= wsum;
+			_centroid = origin + m1;
+			_rms_radius = sqrt (std::max (0., m2 / wsum - m1 * m1));
 			_tot_intensity = intensity;
+			// sort rays by distance to centroid, cumulative intensity
+			// then gives encircled energy at any radius
+			std::vector<std::pair<double, const trace::Ray *> > circ (count), squa (count);
+			for (size_t j = 0; j < count; j++)
+			{
+				const trace::Ray *i = (*_intercepts)[j];
+				math::Vector3 d = i->get_intercept_point () - _centroid;
+				circ[j] = std::make_pair (d.len (), i);
+				squa[j] = std::make_pair (std::max (fabs (d.x ()), fabs (d.y ())), i);
+			}
+			std::sort (circ.begin (), circ.end ());
+			std::sort (squa.begin (), squa.end ());
+			_encircled.set (circ);
+			_ensquared.set (squa);
+			_encircled_wavelen.clear ();
+			for (size_t j = 0; j < count; j++)
+			{
+				double w = circ[j].second->get_wavelen ();
+				if (_encircled_wavelen.empty () || _encircled_wavelen.back ().first != w)
+				{
+					// few wavelengths, linear search is fine
+					auto k = _encircled_wavelen.begin ();
+					for (; k != _encircled_wavelen.end () && k->first != w; ++k)
+						;
+					if (k == _encircled_wavelen.end ())
+					{
+						_encircled_wavelen.push_back (std::make_pair (w, energy_s ()));
+					}
+					else
+					{
+						// move to back so that consecutive rays hit first test
+						std::swap (*k, _encircled_wavelen.back ());
+					}
+				}
+				_encircled_wavelen.back ().second.add (circ[j].first,
+				                                       circ[j].second->get_intensity ());
+			}
+			_useful_radius = _max_radius = circ.back ().first;
 			_processed_analysis = true;
 		}
 
-		double
-		Spot::get_encircled_intensity (double radius)
+		void
+		Spot::energy_s::set (const std::vector<std::pair<double, const trace::Ray *> > &
+		                     sorted)
 		{
-			process_trace ();
-			double intensity = 0;
-for (auto &i : *_intercepts)
+			_radius.clear ();
+			_cumulative.clear ();
+			_radius.reserve (sorted.size ());
+			_cumulative.reserve (sorted.size ());
+for (auto &i : sorted)
 			{
-				if ((i->get_intercept_point () - _centroid).len () <= radius)
-				{
-					intensity += i->get_intensity ();
-				}
+				add (i.first, i.second->get_intensity ());
 			}
-			return intensity;
+		}
+
+		void
+		Spot::energy_s::add (double radius, double intensity)
+		{
+			_radius.push_back (radius);
+			_cumulative.push_back (_cumulative.empty ()
+			                       ? intensity
+			                       : _cumulative.back () + intensity);
+		}
+
+		double
+		Spot::energy_s::get (double radius) const
+		{
+			// rays at distance less or equal to radius
+			size_t n = std::upper_bound (_radius.begin (), _radius.end (), radius)
+			           - _radius.begin ();
+			return n ? _cumulative[n - 1] : 0.;
+		}
+
+		double
+		Spot::get_encircled_intensity (double radius)
+		{
+			process_analysis ();
+			return _encircled.get (radius);
+		}
+
+		double
+		Spot::get_ensquared_intensity (double half_width)
+		{
+			process_analysis ();
+			return _ensquared.get (half_width);
 		}
 
 		std::shared_ptr<data::Plot>
@@ -112,13 +557,12 @@ for (auto &i : *_intercepts)
 		{
 			trace::Result &result = _tracer.get_trace_result ();
 			const trace::rays_queue_t &intercepts = result.get_intercepted (*_image);
-			process_analysis ();
 			if (intercepts.empty ())
 			{
 				throw Error ("no ray intercept found for encircled intensity plot");
 			}
-			typedef std::map<double, std::shared_ptr<data::SampleSet> > data_sets_t;
-			data_sets_t data_sets;
+			process_analysis ();
+			std::shared_ptr<data::Plot> plot = std::make_shared<data::Plot> ();
 			// create plot data for each wavelen
 for (auto &w : result.get_ray_wavelen_set ())
 			{
@@ -127,31 +571,27 @@ for (auto &w : result.get_ray_wavelen_set ())
 				s->set_interpolation (data::Linear);
 				s->set_metrics (0.0, _useful_radius / (double)zones);
 				s->resize (zones + 1);
-				data_sets.insert (data_sets_t::value_type (w, s));
-			}
-			// compute encircled intensity for each radius range
-for (auto &i : *_intercepts)
-			{
-				double dist = (i->get_intercept_point () - _centroid).len ();
-				if (dist > _useful_radius)
-				{
-					continue;
-				}
-				int n = (unsigned int)((zones - 1) * (dist / _useful_radius));
-				assert (n >= 0 && n < zones);
-				data_sets[i->get_wavelen ()]->get_y_value (n + 1) += i->get_intensity ();
-			}
-			// integrate
-			std::shared_ptr<data::Plot> plot = std::make_shared<data::Plot> ();
-for (auto &d : data_sets)
-			{
-				for (int i = 1; i < zones; i++)
+				auto e = _encircled_wavelen.begin ();
+				for (; e != _encircled_wavelen.end () && e->first != w; ++e)
+					;
+				if (e != _encircled_wavelen.end ())
 				{
-					d.second->get_y_value (i + 1) += d.second->get_y_value (i);
+					const std::vector<double> &r = e->second._radius;
+					// sample i holds intensity of rays in zones below i
+					for (int i = 1; i <= zones; i++)
+					{
+						size_t n = std::partition_point (r.begin (), r.end (),
+						                                 [&] (double dist)
+						{
+							return dist <= _useful_radius
+							       && (int)((zones - 1) * (dist / _useful_radius)) < i;
+						}) - r.begin ();
+						s->get_y_value (i) = n ? e->second._cumulative[n - 1] : 0.;
+					}
 				}
-				data::Plotdata p (d.second);
+				data::Plotdata p (s);
 				//      p.set_label("Encircled ray intensity"); FIXME set wavelen
-				p.set_color (light::SpectralLine::get_wavelen_color (d.first));
+				p.set_color (light::SpectralLine::get_wavelen_color (w));
 				p.set_style (data::LinePlot);
 				plot->add_plot_data (p);
 			}
@@ -0,0 +1,312 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <cmath>
+
+#include <goptical/core/analysis/through_focus.hpp>
+#include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/system.hpp>
+
+#include <goptical/core/data/plot.hpp>
+#include <goptical/core/data/plotdata.hpp>
+#include <goptical/core/data/sample_set.hpp>
+
+#include <goptical/core/material/base.hpp>
+#include <goptical/core/math/transform.hpp>
+
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/result.hpp>
+
+namespace goptical
+{
+
+	namespace analysis
+	{
+
+		ThroughFocus::ThroughFocus (std::shared_ptr<sys::System> &system)
+			: PointImage (system), _processed_focus (false),
+			  _processed_wavefront (false)
+		{
+		}
+
+		// image space direction of intercepted ray, false if the ray
+		// does not cross planes parallel to the image
+		static bool
+		get_image_direction (const trace::Ray &r, const sys::Image &image,
+		                     math::Vector3 &u)
+		{
+			u = r.get_direction (image);
+			return fabs (u.z ()) > 1e-12;
+		}
+
+		void
+		ThroughFocus::process_focus ()
+		{
+			if (_processed_focus)
+			{
+				return;
+			}
+			trace ();
+			// ray crosses plane z at a + b * z
+			std::vector<std::pair<math::Vector2, math::Vector2> > lines;
+			lines.reserve (_intercepts->size ());
+			math::Vector2 ma (0., 0.), mb (0., 0.);
+for (auto &i : *_intercepts)
+			{
+				math::Vector3 u;
+				if (!get_image_direction (*i, *_image, u))
+				{
+					continue;
+				}
+				const math::Vector3 &p = i->get_intercept_point ();
+				math::Vector2 b (u.x () / u.z (), u.y () / u.z ());
+				math::Vector2 a (p.x () - b.x () * p.z (), p.y () - b.y () * p.z ());
+				lines.push_back (std::make_pair (a, b));
+				ma += a;
+				mb += b;
+			}
+			if (lines.empty ())
+			{
+				throw Error ("no ray intercepts found on the surface");
+			}
+			const double count = lines.size ();
+			ma /= count;
+			mb /= count;
+			double aa = 0., ab = 0., bb = 0.;
+for (auto &l : lines)
+			{
+				math::Vector2 a = l.first - ma;
+				math::Vector2 b = l.second - mb;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+			}
+			_centroid_a = ma;
+			_centroid_b = mb;
+			_spot_ms._c0 = aa / count;
+			_spot_ms._c1 = 2. * ab / count;
+			_spot_ms._c2 = bb / count;
+			_processed_focus = true;
+		}
+
+		// wavefront sample: optical path in waves to reference point R
+		// is alpha + g . R
+		struct wavefront_sample_s
+		{
+			double _alpha;
+			math::Vector3 _g;
+			unsigned int _group;
+		};
+
+		// solve symmetric 2x2 system, pseudo inverse when singular as
+		// with meridional only distributions
+		static math::Vector2
+		solve_2x2 (double xx, double xy, double yy, const math::Vector2 &v)
+		{
+			const double tr = xx + yy;
+			const double det = xx * yy - xy * xy;
+			if (det > 1e-12 * tr * tr)
+			{
+				return math::Vector2 (yy * v.x () - xy * v.y (),
+				                      xx * v.y () - xy * v.x ()) / det;
+			}
+			if (tr <= 0.)
+			{
+				return math::vector2_0;
+			}
+			// rank 1 matrix M, pseudo inverse is M / tr^2
+			return math::Vector2 (xx * v.x () + xy * v.y (),
+			                      xy * v.x () + yy * v.y ()) / (tr * tr);
+		}
+
+		void
+		ThroughFocus::process_wavefront ()
+		{
+			if (_processed_wavefront)
+			{
+				return;
+			}
+			trace ();
+			if (_tracer.get_params ().get_genealogy_mode () == trace::GenealogyNone)
+			{
+				throw Error ("wavefront analysis requires ray genealogy");
+			}
+			std::vector<wavefront_sample_s> samples;
+			samples.reserve (_intercepts->size ());
+			// mean alpha and g of each wavelength
+			std::vector<double> wavelens;
+			std::vector<double> m_alpha;
+			std::vector<math::Vector3> m_g;
+			std::vector<unsigned int> m_count;
+for (auto &i : *_intercepts)
+			{
+				math::Vector3 u;
+				if (!get_image_direction (*i, *_image, u))
+				{
+					continue;
+				}
+				const double wl = i->get_wavelen ();
+				double opl = 0.;
+				for (const trace::Ray *r = i; r; r = r->get_parent ())
+				{
+					opl += r->get_len () * r->get_material ()->get_refractive_index (wl);
+				}
+				const double n = i->get_material ()->get_refractive_index (wl);
+				const double waves = 1. / (wl * 1e-6);
+				wavefront_sample_s s;
+				s._alpha = (opl - n * (i->get_intercept_point () * u)) * waves;
+				s._g = u * (n * waves);
+				// few wavelengths, linear search is fine
+				for (s._group = 0; s._group < wavelens.size ()
+				        && wavelens[s._group] != wl; s._group++)
+					;
+				if (s._group == wavelens.size ())
+				{
+					wavelens.push_back (wl);
+					m_alpha.push_back (0.);
+					m_g.push_back (math::vector3_0);
+					m_count.push_back (0);
+				}
+				m_alpha[s._group] += s._alpha;
+				m_g[s._group] += s._g;
+				m_count[s._group]++;
+				samples.push_back (s);
+			}
+			if (samples.empty ())
+			{
+				throw Error ("no ray intercepts found on the surface");
+			}
+			for (unsigned int j = 0; j < wavelens.size (); j++)
+			{
+				m_alpha[j] /= m_count[j];
+				m_g[j] /= m_count[j];
+			}
+			// pooled covariances of alpha and g about wavelength means
+			double aa = 0., gxx = 0., gxy = 0., gyy = 0., gzz = 0.;
+			math::Vector2 ga (0., 0.), gz (0., 0.);
+			double gza = 0.;
+for (auto &s : samples)
+			{
+				const double a = s._alpha - m_alpha[s._group];
+				const math::Vector3 g = s._g - m_g[s._group];
+				aa += a * a;
+				gxx += g.x () * g.x ();
+				gxy += g.x () * g.y ();
+				gyy += g.y () * g.y ();
+				gzz += g.z () * g.z ();
+				ga += math::Vector2 (g.x (), g.y ()) * a;
+				gz += math::Vector2 (g.x (), g.y ()) * g.z ();
+				gza += g.z () * a;
+			}
+			// minimize over reference point position on plane
+			// z, lateral position is -G^-1 (ga + z gz)
+			const math::Vector2 ia = solve_2x2 (gxx, gxy, gyy, ga);
+			const math::Vector2 iz = solve_2x2 (gxx, gxy, gyy, gz);
+			const double count = samples.size ();
+			_wavefront_ms._c0 = (aa - ga * ia) / count;
+			_wavefront_ms._c1 = 2. * (gza - gz * ia) / count;
+			_wavefront_ms._c2 = (gzz - gz * iz) / count;
+			_processed_wavefront = true;
+		}
+
+		double
+		ThroughFocus::get_rms_radius (double defocus)
+		{
+			process_focus ();
+			return sqrt (_spot_ms.get (defocus));
+		}
+
+		math::Vector3
+		ThroughFocus::get_centroid (double defocus)
+		{
+			process_focus ();
+			return math::Vector3 (_centroid_a + _centroid_b * defocus, defocus);
+		}
+
+		double
+		ThroughFocus::get_rms_wavefront (double defocus)
+		{
+			process_wavefront ();
+			return sqrt (_wavefront_ms.get (defocus));
+		}
+
+		math::VectorPair3
+		ThroughFocus::get_focus_plane (double defocus)
+		{
+			get_default_image ();
+			const math::Transform<3> &t = _system->get_global_transform (*_image);
+			return math::VectorPair3 (t.transform (math::Vector3 (0., 0., defocus)),
+			                          t.transform_linear (math::vector3_001));
+		}
+
+		std::shared_ptr<data::Plot>
+		ThroughFocus::get_rms_radius_plot (double from, double to, int count)
+		{
+			std::shared_ptr<data::Plot> plot = std::make_shared<data::Plot> ();
+			std::shared_ptr<data::SampleSet> s = std::make_shared<data::SampleSet> ();
+			s->set_interpolation (data::Linear);
+			s->set_metrics (from, (to - from) / std::max (1, count - 1));
+			s->resize (count);
+			for (int i = 0; i < count; i++)
+			{
+				s->get_y_value (i) = get_rms_radius (s->get_x_value (i));
+			}
+			data::Plotdata p (s);
+			p.set_style (data::LinePlot);
+			plot->add_plot_data (p);
+			plot->set_title ("Through focus rms spot radius");
+			plot->get_axes ().set_label ("Defocus", io::RendererAxes::X);
+			plot->get_axes ().set_label ("Spot rms radius", io::RendererAxes::Y);
+			plot->get_axes ().set_unit ("m", true, true, -3, io::RendererAxes::X);
+			plot->get_axes ().set_unit ("m", true, true, -3, io::RendererAxes::Y);
+			return plot;
+		}
+
+		std::shared_ptr<data::Plot>
+		ThroughFocus::get_rms_wavefront_plot (double from, double to, int count)
+		{
+			std::shared_ptr<data::Plot> plot = std::make_shared<data::Plot> ();
+			std::shared_ptr<data::SampleSet> s = std::make_shared<data::SampleSet> ();
+			s->set_interpolation (data::Linear);
+			s->set_metrics (from, (to - from) / std::max (1, count - 1));
+			s->resize (count);
+			for (int i = 0; i < count; i++)
+			{
+				s->get_y_value (i) = get_rms_wavefront (s->get_x_value (i));
+			}
+			data::Plotdata p (s);
+			p.set_style (data::LinePlot);
+			plot->add_plot_data (p);
+			plot->set_title ("Through focus rms wavefront error");
+			plot->get_axes ().set_label ("Defocus", io::RendererAxes::X);
+			plot->get_axes ().set_label ("Wavefront rms error", io::RendererAxes::Y);
+			plot->get_axes ().set_unit ("m", true, true, -3, io::RendererAxes::X);
+			plot->get_axes ().set_unit ("waves", false, false, 0, io::RendererAxes::Y);
+			return plot;
+		}
+
+	}
+
+}
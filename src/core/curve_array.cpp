@@ -108,6 +108,12 @@ namespace goptical
 			_curve->derivative ((this->*_transform) (xy), dxdy);
 		}
 
+		unsigned int
+		Array::get_version () const
+		{
+			return Base::get_version () + _curve->get_version ();
+		}
+
 	}
 
 }
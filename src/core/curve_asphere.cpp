@@ -292,6 +292,11 @@ namespace goptical
 			 * dz/dy = y*E
 			 */
 			double s = sqrt (xy.x () * xy.x () + xy.y () * xy.y ());
+			if (s == 0.0)
+			{
+				dxdy.x () = dxdy.y () = 0.0;
+				return;
+			}
 			double E = compute_derivative (surface, s) / s;
 			dxdy.x () = xy.x () * E;
 			dxdy.y () = xy.y () * E;
@@ -306,14 +311,7 @@ namespace goptical
 		double
 		Asphere::derivative (double r) const
 		{
-			if (_feder_algo)
-			{
-				return compute_derivative (this, r);
-			}
-			else
-			{
-				return Rotational::derivative (r);
-			}
+			return compute_derivative (this, r);
 		}
 
 		double
@@ -325,21 +323,12 @@ namespace goptical
 		void
 		Asphere::derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const
 		{
-			if (_feder_algo)
-			{
-				compute_derivative (this, xy, dxdy);
-			}
-			else
-			{
-				Rotational::derivative (xy, dxdy);
-			}
+			compute_derivative (this, xy, dxdy);
 		}
 
 		bool
 		Asphere::intersect (math::Vector3 &point, const math::VectorPair3 &ray) const
 		{
-			static int count = 0;
-			count++;
 			if (_feder_algo)
 			{
 				math::Vector3 normal (0, 0, 0);
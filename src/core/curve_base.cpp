@@ -22,7 +22,10 @@
 
 */
 
+#include <cmath>
+
 #include <goptical/core/curve/base.hpp>
+#include <goptical/core/curve/intersect_stats.hpp>
 #include <goptical/core/math/vector.hpp>
 #include <goptical/core/math/vector_pair.hpp>
 
@@ -36,47 +39,200 @@ namespace goptical
 
 		// Default curve/ray intersection iterative method
 
+		/* maximum Newton iterations before falling back to bisection */
+		static const unsigned int intersect_newton_max = 16;
+		/* maximum bracketing interval expansion steps */
+		static const unsigned int intersect_expand_max = 40;
+		/* maximum bisection iterations, counted apart from Newton and
+		   expansion steps. Enough to reduce the widest bracketing
+		   interval down to the tolerance */
+		static const unsigned int intersect_bisect_max = 128;
+
+		/* distance between the curve and the ray point at parameter t,
+		   measured along the z axis, and its derivative with respect
+		   to t */
+		static inline bool
+		intersect_eval (const Base &c, const math::VectorPair3 &ray, double t,
+		                double &f, double &df)
+		{
+			math::Vector3 p = ray.origin () + ray.direction () * t;
+			math::Vector2 xy = p.project_xy ();
+			math::Vector2 g;
+			double z;
+			c.sagitta_derivative (xy, z, g);
+			f = p.z () - z;
+			df = ray.direction ().z () - g.x () * ray.direction ().x ()
+			     - g.y () * ray.direction ().y ();
+			return std::isfinite (f) && std::isfinite (df);
+		}
+
+		/* parameter of the ray intersection with the sphere of
+		   curvature c tangent to the z=0 plane at origin which is the
+		   nearest to t */
+		static inline double
+		intersect_sphere (const math::VectorPair3 &ray, double c, double t)
+		{
+			const math::Vector3 &o = ray.origin ();
+			const math::Vector3 &d = ray.direction ();
+			double a = c * (d * d);
+			double b = 2.0 * (c * (o * d) - d.z ());
+			double k = c * (o * o) - 2.0 * o.z ();
+			double disc = b * b - 4.0 * a * k;
+			if (!(disc >= 0) || a == 0)
+			{
+				return t;
+			}
+			double q = -0.5 * (b + (b < 0 ? -sqrt (disc) : sqrt (disc)));
+			if (q == 0)
+			{
+				return t;
+			}
+			double t1 = q / a;
+			double t2 = k / q;
+			return fabs (t1 - t) < fabs (t2 - t) ? t1 : t2;
+		}
+
 		bool
 		Base::intersect (math::Vector3 &point, const math::VectorPair3 &ray) const
 		{
-			math::VectorPair3 p;
 			// initial intersection with z=0 plane
+			double s = ray.direction ().z ();
+			if (s == 0)
+			{
+				return false;
+			}
+			double t0 = -ray.origin ().z () / s;
+			if (t0 < 0)
+			{
+				return false;
+			}
+			double t = t0;
+			// better start on the sphere through the curve point above
+			// the plane intersection
 			{
-				double s = ray.direction ().z ();
-				if (s == 0)
+				math::Vector3 p = ray.origin () + ray.direction () * t0;
+				math::Vector2 xy = p.project_xy ();
+				double z = sagitta (xy);
+				double r2 = xy * xy + z * z;
+				if (std::isfinite (z) && r2 > 0)
+				{
+					double ts = intersect_sphere (ray, 2.0 * z / r2, t0);
+					if (ts >= 0 && std::isfinite (ts))
+					{
+						t = ts;
+					}
+				}
+			}
+			unsigned int iterations = 0;
+			bool bracketed = false;
+			bool converged = false;
+			// bracketing interval known from evaluated points
+			double t_neg = 0, t_pos = 0;
+			bool has_neg = false, has_pos = false;
+			double f, df;
+			// Newton iterations along the ray
+			while (iterations < intersect_newton_max)
+			{
+				iterations++;
+				if (!intersect_eval (*this, ray, t, f, df))
+				{
+					break;
+				}
+				if (f < 0)
+				{
+					t_neg = t;
+					has_neg = true;
+				}
+				else
 				{
-					return false;
+					t_pos = t;
+					has_pos = true;
 				}
-				double a = -ray.origin ().z () / s;
-				if (a < 0)
+				if (df == 0)
 				{
-					return false;
+					break;
+				}
+				double dt = f / df;
+				t -= dt;
+				if (fabs (dt) < _intersect_tolerance)
+				{
+					converged = true;
+					break;
 				}
-				p.origin () = ray.origin () + ray.direction () * a;
 			}
-			unsigned int n = 32; // avoid infinite loop
-			while (n--)
+			if (!converged)
 			{
-				double new_sag = sagitta (p.origin ().project_xy ());
-				double old_sag = p.origin ().z ();
-				// project previous intersection point on curve
-				p.origin ().z () = new_sag;
-				// stop if close enough
-				if (fabs (old_sag - new_sag) < 1e-10)
+				bracketed = true;
+				double t_start = has_neg ? t_neg : has_pos ? t_pos : t0;
+				// expand search around known points until the sign changes
+				double h = fabs (t_start - t0) + 1.0;
+				for (unsigned int i = 0; i < intersect_expand_max && !(has_neg && has_pos);
+				        i++, h *= 2.0)
 				{
-					break;
+					for (int dir = -1; dir <= 1; dir += 2)
+					{
+						double tt = t_start + dir * h;
+						if (tt < 0)
+						{
+							tt = 0;
+						}
+						iterations++;
+						if (!intersect_eval (*this, ray, tt, f, df))
+						{
+							continue;
+						}
+						if (f < 0)
+						{
+							t_neg = tt;
+							has_neg = true;
+						}
+						else
+						{
+							t_pos = tt;
+							has_pos = true;
+						}
+						if (has_neg && has_pos)
+						{
+							break;
+						}
+					}
 				}
-				// get curve tangeante plane at intersection point
-				normal (p.normal (), p.origin ());
-				// intersect again with new tangeante plane
-				double a = p.pl_ln_intersect_scale (ray);
-				if (a < 0)
+				// bisection
+				if (has_neg && has_pos)
 				{
-					return false;
+					for (unsigned int i = 0; i < intersect_bisect_max; i++)
+					{
+						t = (t_neg + t_pos) * 0.5;
+						if (fabs (t_neg - t_pos) < _intersect_tolerance)
+						{
+							converged = true;
+							break;
+						}
+						iterations++;
+						if (!intersect_eval (*this, ray, t, f, df))
+						{
+							break;
+						}
+						if (f < 0)
+						{
+							t_neg = t;
+						}
+						else
+						{
+							t_pos = t;
+						}
+					}
 				}
-				p.origin () = ray.origin () + ray.direction () * a;
 			}
-			point = p.origin ();
+			if (_intersect_stats)
+			{
+				_intersect_stats->add (iterations, bracketed, converged);
+			}
+			if (!converged || t < 0)
+			{
+				return false;
+			}
+			point = ray.origin () + ray.direction () * t;
 			return true;
 		}
 
@@ -118,6 +274,14 @@ namespace goptical
 			gsl_deriv_central (&gsl_func, xy.y (), 1e-6, &dxdy.y (), &abserr);
 		}
 
+		void
+		Base::sagitta_derivative (const math::Vector2 &xy, double &z,
+		                          math::Vector2 &dxdy) const
+		{
+			derivative (xy, dxdy);
+			z = sagitta (xy);
+		}
+
 		void
 		Base::normal (math::Vector3 &normal, const math::Vector3 &point) const
 		{
@@ -127,6 +291,13 @@ namespace goptical
 			normal.normalize ();
 		}
 
+		bool
+		Base::get_intersect_z_range (double radius, double &zmin,
+		                             double &zmax) const
+		{
+			return false;
+		}
+
 	}
 
 }
@@ -37,11 +37,13 @@ namespace goptical
 		{
 			Attributes attr;
 			attr._curve = curve;
+			attr._version = 0;
 			attr._z_scale = 1.;
 			attr._z_offset = 0.;
 			attr._transform.reset ();
 			attr._inv_transform.reset ();
 			_list.push_back (attr);
+			update_version ();
 			return _list.back ();
 		}
 
@@ -65,9 +67,26 @@ for (auto &c : _list)
 			{
 				math::Vector2 dtmp;
 				c._curve->derivative (c._inv_transform.transform (xy), dtmp);
-				dxdy += c._transform.transform_linear (dtmp) * c._z_scale;
+				// chain rule, gradient is transformed by the transposed
+				// inverse linear part
+				if (c._inv_transform.has_linear ())
+				{
+					dtmp = c._inv_transform.get_linear ().transpose () * dtmp;
+				}
+				dxdy += dtmp * c._z_scale;
 			}
 		}
 
+		unsigned int
+		Composer::get_version () const
+		{
+			unsigned int v = Base::get_version ();
+for (auto &c : _list)
+			{
+				v += c._version + c._curve->get_version ();
+			}
+			return v;
+		}
+
 	}
 }
@@ -183,6 +183,7 @@ namespace goptical
 			_roc = c0 / 2.0;
 			free (X);
 			free (Y);
+			update_version ();
 			return sqrt (chisq / count); // FIXME bad rms error
 		}
 
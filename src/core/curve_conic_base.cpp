@@ -22,6 +22,7 @@
 
 */
 
+#include <algorithm>
 #include <cassert>
 
 #include <gsl/gsl_fit.h>
@@ -131,9 +132,59 @@ namespace goptical
 			}
 			free (X);
 			free (Y);
+			update_version ();
 			return sqrt (chisq / count); // FIXME bad rms error
 		}
 
+		void
+		ConicBase::roc_changed ()
+		{
+			update_version ();
+		}
+
+		/*
+		  Intersection points satisfy the quadric equation:
+
+		  sh * z^2 - 2 * roc * z + r^2 = 0
+
+		  with z = (roc +/- sqrt(roc^2 - sh * r^2)) / sh, both roots
+		  being monotonic in r. The z range is bounded by roots values
+		  at r = 0 and at the largest radius where roots are real.
+		*/
+
+		bool
+		ConicBase::get_intersect_z_range (double radius, double &zmin,
+		                                  double &zmax) const
+		{
+			if (_roc == 0.0)
+			{
+				return false;
+			}
+			if (_sh == 0.0)
+			{
+				// Parabola special case
+				double z = math::square (radius) / (2.0 * _roc);
+				zmin = std::min (0.0, z);
+				zmax = std::max (0.0, z);
+				return true;
+			}
+			double d = math::square (_roc) - _sh * math::square (radius);
+			if (d < 0)
+			{
+				d = 0;
+			}
+			double z[4] = { 0.0, 2.0 * _roc / _sh, (_roc - sqrt (d)) / _sh,
+			                (_roc + sqrt (d)) / _sh
+			              };
+			zmin = zmax = 0.0;
+			for (unsigned int i = 1; i < 4; i++)
+			{
+				zmin = std::min (zmin, z[i]);
+				zmax = std::max (zmax, z[i]);
+			}
+			return true;
+		}
+
 	}
 
 }
@@ -43,7 +43,7 @@ namespace goptical
 		double
 		Flat::derivative (double r) const
 		{
-			return 1.0;
+			return 0.0;
 		}
 
 		/*
@@ -86,6 +86,14 @@ namespace goptical
 			normal = math::Vector3 (0, 0, -1);
 		}
 
+		bool
+		Flat::get_intersect_z_range (double radius, double &zmin,
+		                             double &zmax) const
+		{
+			zmin = zmax = 0.0;
+			return true;
+		}
+
 		std::shared_ptr<Flat> flat = std::make_shared<Flat> ();
 
 	}
@@ -45,7 +45,6 @@ namespace goptical
 			_offset = 0;
 			_radius = 0;
 			_ode_step = 1;
-			_updated = false;
 			_reading.set_interpolation (data::Cubic);
 			_sagitta.set_interpolation (data::CubicDeriv);
 			gsl_st = gsl_odeiv_step_alloc (gsl_odeiv_step_rkf45, 1);
@@ -68,6 +67,8 @@ namespace goptical
 		void
 		Foucault::fit (const Rotational &c)
 		{
+			_prepared.reset ();
+			update_version ();
 			_offset = 0;
 			_moving_source = true;
 			for (unsigned int j = 0; j < _reading.get_count (); j++)
@@ -80,7 +81,8 @@ namespace goptical
 		void
 		Foucault::add_reading (double zone_radius, double knife_offset)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			if (_radius < zone_radius * 1.1)
 			{
 				_radius = zone_radius * 1.1;
@@ -91,6 +93,8 @@ namespace goptical
 		unsigned int
 		Foucault::add_uniform_zones (double hole_radius, unsigned int count = 0)
 		{
+			_prepared.reset ();
+			update_version ();
 			assert (hole_radius < _radius);
 			assert (count > 0);
 			double step = (_radius - hole_radius) / (double)count;
@@ -108,6 +112,8 @@ namespace goptical
 		                            std::vector<double> *edge)
 		{
 			assert (hole_radius < _radius);
+			_prepared.reset ();
+			update_version ();
 			// see http://www.atmsite.org/contrib/Carlin/couder/
 			if (count == 0)
 			{
@@ -144,7 +150,8 @@ namespace goptical
 		void
 		Foucault::clear ()
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			_reading.clear ();
 			_sagitta.clear ();
 		}
@@ -152,9 +159,9 @@ namespace goptical
 		double
 		Foucault::sagitta (double r) const
 		{
-			if (!_updated)
+			if (!_prepared.is_prepared ())
 			{
-				const_cast<Foucault *> (this)->update ();
+				prepare ();
 			}
 			return _sagitta.interpolate (r);
 		}
@@ -162,9 +169,9 @@ namespace goptical
 		double
 		Foucault::derivative (double r) const
 		{
-			if (!_updated)
+			if (!_prepared.is_prepared ())
 			{
-				const_cast<Foucault *> (this)->update ();
+				prepare ();
 			}
 			return _sagitta.interpolate (r, 1);
 		}
@@ -192,7 +199,19 @@ namespace goptical
 				dydt_in = dydt_out;
 				t += _ode_step;
 			}
-			_updated = true;
+		}
+
+		void
+		Foucault::roc_changed ()
+		{
+			_prepared.reset ();
+			update_version ();
+		}
+
+		void
+		Foucault::prepare () const
+		{
+			_prepared.prepare ([this] () { const_cast<Foucault *> (this)->update (); });
 		}
 
 		int
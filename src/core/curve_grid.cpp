@@ -44,6 +44,7 @@ namespace goptical
 		void
 		Grid::fit (const Base &c)
 		{
+			update_version ();
 			for (unsigned int x = 0; x < _data.get_count (0); x++)
 				for (unsigned int y = 0; y < _data.get_count (1); y++)
 				{
@@ -68,5 +69,12 @@ namespace goptical
 			dxdy = _data.interpolate_deriv (xy);
 		}
 
+		void
+		Grid::sagitta_derivative (const math::Vector2 &xy, double &z,
+		                          math::Vector2 &dxdy) const
+		{
+			z = _data.interpolate (xy, dxdy);
+		}
+
 	}
 }
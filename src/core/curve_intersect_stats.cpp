@@ -0,0 +1,70 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <goptical/core/curve/intersect_stats.hpp>
+
+namespace goptical
+{
+
+	namespace curve
+	{
+
+		IntersectStats::IntersectStats ()
+			: _count (0), _iteration_count (0), _max_iterations (0),
+			  _bracketed_count (0), _failure_count (0)
+		{
+		}
+
+		void
+		IntersectStats::clear ()
+		{
+			_count = 0;
+			_iteration_count = 0;
+			_max_iterations = 0;
+			_bracketed_count = 0;
+			_failure_count = 0;
+		}
+
+		void
+		IntersectStats::add (unsigned int iterations, bool bracketed,
+		                     bool converged)
+		{
+			_count++;
+			_iteration_count += iterations;
+			unsigned int max = _max_iterations;
+			while (iterations > max
+			        && !_max_iterations.compare_exchange_weak (max, iterations))
+				;
+			if (bracketed)
+			{
+				_bracketed_count++;
+			}
+			if (!converged)
+			{
+				_failure_count++;
+			}
+		}
+
+	}
+}
@@ -57,6 +57,7 @@ namespace goptical
 		void
 		Polynomial::set (unsigned int first_term, unsigned int last_term, ...)
 		{
+			update_version ();
 			va_list ap;
 			assert (last_term >= last_term);
 			_first_term = first_term;
@@ -74,6 +75,7 @@ namespace goptical
 		void
 		Polynomial::set_even (unsigned int first_term, unsigned int last_term, ...)
 		{
+			update_version ();
 			va_list ap;
 			assert (first_term % 2 == 0);
 			assert (last_term % 2 == 0);
@@ -93,6 +95,7 @@ namespace goptical
 		void
 		Polynomial::set_odd (unsigned int first_term, unsigned int last_term, ...)
 		{
+			update_version ();
 			va_list ap;
 			assert (first_term % 2 == 1);
 			assert (last_term % 2 == 1);
@@ -112,6 +115,7 @@ namespace goptical
 		void
 		Polynomial::set_term_factor (unsigned int n, double c)
 		{
+			update_version ();
 			if (_last_term < n)
 			{
 				_last_term = n;
@@ -127,6 +131,7 @@ namespace goptical
 		void
 		Polynomial::set_last_term (unsigned int n)
 		{
+			update_version ();
 			_last_term = n;
 			if (_first_term > _last_term)
 			{
@@ -138,6 +143,7 @@ namespace goptical
 		void
 		Polynomial::set_first_term (unsigned int n)
 		{
+			update_version ();
 			_first_term = n;
 			if (_first_term > _last_term)
 			{
@@ -41,6 +41,7 @@ namespace goptical
 		Spline::fit (const Rotational &c, double radius, unsigned int points)
 		{
 			double step = radius / points;
+			update_version ();
 			_data.clear ();
 			for (double x = 0; x < radius + step / 2; x += step)
 			{
@@ -0,0 +1,159 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+
+#include <goptical/core/curve/tabulated.hpp>
+#include <goptical/core/error.hpp>
+
+namespace goptical
+{
+
+	namespace curve
+	{
+
+		/* initial and maximum number of tabulated intervals */
+		static const unsigned int tabulated_min_intervals = 16;
+		static const unsigned int tabulated_max_intervals = 1 << 20;
+
+		Tabulated::Tabulated (const std::shared_ptr<Rotational> &curve,
+		                      double radius, double max_sag_error,
+		                      double max_slope_error)
+			: _curve (curve), _curve_version (curve->get_version ()),
+			  _radius (radius), _max_sag_error (max_sag_error),
+			  _max_slope_error (max_slope_error), _inv_step (0), _data (), _poly (),
+			  _sag_error (0), _slope_error (0)
+		{
+			if (radius <= 0)
+			{
+				throw Error ("tabulated curve radius must be positive");
+			}
+			_data.set_interpolation (data::CubicDeriv);
+			tabulate ();
+		}
+
+		Tabulated::~Tabulated () {}
+
+		void
+		Tabulated::update ()
+		{
+			unsigned int v = _curve->get_version ();
+			if (v == _curve_version)
+			{
+				return;
+			}
+			_curve_version = v;
+			tabulate ();
+			update_version ();
+		}
+
+		unsigned int
+		Tabulated::get_version () const
+		{
+			return Base::get_version () + _curve->get_version ();
+		}
+
+		void
+		Tabulated::tabulate ()
+		{
+			unsigned int n = tabulated_min_intervals;
+			while (1)
+			{
+				sample (n);
+				measure_error ();
+				if (_sag_error <= _max_sag_error && _slope_error <= _max_slope_error)
+				{
+					break;
+				}
+				// hermite interpolation error decreases as h^4 for
+				// sagitta and h^3 for derivative, estimate the required
+				// sample count from measured errors
+				double f = std::max (pow (_sag_error / _max_sag_error, 1.0 / 4.0),
+				                     pow (_slope_error / _max_slope_error, 1.0 / 3.0));
+				f = std::min (std::max (f * 1.25, 2.0), 16.0);
+				if (n * f > tabulated_max_intervals)
+				{
+					throw Error ("unable to tabulate curve within error bounds");
+				}
+				n = (unsigned int)ceil (n * f);
+			}
+		}
+
+		void
+		Tabulated::sample (unsigned int intervals)
+		{
+			double step = _radius / intervals;
+			_data.clear ();
+			_data.resize (intervals + 1);
+			_data.set_metrics (0.0, step);
+			for (unsigned int i = 0; i <= intervals; i++)
+			{
+				double r = step * i;
+				_data.set_value (i, _curve->sagitta (r), _curve->derivative (r));
+			}
+			_inv_step = 1.0 / step;
+			_poly.resize (intervals);
+			for (unsigned int i = 0; i < intervals; i++)
+			{
+				double y0 = _data.get_y_value (i);
+				double y1 = _data.get_y_value (i + 1);
+				double d0 = _data.get_d_value (i) * step;
+				double d1 = _data.get_d_value (i + 1) * step;
+				poly_s &p = _poly[i];
+				p.c[0] = y0;
+				p.c[1] = d0;
+				p.c[2] = 3.0 * (y1 - y0) - 2.0 * d0 - d1;
+				p.c[3] = 2.0 * (y0 - y1) + d0 + d1;
+			}
+		}
+
+		void
+		Tabulated::measure_error ()
+		{
+			// hermite interpolation error is largest near interval quarters
+			// and middle
+			static const double t[3] = { 0.25, 0.5, 0.75 };
+			double step = _data.get_step ();
+			_sag_error = _slope_error = 0;
+			for (unsigned int i = 0; i < _poly.size (); i++)
+				for (unsigned int j = 0; j < 3; j++)
+				{
+					double r = step * (i + t[j]);
+					_sag_error = std::max (_sag_error,
+					                       fabs (sagitta (r) - _curve->sagitta (r)));
+					_slope_error = std::max (_slope_error,
+					                         fabs (derivative (r) - _curve->derivative (r)));
+				}
+		}
+
+		bool
+		Tabulated::get_intersect_z_range (double radius, double &zmin,
+		                                  double &zmax) const
+		{
+			return _curve->get_intersect_z_range (radius, zmin, zmax);
+		}
+
+	}
+
+}
@@ -0,0 +1,530 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include <goptical/core/curve/zernike.hpp>
+#include <goptical/core/error.hpp>
+#include <goptical/core/shape/disk.hpp>
+
+namespace goptical
+{
+
+	namespace curve
+	{
+
+		const trace::Distribution Zernike::default_dist (trace::HexaPolarDist, 10);
+
+		/*
+		  Terms use the fringe ordering of ISO 10110-5. Term with
+		  azimuthal order m and radial order n = m + 2k is:
+
+		    Z = R(n, m)(r) * cos(m.theta)  or  R(n, m)(r) * sin(m.theta)
+
+		  with R(n, m)(r) = r^m * P(k, m)(r^2). The r^m.cos(m.theta) and
+		  r^m.sin(m.theta) parts are the real and imaginary parts of
+		  (x + iy)^m and P(k, m) is the Jacobi polynomial P_k^(0,m)
+		  evaluated at 2r^2 - 1. Both are computed with three terms
+		  recurrences (Kintner), so all terms and their gradient are
+		  obtained in a single pass without any trigonometric call.
+		*/
+
+		/* maximum azimuthal order m, and maximum k for m = 0 */
+		static const unsigned int zernike_max_m = 5;
+
+		struct zernike_term_s
+		{
+			unsigned char m;
+			unsigned char k;
+			bool sin;
+		};
+
+		static const zernike_term_s zernike_terms[Zernike::term_count] =
+		{
+			{ 0, 0, false },
+			{ 1, 0, false }, { 1, 0, true }, { 0, 1, false },
+			{ 2, 0, false }, { 2, 0, true }, { 1, 1, false }, { 1, 1, true },
+			{ 0, 2, false },
+			{ 3, 0, false }, { 3, 0, true }, { 2, 1, false }, { 2, 1, true },
+			{ 1, 2, false }, { 1, 2, true }, { 0, 3, false },
+			{ 4, 0, false }, { 4, 0, true }, { 3, 1, false }, { 3, 1, true },
+			{ 2, 2, false }, { 2, 2, true }, { 1, 3, false }, { 1, 3, true },
+			{ 0, 4, false },
+			{ 5, 0, false }, { 5, 0, true }, { 4, 1, false }, { 4, 1, true },
+			{ 3, 2, false }, { 3, 2, true }, { 2, 3, false }, { 2, 3, true },
+			{ 1, 4, false }, { 1, 4, true }, { 0, 5, false },
+		};
+
+		/* angular and radial basis values at a point of the unit disk */
+		struct zernike_basis_s
+		{
+			double x, y;
+			/* real and imaginary parts of (x + iy)^m */
+			double c[zernike_max_m + 1], s[zernike_max_m + 1];
+			/* P(k, m) and its derivative with respect to r^2 */
+			double p[zernike_max_m + 1][zernike_max_m + 1];
+			double dp[zernike_max_m + 1][zernike_max_m + 1];
+
+			template <bool deriv>
+			void compute (double x, double y, const signed char max_k[]);
+
+			template <bool deriv>
+			void term (unsigned int n, double &z, math::Vector2 &d) const;
+		};
+
+		template <bool deriv>
+		void
+		zernike_basis_s::compute (double x_, double y_, const signed char max_k[])
+		{
+			x = x_;
+			y = y_;
+			double r2 = x * x + y * y;
+			double t = 2.0 * r2 - 1.0;
+			c[0] = 1.0;
+			s[0] = 0.0;
+			for (unsigned int m = 1; m <= zernike_max_m; m++)
+			{
+				c[m] = x * c[m - 1] - y * s[m - 1];
+				s[m] = x * s[m - 1] + y * c[m - 1];
+			}
+			for (unsigned int m = 0; m <= zernike_max_m; m++)
+			{
+				int kmax = max_k[m];
+				if (kmax < 0)
+				{
+					continue;
+				}
+				double *q = p[m];
+				double *dq = dp[m];
+				q[0] = 1.0;
+				dq[0] = 0.0;
+				if (kmax < 1)
+				{
+					continue;
+				}
+				q[1] = 1.0 + (m + 2) * (r2 - 1.0);
+				dq[1] = m + 2;
+				for (int k = 1; k < kmax; k++)
+				{
+					double a = 2 * k + m;
+					double b = (a + 1.0) * ((a + 2.0) * a * t - (double)(m * m));
+					double e = 2.0 * k * (k + m) * (a + 2.0);
+					double f = 1.0 / (2.0 * (k + 1) * (k + m + 1) * a);
+					q[k + 1] = (b * q[k] - e * q[k - 1]) * f;
+					if (deriv)
+					{
+						dq[k + 1] = (b * dq[k] + 2.0 * (a + 1.0) * (a + 2.0) * a * q[k]
+						             - e * dq[k - 1]) * f;
+					}
+				}
+			}
+		}
+
+		template <bool deriv>
+		void
+		zernike_basis_s::term (unsigned int n, double &z, math::Vector2 &d) const
+		{
+			const zernike_term_s &zt = zernike_terms[n];
+			unsigned int m = zt.m;
+			double a = zt.sin ? s[m] : c[m];
+			double q = p[m][zt.k];
+			z = q * a;
+			if (!deriv)
+			{
+				return;
+			}
+			// gradient of r^2 is 2(x, y), gradient of (x + iy)^m is
+			// m(x + iy)^(m-1) along x and i.m(x + iy)^(m-1) along y
+			double dq = 2.0 * dp[m][zt.k] * a;
+			d.x () = dq * x;
+			d.y () = dq * y;
+			if (m)
+			{
+				if (zt.sin)
+				{
+					d.x () += q * m * s[m - 1];
+					d.y () += q * m * c[m - 1];
+				}
+				else
+				{
+					d.x () += q * m * c[m - 1];
+					d.y () -= q * m * s[m - 1];
+				}
+			}
+		}
+
+		/* highest k for each m needed to evaluate the given terms */
+		static void
+		zernike_max_k (signed char max_k[], const unsigned char list[],
+		               unsigned int count)
+		{
+			std::fill (max_k, max_k + zernike_max_m + 1, -1);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const zernike_term_s &zt = zernike_terms[list[i]];
+				max_k[zt.m] = std::max (max_k[zt.m], (signed char)zt.k);
+			}
+		}
+
+		Zernike::Zernike (double radius, double unit_scale)
+			: _scale (unit_scale), _threshold (1e-10), _radius (radius),
+			  _enabled_count (0)
+		{
+			std::fill (_coeff, _coeff + term_count, 0.0);
+			update_threshold_state ();
+		}
+
+		Zernike::Zernike (double radius, double coefs[], unsigned int coefs_count,
+		                  double unit_scale)
+			: _scale (unit_scale), _threshold (1e-10), _radius (radius),
+			  _enabled_count (0)
+		{
+			if (coefs_count > term_count)
+			{
+				throw Error ("too many zernike coefficients");
+			}
+			std::fill (_coeff, _coeff + term_count, 0.0);
+			std::copy (coefs, coefs + coefs_count, _coeff);
+			update_threshold_state ();
+		}
+
+		template <bool deriv>
+		inline double
+		Zernike::evaluate (const math::Vector2 &xy, math::Vector2 &dxdy) const
+		{
+			double x = xy.x () / _radius;
+			double y = xy.y () / _radius;
+			dxdy.set (0.0);
+			if (x * x + y * y > 1.0)
+			{
+				return 0;
+			}
+			zernike_basis_s b;
+			b.compute<deriv> (x, y, _max_k);
+			double sum = 0.0;
+			for (unsigned int i = 0; i < _enabled_count; i++)
+			{
+				unsigned int n = _enabled_list[i];
+				double z;
+				math::Vector2 d;
+				b.term<deriv> (n, z, d);
+				sum += z * _coeff[n];
+				if (deriv)
+				{
+					dxdy += d * _coeff[n];
+				}
+			}
+			if (deriv)
+			{
+				dxdy *= _scale / _radius;
+			}
+			return sum * _scale;
+		}
+
+		double
+		Zernike::sagitta (const math::Vector2 &xy) const
+		{
+			math::Vector2 d;
+			return evaluate<false> (xy, d);
+		}
+
+		void
+		Zernike::derivative (const math::Vector2 &xy, math::Vector2 &dxdy) const
+		{
+			evaluate<true> (xy, dxdy);
+		}
+
+		void
+		Zernike::sagitta_derivative (const math::Vector2 &xy, double &z,
+		                             math::Vector2 &dxdy) const
+		{
+			z = evaluate<true> (xy, dxdy);
+		}
+
+		/* minimum number of fit sample points handled by a single thread */
+		static const unsigned int fit_min_points = 512;
+
+		/* run f (begin, end) over point ranges split between worker
+		   threads, f is called with range index as first argument */
+		template <typename F>
+		static void
+		fit_parallel (unsigned int threads, unsigned int count, const F &f)
+		{
+			std::vector<std::exception_ptr> errors (threads);
+			auto run = [&] (unsigned int w)
+			{
+				try
+				{
+					f (w, (size_t)count * w / threads, (size_t)count * (w + 1) / threads);
+				}
+				catch (...)
+				{
+					errors[w] = std::current_exception ();
+				}
+			};
+			std::vector<std::thread> workers;
+			for (unsigned int w = 1; w < threads; w++)
+			{
+				workers.push_back (std::thread (run, w));
+			}
+			run (0);
+for (auto &w : workers)
+			{
+				w.join ();
+			}
+for (auto &e : errors)
+				if (e)
+				{
+					std::rethrow_exception (e);
+				}
+		}
+
+		/* solve the n*n symmetric positive definite system a.x = b in
+		   place using Cholesky decomposition, b is replaced by x */
+		static void
+		fit_cholesky_solve (double *a, double *b, unsigned int n)
+		{
+			for (unsigned int j = 0; j < n; j++)
+			{
+				double d = a[j * n + j];
+				for (unsigned int k = 0; k < j; k++)
+				{
+					d -= math::square (a[j * n + k]);
+				}
+				if (!(d > 0.0))
+				{
+					throw Error ("zernike fit is singular, not enough sample points");
+				}
+				d = sqrt (d);
+				a[j * n + j] = d;
+				for (unsigned int i = j + 1; i < n; i++)
+				{
+					double v = a[i * n + j];
+					for (unsigned int k = 0; k < j; k++)
+					{
+						v -= a[i * n + k] * a[j * n + k];
+					}
+					a[i * n + j] = v / d;
+				}
+			}
+			for (unsigned int i = 0; i < n; i++)
+			{
+				for (unsigned int k = 0; k < i; k++)
+				{
+					b[i] -= a[i * n + k] * b[k];
+				}
+				b[i] /= a[i * n + i];
+			}
+			for (unsigned int i = n; i-- > 0;)
+			{
+				for (unsigned int k = i + 1; k < n; k++)
+				{
+					b[i] -= a[k * n + i] * b[k];
+				}
+				b[i] /= a[i * n + i];
+			}
+		}
+
+		double
+		Zernike::fit (const Base &curve, const trace::Distribution &d)
+		{
+			// get distributed sample points on surface
+			std::vector<math::Vector2> pattern;
+			shape::Disk shape (1.0);
+			shape.get_pattern ([&pattern] (const math::Vector2 &v)
+			{
+				pattern.push_back (v);
+			}, d, false);
+			const unsigned int pcount = pattern.size ();
+			const unsigned int n = term_count;
+			if (pcount < n)
+			{
+				throw Error ("not enough sample points to fit zernike curve");
+			}
+			unsigned char all[term_count];
+			for (unsigned int j = 0; j < n; j++)
+			{
+				all[j] = j;
+			}
+			signed char max_k[zernike_max_m + 1];
+			zernike_max_k (max_k, all, n);
+			unsigned int threads = std::thread::hardware_concurrency ();
+			threads = std::max (1u, std::min (threads, pcount / fit_min_points));
+			// accumulate least square normal equations, each thread
+			// sums its own share of sample points
+			std::vector<double> y (pcount);
+			std::vector<double> ata (threads * n * n, 0.0);
+			std::vector<double> aty (threads * n, 0.0);
+			fit_parallel (threads, pcount, [&] (unsigned int w, unsigned int begin,
+			                                    unsigned int end)
+			{
+				double *wa = &ata[w * n * n];
+				double *wy = &aty[w * n];
+				zernike_basis_s b;
+				double row[term_count];
+				for (unsigned int i = begin; i < end; i++)
+				{
+					const math::Vector2 &pt = pattern[i];
+					y[i] = curve.sagitta (pt * _radius);
+					b.compute<false> (pt.x (), pt.y (), max_k);
+					for (unsigned int j = 0; j < n; j++)
+					{
+						math::Vector2 dz;
+						b.term<false> (j, row[j], dz);
+						row[j] *= _scale;
+					}
+					for (unsigned int j = 0; j < n; j++)
+					{
+						wy[j] += row[j] * y[i];
+						for (unsigned int k = 0; k <= j; k++)
+						{
+							wa[j * n + k] += row[j] * row[k];
+						}
+					}
+				}
+			});
+			for (unsigned int w = 1; w < threads; w++)
+			{
+				for (unsigned int j = 0; j < n * n; j++)
+				{
+					ata[j] += ata[w * n * n + j];
+				}
+				for (unsigned int j = 0; j < n; j++)
+				{
+					aty[j] += aty[w * n + j];
+				}
+			}
+			fit_cholesky_solve (&ata[0], &aty[0], n);
+			std::copy (aty.begin (), aty.begin () + n, _coeff);
+			// residuals of the full fit
+			std::vector<double> chisq (threads, 0.0);
+			fit_parallel (threads, pcount, [&] (unsigned int w, unsigned int begin,
+			                                    unsigned int end)
+			{
+				zernike_basis_s b;
+				for (unsigned int i = begin; i < end; i++)
+				{
+					const math::Vector2 &pt = pattern[i];
+					b.compute<false> (pt.x (), pt.y (), max_k);
+					double z = 0.0;
+					for (unsigned int j = 0; j < n; j++)
+					{
+						double t;
+						math::Vector2 dz;
+						b.term<false> (j, t, dz);
+						z += t * _coeff[j];
+					}
+					chisq[w] += math::square (y[i] - z * _scale);
+				}
+			});
+			double sum = 0.0;
+for (double c : chisq)
+			{
+				sum += c;
+			}
+			update_threshold_state ();
+			update_version ();
+			return sqrt (sum / pcount);
+		}
+
+		void
+		Zernike::update_threshold_state ()
+		{
+			unsigned int n = 0;
+			for (unsigned int i = 0; i < term_count; i++)
+				if (fabs (_coeff[i]) >= _threshold)
+				{
+					_enabled_list[n++] = i;
+				}
+			_enabled_count = n;
+			zernike_max_k (_max_k, _enabled_list, _enabled_count);
+		}
+
+		void
+		Zernike::set_term_state (unsigned int n, bool enabled)
+		{
+			unsigned int i;
+			assert (n < term_count);
+			update_version ();
+			for (i = 0; i < _enabled_count; i++)
+				if (_enabled_list[i] == n)
+				{
+					break;
+				}
+			if (enabled && i == _enabled_count)
+			{
+				_enabled_list[_enabled_count++] = n;
+			}
+			else if (!enabled && i < _enabled_count)
+			{
+				_enabled_list[i] = _enabled_list[--_enabled_count];
+			}
+			zernike_max_k (_max_k, _enabled_list, _enabled_count);
+		}
+
+		bool
+		Zernike::get_term_state (unsigned int n)
+		{
+			for (unsigned int i = 0; i < _enabled_count; i++)
+				if (_enabled_list[i] == n)
+				{
+					return true;
+				}
+			return false;
+		}
+
+		double
+		Zernike::zernike_poly (unsigned int n, const math::Vector2 &xy)
+		{
+			assert (n < term_count);
+			unsigned char list[1] = { (unsigned char)n };
+			signed char max_k[zernike_max_m + 1];
+			zernike_max_k (max_k, list, 1);
+			zernike_basis_s b;
+			b.compute<false> (xy.x (), xy.y (), max_k);
+			double z;
+			math::Vector2 d;
+			b.term<false> (n, z, d);
+			return z;
+		}
+
+		void
+		Zernike::zernike_poly_d (unsigned int n, const math::Vector2 &xy,
+		                         math::Vector2 &dxdy)
+		{
+			assert (n < term_count);
+			unsigned char list[1] = { (unsigned char)n };
+			signed char max_k[zernike_max_m + 1];
+			zernike_max_k (max_k, list, 1);
+			zernike_basis_s b;
+			b.compute<true> (xy.x (), xy.y (), max_k);
+			double z;
+			b.term<true> (n, z, dxdy);
+		}
+
+	}
+}
@@ -33,9 +33,10 @@ namespace goptical
 
 		Grid::Grid (unsigned int n1, unsigned int n2, const math::Vector2 &origin,
 		            const math::Vector2 &step)
-			: Set (), _y_data (), _d_data (), _poly (), _update (&Grid::update_linear),
-			  _lookup (&Grid::update_linear), _resize (&Grid::resize_y),
-			  _origin (origin), _step (step)
+			: Set (), _y_data (), _d_data (), _poly (), _knot (),
+			  _update (&Grid::update_linear), _lookup (0),
+			  _resize (&Grid::resize_y), _prepared (), _origin (origin),
+			  _step (step), _patch_table (true)
 		{
 			_origin = origin;
 			_step = step;
@@ -119,12 +120,14 @@ for (auto &i : _d_data)
 					_resize = &Grid::resize_y;
 					_d_data.clear ();
 					_poly.clear ();
+					_knot.clear ();
 					break;
 				case Linear:
 					_update = &Grid::update_linear;
 					_resize = &Grid::resize_y;
 					_d_data.clear ();
 					_poly.clear ();
+					_knot.clear ();
 					break;
 				case Bicubic:
 					_update = &Grid::update_bicubic;
@@ -145,13 +148,19 @@ for (auto &i : _d_data)
 					throw Error ("invalid interpolation selected");
 			}
 			_interpolation = i;
-			_lookup = _update;
+			_prepared.reset ();
+		}
+
+		void
+		Grid::prepare () const
+		{
+			_prepared.prepare ([this] () { (this->*_update) (); });
 		}
 
 		// **********************************************************************
 
 		void
-		Grid::update_nearest (unsigned int x[2], const math::Vector2 &v) const
+		Grid::update_nearest () const
 		{
 			Grid *this_ = const_cast<Grid *> (this);
 			if (_size[0] < 1 || _size[1] < 1)
@@ -161,7 +170,7 @@ for (auto &i : _d_data)
 			this_->_lookup = &Grid::lookup_nearest;
 			this_->_interpolate_y = &Grid::interpolate_nearest_y;
 			this_->_interpolate_d = &Grid::interpolate_nearest_d;
-			return lookup_nearest (x, v);
+			this_->_interpolate_yd = &Grid::interpolate_generic_yd;
 		}
 
 		double
@@ -181,7 +190,7 @@ for (auto &i : _d_data)
 		// **********************************************************************
 
 		void
-		Grid::update_linear (unsigned int x[2], const math::Vector2 &v) const
+		Grid::update_linear () const
 		{
 			Grid *this_ = const_cast<Grid *> (this);
 			if (_size[0] < 2 || _size[1] < 2)
@@ -191,7 +200,7 @@ for (auto &i : _d_data)
 			this_->_lookup = &Grid::lookup_interval;
 			this_->_interpolate_y = &Grid::interpolate_linear_y;
 			this_->_interpolate_d = &Grid::interpolate_linear_d;
-			return lookup_interval (x, v);
+			this_->_interpolate_yd = &Grid::interpolate_generic_yd;
 		}
 
 		double
@@ -377,15 +386,12 @@ for (auto &i : _d_data)
 		}
 
 		void
-		Grid::update_bicubic (unsigned int x[2], const math::Vector2 &v) const
+		Grid::update_bicubic () const
 		{
-			Grid *this_ = const_cast<Grid *> (this);
 			if (_size[0] < 2 || _size[1] < 2)
 			{
 				throw Error ("data set doesn't contains enough data");
 			}
-			const unsigned int s0 = _size[0] - 1;
-			this_->_poly.resize (s0 * (_size[1] - 1));
 			// double cd[_size[0] * _size[1]];
 			double *cd = (double *)calloc (_size[0] * _size[1], sizeof (double));
 			get_cross_deriv_diff (cd);
@@ -400,131 +406,118 @@ for (auto &i : _d_data)
 			{
 				get_deriv_smooth<1> (&d[0], w, x0);
 			}
-			for (unsigned int x0 = 0; x0 < _size[0] - 1; x0++)
-				for (unsigned int x1 = 0; x1 < _size[1] - 1; x1++)
-				{
-					const unsigned int idx = x0 + _size[0] * x1;
-					double t[16];
-					t[0] = _y_data[idx];
-					t[1] = _y_data[idx + 1];
-					t[2] = _y_data[idx + w];
-					t[3] = _y_data[idx + w + 1];
-					t[4 + 0] = d[idx].x ();
-					t[4 + 1] = d[idx + 1].x ();
-					t[4 + 2] = d[idx + w].x ();
-					t[4 + 3] = d[idx + w + 1].x ();
-					t[8 + 0] = d[idx].y ();
-					t[8 + 1] = d[idx + 1].y ();
-					t[8 + 2] = d[idx + w].y ();
-					t[8 + 3] = d[idx + w + 1].y ();
-					t[12 + 0] = cd[idx];
-					t[12 + 1] = cd[idx + 1];
-					t[12 + 2] = cd[idx + w];
-					t[12 + 3] = cd[idx + w + 1];
-					set_poly (this_->_poly[x0 + s0 * x1], t);
-				}
-			this_->_lookup = &Grid::lookup_interval;
-			this_->_interpolate_y = &Grid::interpolate_bicubic_y;
-			this_->_interpolate_d = &Grid::interpolate_bicubic_d;
+			set_patches (&d[0], cd);
 			free (cd);
-			return lookup_interval (x, v);
 		}
 
 		void
-		Grid::update_bicubic_diff (unsigned int x[2], const math::Vector2 &v) const
+		Grid::update_bicubic_diff () const
 		{
-			Grid *this_ = const_cast<Grid *> (this);
 			if (_size[0] < 2 || _size[1] < 2)
 			{
 				throw Error ("data set doesn't contains enough data");
 			}
-			const unsigned int s0 = _size[0] - 1;
-			this_->_poly.resize (s0 * (_size[1] - 1));
 			// double cd[_size[0] * _size[1]];
 			double *cd = (double *)calloc (_size[0] * _size[1], sizeof (double));
 			get_cross_deriv_diff (cd);
 			DPP_VLARRAY (math::Vector2, _size[0] * _size[1], d);
 			get_deriv_diff (&d[0]);
-			const unsigned int w = _size[0];
-			for (unsigned int x0 = 0; x0 < _size[0] - 1; x0++)
-				for (unsigned int x1 = 0; x1 < _size[1] - 1; x1++)
-				{
-					const unsigned int idx = x0 + _size[0] * x1;
-					double t[16];
-					t[0] = _y_data[idx];
-					t[1] = _y_data[idx + 1];
-					t[2] = _y_data[idx + w];
-					t[3] = _y_data[idx + w + 1];
-					t[4 + 0] = d[idx].x ();
-					t[4 + 1] = d[idx + 1].x ();
-					t[4 + 2] = d[idx + w].x ();
-					t[4 + 3] = d[idx + w + 1].x ();
-					t[8 + 0] = d[idx].y ();
-					t[8 + 1] = d[idx + 1].y ();
-					t[8 + 2] = d[idx + w].y ();
-					t[8 + 3] = d[idx + w + 1].y ();
-					t[12 + 0] = cd[idx];
-					t[12 + 1] = cd[idx + 1];
-					t[12 + 2] = cd[idx + w];
-					t[12 + 3] = cd[idx + w + 1];
-					set_poly (this_->_poly[x0 + s0 * x1], t);
-				}
-			this_->_lookup = &Grid::lookup_interval;
-			this_->_interpolate_y = &Grid::interpolate_bicubic_y;
-			this_->_interpolate_d = &Grid::interpolate_bicubic_d;
+			set_patches (&d[0], cd);
 			free (cd);
-			return lookup_interval (x, v);
 		}
 
 		void
-		Grid::update_bicubic_deriv (unsigned int x[2], const math::Vector2 &v) const
+		Grid::update_bicubic_deriv () const
 		{
-			Grid *this_ = const_cast<Grid *> (this);
 			if (_size[0] < 2 || _size[1] < 2)
 			{
 				throw Error ("data set doesn't contains enough data");
 			}
-			const unsigned int s0 = _size[0] - 1;
-			this_->_poly.resize (s0 * (_size[1] - 1));
 			// double cd[_size[0] * _size[1]];
 			double *cd = (double *)calloc (_size[0] * _size[1], sizeof (double));
 			get_cross_deriv_diff (cd);
+			DPP_VLARRAY (math::Vector2, _size[0] * _size[1], d);
+			for (unsigned int i = 0; i < _size[0] * _size[1]; i++)
+			{
+				d[i] = _d_data[i].mul (_step);
+			}
+			set_patches (&d[0], cd);
+			free (cd);
+		}
+
+		void
+		Grid::set_patches (const math::Vector2 d[], const double cd[]) const
+		{
+			Grid *this_ = const_cast<Grid *> (this);
 			const unsigned int w = _size[0];
-			for (unsigned int x0 = 0; x0 < _size[0] - 1; x0++)
+			if (_patch_table)
+			{
+				const unsigned int s0 = _size[0] - 1;
+				this_->_knot.clear ();
+				this_->_poly.resize (s0 * (_size[1] - 1));
 				for (unsigned int x1 = 0; x1 < _size[1] - 1; x1++)
+					for (unsigned int x0 = 0; x0 < _size[0] - 1; x0++)
+					{
+						const unsigned int idx = x0 + w * x1;
+						const unsigned int k[4] = { idx, idx + 1, idx + w, idx + w + 1 };
+						double t[16];
+						for (unsigned int i = 0; i < 4; i++)
+						{
+							t[i] = _y_data[k[i]];
+							t[4 + i] = d[k[i]].x ();
+							t[8 + i] = d[k[i]].y ();
+							t[12 + i] = cd[k[i]];
+						}
+						set_poly (this_->_poly[x0 + s0 * x1], t);
+					}
+			}
+			else
+			{
+				this_->_poly.clear ();
+				this_->_knot.resize (_size[0] * _size[1]);
+				for (unsigned int i = 0; i < _size[0] * _size[1]; i++)
 				{
-					const unsigned int idx = x0 + _size[0] * x1;
-					double t[16];
-					t[0] = _y_data[idx];
-					t[1] = _y_data[idx + 1];
-					t[2] = _y_data[idx + w];
-					t[3] = _y_data[idx + w + 1];
-					t[4 + 0] = _d_data[idx].x () * _step.x ();
-					t[4 + 4] = _d_data[idx].y () * _step.y ();
-					t[4 + 1] = _d_data[idx + 1].x () * _step.x ();
-					t[4 + 5] = _d_data[idx + 1].y () * _step.y ();
-					t[4 + 2] = _d_data[idx + w].x () * _step.x ();
-					t[4 + 6] = _d_data[idx + w].y () * _step.y ();
-					t[4 + 3] = _d_data[idx + w + 1].x () * _step.x ();
-					t[4 + 7] = _d_data[idx + w + 1].y () * _step.y ();
-					t[12 + 0] = cd[idx];
-					t[12 + 1] = cd[idx + 1];
-					t[12 + 2] = cd[idx + w];
-					t[12 + 3] = cd[idx + w + 1];
-					set_poly (this_->_poly[x0 + s0 * x1], t);
+					knot_t &k = this_->_knot[i];
+					k.d[0] = d[i].x ();
+					k.d[1] = d[i].y ();
+					k.d[2] = cd[i];
 				}
+			}
 			this_->_lookup = &Grid::lookup_interval;
 			this_->_interpolate_y = &Grid::interpolate_bicubic_y;
 			this_->_interpolate_d = &Grid::interpolate_bicubic_d;
-			free (cd);
-			return lookup_interval (x, v);
+			this_->_interpolate_yd = &Grid::interpolate_bicubic_yd;
+		}
+
+		const Grid::poly_t &
+		Grid::get_patch (const unsigned int x[2], poly_t &tmp) const
+		{
+			if (_patch_table)
+			{
+				return _poly[x[0] + x[1] * (_size[0] - 1)];
+			}
+			const unsigned int w = _size[0];
+			const unsigned int idx = x[0] + w * x[1];
+			const unsigned int k[4] = { idx, idx + 1, idx + w, idx + w + 1 };
+			double t[16];
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				const knot_t &n = _knot[k[i]];
+				t[i] = _y_data[k[i]];
+				t[4 + i] = n.d[0];
+				t[8 + i] = n.d[1];
+				t[12 + i] = n.d[2];
+			}
+			set_poly (tmp, t);
+			return tmp;
 		}
 
 		double
 		Grid::interpolate_bicubic_y (const unsigned int x[2],
 		                             const math::Vector2 &v) const
 		{
-			const poly_t &p = _poly[x[0] + x[1] * (_size[0] - 1)];
+			poly_t tmp;
+			const poly_t &p = get_patch (x, tmp);
 			math::Vector2 t ((v - _origin) / _step
 			                 - math::Vector2 ((double)x[0], (double)x[1]));
 			double res;
@@ -542,28 +535,39 @@ for (auto &i : _d_data)
 		Grid::interpolate_bicubic_d (const unsigned int x[2], math::Vector2 &d,
 		                             const math::Vector2 &v) const
 		{
-			const poly_t &p = _poly[x[0] + x[1] * (_size[0] - 1)];
+			interpolate_bicubic_yd (x, d, v);
+		}
+
+		double
+		Grid::interpolate_bicubic_yd (const unsigned int x[2], math::Vector2 &d,
+		                              const math::Vector2 &v) const
+		{
+			poly_t tmp;
+			const poly_t &p = get_patch (x, tmp);
 			math::Vector2 t ((v - _origin) / _step
 			                 - math::Vector2 ((double)x[0], (double)x[1]));
-			d.set (0);
-			d.x ()
-			    = (3.0 * p.p[12 + 3] * t.x () + 2.0 * p.p[8 + 3]) * t.x () + p.p[4 + 3];
-			d.x () = (3.0 * p.p[12 + 2] * t.x () + 2.0 * p.p[8 + 2]) * t.x ()
-			         + p.p[4 + 2] + t.y () * d.x ();
-			d.x () = (3.0 * p.p[12 + 1] * t.x () + 2.0 * p.p[8 + 1]) * t.x ()
-			         + p.p[4 + 1] + t.y () * d.x ();
-			d.x () = (3.0 * p.p[12 + 0] * t.x () + 2.0 * p.p[8 + 0]) * t.x ()
-			         + p.p[4 + 0] + t.y () * d.x ();
-			d.x () /= _step.x ();
-			d.y () = (3.0 * p.p[12 + 3] * t.y () + 2.0 * p.p[12 + 2]) * t.y ()
-			         + p.p[12 + 1];
-			d.y () = (3.0 * p.p[8 + 3] * t.y () + 2.0 * p.p[8 + 2]) * t.y () + p.p[8 + 1]
-			         + t.x () * d.y ();
-			d.y () = (3.0 * p.p[4 + 3] * t.y () + 2.0 * p.p[4 + 2]) * t.y () + p.p[4 + 1]
-			         + t.x () * d.y ();
-			d.y () = (3.0 * p.p[0 + 3] * t.y () + 2.0 * p.p[0 + 2]) * t.y () + p.p[0 + 1]
-			         + t.x () * d.y ();
-			d.y () /= _step.y ();
+			// p.p[4 * i + j] is the coefficient of t.x()^i * t.y()^j. Each
+			// row is evaluated independently along y, then rows are
+			// combined along x for value and both partial derivatives.
+			double r[4], s[4];
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				const double *q = p.p + 4 * i;
+				r[i] = ((q[3] * t.y () + q[2]) * t.y () + q[1]) * t.y () + q[0];
+				s[i] = (3.0 * q[3] * t.y () + 2.0 * q[2]) * t.y () + q[1];
+			}
+			d.x () = ((3.0 * r[3] * t.x () + 2.0 * r[2]) * t.x () + r[1]) / _step.x ();
+			d.y () = (((s[3] * t.x () + s[2]) * t.x () + s[1]) * t.x () + s[0])
+			         / _step.y ();
+			return ((r[3] * t.x () + r[2]) * t.x () + r[1]) * t.x () + r[0];
+		}
+
+		double
+		Grid::interpolate_generic_yd (const unsigned int x[2], math::Vector2 &d,
+		                              const math::Vector2 &v) const
+		{
+			(this->*_interpolate_d) (x, d, v);
+			return (this->*_interpolate_y) (x, v);
 		}
 
 		// **********************************************************************
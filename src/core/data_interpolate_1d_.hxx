@@ -32,7 +32,8 @@ namespace data
 
 template <class X>
 Interpolate1d<X>::Interpolate1d ()
-    : _update (&Interpolate1d::update_linear), _interpolate (_update), _poly ()
+    : _update (&Interpolate1d::update_linear), _interpolate (0), _poly (),
+      _prepared ()
 {
 }
 
@@ -295,7 +296,7 @@ Interpolate1d<X>::set_interpolation (Interpolation i)
     }
 
   X::_interpolation = i;
-  _interpolate = _update;
+  _prepared.reset ();
 }
 
 template <class X>
@@ -313,8 +314,8 @@ Interpolate1d<X>::interpolate_nearest (unsigned int d, double x) const
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_nearest (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_nearest () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
 
@@ -322,8 +323,6 @@ Interpolate1d<X>::update_nearest (unsigned int d, double x) const
     throw Error ("data set contains no data");
 
   this_->_interpolate = &Interpolate1d::interpolate_nearest;
-
-  return interpolate_nearest (d, x);
 }
 
 template <class X>
@@ -361,8 +360,8 @@ Interpolate1d<X>::interpolate_linear (unsigned int d, double x) const
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_linear (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_linear () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
 
@@ -370,8 +369,6 @@ Interpolate1d<X>::update_linear (unsigned int d, double x) const
     throw Error ("data set doesn't contains enough data");
 
   this_->_interpolate = &Interpolate1d::interpolate_linear;
-
-  return interpolate_linear (d, x);
 }
 
 template <class X>
@@ -397,8 +394,8 @@ Interpolate1d<X>::interpolate_quadratic (unsigned int d, double x) const
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_quadratic (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_quadratic () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -429,8 +426,6 @@ Interpolate1d<X>::update_quadratic (unsigned int d, double x) const
                    X::get_x_value (i), X::get_y_value (i));
 
   this_->_interpolate = &Interpolate1d::interpolate_quadratic;
-
-  return interpolate_quadratic (d, x);
 }
 
 template <class X>
@@ -459,8 +454,8 @@ Interpolate1d<X>::interpolate_cubic (unsigned int d, double x) const
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic_simple (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic_simple () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -509,13 +504,11 @@ Interpolate1d<X>::update_cubic_simple (unsigned int d, double x) const
   set_linear_poly (poly[n], vp1.x (), vp1.y (), d2);
 
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -548,13 +541,11 @@ Interpolate1d<X>::update_cubic (unsigned int d, double x) const
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
 
   free (dd);
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic2 (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic2 () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -588,13 +579,11 @@ Interpolate1d<X>::update_cubic2 (unsigned int d, double x) const
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
 
   free (dd);
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic_deriv_init (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic_deriv_init () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -625,13 +614,11 @@ Interpolate1d<X>::update_cubic_deriv_init (unsigned int d, double x) const
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
 
   free (dd);
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic2_deriv_init (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic2_deriv_init () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -663,13 +650,11 @@ Interpolate1d<X>::update_cubic2_deriv_init (unsigned int d, double x) const
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
 
   free (dd);
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic2_deriv (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic2_deriv () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -699,13 +684,11 @@ Interpolate1d<X>::update_cubic2_deriv (unsigned int d, double x) const
                       X::get_d_value (n - 1), ddn);
 
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
-double
-Interpolate1d<X>::update_cubic_deriv (unsigned int d, double x) const
+void
+Interpolate1d<X>::update_cubic_deriv () const
 {
   Interpolate1d *this_ = const_cast<Interpolate1d *> (this);
   std::vector<struct poly_s> &poly = this_->_poly;
@@ -729,15 +712,20 @@ Interpolate1d<X>::update_cubic_deriv (unsigned int d, double x) const
                    X::get_d_value (n - 1));
 
   this_->_interpolate = &Interpolate1d::interpolate_cubic;
-
-  return interpolate_cubic (d, x);
 }
 
 template <class X>
 void
 Interpolate1d<X>::invalidate ()
 {
-  _interpolate = _update;
+  _prepared.reset ();
+}
+
+template <class X>
+void
+Interpolate1d<X>::prepare () const
+{
+  _prepared.prepare ([this] () { (this->*_update) (); });
 }
 
 }
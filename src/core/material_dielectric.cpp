@@ -35,7 +35,7 @@ namespace goptical
 		Dielectric::Dielectric ()
 			: Solid ("dielectric"), _transmittance (), _temp_model (ThermalNone),
 			  _low_wavelen (350.0), _high_wavelen (750.0),
-			  _measurement_medium (std_air), _last_wavelen (0)
+			  _measurement_medium (std_air)
 		{
 			_transmittance.set_interpolation (data::Cubic);
 		}
@@ -94,10 +94,7 @@ namespace goptical
 		double
 		Dielectric::get_refractive_index (double wavelen) const
 		{
-			if (wavelen == _last_wavelen)
-			{
-				return _last_get_refractive_index;
-			}
+			// not cached, the tracer tabulates indices in a trace::IndexTable
 			double a = _measurement_medium->get_refractive_index (wavelen);
 			double m = get_measurement_index (wavelen);
 			// get absolute refractive index
@@ -117,8 +114,6 @@ namespace goptical
 				case ThermalNone:
 					;
 			}
-			_last_wavelen = wavelen;
-			_last_get_refractive_index = n;
 			return n;
 		}
 
@@ -24,16 +24,57 @@
 
 #include <cstdlib>
 
+#include <goptical/core/math/philox.hpp>
 #include <goptical/core/math/vector.hpp>
 #include <goptical/core/shape/base.hpp>
 #include <goptical/core/trace/distribution.hpp>
 
+#include "shape_sampling_.hxx"
+
 namespace goptical
 {
 
 	namespace shape
 	{
 
+		static double
+		radical_inverse (unsigned int i, unsigned int base)
+		{
+			double inv = 1.0 / base;
+			double f = inv;
+			double r = 0.0;
+			for (; i; i /= base)
+			{
+				r += (i % base) * f;
+				f *= inv;
+			}
+			return r;
+		}
+
+		// Second Sobol dimension, primitive polynomial x + 1
+		static uint32_t
+		sobol_dim2 (uint32_t i)
+		{
+			uint32_t r = 0;
+			for (uint32_t v = 1U << 31; i; i >>= 1, v ^= v >> 1)
+				if (i & 1)
+				{
+					r ^= v;
+				}
+			return r;
+		}
+
+		static uint32_t
+		bit_reverse (uint32_t i)
+		{
+			i = (i << 16) | (i >> 16);
+			i = ((i & 0x00ff00ff) << 8) | ((i & 0xff00ff00) >> 8);
+			i = ((i & 0x0f0f0f0f) << 4) | ((i & 0xf0f0f0f0) >> 4);
+			i = ((i & 0x33333333) << 2) | ((i & 0xcccccccc) >> 2);
+			i = ((i & 0x55555555) << 1) | ((i & 0xaaaaaaaa) >> 1);
+			return i;
+		}
+
 #define ADD_PATTERN_POINT(v)                                                  \
 	{                                                                           \
 		math::Vector2 v_ (v);                                                     \
@@ -92,16 +133,62 @@ namespace goptical
 					}
 				case trace::RandomDist:
 					{
+						// point index is used as counter so that the
+						// pattern only depends on the seed
+						const math::Philox rng (d.get_seed (), p);
+						uint64_t k = 0;
 						double x, y;
 						for (x = -tr; x < tr; x += step)
 						{
 							double ybound = sqrt (math::square (tr) - math::square (x));
 							for (y = -ybound; y < ybound; y += step)
 							{
-								ADD_PATTERN_POINT (
-								    math::Vector2 (x + (drand48 () - .5) * step,
-								                   y + (drand48 () - .5) * step));
+								double u, v;
+								rng.uniform2 (k++, u, v);
+								ADD_PATTERN_POINT (math::Vector2 (x + (u - .5) * step,
+								                                  y + (v - .5) * step));
+							}
+						}
+						break;
+					}
+				case trace::HaltonDist:
+				case trace::SobolDist:
+				case trace::StratifiedDist:
+					{
+						// same point density as grid based patterns
+						const unsigned int n
+						    = (unsigned int)ceil (d.get_radial_density () * sqrt (M_PI));
+						const math::Philox rng (d.get_seed (), p);
+						// random shift of the whole sequence
+						uint32_t shift[4];
+						rng.block (0, shift);
+						const double s0 = shift[0] * (1.0 / 4294967296.0);
+						const double s1 = shift[1] * (1.0 / 4294967296.0);
+						for (unsigned int i = 0; i < n * n; i++)
+						{
+							double u, v;
+							switch (p)
+							{
+								case trace::HaltonDist:
+									u = radical_inverse (i + 1, 2) + s0;
+									v = radical_inverse (i + 1, 3) + s1;
+									u -= floor (u);
+									v -= floor (v);
+									break;
+								case trace::SobolDist:
+									// digital shift keeps net properties
+									u = ((bit_reverse (i) ^ shift[0]) + .5)
+									    * (1.0 / 4294967296.0);
+									v = ((sobol_dim2 (i) ^ shift[1]) + .5)
+									    * (1.0 / 4294967296.0);
+									break;
+								default:
+									rng.uniform2 (i + 1, u, v);
+									u = (i % n + u) / n;
+									v = (i / n + v) / n;
+									break;
 							}
+							ADD_PATTERN_POINT (concentric_disk (u, v) * tr);
 						}
 						break;
 					}
@@ -22,6 +22,7 @@
 
 */
 
+#include <algorithm>
 #include <limits>
 
 #include <goptical/core/math/transform.hpp>
@@ -36,14 +37,17 @@ namespace goptical
 	{
 
 		Composer::Composer ()
-			: _list (), _update (false), _global_dist (true), _max_radius (0.0),
+			: _list (), _nodes (), _prepared (), _prepared_version (0),
+			  _global_dist (true), _max_radius (0.0),
 			  _min_radius (std::numeric_limits<double>::max ()),
 			  _bbox (math::vector2_pair_00), _contour_cnt (0)
 		{
 		}
 
-		Composer::Attributes::Attributes (const std::shared_ptr<Base> &shape)
-			: _shape (shape), _list ()
+		Composer::Attributes::Attributes (const std::shared_ptr<Base> &shape,
+		                                  util::PrepareFlag *prepared)
+			: _shape (shape), _version (0), _exclude (false), _list (),
+			  _prepared (prepared)
 		{
 			_transform.reset ();
 			_inv_transform.reset ();
@@ -52,56 +56,134 @@ namespace goptical
 		Composer::Attributes &
 		Composer::add_shape (const std::shared_ptr<Base> &shape)
 		{
-			_list.push_back (Attributes (shape));
-			_update = true;
+			_list.push_back (Attributes (shape, &_prepared));
+			_prepared.reset ();
+			update_version ();
 			return _list.back ();
 		}
 
 		Composer::Attributes &
 		Composer::Attributes::include (const std::shared_ptr<Base> &shape)
 		{
-			_list.push_back (Attributes (shape));
+			_list.push_back (Attributes (shape, _prepared));
 			_list.back ()._exclude = false;
+			_prepared->reset ();
+			_version++;
 			return _list.back ();
 		}
 
 		Composer::Attributes &
 		Composer::Attributes::exclude (const std::shared_ptr<Base> &shape)
 		{
-			_list.push_back (Attributes (shape));
+			_list.push_back (Attributes (shape, _prepared));
 			_list.back ()._exclude = true;
+			_prepared->reset ();
+			_version++;
 			return _list.back ();
 		}
 
+		unsigned int
+		Composer::Attributes::get_version () const
+		{
+			unsigned int v = _version + _shape->get_version ();
+for (auto &a : _list)
+			{
+				v += a.get_version ();
+			}
+			return v;
+		}
+
+		unsigned int
+		Composer::get_version () const
+		{
+			unsigned int v = Base::get_version ();
+for (auto &a : _list)
+			{
+				v += a.get_version ();
+			}
+			return v;
+		}
+
 		bool
-		Composer::Attributes::inside (const math::Vector2 &point) const
+		Composer::inside (unsigned int i, const math::Vector2 &point) const
 		{
-			math::Vector2 tp (_inv_transform.transform (point));
-			bool res = _shape->inside (tp);
-for (auto &s : _list)
+			const node_s &n = _nodes[i];
+			bool res = false;
+			if (!n._bounded
+			        || (point.x () >= n._bbox[0].x () && point.x () <= n._bbox[1].x ()
+			            && point.y () >= n._bbox[0].y () && point.y () <= n._bbox[1].y ()))
 			{
-				res &= s.inside (tp);
+				math::Vector2 tp (n._inv_transform.transform (point));
+				res = n._shape->inside (tp);
+				for (unsigned int j = i + 1; res && j < n._end; j = _nodes[j]._end)
+				{
+					res = inside (j, tp);
+				}
 			}
-			return res ^ _exclude;
+			return res ^ n._exclude;
 		}
 
 		bool
 		Composer::inside (const math::Vector2 &point) const
 		{
-for (auto &s : _list)
-				if (s.inside (point))
+			if (!is_prepared ())
+			{
+				prepare ();
+			}
+			for (unsigned int i = 0; i < _nodes.size (); i = _nodes[i]._end)
+				if (inside (i, point))
 				{
 					return true;
 				}
 			return false;
 		}
 
+		void
+		Composer::flatten (const Attributes &a)
+		{
+			unsigned int i = _nodes.size ();
+			_nodes.push_back (node_s ());
+			node_s &n = _nodes[i];
+			n._shape = a._shape.get ();
+			n._exclude = a._exclude;
+			n._inv_transform = a._inv_transform;
+			// bounding box of transformed shape bounding box corners,
+			// slightly enlarged to absorb transform rounding errors
+			math::VectorPair2 b = a._shape->get_bounding_box ();
+			math::Vector2 lo (std::numeric_limits<double>::max ());
+			math::Vector2 hi (-std::numeric_limits<double>::max ());
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				math::Vector2 p (a._transform.transform (
+				                     math::Vector2 (b[c & 1].x (), b[c >> 1].y ())));
+				for (unsigned int j = 0; j < 2; j++)
+				{
+					lo[j] = std::min (lo[j], p[j]);
+					hi[j] = std::max (hi[j], p[j]);
+				}
+			}
+			math::Vector2 e ((hi - lo) * 1e-9 + math::Vector2 (1e-12));
+			n._bbox = math::VectorPair2 (lo - e, hi + e);
+			// shapes with empty bounding box like infinite shape are
+			// not bounded
+			n._bounded = b[1].x () > b[0].x () && b[1].y () > b[0].y ()
+			             && std::isfinite ((hi - lo).len ());
+for (auto &s : a._list)
+			{
+				flatten (s);
+			}
+			_nodes[i]._end = _nodes.size ();
+		}
+
 		void
 		Composer::update ()
 		{
 			math::Vector2 a (0);
 			math::Vector2 b (0);
 			_contour_cnt = 0;
+			_max_radius = 0.0;
+			_min_radius = std::numeric_limits<double>::max ();
+			_nodes.clear ();
 for (auto &s : _list)
 			{
 				// update max radius
@@ -135,23 +217,25 @@ for (auto &s : _list)
 				}
 				// update contour count
 				_contour_cnt += s._shape->get_contour_count ();
+				flatten (s);
 			}
 			_bbox = math::VectorPair2 (a, b);
-			_update = false;
+			_prepared_version = get_version ();
 		}
 
 		void
-		Composer::update () const
+		Composer::prepare () const
 		{
-			const_cast<Composer *> (this)->update ();
+			_prepared.prepare ([this] () { const_cast<Composer *> (this)->update (); },
+			                   [this] () { return _prepared_version != get_version (); });
 		}
 
 		double
 		Composer::max_radius () const
 		{
-			if (_update)
+			if (!is_prepared ())
 			{
-				update ();
+				prepare ();
 			}
 			return _max_radius;
 		}
@@ -159,9 +243,9 @@ for (auto &s : _list)
 		double
 		Composer::min_radius () const
 		{
-			if (_update)
+			if (!is_prepared ())
 			{
-				update ();
+				prepare ();
 			}
 			return _min_radius;
 		}
@@ -183,9 +267,9 @@ for (auto &s : _list)
 		math::VectorPair2
 		Composer::get_bounding_box () const
 		{
-			if (_update)
+			if (!is_prepared ())
 			{
-				update ();
+				prepare ();
 			}
 			return _bbox;
 		}
@@ -221,9 +305,9 @@ for (auto &s1 : s._list)
 		unsigned int
 		Composer::get_contour_count () const
 		{
-			if (_update)
+			if (!is_prepared ())
 			{
-				update ();
+				prepare ();
 			}
 			return _contour_cnt;
 		}
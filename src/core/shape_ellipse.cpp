@@ -41,6 +41,7 @@ namespace goptical
 		void
 		EllipseBase::set_radius (double x_radius, double y_radius)
 		{
+			update_version ();
 			_xr = x_radius;
 			_yr = y_radius;
 			_xy_ratio = x_radius / y_radius;
@@ -44,6 +44,7 @@ namespace goptical
 		                                double x_hole_radius)
 		{
 			assert (x_radius > x_hole_radius);
+			update_version ();
 			_xr = x_radius;
 			_xhr = x_hole_radius;
 			_yr = y_radius;
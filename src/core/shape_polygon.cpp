@@ -22,6 +22,7 @@
 
 */
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 
@@ -37,9 +38,13 @@ namespace goptical
 	namespace shape
 	{
 
+		/* maximum number of horizontal slabs used to speed up inside test */
+		static const size_t polygon_max_bins = 1024;
+
 		Polygon::Polygon ()
-			: _updated (false), _vertices (), _bbox (math::vector2_pair_00),
-			  _max_radius (0), _min_radius (1e100)
+			: _prepared (), _vertices (), _bbox (math::vector2_pair_00),
+			  _max_radius (0), _min_radius (1e100), _bins (), _bin_edges (),
+			  _bin_scale (0)
 		{
 		}
 
@@ -81,19 +86,84 @@ namespace goptical
 					{
 						_bbox[0][i] = (*cur)[i];
 					}
-					else if ((*cur)[i] > _bbox[1][i])
+					if ((*cur)[i] > _bbox[1][i])
 					{
 						_bbox[1][i] = (*cur)[i];
 					}
 				}
 				prev = cur;
 			}
+			update_bins ();
+		}
+
+		/* slab index containing y, clamped to valid slabs */
+		static inline unsigned int
+		polygon_bin (double y, double ymin, double scale, unsigned int count)
+		{
+			double b = (y - ymin) * scale;
+			if (!(b > 0))
+			{
+				return 0;
+			}
+			return b >= count ? count - 1 : (unsigned int)b;
+		}
+
+		void
+		Polygon::update_bins ()
+		{
+			// split the bounding box in horizontal slabs and record
+			// edges which span each slab, about one slab per edge
+			size_t s = _vertices.size ();
+			unsigned int count = std::min (s, polygon_max_bins);
+			double height = _bbox[1].y () - _bbox[0].y ();
+			_bin_scale = height > 0 ? count / height : 0;
+			std::vector<unsigned int> first (s), last (s);
+			_bins.assign (count + 1, 0);
+			const math::Vector2 *w = &_vertices[s - 1];
+			for (unsigned int i = 0; i < s; i++)
+			{
+				const math::Vector2 *v = &_vertices[i];
+				double ymin = std::min (v->y (), w->y ());
+				double ymax = std::max (v->y (), w->y ());
+				first[i] = polygon_bin (ymin, _bbox[0].y (), _bin_scale, count);
+				last[i] = polygon_bin (ymax, _bbox[0].y (), _bin_scale, count);
+				for (unsigned int b = first[i]; b <= last[i]; b++)
+				{
+					_bins[b + 1]++;
+				}
+				w = v;
+			}
+			for (unsigned int b = 0; b < count; b++)
+			{
+				_bins[b + 1] += _bins[b];
+			}
+			_bin_edges.resize (_bins[count]);
+			std::vector<unsigned int> pos (_bins.begin (), _bins.end () - 1);
+			w = &_vertices[s - 1];
+			for (unsigned int i = 0; i < s; i++)
+			{
+				const math::Vector2 *v = &_vertices[i];
+				for (unsigned int b = first[i]; b <= last[i]; b++)
+				{
+					edge_s &e = _bin_edges[pos[b]++];
+					e.v = *v;
+					e.w = *w;
+				}
+				w = v;
+			}
+		}
+
+		void
+		Polygon::prepare () const
+		{
+			_prepared.prepare ([this] () { const_cast<Polygon *> (this)->update (); });
 		}
 
 		void
 		Polygon::insert_vertex (const math::Vector2 &v, unsigned int id)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			assert (id <= _vertices.size ());
 			_vertices.insert (_vertices.begin () + id, v);
 		}
@@ -101,7 +171,8 @@ namespace goptical
 		unsigned int
 		Polygon::add_vertex (const math::Vector2 &v)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			unsigned int pos = _vertices.size ();
 			insert_vertex (v, pos);
 			return pos;
@@ -110,7 +181,8 @@ namespace goptical
 		void
 		Polygon::delete_vertex (unsigned int id)
 		{
-			_updated = false;
+			_prepared.reset ();
+			update_version ();
 			assert (id < _vertices.size ());
 			_vertices.erase (_vertices.begin () + id);
 		}
@@ -118,17 +190,27 @@ namespace goptical
 		bool
 		Polygon::inside (const math::Vector2 &p) const
 		{
-			unsigned int s = _vertices.size ();
-			if (s < 3)
+			if (_vertices.size () < 3)
+			{
+				return false;
+			}
+			if (!_prepared.is_prepared ())
+			{
+				prepare ();
+			}
+			if (p.x () < _bbox[0].x () || p.x () > _bbox[1].x ()
+			        || p.y () < _bbox[0].y () || p.y () > _bbox[1].y ())
 			{
 				return false;
 			}
+			// only edges spanning the point slab may be crossed
+			unsigned int b = polygon_bin (p.y (), _bbox[0].y (), _bin_scale,
+			                              _bins.size () - 1);
 			unsigned int count = 0;
-			const math::Vector2 *w = &_vertices[s - 1];
-			// FIXME optimize
-			for (unsigned int i = 0; i < s; i++)
+			for (unsigned int i = _bins[b]; i < _bins[b + 1]; i++)
 			{
-				const math::Vector2 *v = &_vertices[i];
+				const math::Vector2 *v = &_bin_edges[i].v;
+				const math::Vector2 *w = &_bin_edges[i].w;
 				// Algorithm from
 				// http://local.wasp.uwa.edu.au/~pbourke/geometry/insidepoly/
 				if ((((v->y () <= p.y ()) && (p.y () < w->y ()))
@@ -139,7 +221,6 @@ namespace goptical
 				{
 					count++;
 				}
-				w = v;
 			}
 			return (count & 1) != 0;
 		}
@@ -171,9 +252,9 @@ for (auto &v : _vertices)
 		double
 		Polygon::max_radius () const
 		{
-			if (!_updated)
+			if (!_prepared.is_prepared ())
 			{
-				const_cast<Polygon *> (this)->update ();
+				prepare ();
 			}
 			return _max_radius;
 		}
@@ -181,9 +262,9 @@ for (auto &v : _vertices)
 		double
 		Polygon::min_radius () const
 		{
-			if (!_updated)
+			if (!_prepared.is_prepared ())
 			{
-				const_cast<Polygon *> (this)->update ();
+				prepare ();
 			}
 			return _min_radius;
 		}
@@ -191,9 +272,9 @@ for (auto &v : _vertices)
 		math::VectorPair2
 		Polygon::get_bounding_box () const
 		{
-			if (!_updated)
+			if (!_prepared.is_prepared ())
 			{
-				const_cast<Polygon *> (this)->update ();
+				prepare ();
 			}
 			return _bbox;
 		}
@@ -201,9 +282,9 @@ for (auto &v : _vertices)
 		double
 		Polygon::get_outter_radius (const math::Vector2 &dir) const
 		{
-			if (!_updated)
+			if (!_prepared.is_prepared ())
 			{
-				const_cast<Polygon *> (this)->update ();
+				prepare ();
 			}
 			double r = 0;
 			unsigned int s = _vertices.size ();
@@ -25,6 +25,7 @@
 #include <cstdlib>
 
 #include <goptical/core/common.hpp>
+#include <goptical/core/math/philox.hpp>
 #include <goptical/core/math/triangle.hpp>
 #include <goptical/core/trace/distribution.hpp>
 
@@ -113,15 +114,18 @@ Round<X, hole>::get_pattern (const math::Vector2::put_delegate_t &f,
 
         const double bound = obstructed ? hr - epsilon : epsilon;
 
-        double tr1 = tr / 20;
-        for (double r = tr1; r > bound; r -= step)
+        const math::Philox rng (d.get_seed (), p);
+        uint64_t k = 0;
+        for (double r = tr; r > bound; r -= step)
           {
             double astep = (M_PI / 3) / ceil (r / step);
             // angle
             for (double a = 0; a < 2 * M_PI - epsilon; a += astep)
               {
-                math::Vector2 v (sin (a) * r + (drand48 () - .5) * step,
-                                 cos (a) * r * xyr + (drand48 () - .5) * step);
+                double u0, u1;
+                rng.uniform2 (k++, u0, u1);
+                math::Vector2 v (sin (a) * r + (u0 - .5) * step,
+                                 cos (a) * r * xyr + (u1 - .5) * step);
                 double h = hypot (v.x (), v.y () / xyr);
                 if (h < tr && (h > hr || unobstructed))
                   f (v);
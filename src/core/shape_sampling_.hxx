@@ -0,0 +1,67 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_SHAPE_SAMPLING_HXX_
+#define GOPTICAL_SHAPE_SAMPLING_HXX_
+
+#include <cmath>
+
+#include <goptical/core/math/vector.hpp>
+
+namespace goptical
+{
+
+	namespace shape
+	{
+
+		// Map unit square to unit disk preserving area and strata
+		// shape (Shirley-Chiu concentric mapping)
+		static inline math::Vector2
+		concentric_disk (double u, double v)
+		{
+			double a = 2.0 * u - 1.0;
+			double b = 2.0 * v - 1.0;
+			if (a == 0.0 && b == 0.0)
+			{
+				return math::vector2_0;
+			}
+			double r, phi;
+			if (fabs (a) > fabs (b))
+			{
+				r = a;
+				phi = (M_PI / 4) * (b / a);
+			}
+			else
+			{
+				r = b;
+				phi = (M_PI / 2) - (M_PI / 4) * (a / b);
+			}
+			return math::Vector2 (r * cos (phi), r * sin (phi));
+		}
+
+	}
+
+}
+
+#endif
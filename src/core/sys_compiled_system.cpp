@@ -0,0 +1,129 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <goptical/core/sys/compiled_system.hpp>
+#include <goptical/core/sys/surface.hpp>
+#include <goptical/core/sys/system.hpp>
+
+namespace goptical
+{
+
+	namespace sys
+	{
+
+		CompiledSystem::CompiledSystem (const System &system)
+			: _sequential (false)
+		{
+			init (system);
+		}
+
+		CompiledSystem::CompiledSystem (const System &system,
+		                                const std::vector<const Element *> &sequence)
+			: _sequential (true), _sequence (sequence)
+		{
+			init (system);
+			const Element *prev = 0;
+for (auto e : sequence)
+			{
+				// foreign elements are reported by the tracer
+				if (e->get_system () != &system || !e->is_enabled ())
+				{
+					continue;
+				}
+				if (prev && prev != e)
+				{
+					add (*prev, *e);
+				}
+				prev = e;
+			}
+		}
+
+		void
+		CompiledSystem::init (const System &system)
+		{
+			_system = &system;
+			_version = system.get_version ();
+			_e_count = system.get_element_count () + 1;
+			_global.resize (_e_count);
+			_local.resize (_e_count);
+			_first.resize (_e_count, 0);
+			for (unsigned int i = 1; i < _e_count; i++)
+			{
+				// skip unused ids of removed elements
+				if (const Element *e = system._index_map[i])
+				{
+					_global[i] = system.get_global_transform (*e);
+					_local[i] = system.get_local_transform (*e);
+				}
+			}
+		}
+
+		void
+		CompiledSystem::add (const Element &from, const Element &to)
+		{
+			unsigned int &first = _first[from.id ()];
+			for (unsigned int i = first; i; i = _links[i - 1]._next)
+				if (_links[i - 1]._to == to.id ())
+				{
+					return;
+				}
+			link_s l;
+			l._to = to.id ();
+			l._next = first;
+			// same computation as System::transform_cache_update
+			l._t = _global[from.id ()];
+			l._t.compose (_local[to.id ()]);
+			_links.push_back (l);
+			first = _links.size ();
+		}
+
+		bool
+		CompiledSystem::is_valid (const System &system) const
+		{
+			return !_sequential && _system == &system
+			       && _version == system.get_version ();
+		}
+
+		bool
+		CompiledSystem::is_valid (const System &system,
+		                          const std::vector<const Element *> &sequence) const
+		{
+			return _sequential && _system == &system
+			       && _version == system.get_version () && _sequence == sequence;
+		}
+
+		void
+		CompiledSystem::dump (std::ostream &o) const
+		{
+			o << "compiled system transforms count is " << _links.size ()
+			  << std::endl;
+			for (unsigned int from = 0; from < _e_count; from++)
+				for (unsigned int i = _first[from]; i; i = _links[i - 1]._next)
+					o << "from " << from << " to " << _links[i - 1]._to << ":"
+					  << std::endl << _links[i - 1]._t << std::endl;
+		}
+
+	}
+
+}
@@ -25,10 +25,12 @@
 #include <cassert>
 #include <typeinfo>
 
+#include <goptical/core/sys/compiled_system.hpp>
 #include <goptical/core/sys/element.hpp>
 #include <goptical/core/sys/group.hpp>
 #include <goptical/core/sys/system.hpp>
 
+#include <goptical/core/trace/params.hpp>
 #include <goptical/core/trace/ray.hpp>
 
 #include <goptical/core/math/quaternion.hpp>
@@ -181,6 +183,37 @@ namespace goptical
 			return _system->get_transform (e, *this);
 		}
 
+		math::Transform<3>
+		Element::get_transform_to (const Element &e,
+		                           const trace::Params &params) const
+		{
+			const CompiledSystem *c = params.get_compiled_system ();
+			const System *s = _system ? _system : e._system;
+			assert (s);
+			bool compiled = c && &c->get_system () == s
+			                && c->get_version () == s->get_version ();
+			// element which is not part of a system is positioned
+			// relative to global coordinates
+			if (!_system)
+			{
+				math::Transform<3> t (_transform);
+				t.compose (compiled ? c->get_local_transform (e) : e.get_local_transform ());
+				return t;
+			}
+			if (!e._system)
+			{
+				math::Transform<3> t (compiled ? c->get_global_transform (*this)
+				                      : get_global_transform ());
+				t.compose (e._transform.inverse ());
+				return t;
+			}
+			if (compiled)
+			{
+				return c->get_transform (*this, e);
+			}
+			return get_transform_to (e);
+		}
+
 		const math::Transform<3> &
 		Element::get_transform_to (const Element *e) const
 		{
@@ -241,6 +274,14 @@ namespace goptical
 			             "in polarized ray trace mode");
 		}
 
+		void
+		Element::process_rays_batch (trace::RayBatch &batch,
+		                             const trace::Params &params) const
+		{
+			throw Error ("this element is not designed to process incoming light rays "
+			             "in batch ray trace mode");
+		}
+
 		void
 		Element::system_register (System *s)
 		{
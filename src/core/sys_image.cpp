@@ -26,6 +26,7 @@
 #include <goptical/core/shape/rectangle.hpp>
 #include <goptical/core/sys/image.hpp>
 #include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
 
 namespace goptical
 {
@@ -67,6 +68,19 @@ namespace goptical
 		{
 		}
 
+		void
+		Image::trace_rays_batch (trace::RayBatch &batch,
+		                         const trace::Params &params) const
+		{
+			for (unsigned int i = 0; i < batch.size (); i++)
+			{
+				if (batch.is_active (i))
+				{
+					batch.deactivate (i);
+				}
+			}
+		}
+
 	}
 
 }
@@ -30,12 +30,18 @@
 #include <goptical/core/shape/disk.hpp>
 
 #include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/index_table.hpp>
 #include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
+#include <goptical/core/trace/refraction_stats.hpp>
 #include <goptical/core/trace/result.hpp>
 
 #include <goptical/core/io/renderer.hpp>
 #include <goptical/core/io/rgb.hpp>
 
+#include "trace_kernel_.hxx"
+
 namespace goptical
 {
 
@@ -87,38 +93,44 @@ namespace goptical
 			return r.get_style_color (io::StyleSurface);
 		}
 
-		/** Compute refracted ray direction given
-		 *
-		 * @param ray Original ray - position and direction
-		 * @param dir
-		 * @param normal Normal to the intercept
-		 * @param mu Ration of refractive index
-		 */
-		bool
-		compute_refraction (const math::VectorPair3 &ray, math::Vector3 &dir,
-		                    const math::Vector3 &normal, double mu)
+		/** Compute refracted ray direction with Feder formula, see Feder
+		    paper p632. Normal points toward incident ray, its sign is
+		    changed here. Return false if direction can not be computed. */
+		static bool
+		refract_feder (const math::Vector3 &incident, math::Vector3 &dir,
+		               const math::Vector3 &normal, double mu)
 		{
-			auto N = normal * -1.0; // Because we changed sign at intersection
-			// See Feder paper p632
+			auto N = normal * -1.0;
 			double O2 = N * N;
-			double E1 = ray.direction () * N;
+			double E1 = incident * N;
 			double E1_ = sqrt (O2 * (1.0 - mu * mu) + mu * mu * E1 * E1);
 			if (isnan (E1_))
 			{
 				return false;
 			}
 			double g1 = (E1_ - mu * E1) / O2;
-			dir = ray.direction () * mu + N * g1;
+			dir = incident * mu + N * g1;
 			return true;
 		}
 
+		/** Compute refracted ray direction with vector form of Snell law
+		    from Bram de Greve article "Reflections & Refractions in
+		    Raytracing" http://www.bramz.org/ */
+		static void
+		refract_de_greve (const math::Vector3 &incident, math::Vector3 &dir,
+		                  const math::Vector3 &normal, double cosi, double sint2,
+		                  double refract_index)
+		{
+			dir = incident * refract_index
+			      - normal * (refract_index * cosi + sqrt (1.0 - sint2));
+		}
+
 		bool
-		OpticalSurface::refract (const math::VectorPair3 &ray, math::Vector3 &dir,
+		OpticalSurface::refract (const trace::Params &params,
+		                         const math::VectorPair3 &ray, math::Vector3 &dir,
 		                         const math::Vector3 &normal,
 		                         double refract_index) const
 		{
-			// Algorithm from Bram de Greve article "Reflections & Refractions in
-			// Raytracing" http://www.bramz.org/
 			assert (fabs (normal.len () - 1.0) < 1e-10);
 			assert (fabs ((ray.direction ().len ()) - 1.0) < 1e-10);
 			double cosi = (normal * ray.direction ());
@@ -127,21 +139,35 @@ namespace goptical
 			{
 				return false;    // total internal reflection
 			}
-			dir = ray.direction () * refract_index
-			      - normal * (refract_index * cosi + sqrt (1.0 - sint2));
-			// This uses Feder refractive formula
-			Vector3 dir2;
-			compute_refraction (ray, dir2, normal, refract_index);
-			if ((fabs (dir.x () - dir2.x ()) > 1e-14
-			        || fabs (dir.y () - dir2.y ()) > 1e-14
-			        || fabs (dir.z () - dir2.z ()) > 1e-14))
+			trace::RefractionStats *stats = params.get_refraction_stats ();
+			math::Vector3 other;
+			switch (params.get_refraction_law ())
+			{
+				case trace::RefractionFeder:
+					if (!refract_feder (ray.direction (), dir, normal, refract_index))
+					{
+						return false;
+					}
+					if (stats)
+					{
+						refract_de_greve (ray.direction (), other, normal, cosi, sint2,
+						                  refract_index);
+					}
+					break;
+				case trace::RefractionDeGreve:
+					refract_de_greve (ray.direction (), dir, normal, cosi, sint2,
+					                  refract_index);
+					if (stats && !refract_feder (ray.direction (), other, normal,
+					                             refract_index))
+					{
+						other = math::Vector3 (NAN, NAN, NAN);
+					}
+					break;
+			}
+			if (stats)
 			{
-				printf ("Refract Orig  %.16f, %.16f, %.16f\n", dir.x (), dir.y (),
-				        dir.z ());
-				printf ("Refract Feder %.16f, %.16f, %.16f\n", dir2.x (), dir2.y (),
-				        dir2.z ());
+				stats->add (ray.direction (), normal, refract_index, dir, other);
 			}
-			dir = dir2;
 			return true;
 		}
 
@@ -157,6 +183,22 @@ namespace goptical
 			dir = ray.direction () - normal * (2.0 * cosi);
 		}
 
+		double
+		OpticalSurface::get_index_ratio (const trace::Params &params,
+		                                 bool right_to_left, double wavelen) const
+		{
+			const trace::IndexTable *table = params.get_index_table ();
+			double ratio;
+			if (table
+			        && table->get_index_ratio (*this, right_to_left,
+			                                   table->get_wavelen_index (wavelen), ratio))
+			{
+				return ratio;
+			}
+			return _mat[right_to_left]->get_refractive_index (wavelen)
+			       / _mat[!right_to_left]->get_refractive_index (wavelen);
+		}
+
 		void
 		OpticalSurface::trace_ray_simple (trace::Result &result, trace::Ray &incident,
 		                                  const math::VectorPair3 &local,
@@ -174,9 +216,9 @@ namespace goptical
 				return;
 			}
 			double wl = incident.get_wavelen ();
-			double index = prev_mat->get_refractive_index (wl)
-			               / next_mat->get_refractive_index (wl);
-			if (!refract (local, direction, intersect.normal (), index))
+			double index = get_index_ratio (result.get_params (), right_to_left, wl);
+			if (!refract (result.get_params (), local, direction, intersect.normal (),
+			              index))
 			{
 				trace::Ray &r = result.new_ray ();
 				// total internal reflection
@@ -186,7 +228,7 @@ namespace goptical
 				r.origin () = intersect.origin ();
 				reflect (local, r.direction (), intersect.normal ());
 				r.set_creator (this);
-				incident.add_generated (&r);
+				result.link_generated (incident, r);
 				return;
 			}
 			// transmit
@@ -199,7 +241,7 @@ namespace goptical
 				r.origin () = intersect.origin ();
 				r.direction () = direction;
 				r.set_creator (this);
-				incident.add_generated (&r);
+				result.link_generated (incident, r);
 			}
 			// reflect
 			if (next_mat->is_reflecting ())
@@ -211,7 +253,102 @@ namespace goptical
 				r.origin () = intersect.origin ();
 				reflect (local, r.direction (), intersect.normal ());
 				r.set_creator (this);
-				incident.add_generated (&r);
+				result.link_generated (incident, r);
+			}
+		}
+
+		void
+		OpticalSurface::trace_rays_batch (trace::RayBatch &batch,
+		                                  const trace::Params &params) const
+		{
+			const unsigned int count = batch.size ();
+			std::vector<double> index (count);
+			std::vector<unsigned char> action (count, trace::KernelActionNone);
+			// refractive index ratio of last wavelen, for both directions
+			double last_wl[2] = { 0.0, 0.0 };
+			double last_index[2] = { 0.0, 0.0 };
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (!batch.is_active (i))
+				{
+					continue;
+				}
+				bool right_to_left = batch.get_data (trace::RayBatch::NormalZ)[i] > 0;
+				const material::Base *prev_mat = _mat[right_to_left].get ();
+				const material::Base *next_mat = _mat[!right_to_left].get ();
+				// check ray didn't "escaped" from its material
+				if (prev_mat != batch.get_material (i))
+				{
+					batch.deactivate (i);
+					continue;
+				}
+				double wl = batch.get_wavelen (i);
+				if (wl != last_wl[right_to_left])
+				{
+					last_wl[right_to_left] = wl;
+					last_index[right_to_left] = get_index_ratio (params, right_to_left, wl);
+				}
+				index[i] = last_index[right_to_left];
+				// only a single outgoing ray can be propagated in batch mode,
+				// total internal reflection is handled by the refract action
+				if (!next_mat->is_opaque () && next_mat->is_reflecting ())
+					throw Error ("batch ray trace can not handle material which both "
+					             "transmits and reflects light");
+				action[i] = next_mat->is_reflecting () ? trace::KernelActionReflect
+				            : trace::KernelActionRefract;
+			}
+			if (params.get_refraction_stats ())
+			{
+				// formulas validation is not handled by kernels
+				for (unsigned int i = 0; i < count; i++)
+				{
+					if (action[i] == trace::KernelActionNone)
+					{
+						continue;
+					}
+					math::VectorPair3 local (batch.get_ray (i));
+					math::Vector3 normal (batch.get_normal (i));
+					math::Vector3 direction;
+					if (action[i] == trace::KernelActionReflect
+					        || !refract (params, local, direction, normal, index[i]))
+					{
+						reflect (local, direction, normal);
+						action[i] = trace::KernelActionReflect;
+					}
+					batch.set_direction (i, direction);
+				}
+			}
+			else
+			{
+				trace::kernel_refract_s r;
+				r._law = (trace::kernel_refraction_e)params.get_refraction_law ();
+				r._d[0] = batch.get_data (trace::RayBatch::DirectionX);
+				r._d[1] = batch.get_data (trace::RayBatch::DirectionY);
+				r._d[2] = batch.get_data (trace::RayBatch::DirectionZ);
+				r._n[0] = batch.get_data (trace::RayBatch::NormalX);
+				r._n[1] = batch.get_data (trace::RayBatch::NormalY);
+				r._n[2] = batch.get_data (trace::RayBatch::NormalZ);
+				r._index = index.data ();
+				r._action = action.data ();
+				trace::kernel_refract (r, count);
+			}
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (action[i] != trace::KernelActionRefract)
+				{
+					continue;
+				}
+				// transmit
+				bool right_to_left = batch.get_data (trace::RayBatch::NormalZ)[i] > 0;
+				const material::Base *next_mat = _mat[!right_to_left].get ();
+				if (next_mat->is_opaque ())
+				{
+					batch.deactivate (i);
+				}
+				else
+				{
+					batch.set_material (i, next_mat);
+				}
 			}
 		}
 
@@ -231,10 +368,10 @@ namespace goptical
 				return;
 			}
 			double wl = incident.get_wavelen ();
-			double index = prev_mat->get_refractive_index (wl)
-			               / next_mat->get_refractive_index (wl);
+			double index = get_index_ratio (result.get_params (), right_to_left, wl);
 			double intensity = incident.get_intercept_intensity ();
-			if (!refract (local, direction, intersect.normal (), index))
+			if (!refract (result.get_params (), local, direction, intersect.normal (),
+			              index))
 			{
 				// total internal reflection
 				trace::Ray &r = result.new_ray ();
@@ -244,7 +381,7 @@ namespace goptical
 				r.origin () = intersect.origin ();
 				reflect (local, r.direction (), intersect.normal ());
 				r.set_creator (this);
-				incident.add_generated (&r);
+				result.link_generated (incident, r);
 				return;
 			}
 			// transmit
@@ -261,7 +398,7 @@ namespace goptical
 					r.origin () = intersect.origin ();
 					r.direction () = direction;
 					r.set_creator (this);
-					incident.add_generated (&r);
+					result.link_generated (incident, r);
 				}
 			}
 			// reflect
@@ -277,7 +414,7 @@ namespace goptical
 					r.origin () = intersect.origin ();
 					reflect (local, r.direction (), intersect.normal ());
 					r.set_creator (this);
-					incident.add_generated (&r);
+					result.link_generated (incident, r);
 				}
 			}
 		}
@@ -295,6 +432,7 @@ namespace goptical
 			{
 				_mat[index] = m;
 			}
+			update_version ();
 		}
 
 		void
@@ -54,6 +54,13 @@ namespace goptical
 			}
 		}
 
+		size_t
+		Source::get_sample_count (const trace::Params &params,
+		                          const targets_t &entry) const
+		{
+			return 0;
+		}
+
 		void
 		Source::generate_rays_simple (trace::Result &result,
 		                              const targets_t &entry) const
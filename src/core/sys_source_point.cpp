@@ -54,10 +54,46 @@ namespace goptical
 		{
 		}
 
+		/* get pattern points on target surface, reused across traces */
+		static const std::vector<math::Vector3> *
+		source_pattern_points (const trace::Params &params, const Surface &target,
+		                       std::shared_ptr<const std::vector<math::Vector3>> &cached,
+		                       const std::vector<double> *&weights)
+		{
+			const std::vector<math::Vector3> *points;
+			if (!params.get_pattern_points (target, points, weights))
+			{
+				cached = target.get_pattern_points (params.get_distribution (target),
+				                                    params.get_unobstructed ());
+				points = cached.get ();
+				weights = 0;
+			}
+			return points;
+		}
+
+		size_t
+		SourcePoint::get_sample_count (const trace::Params &params,
+		                               const targets_t &entry) const
+		{
+			size_t count = 0;
+for (auto &target : entry)
+			{
+				const Surface *starget = dynamic_cast<const Surface *> (target);
+				if (!starget)
+				{
+					continue;
+				}
+				std::shared_ptr<const std::vector<math::Vector3>> cached;
+				const std::vector<double> *weights;
+				count += source_pattern_points (params, *starget, cached, weights)->size ();
+			}
+			return count;
+		}
+
 		template <SourceInfinityMode mode>
 		void
 		SourcePoint::get_lightrays_ (trace::Result &result,
-		                             const Element &target) const
+		                             const Element &target, size_t &sample) const
 		{
 			const Surface *starget = dynamic_cast<const Surface *> (&target);
 			if (!starget)
@@ -65,12 +101,35 @@ namespace goptical
 				return;
 			}
 			double rlen = result.get_params ().get_lost_ray_length ();
-			const trace::Distribution &d
-			    = result.get_params ().get_distribution (*starget);
-			auto de = [&] (const math::Vector3 &i)
+			std::shared_ptr<const std::vector<math::Vector3>> cached;
+			const std::vector<double> *weights;
+			const std::vector<math::Vector3> *points = source_pattern_points (
+			            result.get_params (), *starget, cached, weights);
+			// restrict to requested samples range
+			size_t first, end;
+			result.get_sample_range (first, end);
+			first = std::min (std::max (first, sample) - sample, points->size ());
+			end = std::min (std::max (end, sample) - sample, points->size ());
+			sample += points->size ();
+			// source may not be part of the system when given to the tracer
+			const math::Transform<3> t (
+			    starget->get_transform_to (*this, result.get_params ()));
+			const material::Base *mat
+			    = _mat.operator bool ()
+			      ? _mat.get ()
+			      : starget->get_system ()->get_environment_proxy ().get ();
+			math::VectorPair3 plane;
+			if (mode == SourceAtInfinity)
+			{
+				plane = math::VectorPair3 (t.transform (math::vector3_0)
+				                           - math::vector3_001 * rlen,
+				                           math::vector3_001);
+			}
+			for (size_t j = first; j < end; j++)
 			{
-				math::Vector3 r = starget->get_transform_to (*this).transform (
-				                      i); // pattern point on target surface
+				// pattern point on target surface
+				math::Vector3 r = t.transform ((*points)[j]);
+				double w = weights ? (*weights)[j] : 1.0;
 				math::Vector3 direction;
 				math::Vector3 position;
 				switch (mode)
@@ -81,10 +140,7 @@ namespace goptical
 						break;
 					case (SourceAtInfinity):
 						direction = math::vector3_001;
-						position = math::VectorPair3 (starget->get_position (*this)
-						                              - math::vector3_001 * rlen,
-						                              math::vector3_001)
-						           .pl_ln_intersect (math::VectorPair3 (r, direction));
+						position = plane.pl_ln_intersect (math::VectorPair3 (r, direction));
 						break;
 				}
 for (auto &l : this->_spectrum)
@@ -94,15 +150,12 @@ for (auto &l : this->_spectrum)
 					r.direction () = direction;
 					r.origin () = position;
 					r.set_creator (this);
-					r.set_intensity (l.get_intensity ()); // FIXME depends on distance from
-					// source and pattern density
+					// FIXME depends on distance from source and pattern density
+					r.set_intensity (l.get_intensity () * w);
 					r.set_wavelen (l.get_wavelen ());
-					r.set_material (_mat.operator bool ()
-					                ? _mat.get ()
-					                : get_system ()->get_environment_proxy ().get ());
+					r.set_material (mat);
 				}
-			};
-			starget->get_pattern (de, d, result.get_params ().get_unobstructed ());
+			}
 		}
 
 		void
@@ -113,18 +166,19 @@ for (auto &l : _spectrum)
 			{
 				result.add_ray_wavelen (l.get_wavelen ());
 			}
+			size_t sample = 0;
 			switch (_mode)
 			{
 				case SourceAtFiniteDistance:
 for (auto &target : entry)
 					{
-						get_lightrays_<SourceAtFiniteDistance> (result, *target);
+						get_lightrays_<SourceAtFiniteDistance> (result, *target, sample);
 					}
 					return;
 				case SourceAtInfinity:
 for (auto &target : entry)
 					{
-						get_lightrays_<SourceAtInfinity> (result, *target);
+						get_lightrays_<SourceAtInfinity> (result, *target, sample);
 					}
 					return;
 			}
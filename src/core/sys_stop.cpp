@@ -26,6 +26,7 @@
 
 #include <goptical/core/trace/params.hpp>
 #include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
 #include <goptical/core/trace/result.hpp>
 
 #include <goptical/core/math/vector.hpp>
@@ -38,6 +39,8 @@
 
 #include <goptical/core/io/renderer.hpp>
 
+#include "trace_kernel_.hxx"
+
 namespace goptical
 {
 
@@ -101,7 +104,7 @@ namespace goptical
 				r.origin () = intersect.origin ();
 				r.direction () = incident.direction ();
 				r.set_creator (this);
-				incident.add_generated (&r);
+				result.link_generated (incident, r);
 			}
 		}
 
@@ -113,16 +116,74 @@ namespace goptical
 			trace_ray_simple (result, incident, local, intersect);
 		}
 
+		void
+		Stop::intersect_batch (trace::RayBatch &batch,
+		                       const trace::Params &params) const
+		{
+			trace::kernel_surface_s ks;
+			if (trace::kernel_surface_setup (ks, get_curve (), 0))
+			{
+				ks._aperture = trace::KernelApertureExternal;
+				ks._radius = _external_radius;
+				trace::kernel_intersect (ks, batch);
+				return;
+			}
+			for (unsigned int i = 0; i < batch.size (); i++)
+			{
+				if (!batch.is_active (i))
+				{
+					continue;
+				}
+				math::VectorPair3 intersect;
+				math::VectorPair3 local (batch.get_ray (i));
+				if (!get_curve ().intersect (intersect.origin (), local)
+				        || !(intersect.origin ().project_xy ().len () < _external_radius))
+				{
+					batch.set_lost (i);
+					continue;
+				}
+				get_curve ().normal (intersect.normal (), intersect.origin ());
+				if (local.direction ().z () < 0)
+				{
+					intersect.normal () = -intersect.normal ();
+				}
+				batch.get_data (trace::RayBatch::Length)[i]
+				    = (intersect.origin () - local.origin ()).len ();
+				batch.set_origin (i, intersect.origin ());
+				batch.set_normal (i, intersect.normal ());
+			}
+		}
+
+		void
+		Stop::trace_rays_batch (trace::RayBatch &batch,
+		                        const trace::Params &params) const
+		{
+			// batch mode is sequential, rays are always reemitted
+			for (unsigned int i = 0; i < batch.size (); i++)
+			{
+				if (batch.is_active (i)
+				        && !get_shape ().inside (batch.get_origin (i).project_xy ()))
+				{
+					batch.deactivate (i);
+				}
+			}
+		}
+
 		template <trace::IntensityMode m>
 		inline void
 		Stop::process_rays_ (trace::Result &result, trace::rays_queue_t *input) const
 		{
+			const Element *creator = 0;
+			math::Transform<3> t;
 for (auto &i : *input)
 			{
 				math::VectorPair3 intersect;
 				trace::Ray &ray = *i;
-				const math::Transform<3> &t
-				    = ray.get_creator ()->get_transform_to (*this);
+				if (ray.get_creator () != creator)
+				{
+					creator = ray.get_creator ();
+					t = creator->get_transform_to (*this, result.get_params ());
+				}
 				math::VectorPair3 local (t.transform_line (ray));
 				if (get_curve ().intersect (intersect.origin (), local))
 				{
@@ -179,6 +240,20 @@ for (auto &i : *input)
 			r.group_end ();
 		}
 
+		bool
+		Stop::get_intersect_bounding_box (math::VectorPair3 &box) const
+		{
+			double zmin, zmax;
+			if (!get_curve ().get_intersect_z_range (_external_radius, zmin, zmax))
+			{
+				return false;
+			}
+			box = math::VectorPair3 (
+			          math::Vector3 (-_external_radius, -_external_radius, zmin),
+			          math::Vector3 (_external_radius, _external_radius, zmax));
+			return true;
+		}
+
 		void
 		Stop::draw_2d_e (io::Renderer &r, const Element *ref) const
 		{
@@ -39,11 +39,16 @@
 #include <goptical/core/trace/distribution.hpp>
 #include <goptical/core/trace/params.hpp>
 #include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
 #include <goptical/core/trace/result.hpp>
 
 #include <goptical/core/io/renderer.hpp>
 #include <goptical/core/io/rgb.hpp>
 
+#include "trace_kernel_.hxx"
+
+#include <mutex>
+
 namespace goptical
 {
 
@@ -71,6 +76,75 @@ namespace goptical
 			_shape->get_pattern (de, d, unobstructed);
 		}
 
+		// Maximum number of distinct patterns kept per surface
+		static const size_t pattern_cache_size = 4;
+
+		// pattern lookups happen once per trace and per source, a single
+		// lock shared by all surfaces is enough
+		static std::mutex pattern_cache_lock;
+
+		bool
+		Surface::is_pattern_valid (const pattern_cache_s &c) const
+		{
+			return c._version == get_version () && c._curve == _curve.get ()
+			       && c._shape == _shape.get ()
+			       && c._curve_version == _curve->get_version ()
+			       && c._shape_version == _shape->get_version ();
+		}
+
+		std::shared_ptr<const std::vector<math::Vector3>>
+		        Surface::get_pattern_points (const trace::Distribution &d,
+		                                     bool unobstructed) const
+		{
+			{
+				std::lock_guard<std::mutex> lock (pattern_cache_lock);
+				for (auto &c : _pattern_cache)
+					if (c._dist == d && c._unobstructed == unobstructed
+					        && is_pattern_valid (c))
+					{
+						return c._points;
+					}
+			}
+			auto points = std::make_shared<std::vector<math::Vector3>> ();
+			std::vector<math::Vector2> tmp;
+			auto de = [&] (const math::Vector2 &v2d) { tmp.push_back (v2d); };
+			_shape->get_pattern (de, d, unobstructed);
+			// project on curve in a single pass over contiguous storage
+			points->resize (tmp.size ());
+			for (size_t i = 0; i < tmp.size (); i++)
+			{
+				(*points)[i] = math::Vector3 (tmp[i], _curve->sagitta (tmp[i]));
+			}
+			{
+				std::lock_guard<std::mutex> lock (pattern_cache_lock);
+				// drop stale entries first, then the oldest one
+				size_t j = 0;
+				for (size_t i = 0; i < _pattern_cache.size (); i++)
+					if (is_pattern_valid (_pattern_cache[i]))
+					{
+						_pattern_cache[j++] = _pattern_cache[i];
+					}
+				_pattern_cache.resize (j);
+				if (_pattern_cache.size () >= pattern_cache_size)
+				{
+					_pattern_cache.erase (_pattern_cache.begin ());
+				}
+				pattern_cache_s c = { d, unobstructed, get_version (), _curve.get (),
+				                      _shape.get (), _curve->get_version (),
+				                      _shape->get_version (), points
+				                    };
+				_pattern_cache.push_back (c);
+			}
+			return points;
+		}
+
+		void
+		Surface::clear_pattern_cache () const
+		{
+			std::lock_guard<std::mutex> lock (pattern_cache_lock);
+			_pattern_cache.clear ();
+		}
+
 		void
 		Surface::trace_ray_simple (trace::Result &result, trace::Ray &incident,
 		                           const math::VectorPair3 &local,
@@ -95,6 +169,13 @@ namespace goptical
 			throw Error ("polarized ray trace not handled by this surface class");
 		}
 
+		void
+		Surface::trace_rays_batch (trace::RayBatch &batch,
+		                           const trace::Params &params) const
+		{
+			throw Error ("batch ray trace not handled by this surface class");
+		}
+
 		bool
 		Surface::intersect (const trace::Params &params, math::VectorPair3 &pt,
 		                    const math::VectorPair3 &ray) const
@@ -127,6 +208,8 @@ namespace goptical
 			if (m == trace::Simpletrace)
 			{
 				incident.set_intercept_intensity (1.0);
+				result.add_intercept_event (*this, pt.origin (), local.direction (),
+				                            incident.get_wavelen (), 1.0);
 				return trace_ray_simple (result, incident, local, pt);
 			}
 			else
@@ -137,6 +220,8 @@ namespace goptical
 				      * incident.get_material ()->get_internal_transmittance (
 				          incident.get_wavelen (), incident.get_len ());
 				incident.set_intercept_intensity (i_intensity);
+				result.add_intercept_event (*this, pt.origin (), local.direction (),
+				                            incident.get_wavelen (), i_intensity);
 				if (i_intensity < _discard_intensity)
 				{
 					return;
@@ -172,12 +257,17 @@ namespace goptical
 		                        trace::rays_queue_t *input) const
 		{
 			const trace::Params &params = result.get_params ();
+			const Element *creator = 0;
+			math::Transform<3> t;
 for (auto &i : *input)
 			{
 				math::VectorPair3 pt;
 				trace::Ray &ray = *i;
-				const math::Transform<3> &t
-				    = ray.get_creator ()->get_transform_to (*this);
+				if (ray.get_creator () != creator)
+				{
+					creator = ray.get_creator ();
+					t = creator->get_transform_to (*this, params);
+				}
 				math::VectorPair3 local (t.transform_line (ray));
 				if (intersect (params, pt, local))
 				{
@@ -187,6 +277,102 @@ for (auto &i : *input)
 			}
 		}
 
+		void
+		Surface::intersect_batch (trace::RayBatch &batch,
+		                          const trace::Params &params) const
+		{
+			trace::kernel_surface_s ks;
+			if (trace::kernel_surface_setup (
+			            ks, *_curve, params.get_unobstructed () ? 0 : _shape.get ()))
+			{
+				trace::kernel_intersect (ks, batch);
+				return;
+			}
+			for (unsigned int i = 0; i < batch.size (); i++)
+			{
+				if (!batch.is_active (i))
+				{
+					continue;
+				}
+				math::VectorPair3 pt;
+				math::VectorPair3 local (batch.get_ray (i));
+				if (!intersect (params, pt, local))
+				{
+					batch.set_lost (i);
+					continue;
+				}
+				batch.get_data (trace::RayBatch::Length)[i]
+				    = (pt.origin () - local.origin ()).len ();
+				batch.set_origin (i, pt.origin ());
+				batch.set_normal (i, pt.normal ());
+			}
+		}
+
+		void
+		Surface::process_rays_batch (trace::RayBatch &batch,
+		                             const trace::Params &params) const
+		{
+			const Element *frame = batch.get_frame ();
+			if (frame && frame != this)
+			{
+				batch.transform (frame->get_transform_to (*this, params));
+			}
+			batch.set_frame (this);
+			intersect_batch (batch, params);
+			trace::Result *sink_result = batch.get_sink_result ();
+			if (sink_result)
+			{
+				for (unsigned int i = 0; i < batch.size (); i++)
+				{
+					if (batch.is_active (i))
+					{
+						sink_result->add_intercept_event (
+						    *this, batch.get_origin (i), batch.get_direction (i),
+						    batch.get_wavelen (i), 1.0);
+					}
+				}
+			}
+			trace::Result *result = batch.get_result ();
+			if (result && batch.get_traced_incident ())
+			{
+				for (unsigned int i = 0; i < batch.size (); i++)
+				{
+					trace::Ray *ray = batch.get_traced_ray (i);
+					if (!batch.is_active (i) || !ray)
+					{
+						continue;
+					}
+					ray->set_len (batch.get_len (i));
+					ray->set_intercept (*this, batch.get_origin (i));
+					ray->set_intercept_intensity (1.0);
+					result->add_intercepted (*this, *ray);
+				}
+			}
+			trace_rays_batch (batch, params);
+			if (result && batch.get_allocate ())
+			{
+				// allocate rays tree nodes for outgoing rays
+				for (unsigned int i = 0; i < batch.size (); i++)
+				{
+					trace::Ray *ray = batch.get_traced_ray (i);
+					if (!batch.is_active (i) || !ray)
+					{
+						continue;
+					}
+					trace::Ray &r = result->new_ray ();
+					r.set_wavelen (batch.get_wavelen (i));
+					r.set_intensity (batch.get_intensity (i));
+					r.set_material (batch.get_material (i));
+					r.origin () = batch.get_origin (i);
+					r.direction () = batch.get_direction (i);
+					r.set_creator (this);
+					result->link_generated (*ray, r);
+					batch.set_traced_ray (i, &r);
+				}
+			}
+			batch.set_traced_incident (batch.get_allocate ());
+		}
+
 		void
 		Surface::process_rays_simple (trace::Result &result,
 		                              trace::rays_queue_t *input) const
@@ -229,6 +415,23 @@ for (auto &i : *input)
 			                          math::Vector3 (sb[1].x (), sb[1].y (), ms));
 		}
 
+		bool
+		Surface::get_intersect_bounding_box (math::VectorPair3 &box) const
+		{
+			math::VectorPair2 sb = _shape->get_bounding_box ();
+			// bounding box corner farthest from the z axis
+			double rx = std::max (fabs (sb[0].x ()), fabs (sb[1].x ()));
+			double ry = std::max (fabs (sb[0].y ()), fabs (sb[1].y ()));
+			double zmin, zmax;
+			if (!_curve->get_intersect_z_range (sqrt (rx * rx + ry * ry), zmin, zmax))
+			{
+				return false;
+			}
+			box = math::VectorPair3 (math::Vector3 (sb[0].x (), sb[0].y (), zmin),
+			                         math::Vector3 (sb[1].x (), sb[1].y (), zmax));
+			return true;
+		}
+
 		void
 		Surface::draw_3d_e (io::Renderer &r, const Element *ref) const
 		{
@@ -22,6 +22,10 @@
 
 */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include <goptical/core/common.hpp>
 #include <goptical/core/sys/container.hpp>
 #include <goptical/core/sys/group.hpp>
@@ -43,9 +47,136 @@ namespace goptical
 	namespace sys
 	{
 
+		/* Bounding volume hierarchy of global surface bounding boxes. Nodes
+		   are stored in depth first order: first child of an inner node
+		   immediately follows its parent. */
+		struct colide_bvh_s
+		{
+			struct item_s
+			{
+				math::VectorPair3 _box;
+				math::Vector3 _center;
+				Surface *_surface;
+				unsigned int _index;
+			};
+
+			struct node_s
+			{
+				math::VectorPair3 _box;
+				// index of second child for inner nodes, first item for leaves
+				unsigned int _next;
+				// item count, 0 for inner nodes
+				unsigned int _count;
+			};
+
+			void build (unsigned int first, unsigned int count);
+
+			std::vector<item_s> _items;
+			std::vector<node_s> _nodes;
+			// surfaces without known intersection bounds, always tested
+			std::vector<item_s> _unbounded;
+			// element local to global and global to local transforms,
+			// indexed by element id
+			std::vector<math::Transform<3> > _global;
+			std::vector<math::Transform<3> > _local;
+		};
+
+		static const unsigned int colide_bvh_leaf_size = 2;
+
+		static void
+		colide_box_merge (math::VectorPair3 &box, const math::VectorPair3 &b)
+		{
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				box[0][i] = std::min (box[0][i], b[0][i]);
+				box[1][i] = std::max (box[1][i], b[1][i]);
+			}
+		}
+
+		void
+		colide_bvh_s::build (unsigned int first, unsigned int count)
+		{
+			node_s n;
+			math::VectorPair3 cbox (_items[first]._center, _items[first]._center);
+			n._box = _items[first]._box;
+			for (unsigned int i = first + 1; i < first + count; i++)
+			{
+				colide_box_merge (n._box, _items[i]._box);
+				colide_box_merge (cbox, math::VectorPair3 (_items[i]._center,
+				                  _items[i]._center));
+			}
+			unsigned int id = _nodes.size ();
+			if (count <= colide_bvh_leaf_size)
+			{
+				n._next = first;
+				n._count = count;
+				_nodes.push_back (n);
+				return;
+			}
+			n._count = 0;
+			_nodes.push_back (n);
+			// split items at median along largest axis of centers extent
+			math::Vector3 ext (cbox[1] - cbox[0]);
+			unsigned int axis = 0;
+			for (unsigned int i = 1; i < 3; i++)
+				if (ext[i] > ext[axis])
+				{
+					axis = i;
+				}
+			unsigned int half = count / 2;
+			std::nth_element (_items.begin () + first, _items.begin () + first + half,
+			                  _items.begin () + first + count,
+			                  [axis] (const item_s & a, const item_s & b)
+			{
+				return a._center[axis] < b._center[axis];
+			});
+			build (first, half);
+			_nodes[id]._next = _nodes.size ();
+			build (first + half, count - half);
+		}
+
+		/* Get ray entry position on box as a multiple of ray
+		   direction. Return false if ray line does not cross the box
+		   after ray origin. */
+		static bool
+		colide_box_enter (const math::VectorPair3 &box, const math::VectorPair3 &ray,
+		                  double &tmin)
+		{
+			double t0 = 0.0;
+			double t1 = std::numeric_limits<double>::infinity ();
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				double o = ray.origin ()[i];
+				double d = ray.direction ()[i];
+				if (d == 0.0)
+				{
+					if (o < box[0][i] || o > box[1][i])
+					{
+						return false;
+					}
+					continue;
+				}
+				double a = (box[0][i] - o) / d;
+				double b = (box[1][i] - o) / d;
+				if (a > b)
+				{
+					std::swap (a, b);
+				}
+				t0 = std::max (t0, a);
+				t1 = std::min (t1, b);
+				if (t0 > t1)
+				{
+					return false;
+				}
+			}
+			tmin = t0;
+			return true;
+		}
+
 		System::System ()
 			: _version (0), _env_proxy (material::std_air), _tracer_params (),
-			  _e_count (0), _index_map (), _transform_cache ()
+			  _e_count (0), _index_map (), _transform_cache (), _colide_bvh (),
+			  _colide_version (~0u)
 		{
 			transform_cache_resize (1);
 			// index 0 is reserved for global coordinates transformations
@@ -69,6 +200,18 @@ namespace goptical
 			e->system_register (this);
 		}
 
+		void
+		System::remove (const std::shared_ptr<Element> &e)
+		{
+			if (e->_system != this)
+			{
+				throw Error ("Element is not part of the system");
+			}
+			Container::remove (e);
+			e->system_unregister ();
+			update_version ();
+		}
+
 		void
 		System::set_environment (const std::shared_ptr<material::Base> &env)
 		{
@@ -249,39 +392,199 @@ namespace goptical
 			return *res;
 		}
 
-		/** FIXME write an optimized version of this function which uses
-		    some kind of data structure (bsp tree?) */
+		const colide_bvh_s &
+		System::colide_bvh_get () const
+		{
+			if (_colide_version.load (std::memory_order_acquire) == _version)
+			{
+				return *_colide_bvh;
+			}
+			std::lock_guard<std::mutex> lock (_colide_lock);
+			if (_colide_version.load (std::memory_order_relaxed) == _version)
+			{
+				return *_colide_bvh;
+			}
+			std::unique_ptr<colide_bvh_s> bvh (new colide_bvh_s);
+			bvh->_global.resize (_e_count);
+			bvh->_local.resize (_e_count);
+			for (unsigned int i = 1; i <= get_element_count (); i++)
+			{
+				Element *j = _index_map[i];
+				if (!j)
+				{
+					continue;
+				}
+				bvh->_global[j->id ()] = get_global_transform (*j);
+				bvh->_local[j->id ()] = get_local_transform (*j);
+				Surface *s = dynamic_cast<Surface *> (j);
+				if (!s || !j->is_enabled ())
+				{
+					continue;
+				}
+				colide_bvh_s::item_s item;
+				item._surface = s;
+				item._index = i;
+				math::VectorPair3 box;
+				if (!s->get_intersect_bounding_box (box))
+				{
+					bvh->_unbounded.push_back (item);
+					continue;
+				}
+				// global axis aligned box of local box corners
+				const math::Transform<3> &t = bvh->_global[j->id ()];
+				for (unsigned int c = 0; c < 8; c++)
+				{
+					math::Vector3 p (t.transform (math::Vector3 (box[c & 1].x (),
+					                              box[(c >> 1) & 1].y (),
+					                              box[c >> 2].z ())));
+					if (c == 0)
+					{
+						item._box = math::VectorPair3 (p, p);
+					}
+					else
+					{
+						colide_box_merge (item._box, math::VectorPair3 (p, p));
+					}
+				}
+				// enlarge box to cover rounding errors on intersection points
+				double m = 0.0;
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					m = std::max (m, std::max (fabs (item._box[0][k]), fabs (item._box[1][k])));
+				}
+				double pad = m * 1e-6 + 1e-9;
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					item._box[0][k] -= pad;
+					item._box[1][k] += pad;
+				}
+				item._center = (item._box[0] + item._box[1]) * 0.5;
+				bvh->_items.push_back (item);
+			}
+			if (!bvh->_items.empty ())
+			{
+				bvh->build (0, bvh->_items.size ());
+			}
+			_colide_bvh = std::move (bvh);
+			_colide_version.store (_version, std::memory_order_release);
+			return *_colide_bvh;
+		}
+
 		Surface *
 		System::colide_next (const trace::Params &params, math::VectorPair3 &intersect,
 		                     const trace::Ray &ray) const
 		{
 			const Element *origin = ray.get_creator ();
-			// test all elements and keep closest intersection
-			Surface *s, *e = 0;
+			const colide_bvh_s &bvh = colide_bvh_get ();
+			// ray is moved to global coordinates once, then to each
+			// candidate surface local coordinates. Rays created by an
+			// element which is not part of the system use its transform
+			// relative to global coordinates
+			math::VectorPair3 g (origin->get_system () == this
+			                     ? bvh._global[origin->id ()].transform_line (ray)
+			                     : origin->get_transform ().transform_line (ray));
+			// test surfaces and keep closest intersection, lowest element
+			// index wins on equal distances
+			Surface *e = 0;
+			unsigned int e_index = 0;
 			math::VectorPair3 inter;
 			double min_dist = std::numeric_limits<double>::max ();
-			for (unsigned int i = 1; i <= get_element_count (); i++)
+			auto test = [&] (Surface * s, unsigned int index)
+			{
+				if (s == origin)
+				{
+					return;
+				}
+				math::VectorPair3 local (bvh._local[s->id ()].transform_line (g));
+				if (s->intersect (params, inter, local))
+				{
+					double dist = (inter.origin () - local.origin ()).len ();
+					if (min_dist > dist || (min_dist == dist && index < e_index))
+					{
+						min_dist = dist;
+						intersect = inter;
+						e = s;
+						e_index = index;
+					}
+				}
+			};
+			if (params.get_unobstructed ())
 			{
-				Element *j = &get_element (i);
-				if (j == origin || !j->is_enabled ())
+				// intersection points are not bounded by surfaces shapes
+				for (unsigned int i = 1; i <= get_element_count (); i++)
+				{
+					Element *j = &get_element (i);
+					if (j == origin || !j->is_enabled ())
+					{
+						continue;
+					}
+					if (Surface *s = dynamic_cast<Surface *> (j))
+					{
+						test (s, i);
+					}
+				}
+				return e;
+			}
+for (auto &i : bvh._unbounded)
+			{
+				test (i._surface, i._index);
+			}
+			if (bvh._nodes.empty ())
+			{
+				return e;
+			}
+			double dlen = g.direction ().len ();
+			// depth first traversal, nearest child first
+			std::pair<unsigned int, double> stack[64];
+			unsigned int sp = 0;
+			double tmin;
+			if (colide_box_enter (bvh._nodes[0]._box, g, tmin))
+			{
+				stack[sp++] = std::make_pair (0u, tmin);
+			}
+			while (sp)
+			{
+				sp--;
+				const colide_bvh_s::node_s &n = bvh._nodes[stack[sp].first];
+				// skip boxes behind closest intersection found so far
+				if (stack[sp].second * dlen > min_dist + 1e-9 * (min_dist + 1.0))
 				{
 					continue;
 				}
-				if ((s = dynamic_cast<Surface *> (j)))
+				if (n._count)
 				{
-					const math::Transform<3> &t = origin->get_transform_to (*s);
-					math::VectorPair3 local (t.transform_line (ray));
-					if (s->intersect (params, inter, local))
+					for (unsigned int i = n._next; i < n._next + n._count; i++)
 					{
-						double dist = (inter.origin () - local.origin ()).len ();
-						if (min_dist > dist)
-						{
-							min_dist = dist;
-							intersect = inter;
-							e = s;
-						}
+						test (bvh._items[i]._surface, bvh._items[i]._index);
 					}
+					continue;
+				}
+				unsigned int c[2] = { stack[sp].first + 1, n._next };
+				double t[2];
+				bool hit[2];
+				for (unsigned int k = 0; k < 2; k++)
+				{
+					hit[k] = colide_box_enter (bvh._nodes[c[k]]._box, g, t[k]);
 				}
+				if (hit[0] && hit[1] && t[1] > t[0])
+				{
+					std::swap (c[0], c[1]);
+					std::swap (t[0], t[1]);
+				}
+				else if (!hit[0])
+				{
+					c[0] = c[1];
+					t[0] = t[1];
+					hit[0] = hit[1];
+					hit[1] = false;
+				}
+				// push farthest child first
+				for (unsigned int k = 0; k < 2; k++)
+					if (hit[k])
+					{
+						assert (sp < 64);
+						stack[sp++] = std::make_pair (c[k], t[k]);
+					}
 			}
 			return e;
 		}
@@ -0,0 +1,63 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <goptical/core/material/base.hpp>
+#include <goptical/core/sys/optical_surface.hpp>
+#include <goptical/core/sys/system.hpp>
+#include <goptical/core/trace/index_table.hpp>
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		const unsigned int IndexTable::none;
+
+		IndexTable::IndexTable (const sys::System &system,
+		                        const std::set<double> &wavelengths)
+			: _wavelengths (wavelengths.begin (), wavelengths.end ()), _offsets (),
+			  _ratios ()
+		{
+			system.get_elements<sys::OpticalSurface> (
+			    [&] (const sys::OpticalSurface &s)
+			{
+				unsigned int id = s.id ();
+				if (id >= _offsets.size ())
+				{
+					_offsets.resize (id + 1, none);
+				}
+				_offsets[id] = _ratios.size ();
+				for (unsigned int j = 0; j < 2; j++)
+for (auto wl : _wavelengths)
+					{
+						_ratios.push_back (s.get_material (j).get_refractive_index (wl)
+						                   / s.get_material (!j).get_refractive_index (wl));
+					}
+			});
+		}
+
+	}
+
+}
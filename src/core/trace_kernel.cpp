@@ -0,0 +1,139 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <typeinfo>
+
+#include <goptical/core/curve/conic.hpp>
+#include <goptical/core/curve/flat.hpp>
+#include <goptical/core/curve/sphere.hpp>
+#include <goptical/core/shape/disk.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
+
+#include "trace_kernel_.hxx"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		static_assert ((int)KernelRefractionFeder == (int)RefractionFeder
+		               && (int)KernelRefractionDeGreve == (int)RefractionDeGreve,
+		               "kernel refraction law values mismatch");
+
+		static const kernel_isa_s &
+		kernel_select ()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_cpu_init ();
+			if (__builtin_cpu_supports ("avx512f"))
+			{
+				return kernel_avx512;
+			}
+			if (__builtin_cpu_supports ("avx2"))
+			{
+				return kernel_avx2;
+			}
+#endif
+			return kernel_generic;
+		}
+
+		const kernel_isa_s &
+		kernel_get ()
+		{
+			static const kernel_isa_s &isa = kernel_select ();
+			return isa;
+		}
+
+		bool
+		kernel_surface_setup (kernel_surface_s &s, const curve::Base &curve,
+		                      const shape::Base *shape)
+		{
+			// exact types only, derived classes may change behavior
+			const std::type_info &ct = typeid (curve);
+			if (ct == typeid (curve::Flat))
+			{
+				s._curve = KernelCurveFlat;
+				s._roc = 0.0;
+				s._sh = 0.0;
+			}
+			else if (ct == typeid (curve::Sphere) || ct == typeid (curve::Conic))
+			{
+				const curve::ConicBase &c = static_cast<const curve::ConicBase &> (curve);
+				s._curve = ct == typeid (curve::Sphere) ? KernelCurveSphere
+				           : KernelCurveConic;
+				s._roc = c.get_roc ();
+				s._sh = c.get_sh ();
+			}
+			else
+			{
+				return false;
+			}
+			if (!shape)
+			{
+				s._aperture = KernelApertureNone;
+				s._radius = 0.0;
+			}
+			else if (typeid (*shape) == typeid (shape::Disk))
+			{
+				s._aperture = KernelApertureDisk;
+				s._radius = static_cast<const shape::Disk *> (shape)->get_radius ();
+			}
+			else
+			{
+				return false;
+			}
+			return true;
+		}
+
+		void
+		kernel_intersect (const kernel_surface_s &s, RayBatch &batch)
+		{
+			kernel_rays_s r;
+			r._o[0] = batch.get_data (RayBatch::OriginX);
+			r._o[1] = batch.get_data (RayBatch::OriginY);
+			r._o[2] = batch.get_data (RayBatch::OriginZ);
+			r._d[0] = batch.get_data (RayBatch::DirectionX);
+			r._d[1] = batch.get_data (RayBatch::DirectionY);
+			r._d[2] = batch.get_data (RayBatch::DirectionZ);
+			r._n[0] = batch.get_data (RayBatch::NormalX);
+			r._n[1] = batch.get_data (RayBatch::NormalY);
+			r._n[2] = batch.get_data (RayBatch::NormalZ);
+			r._len = batch.get_data (RayBatch::Length);
+			r._state = batch.get_state_data ();
+			r._active = RayBatch::StateActive;
+			r._lost = RayBatch::StateLost;
+			unsigned int i = kernel_get ()._intersect (s, r, 0, batch.size ());
+			// remaining rays which do not fill a pack
+			kernel_generic._intersect (s, r, i, batch.size ());
+		}
+
+		void
+		kernel_refract (kernel_refract_s &r, unsigned int count)
+		{
+			unsigned int i = kernel_get ()._refract (r, 0, count);
+			kernel_generic._refract (r, i, count);
+		}
+	}
+}
@@ -0,0 +1,156 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#ifndef GOPTICAL_TRACE_KERNEL_HXX_
+#define GOPTICAL_TRACE_KERNEL_HXX_
+
+/*
+  Ray batch processing kernels for common surfaces.
+
+  Kernels work on raw arrays so that they can be compiled for
+  different instruction sets. Per instruction set translation units
+  must not include other library headers, inline functions from
+  those headers would be compiled with instructions which may not be
+  available on the host cpu.
+
+  Kernels perform the same floating point operations in the same
+  order as the ray by ray code, results are bitwise identical.
+*/
+
+namespace goptical
+{
+
+	namespace curve
+	{
+		class Base;
+	}
+
+	namespace shape
+	{
+		class Base;
+	}
+
+	namespace trace
+	{
+		class RayBatch;
+
+		enum kernel_curve_e
+		{
+		    KernelCurveFlat,
+		    KernelCurveSphere,
+		    KernelCurveConic,
+		};
+
+		enum kernel_aperture_e
+		{
+		    /** no aperture test */
+		    KernelApertureNone,
+		    /** disk shape, ray must be inside radius */
+		    KernelApertureDisk,
+		    /** stop external radius, ray must be strictly inside radius */
+		    KernelApertureExternal,
+		};
+
+		/** surface description */
+		struct kernel_surface_s
+		{
+			kernel_curve_e _curve;
+			double _roc;
+			double _sh;
+			kernel_aperture_e _aperture;
+			double _radius;
+		};
+
+		/** rays arrays, see trace::RayBatch */
+		struct kernel_rays_s
+		{
+			double *_o[3];
+			double *_d[3];
+			double *_n[3];
+			double *_len;
+			unsigned char *_state;
+			unsigned char _active;
+			unsigned char _lost;
+		};
+
+		enum kernel_action_e
+		{
+		    KernelActionNone,
+		    KernelActionRefract,
+		    KernelActionReflect,
+		};
+
+		/** same values as trace::RefractionLaw */
+		enum kernel_refraction_e
+		{
+		    KernelRefractionFeder,
+		    KernelRefractionDeGreve,
+		};
+
+		/** refraction input, refract action is changed to reflect
+		    action on total internal reflection */
+		struct kernel_refract_s
+		{
+			kernel_refraction_e _law;
+			double *_d[3];
+			const double *_n[3];
+			const double *_index;
+			unsigned char *_action;
+		};
+
+		/** Instruction set specific kernels, process rays in [begin, end)
+		    range by packs and return index of first unprocessed ray. */
+		struct kernel_isa_s
+		{
+			const char *_name;
+			unsigned int (*_intersect) (const kernel_surface_s &s, kernel_rays_s &r,
+			                            unsigned int begin, unsigned int end);
+			unsigned int (*_refract) (kernel_refract_s &r, unsigned int begin,
+			                          unsigned int end);
+		};
+
+		extern const kernel_isa_s kernel_generic;
+#if defined(__x86_64__) || defined(__i386__)
+		extern const kernel_isa_s kernel_avx2;
+		extern const kernel_isa_s kernel_avx512;
+#endif
+
+		/** Get kernels best suited to host cpu */
+		const kernel_isa_s &kernel_get ();
+
+		/** Setup surface description, return false if no kernel is
+		    available for the curve and shape. Shape may be null if no
+		    aperture test is needed. */
+		bool kernel_surface_setup (kernel_surface_s &s, const curve::Base &curve,
+		                           const shape::Base *shape);
+
+		/** Intersect active rays of batch with surface */
+		void kernel_intersect (const kernel_surface_s &s, RayBatch &batch);
+
+		/** Compute refracted or reflected directions */
+		void kernel_refract (kernel_refract_s &r, unsigned int count);
+	}
+}
+
+#endif
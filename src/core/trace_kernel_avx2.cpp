@@ -0,0 +1,140 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+  This file is compiled for the AVX2 instruction set, it must not
+  include library headers, see trace_kernel_.hxx. Kernels are only
+  used when the host cpu supports AVX2.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* Contracting to fused multiply add would change results compared
+   to the ray by ray code. */
+#if defined(__clang__)
+# pragma clang attribute push (__attribute__ ((target ("avx2"))), apply_to = function)
+# pragma clang fp contract (off)
+#else
+# pragma GCC push_options
+# pragma GCC target ("avx2")
+# pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include <immintrin.h>
+
+#include "trace_kernel_impl_.hxx"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		namespace
+		{
+
+			/** 4 lanes AVX2 pack */
+			struct pack_avx2_s
+			{
+				typedef __m256d vec;
+				typedef __m256d mask;
+				static const unsigned int width = 4;
+
+				static inline vec load (const double *p)
+				{
+					return _mm256_loadu_pd (p);
+				}
+				static inline void store (double *p, vec v)
+				{
+					_mm256_storeu_pd (p, v);
+				}
+				static inline vec set1 (double x)
+				{
+					return _mm256_set1_pd (x);
+				}
+				static inline vec sqrt (vec x)
+				{
+					return _mm256_sqrt_pd (x);
+				}
+				static inline vec select (mask m, vec a, vec b)
+				{
+					return _mm256_blendv_pd (b, a, m);
+				}
+				static inline mask lt (vec a, vec b)
+				{
+					return _mm256_cmp_pd (a, b, _CMP_LT_OQ);
+				}
+				static inline mask le (vec a, vec b)
+				{
+					return _mm256_cmp_pd (a, b, _CMP_LE_OQ);
+				}
+				static inline mask gt (vec a, vec b)
+				{
+					return _mm256_cmp_pd (a, b, _CMP_GT_OQ);
+				}
+				static inline mask eq (vec a, vec b)
+				{
+					return _mm256_cmp_pd (a, b, _CMP_EQ_OQ);
+				}
+				static inline mask mand (mask a, mask b)
+				{
+					return _mm256_and_pd (a, b);
+				}
+				static inline mask mor (mask a, mask b)
+				{
+					return _mm256_or_pd (a, b);
+				}
+				static inline mask mnot (mask a)
+				{
+					return _mm256_xor_pd (a, _mm256_castsi256_pd (_mm256_set1_epi64x (-1)));
+				}
+				static inline unsigned int to_bits (mask m)
+				{
+					return _mm256_movemask_pd (m);
+				}
+				static inline mask from_bits (unsigned int bits)
+				{
+					const __m256i lanes = _mm256_setr_epi64x (1, 2, 4, 8);
+					__m256i b = _mm256_and_si256 (_mm256_set1_epi64x (bits), lanes);
+					return _mm256_castsi256_pd (_mm256_cmpeq_epi64 (b, lanes));
+				}
+			};
+		}
+
+		const kernel_isa_s kernel_avx2 =
+		{
+			"avx2",
+			kernel_intersect_<pack_avx2_s>,
+			kernel_refract_<pack_avx2_s>,
+		};
+	}
+}
+
+#if defined(__clang__)
+# pragma clang attribute pop
+#else
+# pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+  This file is compiled for the AVX-512 instruction set, it must not
+  include library headers, see trace_kernel_.hxx. Kernels are only
+  used when the host cpu supports AVX-512F.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* Contracting to fused multiply add would change results compared
+   to the ray by ray code. */
+#if defined(__clang__)
+# pragma clang attribute push (__attribute__ ((target ("avx512f"))), apply_to = function)
+# pragma clang fp contract (off)
+#else
+# pragma GCC push_options
+# pragma GCC target ("avx512f")
+# pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include <immintrin.h>
+
+#include "trace_kernel_impl_.hxx"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		namespace
+		{
+
+			/** 8 lanes AVX-512 pack */
+			struct pack_avx512_s
+			{
+				typedef __m512d vec;
+				typedef __mmask8 mask;
+				static const unsigned int width = 8;
+
+				static inline vec load (const double *p)
+				{
+					return _mm512_loadu_pd (p);
+				}
+				static inline void store (double *p, vec v)
+				{
+					_mm512_storeu_pd (p, v);
+				}
+				static inline vec set1 (double x)
+				{
+					return _mm512_set1_pd (x);
+				}
+				static inline vec sqrt (vec x)
+				{
+					// full mask form, avoids an undefined source operand
+					return _mm512_mask_sqrt_pd (x, (mask)-1, x);
+				}
+				static inline vec select (mask m, vec a, vec b)
+				{
+					return _mm512_mask_blend_pd (m, b, a);
+				}
+				static inline mask lt (vec a, vec b)
+				{
+					return _mm512_cmp_pd_mask (a, b, _CMP_LT_OQ);
+				}
+				static inline mask le (vec a, vec b)
+				{
+					return _mm512_cmp_pd_mask (a, b, _CMP_LE_OQ);
+				}
+				static inline mask gt (vec a, vec b)
+				{
+					return _mm512_cmp_pd_mask (a, b, _CMP_GT_OQ);
+				}
+				static inline mask eq (vec a, vec b)
+				{
+					return _mm512_cmp_pd_mask (a, b, _CMP_EQ_OQ);
+				}
+				static inline mask mand (mask a, mask b)
+				{
+					return a & b;
+				}
+				static inline mask mor (mask a, mask b)
+				{
+					return a | b;
+				}
+				static inline mask mnot (mask a)
+				{
+					return ~a;
+				}
+				static inline unsigned int to_bits (mask m)
+				{
+					return m;
+				}
+				static inline mask from_bits (unsigned int bits)
+				{
+					return bits;
+				}
+			};
+		}
+
+		const kernel_isa_s kernel_avx512 =
+		{
+			"avx512",
+			kernel_intersect_<pack_avx512_s>,
+			kernel_refract_<pack_avx512_s>,
+		};
+	}
+}
+
+#if defined(__clang__)
+# pragma clang attribute pop
+#else
+# pragma GCC pop_options
+#endif
+
+#endif
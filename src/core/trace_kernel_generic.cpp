@@ -0,0 +1,111 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <cmath>
+
+#include "trace_kernel_impl_.hxx"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		namespace
+		{
+
+			/** Portable single lane pack */
+			struct pack_generic_s
+			{
+				typedef double vec;
+				typedef bool mask;
+				static const unsigned int width = 1;
+
+				static inline vec load (const double *p)
+				{
+					return *p;
+				}
+				static inline void store (double *p, vec v)
+				{
+					*p = v;
+				}
+				static inline vec set1 (double x)
+				{
+					return x;
+				}
+				static inline vec sqrt (vec x)
+				{
+					return std::sqrt (x);
+				}
+				static inline vec select (mask m, vec a, vec b)
+				{
+					return m ? a : b;
+				}
+				static inline mask lt (vec a, vec b)
+				{
+					return a < b;
+				}
+				static inline mask le (vec a, vec b)
+				{
+					return a <= b;
+				}
+				static inline mask gt (vec a, vec b)
+				{
+					return a > b;
+				}
+				static inline mask eq (vec a, vec b)
+				{
+					return a == b;
+				}
+				static inline mask mand (mask a, mask b)
+				{
+					return a && b;
+				}
+				static inline mask mor (mask a, mask b)
+				{
+					return a || b;
+				}
+				static inline mask mnot (mask a)
+				{
+					return !a;
+				}
+				static inline unsigned int to_bits (mask m)
+				{
+					return m;
+				}
+				static inline mask from_bits (unsigned int bits)
+				{
+					return bits & 1;
+				}
+			};
+		}
+
+		const kernel_isa_s kernel_generic =
+		{
+			"generic",
+			kernel_intersect_<pack_generic_s>,
+			kernel_refract_<pack_generic_s>,
+		};
+	}
+}
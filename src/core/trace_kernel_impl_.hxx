@@ -0,0 +1,306 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+  Ray batch kernels implementation, instantiated with an instruction
+  set specific pack class. Pack classes provide a vector type with
+  arithmetic operators and the following static functions:
+
+    load, store, set1, sqrt, select,
+    lt, le, gt, eq, mand, mor, mnot, to_bits, from_bits
+
+  Branches of the ray by ray code are replaced by lane selection,
+  operations order must be kept unchanged.
+*/
+
+#include "trace_kernel_.hxx"
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		namespace
+		{
+
+			template <class P>
+			inline unsigned int
+			kernel_state_bits (const unsigned char *state, unsigned char value)
+			{
+				unsigned int bits = 0;
+				for (unsigned int k = 0; k < P::width; k++)
+				{
+					bits |= (unsigned int)(state[k] == value) << k;
+				}
+				return bits;
+			}
+
+			template <class P>
+			unsigned int
+			kernel_intersect_ (const kernel_surface_s &s, kernel_rays_s &r,
+			                   unsigned int begin, unsigned int end)
+			{
+				typedef typename P::vec vec;
+				typedef typename P::mask mask;
+				const vec zero = P::set1 (0.0);
+				const vec one = P::set1 (1.0);
+				const vec two = P::set1 (2.0);
+				const vec four = P::set1 (4.0);
+				const vec roc = P::set1 (s._roc);
+				const vec sh = P::set1 (s._sh);
+				const vec radius = P::set1 (s._radius);
+				const vec radius2 = P::set1 (s._radius * s._radius);
+				unsigned int i;
+				for (i = begin; i + P::width <= end; i += P::width)
+				{
+					unsigned int active = kernel_state_bits<P> (r._state + i, r._active);
+					if (!active)
+					{
+						continue;
+					}
+					const vec ax = P::load (r._o[0] + i);
+					const vec ay = P::load (r._o[1] + i);
+					const vec az = P::load (r._o[2] + i);
+					const vec bx = P::load (r._d[0] + i);
+					const vec by = P::load (r._d[1] + i);
+					const vec bz = P::load (r._d[2] + i);
+					vec t;
+					mask hit;
+					// curve intersection, see curve::*::intersect
+					switch (s._curve)
+					{
+						case KernelCurveFlat:
+						{
+							t = -az / bz;
+							hit = P::mand (P::mnot (P::eq (bz, zero)),
+							               P::mnot (P::lt (t, zero)));
+							break;
+						}
+						case KernelCurveSphere:
+						{
+							vec d = az - roc;
+							vec ay_by = ay * by;
+							vec ax_bx = ax * bx;
+							vec q = roc * roc + two * (ax_bx + ay_by) * bz * d
+							        + two * ax_bx * ay_by - (ay * bx) * (ay * bx)
+							        - (ax * by) * (ax * by) - (bx * bx + by * by) * (d * d)
+							        - (ax * ax + ay * ay) * (bz * bz);
+							hit = P::mnot (P::lt (q, zero));
+							q = P::sqrt (q);
+							q = P::select (P::gt (roc * bz, zero), -q, q);
+							t = q - (bz * d + ax_bx + ay_by);
+							hit = P::mand (hit, P::mnot (P::le (t, zero)));
+							break;
+						}
+						case KernelCurveConic:
+						{
+							vec a = sh * (bz * bz) + by * by + bx * bx;
+							vec b = ((sh * bz * az + by * ay + bx * ax) / roc - bz) * two;
+							vec c = (sh * (az * az) + ay * ay + ax * ax) / roc - two * az;
+							vec d = b * b - four * a * c / roc;
+							vec q = P::sqrt (d);
+							q = P::select (P::lt (a * bz, zero), -q, q);
+							if (s._sh < 0)
+							{
+								q = -q;
+							}
+							mask linear = P::eq (a, zero);
+							t = P::select (linear, -c / b, (two * c) / (q - b));
+							hit = P::mand (P::mor (linear, P::mnot (P::lt (d, zero))),
+							               P::mnot (P::le (t, zero)));
+							break;
+						}
+						default:
+							return begin;
+					}
+					const vec px = ax + t * bx;
+					const vec py = ay + t * by;
+					const vec pz = az + t * bz;
+					// aperture test, see shape::DiskBase::inside and sys::Stop
+					switch (s._aperture)
+					{
+						case KernelApertureNone:
+							break;
+						case KernelApertureDisk:
+							hit = P::mand (hit, P::le (px * px + py * py, radius2));
+							break;
+						case KernelApertureExternal:
+							hit = P::mand (hit, P::lt (P::sqrt (zero + px * px + py * py),
+							                           radius));
+							break;
+					}
+					// surface normal, see curve::*::normal
+					vec nx, ny, nz;
+					switch (s._curve)
+					{
+						case KernelCurveFlat:
+						{
+							nx = zero;
+							ny = zero;
+							nz = -one;
+							break;
+						}
+						case KernelCurveSphere:
+						{
+							nx = px;
+							ny = py;
+							nz = pz - roc;
+							vec l = P::sqrt (zero + nx * nx + ny * ny + nz * nz);
+							nx = nx / l;
+							ny = ny / l;
+							nz = nz / l;
+							if (s._roc < 0)
+							{
+								nx = -nx;
+								ny = -ny;
+								nz = -nz;
+							}
+							break;
+						}
+						case KernelCurveConic:
+						{
+							vec rr = P::sqrt (px * px + py * py);
+							vec s2 = sh * (rr * rr);
+							vec s3 = P::sqrt (one - s2 / (roc * roc));
+							vec s4 = two / (roc * (s3 + one))
+							         + s2 / (roc * roc * roc * s3 * ((s3 + one) * (s3 + one)));
+							vec p = rr * s4;
+							nx = px * p / rr;
+							ny = py * p / rr;
+							nz = -one;
+							vec l = P::sqrt (zero + nx * nx + ny * ny + nz * nz);
+							mask axis = P::eq (rr, zero);
+							nx = P::select (axis, zero, nx / l);
+							ny = P::select (axis, zero, ny / l);
+							nz = P::select (axis, -one, nz / l);
+							break;
+						}
+						default:
+							return begin;
+					}
+					mask back = P::lt (bz, zero);
+					nx = P::select (back, -nx, nx);
+					ny = P::select (back, -ny, ny);
+					nz = P::select (back, -nz, nz);
+					const vec lx = px - ax;
+					const vec ly = py - ay;
+					const vec lz = pz - az;
+					const vec len = P::sqrt (zero + lx * lx + ly * ly + lz * lz);
+					const mask ok = P::mand (hit, P::from_bits (active));
+					P::store (r._o[0] + i, P::select (ok, px, ax));
+					P::store (r._o[1] + i, P::select (ok, py, ay));
+					P::store (r._o[2] + i, P::select (ok, pz, az));
+					P::store (r._n[0] + i, P::select (ok, nx, P::load (r._n[0] + i)));
+					P::store (r._n[1] + i, P::select (ok, ny, P::load (r._n[1] + i)));
+					P::store (r._n[2] + i, P::select (ok, nz, P::load (r._n[2] + i)));
+					P::store (r._len + i, P::select (ok, len, P::load (r._len + i)));
+					unsigned int lost = active & ~P::to_bits (hit);
+					for (unsigned int k = 0; lost; k++, lost >>= 1)
+						if (lost & 1)
+						{
+							r._state[i + k] = r._lost;
+						}
+				}
+				return i;
+			}
+
+			template <class P>
+			unsigned int
+			kernel_refract_ (kernel_refract_s &r, unsigned int begin, unsigned int end)
+			{
+				typedef typename P::vec vec;
+				typedef typename P::mask mask;
+				const vec zero = P::set1 (0.0);
+				const vec one = P::set1 (1.0);
+				const vec two = P::set1 (2.0);
+				unsigned int i;
+				for (i = begin; i + P::width <= end; i += P::width)
+				{
+					unsigned int refract
+					    = kernel_state_bits<P> (r._action + i, KernelActionRefract);
+					unsigned int reflect
+					    = kernel_state_bits<P> (r._action + i, KernelActionReflect);
+					if (!(refract | reflect))
+					{
+						continue;
+					}
+					const vec dx = P::load (r._d[0] + i);
+					const vec dy = P::load (r._d[1] + i);
+					const vec dz = P::load (r._d[2] + i);
+					const vec nx = P::load (r._n[0] + i);
+					const vec ny = P::load (r._n[1] + i);
+					const vec nz = P::load (r._n[2] + i);
+					const vec mu = P::load (r._index + i);
+					// see sys::OpticalSurface::refract and reflect
+					vec cosi = zero + nx * dx + ny * dy + nz * dz;
+					vec sint2 = (mu * mu) * (one - cosi * cosi);
+					mask tir = P::gt (sint2, one);
+					vec c2 = two * cosi;
+					vec rx = dx - c2 * nx;
+					vec ry = dy - c2 * ny;
+					vec rz = dz - c2 * nz;
+					vec tx, ty, tz;
+					if (r._law == KernelRefractionFeder)
+					{
+						// Feder refraction formula
+						vec Nx = -nx;
+						vec Ny = -ny;
+						vec Nz = -nz;
+						vec O2 = zero + Nx * Nx + Ny * Ny + Nz * Nz;
+						vec E1 = zero + dx * Nx + dy * Ny + dz * Nz;
+						vec E1_ = P::sqrt (O2 * (one - mu * mu) + mu * mu * E1 * E1);
+						vec g1 = (E1_ - mu * E1) / O2;
+						tx = mu * dx + g1 * Nx;
+						ty = mu * dy + g1 * Ny;
+						tz = mu * dz + g1 * Nz;
+						// no direction, handled as total internal reflection
+						tir = P::mor (tir, P::mnot (P::eq (E1_, E1_)));
+					}
+					else
+					{
+						// vector form of Snell law
+						vec g = mu * cosi + P::sqrt (one - sint2);
+						tx = dx * mu - g * nx;
+						ty = dy * mu - g * ny;
+						tz = dz * mu - g * nz;
+					}
+					mask mrefract = P::from_bits (refract);
+					mask transmit = P::mand (mrefract, P::mnot (tir));
+					mask mirror = P::mor (P::from_bits (reflect), P::mand (mrefract, tir));
+					P::store (r._d[0] + i, P::select (transmit, tx, P::select (mirror, rx, dx)));
+					P::store (r._d[1] + i, P::select (transmit, ty, P::select (mirror, ry, dy)));
+					P::store (r._d[2] + i, P::select (transmit, tz, P::select (mirror, rz, dz)));
+					unsigned int total = refract & P::to_bits (tir);
+					for (unsigned int k = 0; total; k++, total >>= 1)
+						if (total & 1)
+						{
+							r._action[i + k] = KernelActionReflect;
+						}
+				}
+				return i;
+			}
+		}
+	}
+}
@@ -0,0 +1,440 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <typeinfo>
+
+#include <goptical/core/error.hpp>
+
+#include <goptical/core/curve/conic.hpp>
+#include <goptical/core/curve/flat.hpp>
+#include <goptical/core/curve/sphere.hpp>
+#include <goptical/core/material/base.hpp>
+#include <goptical/core/shape/disk.hpp>
+#include <goptical/core/shape/rectangle.hpp>
+
+#include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/mirror.hpp>
+#include <goptical/core/sys/optical_surface.hpp>
+#include <goptical/core/sys/source.hpp>
+#include <goptical/core/sys/stop.hpp>
+#include <goptical/core/sys/system.hpp>
+
+#include <goptical/core/trace/index_table.hpp>
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/plan.hpp>
+#include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/result.hpp>
+#include <goptical/core/trace/sequence.hpp>
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		Plan::Plan (const Sequence &seq)
+			: _system (0), _version (0), _sequence (), _records (), _complete (true)
+		{
+			const sys::Element *prev = 0;
+for (auto &i : seq._list)
+			{
+				const sys::Element *e = i.get ();
+				_sequence.push_back (e);
+				if (!_system)
+				{
+					_system = e->get_system ();
+					_version = _system ? _system->get_version () : 0;
+				}
+				if (!e->is_enabled ())
+				{
+					continue;
+				}
+				if (!_system || e->get_system () != _system)
+				{
+					_complete = false;
+					continue;
+				}
+				record_s r = record_s ();
+				r._transform.reset ();
+				r._element = e;
+				r._prev = prev;
+				prev = e;
+				if (dynamic_cast<const sys::Source *> (e))
+				{
+					r._kind = RecordSource;
+					_records.push_back (r);
+					continue;
+				}
+				// exact types only, derived classes may change behavior
+				const std::type_info &et = typeid (*e);
+				if (et == typeid (sys::OpticalSurface) || et == typeid (sys::Mirror))
+				{
+					r._kind = RecordOptical;
+				}
+				else if (et == typeid (sys::Stop))
+				{
+					r._kind = RecordStop;
+				}
+				else if (et == typeid (sys::Image))
+				{
+					r._kind = RecordImage;
+				}
+				else
+				{
+					_complete = false;
+					continue;
+				}
+				const sys::Surface *s = static_cast<const sys::Surface *> (e);
+				r._curve = &s->get_curve ();
+				const std::type_info &ct = typeid (*r._curve);
+				r._curve_kind = ct == typeid (curve::Flat)     ? CurveFlat
+				                : ct == typeid (curve::Sphere) ? CurveSphere
+				                : ct == typeid (curve::Conic)  ? CurveConic
+				                : CurveOther;
+				r._shape = &s->get_shape ();
+				const std::type_info &st = typeid (*r._shape);
+				r._aperture_kind = st == typeid (shape::Disk)        ? ApertureDisk
+				                   : st == typeid (shape::Rectangle) ? ApertureRectangle
+				                   : ApertureOther;
+				r._shape_version = r._shape->get_version ();
+				r._aperture_radius
+				    = r._aperture_kind == ApertureDisk
+				      ? static_cast<const shape::Disk *> (r._shape)->get_radius ()
+				      : 0.0;
+				r._radius = r._kind == RecordStop
+				            ? static_cast<const sys::Stop *> (s)->get_external_radius ()
+				            : 0.0;
+				if (r._prev)
+				{
+					r._transform = r._prev->get_transform_to (*e);
+				}
+				if (r._kind == RecordOptical)
+				{
+					const sys::OpticalSurface *o
+					    = static_cast<const sys::OpticalSurface *> (s);
+					for (unsigned int j = 0; j < 2; j++)
+					{
+						r._mat[j] = &o->get_material (j);
+						r._opaque[j] = r._mat[j]->is_opaque ();
+						r._reflecting[j] = r._mat[j]->is_reflecting ();
+						// only a single outgoing ray is handled
+						if (!r._opaque[j] && r._reflecting[j])
+						{
+							_complete = false;
+						}
+					}
+				}
+				_records.push_back (r);
+			}
+		}
+
+		bool
+		Plan::is_valid (const Sequence &seq) const
+		{
+			if (!_system || _system->get_version () != _version
+			        || seq._list.size () != _sequence.size ())
+			{
+				return false;
+			}
+			for (unsigned int i = 0; i < _sequence.size (); i++)
+				if (seq._list[i].get () != _sequence[i])
+				{
+					return false;
+				}
+for (auto &r : _records)
+				if (r._shape && r._shape->get_version () != r._shape_version)
+				{
+					return false;
+				}
+			return true;
+		}
+
+		bool
+		Plan::curve_intersect (const record_s &r, math::Vector3 &point,
+		                       const math::VectorPair3 &ray) const
+		{
+			switch (r._curve_kind)
+			{
+				case CurveFlat:
+					return static_cast<const curve::Flat *> (r._curve)
+					       ->curve::Flat::intersect (point, ray);
+				case CurveSphere:
+					return static_cast<const curve::Sphere *> (r._curve)
+					       ->curve::Sphere::intersect (point, ray);
+				case CurveConic:
+					return static_cast<const curve::Conic *> (r._curve)
+					       ->curve::Conic::intersect (point, ray);
+				default:
+					return r._curve->intersect (point, ray);
+			}
+		}
+
+		void
+		Plan::curve_normal (const record_s &r, math::Vector3 &normal,
+		                    const math::Vector3 &point) const
+		{
+			switch (r._curve_kind)
+			{
+				case CurveFlat:
+					return static_cast<const curve::Flat *> (r._curve)
+					       ->curve::Flat::normal (normal, point);
+				case CurveSphere:
+					return static_cast<const curve::Sphere *> (r._curve)
+					       ->curve::Sphere::normal (normal, point);
+				case CurveConic:
+					return static_cast<const curve::Conic *> (r._curve)
+					       ->curve::Conic::normal (normal, point);
+				default:
+					return r._curve->normal (normal, point);
+			}
+		}
+
+		bool
+		Plan::shape_inside (const record_s &r, const math::Vector2 &point) const
+		{
+			switch (r._aperture_kind)
+			{
+				case ApertureDisk:
+					// same as shape::DiskBase::inside
+					return math::square (point.x ()) + math::square (point.y ())
+					       <= math::square (r._aperture_radius);
+				case ApertureRectangle:
+					return static_cast<const shape::Rectangle *> (r._shape)
+					       ->shape::Rectangle::inside (point);
+				default:
+					return r._shape->inside (point);
+			}
+		}
+
+		/* Rays objects are only allocated when some rays lists are saved,
+		   the ray is traced with local variables otherwise. Without
+		   genealogy, only rays which end up in a saved list are
+		   allocated, as flagged in the allocate array. Operations
+		   are the same as in Surface::process_rays_, Stop::process_rays_
+		   and OpticalSurface::trace_ray_simple. */
+		template <bool save>
+		void
+		Plan::trace_ray (Result &result, Ray &source, unsigned int first,
+		                 rays_queue_t *const *generated,
+		                 const char *allocate) const
+		{
+			const Params &params = result.get_params ();
+			const IndexTable *table = params.get_index_table ();
+			math::VectorPair3 ray (source);
+			const material::Base *material = source.get_material ();
+			const sys::Element *creator = source.get_creator ();
+			double wl = source.get_wavelen ();
+			double intensity = source.get_intensity ();
+			Ray *incident = &source;
+			// closest allocated ray, parent of next allocated ray
+			Ray *ancestor = &source;
+			unsigned int w = table ? table->get_wavelen_index (wl) : 0;
+			for (unsigned int k = first; k < _records.size (); k++)
+			{
+				const record_s &r = _records[k];
+				if (r._kind == RecordSource)
+				{
+					break;
+				}
+				const sys::Surface *surface = static_cast<const sys::Surface *> (r._element);
+				math::VectorPair3 local (
+				    creator == r._prev
+				    ? r._transform.transform_line (ray)
+				    : creator->get_transform_to (*surface, params).transform_line (ray));
+				math::VectorPair3 pt;
+				if (!curve_intersect (r, pt.origin (), local))
+				{
+					return;
+				}
+				math::Vector2 v (pt.origin ().project_xy ());
+				if (r._kind == RecordStop)
+				{
+					// same test as Stop::process_rays_
+					if (!(v.len () < r._radius))
+					{
+						return;
+					}
+				}
+				else if (!params.get_unobstructed () && !shape_inside (r, v))
+				{
+					return;
+				}
+				curve_normal (r, pt.normal (), pt.origin ());
+				if (local.direction ().z () < 0)
+				{
+					pt.normal () = -pt.normal ();
+				}
+				result.add_intercept_event (*surface, pt.origin (), local.direction (),
+				                            wl, 1.0);
+				if (save && incident)
+				{
+					result.add_intercepted (*surface, *incident);
+					incident->set_len ((pt.origin () - local.origin ()).len ());
+					incident->set_intercept (*surface, pt.origin ());
+					incident->set_intercept_intensity (1.0);
+				}
+				math::Vector3 direction;
+				switch (r._kind)
+				{
+					case RecordStop:
+						// reemit incident ray
+						if (!shape_inside (r, v))
+						{
+							return;
+						}
+						direction = ray.direction ();
+						break;
+					case RecordOptical:
+					{
+						const sys::OpticalSurface *o
+						    = static_cast<const sys::OpticalSurface *> (surface);
+						bool right_to_left = pt.normal ().z () > 0;
+						const material::Base *prev_mat = r._mat[right_to_left];
+						const material::Base *next_mat = r._mat[!right_to_left];
+						// check ray didn't "escaped" from its material
+						if (prev_mat != material)
+						{
+							return;
+						}
+						double index;
+						if (!table || !table->get_index_ratio (*o, right_to_left, w, index))
+						{
+							index = prev_mat->get_refractive_index (wl)
+							        / next_mat->get_refractive_index (wl);
+						}
+						if (!o->refract (params, local, direction, pt.normal (), index))
+						{
+							// total internal reflection
+							o->reflect (local, direction, pt.normal ());
+						}
+						else if (!r._opaque[!right_to_left])
+						{
+							// transmit
+							material = next_mat;
+						}
+						else if (r._reflecting[!right_to_left])
+						{
+							o->reflect (local, direction, pt.normal ());
+						}
+						else
+						{
+							return;
+						}
+						break;
+					}
+					default:
+						return;
+				}
+				ray.origin () = pt.origin ();
+				ray.direction () = direction;
+				creator = surface;
+				if (save && !allocate[k])
+				{
+					incident = 0;
+				}
+				else if (save)
+				{
+					Ray &n = result.new_ray ();
+					n.set_wavelen (wl);
+					n.set_intensity (intensity);
+					n.set_material (material);
+					n.origin () = ray.origin ();
+					n.direction () = ray.direction ();
+					n.set_creator (surface);
+					result.link_generated (*ancestor, n);
+					if (generated[k])
+					{
+						generated[k]->push_back (&n);
+					}
+					incident = &n;
+					ancestor = &n;
+				}
+			}
+		}
+
+		void
+		Plan::trace (Result &result, const rays_queue_t &input,
+		             const sys::Element &first) const
+		{
+			if (!_complete)
+			{
+				throw Error ("can not trace rays with incomplete plan");
+			}
+			unsigned int k;
+			for (k = 0; k < _records.size (); k++)
+				if (_records[k]._element == &first)
+				{
+					break;
+				}
+			if (k == _records.size ())
+			{
+				throw Error ("element not found in plan");
+			}
+			// only build the rays tree if some rays have to be saved, saved
+			// rays of any element may give access to rays tree
+			bool save = false;
+for (auto &er : result._elements)
+			{
+				save |= er._intercepted || er._generated;
+			}
+			std::vector<rays_queue_t *> generated (_records.size (), 0);
+			// rays generated by a record must be allocated when saved by
+			// this record or intercepted by the next one, all rays are
+			// allocated when the full rays tree is required
+			std::vector<char> allocate (_records.size (),
+			                            result._genealogy == GenealogyFull);
+			for (unsigned int i = k; i < _records.size (); i++)
+			{
+				Result::element_result_s &er
+				    = result.get_element_result (*_records[i]._element);
+				if (er._generated)
+				{
+					er._generated->clear ();
+					generated[i] = er._generated.get ();
+					allocate[i] = 1;
+				}
+				if (er._intercepted && i > k)
+				{
+					allocate[i - 1] = 1;
+				}
+			}
+			result._generated_queue = 0;
+for (auto ray : input)
+			{
+				if (save)
+				{
+					trace_ray<true> (result, *ray, k, generated.data (),
+					                 allocate.data ());
+				}
+				else
+				{
+					trace_ray<false> (result, *ray, k, generated.data (),
+					                 allocate.data ());
+				}
+			}
+		}
+
+	}
+
+}
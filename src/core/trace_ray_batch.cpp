@@ -0,0 +1,169 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		RayBatch::RayBatch ()
+			: _material (), _state (), _traced (), _frame (0), _result (0), _sink_result (0),
+			  _allocate (true), _traced_incident (true)
+		{
+		}
+
+		void
+		RayBatch::clear ()
+		{
+			for (unsigned int f = 0; f < FieldCount; f++)
+			{
+				_data[f].clear ();
+			}
+
+			_material.clear ();
+			_state.clear ();
+			_traced.clear ();
+			_frame = 0;
+			_traced_incident = true;
+		}
+
+		void
+		RayBatch::reserve (unsigned int count)
+		{
+			for (unsigned int f = 0; f < FieldCount; f++)
+			{
+				_data[f].reserve (count);
+			}
+
+			_material.reserve (count);
+			_state.reserve (count);
+			_traced.reserve (count);
+		}
+
+		unsigned int
+		RayBatch::add (const math::VectorPair3 &ray, double wavelen,
+		               double intensity, const material::Base *material)
+		{
+			unsigned int i = _state.size ();
+
+			_data[OriginX].push_back (ray.origin ().x ());
+			_data[OriginY].push_back (ray.origin ().y ());
+			_data[OriginZ].push_back (ray.origin ().z ());
+			_data[DirectionX].push_back (ray.direction ().x ());
+			_data[DirectionY].push_back (ray.direction ().y ());
+			_data[DirectionZ].push_back (ray.direction ().z ());
+			_data[NormalX].push_back (0.0);
+			_data[NormalY].push_back (0.0);
+			_data[NormalZ].push_back (0.0);
+			_data[Wavelen].push_back (wavelen);
+			_data[Intensity].push_back (intensity);
+			_data[Length].push_back (0.0);
+			_material.push_back (material);
+			_state.push_back (StateActive);
+			_traced.push_back (0);
+
+			return i;
+		}
+
+		unsigned int
+		RayBatch::add (Ray &ray)
+		{
+			if (!_frame)
+			{
+				_frame = ray.get_creator ();
+			}
+
+			unsigned int i = add (ray, ray.get_wavelen (), ray.get_intensity (),
+			                      ray.get_material ());
+			_traced[i] = &ray;
+
+			return i;
+		}
+
+		unsigned int
+		RayBatch::get_active_count () const
+		{
+			unsigned int count = 0;
+
+			for (unsigned int i = 0; i < _state.size (); i++)
+			{
+				count += _state[i] == StateActive;
+			}
+
+			return count;
+		}
+
+		void
+		RayBatch::transform (const math::Transform<3> &t)
+		{
+			const unsigned int count = size ();
+			const math::Vector3 &tr = t.get_translation ();
+			double *ox = get_data (OriginX);
+			double *oy = get_data (OriginY);
+			double *oz = get_data (OriginZ);
+
+			if (!t.has_linear ())
+			{
+				for (unsigned int i = 0; i < count; i++)
+				{
+					ox[i] += tr.x ();
+					oy[i] += tr.y ();
+					oz[i] += tr.z ();
+				}
+
+				return;
+			}
+
+			double *dx = get_data (DirectionX);
+			double *dy = get_data (DirectionY);
+			double *dz = get_data (DirectionZ);
+			const math::Matrix<3> &m = t.get_linear ();
+
+			// same summation order as matrix vector product, results
+			// must match the scalar ray trace bit for bit
+			const double m00 = m.value (0, 0), m01 = m.value (0, 1), m02 = m.value (0, 2);
+			const double m10 = m.value (1, 0), m11 = m.value (1, 1), m12 = m.value (1, 2);
+			const double m20 = m.value (2, 0), m21 = m.value (2, 1), m22 = m.value (2, 2);
+
+			for (unsigned int i = 0; i < count; i++)
+			{
+				double x = ox[i], y = oy[i], z = oz[i];
+
+				ox[i] = 0.0 + m00 * x + m01 * y + m02 * z + tr.x ();
+				oy[i] = 0.0 + m10 * x + m11 * y + m12 * z + tr.y ();
+				oz[i] = 0.0 + m20 * x + m21 * y + m22 * z + tr.z ();
+
+				x = dx[i], y = dy[i], z = dz[i];
+
+				dx[i] = 0.0 + m00 * x + m01 * y + m02 * z;
+				dy[i] = 0.0 + m10 * x + m11 * y + m12 * z;
+				dz[i] = 0.0 + m20 * x + m21 * y + m22 * z;
+			}
+		}
+	}
+}
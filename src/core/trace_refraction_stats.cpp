@@ -0,0 +1,86 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <goptical/core/trace/refraction_stats.hpp>
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		RefractionStats::RefractionStats ()
+			: _lock (), _tolerance (1e-14), _record_limit (16), _count (0),
+			  _mismatch_count (0), _max_error (0), _mismatches ()
+		{
+		}
+
+		void
+		RefractionStats::clear ()
+		{
+			std::lock_guard<std::mutex> lock (_lock);
+			_count = 0;
+			_mismatch_count = 0;
+			_max_error = 0;
+			_mismatches.clear ();
+		}
+
+		void
+		RefractionStats::add (const math::Vector3 &incident,
+		                      const math::Vector3 &normal, double index,
+		                      const math::Vector3 &selected,
+		                      const math::Vector3 &other)
+		{
+			// NaN components count as disagreement
+			double error = 0;
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				double e = fabs (selected[i] - other[i]);
+				if (!(e <= error))
+				{
+					error = e;
+				}
+			}
+			_count++;
+			double max = _max_error;
+			while (error > max && !_max_error.compare_exchange_weak (max, error))
+				;
+			if (!(error <= _tolerance))
+			{
+				_mismatch_count++;
+				std::lock_guard<std::mutex> lock (_lock);
+				if (_mismatches.size () < _record_limit)
+				{
+					Mismatch m;
+					m._incident = incident;
+					m._normal = normal;
+					m._index = index;
+					m._selected = selected;
+					m._other = other;
+					_mismatches.push_back (m);
+				}
+			}
+		}
+	}
+}
@@ -22,6 +22,8 @@
 
 */
 
+#include <algorithm>
+
 #include <goptical/core/sys/element.hpp>
 #include <goptical/core/sys/system.hpp>
 
@@ -41,13 +43,17 @@ namespace goptical
 
 		Result::Result ()
 			: _rays (), _elements (), _wavelengths (), _generated_queue (0),
-			  _sources (), _bounce_limit_count (0), _system (0)
+			  _sources (), _bounce_limit_count (0), _system (0), _params (0),
+			  _genealogy (GenealogyFull),
+			  _shards (), _shard_count (0), _memory_retention (false),
+			  _high_water_mark (0), _sample_first (0),
+			  _sample_end (std::numeric_limits<size_t>::max ())
 		{
 		}
 
 		Result::~Result ()
 		{
-			clear ();
+			release_memory ();
 		}
 
 		void
@@ -63,39 +69,244 @@ for (auto &i : _elements)
 		void
 		Result::clear ()
 		{
-for (auto &i : _elements)
+			_high_water_mark = get_ray_high_water_mark ();
+			if (_memory_retention)
 			{
-				if (i._intercepted)
+				// keep storage, pool reset is constant time for rays
+for (auto &i : _elements)
 				{
-					i._intercepted = nullptr;
+					if (i._intercepted)
+					{
+						i._intercepted->clear ();
+					}
+					if (i._generated)
+					{
+						i._generated->clear ();
+					}
+				}
+				_rays.clear ();
+				for (unsigned int i = 0; i < _shard_count; i++)
+				{
+					_shards[i]->clear ();
 				}
-				if (i._generated)
+				_shard_count = 0;
+			}
+			else
+			{
+for (auto &i : _elements)
 				{
+					i._intercepted = nullptr;
 					i._generated = nullptr;
 				}
+				_rays.clear ();
+				_rays.shrink ();
+				_shards.clear ();
+				_shard_count = 0;
 			}
-			_rays.clear (); // = vector_pool<Ray, 256>();
-			_rays.shrink ();
 			_sources.clear ();
 			_wavelengths.clear ();
 			_bounce_limit_count = 0;
 		}
 
+		void
+		Result::release_memory ()
+		{
+			bool retain = _memory_retention;
+			_memory_retention = false;
+			clear ();
+			_memory_retention = retain;
+			_high_water_mark = 0;
+		}
+
+		void
+		Result::merge (const std::shared_ptr<Result> &result,
+		               const std::function<bool (const Ray &)> &filter)
+		{
+			if (result->_system != _system)
+			{
+				throw Error ("trace::Result merged with result of an other system");
+			}
+			auto append = [&] (std::shared_ptr<rays_queue_t> &list, bool enabled,
+			                   const std::shared_ptr<rays_queue_t> &from)
+			{
+				if (!enabled)
+				{
+					return;
+				}
+				if (!list)
+				{
+					list = std::make_shared<rays_queue_t> ();
+				}
+				if (!from)
+				{
+					return;
+				}
+for (auto ray : *from)
+					if (filter (*ray))
+					{
+						list->push_back (ray);
+					}
+			};
+			const size_t count = std::min (_elements.size (), result->_elements.size ());
+			for (unsigned int i = 0; i < count; i++)
+			{
+				element_result_s &er = _elements[i];
+				const element_result_s &oer = result->_elements[i];
+				append (er._intercepted, er._save_intercepted_list, oer._intercepted);
+				append (er._generated, er._save_generated_list, oer._generated);
+			}
+			_wavelengths.insert (result->_wavelengths.begin (), result->_wavelengths.end ());
+			_bounce_limit_count += result->_bounce_limit_count;
+			_params = result->_params;
+			_genealogy = result->_genealogy;
+			// rays of merged result are released along with shards
+			_shards.insert (_shards.begin () + _shard_count++, result);
+		}
+
+		size_t
+		Result::get_ray_count () const
+		{
+			size_t count = _rays.size ();
+			for (unsigned int i = 0; i < _shard_count; i++)
+			{
+				count += _shards[i]->get_ray_count ();
+			}
+			return count;
+		}
+
+		size_t
+		Result::get_ray_capacity () const
+		{
+			size_t count = _rays.capacity ();
+for (auto &s : _shards)
+			{
+				count += s->get_ray_capacity ();
+			}
+			return count;
+		}
+
+		size_t
+		Result::get_ray_high_water_mark () const
+		{
+			return std::max (_high_water_mark, get_ray_count ());
+		}
+
+		void
+		Result::prepare_list (std::shared_ptr<rays_queue_t> &list, bool enabled)
+		{
+			if (!enabled)
+			{
+				list = nullptr;
+			}
+			else if (list && _memory_retention)
+			{
+				list->clear ();
+			}
+			else
+			{
+				list = std::make_shared<rays_queue_t> ();
+			}
+		}
+
 		void
 		Result::prepare ()
 		{
 			clear ();
 for (auto &i : _elements)
 			{
-				if (i._save_intercepted_list)
+				prepare_list (i._intercepted, i._save_intercepted_list);
+				prepare_list (i._generated, i._save_generated_list);
+				if (i._sink)
+				{
+					i._sink->clear ();
+				}
+			}
+		}
+
+		Result &
+		Result::new_shard (bool sinks)
+		{
+			if (_shard_count == _shards.size ())
+			{
+				_shards.push_back (std::make_shared<Result> ());
+			}
+			Result &shard = *_shards[_shard_count++];
+			shard._system = _system;
+			shard._params = _params;
+			shard._genealogy = _genealogy;
+			shard._memory_retention = _memory_retention;
+			shard._elements.resize (_elements.size ());
+			for (unsigned int i = 0; i < _elements.size (); i++)
+			{
+				element_result_s &er = shard._elements[i];
+				er._save_intercepted_list = _elements[i]._save_intercepted_list;
+				er._save_generated_list = _elements[i]._save_generated_list;
+				shard.prepare_list (er._intercepted, !!_elements[i]._intercepted);
+				shard.prepare_list (er._generated, !!_elements[i]._generated);
+				er._sink = sinks && _elements[i]._sink ? _elements[i]._sink->fork ()
+				           : std::shared_ptr<ResultSink> ();
+			}
+			shard._sample_first = _sample_first;
+			shard._sample_end = _sample_end;
+			return shard;
+		}
+
+		bool
+		Result::has_sinks () const
+		{
+for (auto &i : _elements)
+			{
+				if (i._sink)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool
+		Result::has_saved_lists () const
+		{
+for (auto &i : _elements)
+			{
+				if (i._intercepted || i._generated)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void
+		Result::merge_shard (Result &shard)
+		{
+			assert (shard._elements.size () == _elements.size ());
+			for (unsigned int i = 0; i < _elements.size (); i++)
+			{
+				element_result_s &er = _elements[i];
+				element_result_s &ser = shard._elements[i];
+				if (er._intercepted && ser._intercepted)
+				{
+					er._intercepted->insert (er._intercepted->end (),
+					                         ser._intercepted->begin (),
+					                         ser._intercepted->end ());
+					ser._intercepted->clear ();
+				}
+				if (er._generated && ser._generated)
 				{
-					i._intercepted = std::make_shared<rays_queue_t> ();
+					er._generated->insert (er._generated->end (),
+					                       ser._generated->begin (),
+					                       ser._generated->end ());
+					ser._generated->clear ();
 				}
-				if (i._save_generated_list)
+				if (er._sink && ser._sink)
 				{
-					i._generated = std::make_shared<rays_queue_t> ();
+					er._sink->merge (*ser._sink);
+					ser._sink->clear ();
 				}
 			}
+			_wavelengths.insert (shard._wavelengths.begin (), shard._wavelengths.end ());
+			_bounce_limit_count += shard._bounce_limit_count;
 		}
 
 		void
@@ -134,6 +345,20 @@ for (auto &i : _elements)
 			get_element_result (e)._save_generated_list = enabled;
 		}
 
+		void
+		Result::set_intercept_sink (const sys::Surface &s,
+		                            const std::shared_ptr<ResultSink> &sink)
+		{
+			init (s);
+			get_element_result (s)._sink = sink;
+		}
+
+		const std::shared_ptr<ResultSink> &
+		Result::get_intercept_sink (const sys::Surface &s) const
+		{
+			return get_element_result (s)._sink;
+		}
+
 		bool Result::get_intercepted_save_state (const sys::Element &e)
 		{
 			return get_element_result (e)._save_intercepted_list;
@@ -261,6 +486,10 @@ for (auto &r : _rays)
 					res = i;
 				}
 			}
+for (auto &s : _shards)
+			{
+				res = std::max (res, s->get_max_ray_intensity ());
+			}
 			return res;
 		}
 
@@ -0,0 +1,99 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <cmath>
+
+#include <goptical/core/error.hpp>
+#include <goptical/core/trace/sink_histogram.hpp>
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		SinkHistogram::SinkHistogram (const math::VectorPair2 &window,
+		                              unsigned int x_bins, unsigned int y_bins)
+			: _window (window), _values (), _counts (), _outside (0)
+		{
+			if (!x_bins || !y_bins || !(window[1].x () > window[0].x ())
+			        || !(window[1].y () > window[0].y ()))
+			{
+				throw Error ("bad histogram window or bins count");
+			}
+			_bins[0] = x_bins;
+			_bins[1] = y_bins;
+			_scale = math::Vector2 (x_bins / (window[1].x () - window[0].x ()),
+			                        y_bins / (window[1].y () - window[0].y ()));
+			clear ();
+		}
+
+		void
+		SinkHistogram::clear ()
+		{
+			_values.assign (_bins[0] * _bins[1], 0.0);
+			_counts.assign (_bins[0] * _bins[1], 0);
+			_outside = 0;
+		}
+
+		void
+		SinkHistogram::add_intercept (const sys::Surface &s,
+		                              const math::Vector3 &point,
+		                              const math::Vector3 &direction,
+		                              double wavelen, double intensity)
+		{
+			double x = floor ((point.x () - _window[0].x ()) * _scale.x ());
+			double y = floor ((point.y () - _window[0].y ()) * _scale.y ());
+			if (!(x >= 0 && x < _bins[0] && y >= 0 && y < _bins[1]))
+			{
+				_outside += intensity;
+				return;
+			}
+			unsigned int i = (unsigned int)x + _bins[0] * (unsigned int)y;
+			_values[i] += intensity;
+			_counts[i]++;
+		}
+
+		std::shared_ptr<ResultSink>
+		SinkHistogram::fork () const
+		{
+			return std::make_shared<SinkHistogram> (_window, _bins[0], _bins[1]);
+		}
+
+		void
+		SinkHistogram::merge (const ResultSink &sink)
+		{
+			const SinkHistogram &s = dynamic_cast<const SinkHistogram &> (sink);
+			assert (s._values.size () == _values.size ());
+			for (unsigned int i = 0; i < _values.size (); i++)
+			{
+				_values[i] += s._values[i];
+				_counts[i] += s._counts[i];
+			}
+			_outside += s._outside;
+		}
+
+	}
+
+}
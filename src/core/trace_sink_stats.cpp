@@ -0,0 +1,153 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <goptical/core/error.hpp>
+#include <goptical/core/trace/sink_stats.hpp>
+
+namespace goptical
+{
+
+	namespace trace
+	{
+
+		SinkStats::SinkStats ()
+		{
+			clear ();
+		}
+
+		void
+		SinkStats::clear ()
+		{
+			_count = 0;
+			_mean = math::vector3_0;
+			_m2 = 0;
+			_window = math::VectorPair3 (math::vector3_0, math::vector3_0);
+			_intensity = 0;
+			_max_intensity = 0;
+		}
+
+		void
+		SinkStats::add_intercept (const sys::Surface &s, const math::Vector3 &point,
+		                          const math::Vector3 &direction, double wavelen,
+		                          double intensity)
+		{
+			if (!_count)
+			{
+				_window = math::VectorPair3 (point, point);
+			}
+			else
+				for (unsigned int i = 0; i < 3; i++)
+				{
+					_window[0][i] = std::min (_window[0][i], point[i]);
+					_window[1][i] = std::max (_window[1][i], point[i]);
+				}
+			_count++;
+			// Welford incremental mean and squared deviation in the
+			// surface plane
+			math::Vector3 d (point - _mean);
+			_mean += d / (double)_count;
+			math::Vector3 e (point - _mean);
+			_m2 += d.x () * e.x () + d.y () * e.y ();
+			_intensity += intensity;
+			_max_intensity = std::max (_max_intensity, intensity);
+		}
+
+		std::shared_ptr<ResultSink>
+		SinkStats::fork () const
+		{
+			return std::make_shared<SinkStats> ();
+		}
+
+		void
+		SinkStats::merge (const ResultSink &sink)
+		{
+			const SinkStats &s = dynamic_cast<const SinkStats &> (sink);
+			if (!s._count)
+			{
+				return;
+			}
+			if (!_count)
+			{
+				*this = s;
+				return;
+			}
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				_window[0][i] = std::min (_window[0][i], s._window[0][i]);
+				_window[1][i] = std::max (_window[1][i], s._window[1][i]);
+			}
+			// combine partial mean and squared deviation
+			double n = (double)_count + (double)s._count;
+			math::Vector3 d (s._mean - _mean);
+			_m2 += s._m2 + (d.x () * d.x () + d.y () * d.y ())
+			       * ((double)_count * (double)s._count / n);
+			_mean += d * ((double)s._count / n);
+			_count += s._count;
+			_intensity += s._intensity;
+			_max_intensity = std::max (_max_intensity, s._max_intensity);
+		}
+
+		void
+		SinkStats::check_count () const
+		{
+			if (!_count)
+			{
+				throw Error ("no ray intercepts found on the surface");
+			}
+		}
+
+		math::Vector3
+		SinkStats::get_centroid () const
+		{
+			check_count ();
+			return _mean;
+		}
+
+		double
+		SinkStats::get_rms_radius () const
+		{
+			check_count ();
+			return sqrt (_m2 / _count);
+		}
+
+		math::VectorPair3
+		SinkStats::get_window () const
+		{
+			check_count ();
+			return _window;
+		}
+
+		math::Vector3
+		SinkStats::get_center () const
+		{
+			check_count ();
+			return (_window[0] + _window[1]) / 2;
+		}
+
+	}
+
+}
@@ -22,15 +22,25 @@
 
 */
 
+#include <atomic>
 #include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include <goptical/core/error.hpp>
+#include <goptical/core/material/base.hpp>
 #include <goptical/core/math/vector_pair.hpp>
+#include <goptical/core/sys/compiled_system.hpp>
+#include <goptical/core/sys/optical_surface.hpp>
 #include <goptical/core/sys/source.hpp>
 #include <goptical/core/sys/surface.hpp>
 #include <goptical/core/sys/system.hpp>
 #include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/index_table.hpp>
+#include <goptical/core/trace/plan.hpp>
 #include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/ray_batch.hpp>
 #include <goptical/core/trace/result.hpp>
 #include <goptical/core/trace/sequence.hpp>
 #include <goptical/core/trace/tracer.hpp>
@@ -43,12 +53,399 @@ namespace goptical
 
 		Tracer::Tracer (const sys::System *system)
 			: _system (system), _params (system->get_tracer_params ()), _result (),
-			  _result_ptr (&_result)
+			  _result_ptr (&_result), _sources (0)
 		{
 		}
 
 		Tracer::~Tracer () {}
 
+		/* minimum number of source rays handled by a single worker thread */
+		static const unsigned int seq_chunk_min_rays = 256;
+		static const unsigned int nonseq_min_rays = 64;
+		/* sinks accumulate fixed blocks of source rays or samples, merged in
+		   block order so that sums do not depend on the thread count */
+		static const unsigned int seq_sink_block_rays = 4096;
+		static const unsigned int seq_sink_block_samples = 1024;
+
+		unsigned int
+		Tracer::get_thread_count () const
+		{
+			unsigned int threads = _params._thread_count;
+			if (!threads)
+			{
+				threads = std::thread::hardware_concurrency ();
+			}
+			return threads ? threads : 1;
+		}
+
+		void
+		Tracer::update_index_table (const Result &result)
+		{
+			// sources may have added new wavelengths
+			const std::set<double> &wavelengths = result.get_ray_wavelen_set ();
+			if (!_params._index_table || !_params._index_table->is_valid (wavelengths))
+			{
+				_params._index_table = std::make_shared<IndexTable> (*_system, wavelengths);
+			}
+		}
+
+		template <IntensityMode m>
+		void
+		Tracer::trace_seq_elements (Result &result,
+		                            const std::vector<const sys::Element *> &run,
+		                            rays_queue_t *input)
+		{
+			if (m == Simpletrace && _params._plan_mode && _plan
+			        && _plan->is_complete ())
+			{
+				_plan->trace (result, *input, *run.front ());
+				return;
+			}
+			if (m == Simpletrace && _params._batch_mode
+			        && trace_seq_batch (result, run, input))
+			{
+				return;
+			}
+			rays_queue_t tmp[2];
+			unsigned int swaped = 0;
+			rays_queue_t *source_rays = input;
+for (auto element : run)
+			{
+				Result::element_result_s &er = result.get_element_result (*element);
+				rays_queue_t *generated
+				    = er._generated ? er._generated.get () : &tmp[swaped];
+				result._generated_queue = generated;
+				generated->clear ();
+				element->process_rays<m> (result, source_rays);
+				source_rays = generated;
+				swaped ^= 1;
+			}
+			result._generated_queue = 0;
+		}
+
+		bool
+		Tracer::trace_seq_batch (Result &result,
+		                         const std::vector<const sys::Element *> &run,
+		                         rays_queue_t *input)
+		{
+			// rays in a batch share the same coordinates
+			const sys::Element *frame
+			    = input->empty () ? 0 : input->front ()->get_creator ();
+for (auto ray : *input)
+			{
+				if (ray->get_creator () != frame)
+				{
+					return false;
+				}
+			}
+			// only a single outgoing ray can be propagated in batch mode
+for (auto element : run)
+			{
+				const sys::OpticalSurface *o
+				    = dynamic_cast<const sys::OpticalSurface *> (element);
+				if (!o)
+				{
+					continue;
+				}
+				for (unsigned int j = 0; j < 2; j++)
+				{
+					const material::Base &mat = o->get_material (j);
+					if (!mat.is_opaque () && mat.is_reflecting ())
+					{
+						return false;
+					}
+				}
+			}
+			// only build the rays tree if some rays have to be saved, saved
+			// rays of any element may give access to rays tree
+			bool save = false;
+for (auto &er : result._elements)
+			{
+				save |= er._intercepted || er._generated;
+			}
+			RayBatch batch;
+			batch.set_result (save ? &result : 0);
+			batch.set_sink_result (&result);
+			batch.reserve (input->size ());
+for (auto ray : *input)
+			{
+				batch.add (*ray);
+			}
+			for (unsigned int i = 0; i < run.size (); i++)
+			{
+				Result::element_result_s &er = result.get_element_result (*run[i]);
+				if (er._generated)
+				{
+					er._generated->clear ();
+				}
+				// outgoing rays must be allocated when saved by this element
+				// or intercepted by the next one
+				bool allocate = result._genealogy == GenealogyFull || er._generated;
+				if (i + 1 < run.size ())
+				{
+					allocate |= !!result.get_element_result (*run[i + 1])._intercepted;
+				}
+				batch.set_allocate (allocate);
+				result._generated_queue = er._generated.get ();
+				run[i]->process_rays (batch, _params);
+			}
+			result._generated_queue = 0;
+			return true;
+		}
+
+		template <IntensityMode m>
+		void
+		Tracer::trace_seq_parallel (Result &result,
+		                            const std::vector<const sys::Element *> &run,
+		                            rays_queue_t *input, unsigned int threads)
+		{
+			unsigned int count = input->size ();
+			unsigned int chunks
+			    = result.has_sinks ()
+			      ? (count + seq_sink_block_rays - 1) / seq_sink_block_rays
+			      : std::min (threads, (count + seq_chunk_min_rays - 1)
+			                  / seq_chunk_min_rays);
+			if (chunks <= 1)
+			{
+				trace_seq_elements<m> (result, run, input);
+				return;
+			}
+			// rays processed by an element are appended to its saved lists in
+			// input order, merging shards in chunk order keeps this order
+			// whatever the thread count
+for (auto element : run)
+			{
+				Result::element_result_s &er = result.get_element_result (*element);
+				if (er._generated)
+				{
+					er._generated->clear ();
+				}
+			}
+			std::vector<Result *> shards (chunks);
+			std::vector<rays_queue_t> chunk_rays (chunks);
+			std::vector<std::exception_ptr> errors (chunks);
+			for (unsigned int c = 0; c < chunks; c++)
+			{
+				shards[c] = &result.new_shard ();
+				chunk_rays[c].assign (input->begin () + (size_t)count * c / chunks,
+				                      input->begin () + (size_t)count * (c + 1) / chunks);
+			}
+			std::atomic<unsigned int> next (0);
+			std::vector<std::thread> workers;
+			for (unsigned int w = 0; w < std::min (threads, chunks); w++)
+				workers.push_back (std::thread ([&] ()
+			{
+				unsigned int c;
+				while ((c = next++) < chunks)
+				{
+					try
+					{
+						trace_seq_elements<m> (*shards[c], run, &chunk_rays[c]);
+					}
+					catch (...)
+					{
+						errors[c] = std::current_exception ();
+					}
+				}
+			}));
+for (auto &w : workers)
+			{
+				w.join ();
+			}
+			for (unsigned int c = 0; c < chunks; c++)
+			{
+				if (errors[c])
+				{
+					std::rethrow_exception (errors[c]);
+				}
+				result.merge_shard (*shards[c]);
+			}
+		}
+
+		template <IntensityMode m>
+		bool
+		Tracer::trace_seq_stream (const std::vector<const sys::Element *> &seq,
+		                          const sys::Element *entrance, bool plan,
+		                          unsigned int threads)
+		{
+			Result &result = *_result_ptr;
+			// sources must come first, rays are then generated and traced
+			// through all other elements in blocks of source samples
+			std::vector<const sys::Source *> sources;
+			std::vector<const sys::Element *> run;
+for (auto element : seq)
+			{
+				if (!element->is_enabled ())
+				{
+					continue;
+				}
+				if (const sys::Source *source
+				        = dynamic_cast<const sys::Source *> (element))
+				{
+					if (!run.empty ())
+					{
+						return false;
+					}
+					sources.push_back (source);
+				}
+				else
+				{
+					run.push_back (element);
+				}
+			}
+			if (sources.empty () || run.empty ())
+			{
+				return false;
+			}
+			sys::Source::targets_t elist (1, entrance);
+			size_t samples = 0;
+for (auto s : sources)
+			{
+				size_t n = s->get_sample_count (_params, elist);
+				if (!n)
+				{
+					return false;
+				}
+				samples = std::max (samples, n);
+			}
+			// declare sources wavelengths without generating rays
+			result._sample_first = result._sample_end = 0;
+			try
+			{
+for (auto s : sources)
+				{
+					if (s->get_system ())
+					{
+						result._sources.push_back (s);
+					}
+					s->generate_rays<m> (result, elist);
+				}
+			}
+			catch (...)
+			{
+				result._sample_end = std::numeric_limits<size_t>::max ();
+				throw;
+			}
+			result._sample_end = std::numeric_limits<size_t>::max ();
+			update_index_table (result);
+			if (plan && (!_plan || !_plan->is_valid (*_params._sequence)))
+			{
+				_plan = std::make_shared<Plan> (*_params._sequence);
+			}
+			typedef std::vector<std::shared_ptr<ResultSink> > sinks_t;
+			const unsigned int blocks
+			    = (samples + seq_sink_block_samples - 1) / seq_sink_block_samples;
+			const unsigned int count = std::min (threads, blocks);
+			// sinks of traced blocks waiting to be merged, and merged
+			// sinks kept for reuse
+			std::vector<sinks_t> pending (blocks);
+			std::vector<sinks_t> spare;
+			unsigned int merged = 0;
+			std::mutex lock;
+			std::atomic<unsigned int> next (0);
+			std::vector<Result *> shards (count);
+			std::vector<std::exception_ptr> errors (count);
+			for (unsigned int w = 0; w < count; w++)
+			{
+				shards[w] = &result.new_shard (false);
+			}
+			auto worker = [&] (unsigned int w)
+			{
+				Result &shard = *shards[w];
+				try
+				{
+					unsigned int b;
+					while ((b = next++) < blocks)
+					{
+						sinks_t sinks;
+						{
+							std::lock_guard<std::mutex> l (lock);
+							if (!spare.empty ())
+							{
+								sinks.swap (spare.back ());
+								spare.pop_back ();
+							}
+						}
+						if (sinks.empty ())
+						{
+							sinks.resize (result._elements.size ());
+							for (unsigned int i = 0; i < sinks.size (); i++)
+								if (result._elements[i]._sink)
+								{
+									sinks[i] = result._elements[i]._sink->fork ();
+								}
+						}
+						for (unsigned int i = 0; i < sinks.size (); i++)
+						{
+							shard._elements[i]._sink = sinks[i];
+						}
+						// rays of previous block are not referenced anymore
+						shard._rays.clear ();
+						shard._sample_first = (size_t)b * seq_sink_block_samples;
+						shard._sample_end = shard._sample_first + seq_sink_block_samples;
+						rays_queue_t input;
+						shard._generated_queue = &input;
+for (auto s : sources)
+						{
+							s->generate_rays<m> (shard, elist);
+						}
+						shard._generated_queue = 0;
+						trace_seq_elements<m> (shard, run, &input);
+						// merge completed blocks in block order
+						std::lock_guard<std::mutex> l (lock);
+						pending[b].swap (sinks);
+						for (; merged < blocks && !pending[merged].empty (); merged++)
+						{
+							sinks_t &done = pending[merged];
+							for (unsigned int i = 0; i < done.size (); i++)
+								if (done[i])
+								{
+									result._elements[i]._sink->merge (*done[i]);
+									done[i]->clear ();
+								}
+							spare.push_back (sinks_t ());
+							spare.back ().swap (done);
+						}
+					}
+				}
+				catch (...)
+				{
+					errors[w] = std::current_exception ();
+					next = blocks;
+				}
+for (auto &er : shard._elements)
+				{
+					er._sink = nullptr;
+				}
+				shard._generated_queue = 0;
+			};
+			if (count == 1)
+			{
+				worker (0);
+			}
+			else
+			{
+				std::vector<std::thread> workers;
+				for (unsigned int w = 0; w < count; w++)
+				{
+					workers.push_back (std::thread (worker, w));
+				}
+for (auto &w : workers)
+				{
+					w.join ();
+				}
+			}
+			for (unsigned int w = 0; w < count; w++)
+			{
+				if (errors[w])
+				{
+					std::rethrow_exception (errors[w]);
+				}
+				result.merge_shard (*shards[w]);
+			}
+			return true;
+		}
+
 		template <IntensityMode m>
 		void
 		Tracer::trace_seq_template ()
@@ -57,53 +454,132 @@ namespace goptical
 			result.init (_system);
 			// stack of rays to propagate
 			rays_queue_t tmp[2];
+			// rays of consecutive sources are propagated together
+			rays_queue_t merged;
+			bool last_source = false;
 			unsigned int swaped = 0;
 			rays_queue_t *generated;
 			rays_queue_t *source_rays = &tmp[1];
-			const std::vector<std::shared_ptr<sys::Element> > &seq
-			    = _params._sequence->_list;
+			// user given sources replace sequence sources and come first
+			std::vector<const sys::Element *> seq;
+			bool plan = m == Simpletrace && _params._plan_mode;
+			if (_sources)
+			{
+				seq.assign (_sources->begin (), _sources->end ());
+			}
+for (auto &i : _params._sequence->_list)
+			{
+				const sys::Element *element = i.get ();
+				if (_system != element->get_system ())
+					throw Error (
+					    "Sequence contains element which is not part of the system");
+				if (_sources && dynamic_cast<const sys::Source *> (element))
+				{
+					if (seq.size () > _sources->size ())
+					{
+						// plan would stop on the removed source
+						plan = false;
+						_plan.reset ();
+					}
+					continue;
+				}
+				seq.push_back (element);
+			}
 			const sys::Element *entrance = 0;
 			// find entry element (first non source)
 			for (unsigned int i = 0; i < seq.size (); i++)
 			{
-				if (!dynamic_cast<const sys::Source *> (seq[i].get ()))
+				if (!dynamic_cast<const sys::Source *> (seq[i]))
 				{
-					entrance = seq[i].get ();
+					entrance = seq[i];
 					break;
 				}
 			}
+			unsigned int threads = get_thread_count ();
+			const bool sinks = result.has_sinks ();
+			if (sinks && entrance && !result.has_saved_lists ()
+			        && trace_seq_stream<m> (seq, entrance, plan, threads))
+			{
+				return;
+			}
 			for (unsigned int i = 0; i < seq.size (); i++)
 			{
-				const sys::Element *element = seq[i].get ();
-				if (_system != element->get_system ())
-					throw Error (
-					    "Sequence contains element which is not part of the system");
+				const sys::Element *element = seq[i];
 				if (!element->is_enabled ())
 				{
 					continue;
 				}
-				Result::element_result_s &er = result.get_element_result (*element);
-				generated = er._generated ? er._generated.get () : &tmp[swaped];
+				if ((threads > 1 || sinks || _params._batch_mode || _params._plan_mode)
+				        && !dynamic_cast<const sys::Source *> (element))
+				{
+					// trace rays through all elements up to next source
+					std::vector<const sys::Element *> run;
+					for (; i < seq.size (); i++)
+					{
+						element = seq[i];
+						if (dynamic_cast<const sys::Source *> (element))
+						{
+							break;
+						}
+						if (element->is_enabled ())
+						{
+							run.push_back (element);
+						}
+					}
+					i--;
+					update_index_table (result);
+					if (plan && (!_plan || !_plan->is_valid (*_params._sequence)))
+					{
+						_plan = std::make_shared<Plan> (*_params._sequence);
+					}
+					trace_seq_parallel<m> (result, run, source_rays, threads);
+					last_source = false;
+					GOPTICAL_DEBUG (" " << source_rays->size () << " rays traced through "
+					                << run.size () << " elements");
+					continue;
+				}
+				// sources which are not part of the system have no rays lists
+				Result::element_result_s *er
+				    = element->get_system () ? &result.get_element_result (*element) : 0;
+				generated = er && er->_generated ? er->_generated.get () : &tmp[swaped];
 				result._generated_queue = generated;
 				generated->clear ();
 				if (const sys::Source *source
 				        = dynamic_cast<const sys::Source *> (element))
 				{
-					result._sources.push_back (source);
+					if (er)
+					{
+						result._sources.push_back (source);
+					}
 					sys::Source::targets_t elist;
 					if (entrance)
 					{
 						elist.push_back (entrance);
 					}
 					source->generate_rays<m> (result, elist);
+					GOPTICAL_DEBUG (" " << generated->size () << " rays generated by "
+					                << *element);
+					if (last_source)
+					{
+						if (source_rays != &merged)
+						{
+							merged = *source_rays;
+						}
+						merged.insert (merged.end (), generated->begin (), generated->end ());
+						source_rays = &merged;
+						continue;
+					}
+					last_source = true;
 				}
 				else
 				{
+					update_index_table (result);
 					element->process_rays<m> (result, source_rays);
-					// swap ray buffers
+					GOPTICAL_DEBUG (" " << generated->size () << " rays generated by "
+					                << *element);
+					last_source = false;
 				}
-				GOPTICAL_DEBUG (" " << generated->size () << " rays generated by "
-				                << *element);
+				// swap ray buffers
 				source_rays = generated;
 				swaped ^= 1;
 			}
@@ -119,34 +595,44 @@ namespace goptical
 			if (_params._propagation_mode != RayPropagation)
 				throw Error (
 				    "Diffractive propagation not supported in non sequential mode");
+			unsigned int threads = get_thread_count ();
 			// stack of rays to propagate
 			rays_queue_t source_rays;
 			sys::Source::targets_t entry;
 			entry.push_back (&_system->get_entrance_pupil ());
 			// FIXME avoid container use here
 			std::vector<const sys::Source *> slist;
-			_system->get_elements<sys::Source> (
-			    [&] (const sys::Source &elem)
+			if (_sources)
+			{
+				slist = *_sources;
+			}
+			else
 			{
-				slist.push_back (&elem);
-			});
+				_system->get_elements<sys::Source> (
+				    [&] (const sys::Source &elem)
+				{
+					slist.push_back (&elem);
+				});
+			}
 for (auto &s : slist)
 			{
 				const sys::Source &source = *s;
-				if (_system != source.get_system ())
+				if (!_sources && _system != source.get_system ())
 					throw Error (
 					    "can not trace with Source which is not part of the system");
 				if (!source.is_enabled ())
 				{
 					continue;
 				}
-				result._sources.push_back (&source);
 				// get rays from source
 				source_rays.clear ();
 				result._generated_queue = &source_rays;
 				source.generate_rays<m> (result, entry);
-				// copy to source generated rays
+				// copy to source generated rays, sources which are not
+				// part of the system have no rays lists
+				if (source.get_system ())
 				{
+					result._sources.push_back (&source);
 					Result::element_result_s &source_er
 					    = result.get_element_result (source);
 					if (source_er._generated)
@@ -155,49 +641,221 @@ for (auto &s : slist)
 					}
 				}
 				GOPTICAL_DEBUG ("NSeq Ray trace: " << source_rays.size () << " Rays");
+				update_index_table (result);
+				if (threads > 1 && source_rays.size () >= 2 * nonseq_min_rays)
+				{
+					trace_nonseq_parallel<m> (result, source_rays, threads);
+					continue;
+				}
 				// trace each ray generated by source through the system
 				rays_queue_t gqueue;
 				result._generated_queue = &gqueue;
+				auto event = [&] (const sys::Element & e, Ray & ray, bool intercepted)
+				{
+					if (intercepted)
+					{
+						result.add_intercepted (static_cast<const sys::Surface &> (e), ray);
+					}
+					else
+					{
+						result.add_generated (e, ray);
+					}
+				};
 for (auto &r : source_rays)
 				{
-					Ray *ray = r;
-					unsigned int bounce = _params._max_bounce;
-					// trace relfected/refracted ray further
-					while (1)
+					trace_ray_tree<m> (result, r, gqueue, event);
+				}
+			}
+			result._generated_queue = 0;
+		}
+
+		template <IntensityMode m, class Event>
+		void
+		Tracer::trace_ray_tree (Result &result, Ray *ray, rays_queue_t &gqueue,
+		                        Event &event)
+		{
+			unsigned int bounce = _params._max_bounce;
+			// generated rays waiting in gqueue start at this index
+			size_t head = 0;
+			// trace relfected/refracted ray further
+			while (1)
+			{
+				// check bounce limit, rays past the limit are not traced further
+				if (!bounce)
+				{
+					result._bounce_limit_count++;
+				}
+				else
+				{
+					bounce--;
+					math::VectorPair3 intersect; // intersection point and normal
+					// (intersect surface local)
+					// find ray / surface interction
+					if (sys::Surface *s = _system->colide_next (_params, intersect, *ray))
 					{
-						// check bounce limit
-						if (!bounce--)
-						{
-							result._bounce_limit_count++;
-						}
-						else
-						{
-							math::VectorPair3 intersect; // intersection point and normal
-							// (intersect surface local)
-							// find ray / surface interction
-							if (sys::Surface *s
-							        = _system->colide_next (_params, intersect, *ray))
-							{
-								result.add_intercepted (*s, *ray);
-								// transform incident ray to surface local
-								const math::Transform<3> &t
-								    = ray->get_creator ()->get_transform_to (*s);
-								math::VectorPair3 local (t.transform_line (*ray));
-								s->trace_ray<m> (result, *ray, local, intersect);
-							}
-						}
-						// pick next ray to trace further through the system
-						if (gqueue.empty ())
+						event (*s, *ray, true);
+						// transform incident ray to surface local
+						math::VectorPair3 local (ray->get_creator ()
+						                         ->get_transform_to (*s, _params)
+						                         .transform_line (*ray));
+						s->trace_ray<m> (result, *ray, local, intersect);
+					}
+				}
+				// pick next ray to trace further through the system
+				if (head == gqueue.size ())
+				{
+					gqueue.clear ();
+					break;
+				}
+				ray = gqueue[head++];
+				event (*ray->get_creator (), *ray, false);
+			}
+		}
+
+		/* range of source rays indexes owned by a non sequential worker */
+		struct nonseq_range_s
+		{
+			std::mutex _lock;
+			unsigned int _begin;
+			unsigned int _end;
+		};
+
+		/* ray interception or generation recorded by a worker */
+		struct nonseq_event_s
+		{
+			const sys::Element *_element;
+			Ray *_ray;
+			bool _intercepted;
+		};
+
+		template <IntensityMode m>
+		void
+		Tracer::trace_nonseq_parallel (Result &result, const rays_queue_t &source_rays,
+		                               unsigned int threads)
+		{
+			unsigned int count = source_rays.size ();
+			threads = std::min (threads, count / nonseq_min_rays);
+			// each worker starts with a contiguous range of source rays. A whole
+			// ray tree is traced by a single worker so that bounce limit
+			// applies per source ray as in single threaded mode. Idle
+			// workers steal upper half of other workers ranges.
+			std::vector<nonseq_range_s> ranges (threads);
+			std::vector<std::vector<nonseq_event_s> > events (threads);
+			// worker and events range for each source ray tree
+			std::vector<unsigned int> tree_worker (count);
+			std::vector<std::pair<size_t, size_t> > tree_events (count);
+			std::vector<Result *> shards (threads);
+			std::vector<std::exception_ptr> errors (threads);
+			for (unsigned int w = 0; w < threads; w++)
+			{
+				ranges[w]._begin = (size_t)count * w / threads;
+				ranges[w]._end = (size_t)count * (w + 1) / threads;
+				// sinks are fed when events are replayed
+				shards[w] = &result.new_shard (false);
+			}
+			auto take = [&] (unsigned int w, unsigned int & index)
+			{
+				{
+					std::lock_guard<std::mutex> l (ranges[w]._lock);
+					if (ranges[w]._begin < ranges[w]._end)
+					{
+						index = ranges[w]._begin++;
+						return true;
+					}
+				}
+				for (unsigned int k = 1; k < threads; k++)
+				{
+					nonseq_range_s &victim = ranges[(w + k) % threads];
+					unsigned int begin, end;
+					{
+						std::lock_guard<std::mutex> l (victim._lock);
+						if (victim._begin >= victim._end)
 						{
-							break;
+							continue;
 						}
-						ray = gqueue.front ();
-						gqueue.pop_front ();
-						result.add_generated (*ray->get_creator (), *ray);
+						begin = victim._begin + (victim._end - victim._begin) / 2;
+						end = victim._end;
+						victim._end = begin;
+					}
+					std::lock_guard<std::mutex> l (ranges[w]._lock);
+					ranges[w]._begin = begin + 1;
+					ranges[w]._end = end;
+					index = begin;
+					return true;
+				}
+				return false;
+			};
+			std::vector<std::thread> workers;
+			for (unsigned int w = 0; w < threads; w++)
+				workers.push_back (std::thread ([&, w] ()
+			{
+				Result &shard = *shards[w];
+				std::vector<nonseq_event_s> &ev = events[w];
+				auto event = [&] (const sys::Element & e, Ray & ray, bool intercepted)
+				{
+					const Result::element_result_s &er = result.get_element_result (e);
+					if (intercepted ? er._intercepted || er._sink : !!er._generated)
+					{
+						ev.push_back (nonseq_event_s{ &e, &ray, intercepted });
+					}
+				};
+				rays_queue_t gqueue;
+				shard._generated_queue = &gqueue;
+				try
+				{
+					unsigned int i;
+					while (take (w, i))
+					{
+						tree_worker[i] = w;
+						tree_events[i].first = ev.size ();
+						trace_ray_tree<m> (shard, source_rays[i], gqueue, event);
+						tree_events[i].second = ev.size ();
+					}
+				}
+				catch (...)
+				{
+					errors[w] = std::current_exception ();
+				}
+				shard._generated_queue = 0;
+			}));
+for (auto &w : workers)
+			{
+				w.join ();
+			}
+			for (unsigned int w = 0; w < threads; w++)
+			{
+				if (errors[w])
+				{
+					std::rethrow_exception (errors[w]);
+				}
+				result.merge_shard (*shards[w]);
+			}
+			// replay saved events in source ray order
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const std::vector<nonseq_event_s> &ev = events[tree_worker[i]];
+				for (size_t j = tree_events[i].first; j < tree_events[i].second; j++)
+				{
+					const nonseq_event_s &e = ev[j];
+					if (e._intercepted)
+					{
+						const sys::Surface &s = static_cast<const sys::Surface &> (*e._element);
+						const Ray &ray = *e._ray;
+						result.add_intercepted (s, *e._ray);
+						// same values as passed by sys::Surface::trace_ray
+						if (result.get_element_result (s)._sink)
+							result.add_intercept_event (
+							    s, ray.get_intercept_point (),
+							    ray.get_creator ()->get_transform_to (s, _params)
+							    .transform_linear (ray.direction ()),
+							    ray.get_wavelen (), ray.get_intercept_intensity ());
+					}
+					else
+					{
+						result.add_generated (*e._element, *e._ray);
 					}
 				}
 			}
-			result._generated_queue = 0;
 		}
 
 		void
@@ -207,6 +865,30 @@ for (auto &r : source_rays)
 			// clear previous results
 			result.prepare ();
 			result._params = &_params;
+			result._genealogy = _params._genealogy_mode;
+			// snapshot system transforms, elements and tracer threads look
+			// them up through _params. Snapshot is kept until system changes
+			const sys::CompiledSystem *c = _params._compiled_system.get ();
+			if (_params._sequential_mode)
+			{
+				std::vector<const sys::Element *> seq;
+for (auto &e : _params._sequence->_list)
+				{
+					seq.push_back (e.get ());
+				}
+				if (!c || !c->is_valid (*_system, seq))
+				{
+					_params._compiled_system
+					    = std::make_shared<sys::CompiledSystem> (*_system, seq);
+				}
+			}
+			else if (!c || !c->is_valid (*_system))
+			{
+				_params._compiled_system
+				    = std::make_shared<sys::CompiledSystem> (*_system);
+			}
+			// surfaces materials may have changed since last trace
+			_params._index_table.reset ();
 			switch (_params._intensity_mode)
 			{
 				case Simpletrace:
@@ -242,6 +924,43 @@ for (auto &r : source_rays)
 			}
 		}
 
+		void
+		Tracer::trace (const std::vector<const sys::Source *> &sources)
+		{
+for (auto s : sources)
+				if (s->get_system () && s->get_system () != _system)
+				{
+					throw Error ("can not trace with Source which is part of an other system");
+				}
+			_sources = &sources;
+			try
+			{
+				trace ();
+			}
+			catch (...)
+			{
+				_sources = 0;
+				throw;
+			}
+			_sources = 0;
+		}
+
+		const sys::Surface *
+		Tracer::get_entrance () const
+		{
+			if (!_params._sequential_mode)
+			{
+				return &_system->get_entrance_pupil ();
+			}
+			// first non source element, as in trace_seq_template
+for (auto &e : _params._sequence->_list)
+				if (!dynamic_cast<const sys::Source *> (e.get ()))
+				{
+					return dynamic_cast<const sys::Surface *> (e.get ());
+				}
+			return 0;
+		}
+
 	}
 
 }
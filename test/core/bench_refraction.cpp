@@ -0,0 +1,126 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+  Refraction microbenchmark: trace about 1M rays through a doublet in
+  sequential mode with each refraction law, with and without formulas
+  validation, both ray by ray and in batch mode.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include <goptical/core/material/abbe.hpp>
+
+#include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/optical_surface.hpp>
+#include <goptical/core/sys/source_point.hpp>
+#include <goptical/core/sys/system.hpp>
+
+#include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/refraction_stats.hpp>
+#include <goptical/core/trace/result.hpp>
+#include <goptical/core/trace/sequence.hpp>
+#include <goptical/core/trace/tracer.hpp>
+
+#include <goptical/core/light/spectral_line.hpp>
+
+using namespace goptical;
+
+static double
+run(sys::System &sys, trace::RefractionLaw law, bool validate, bool batch,
+    unsigned long &refractions)
+{
+	trace::RefractionStats stats;
+	trace::Tracer tracer (&sys);
+	tracer.get_params ().set_refraction_law (law);
+	tracer.get_params ().set_refraction_stats (validate ? &stats : 0);
+	tracer.get_params ().set_batch_mode (batch);
+	trace::Result result;
+	tracer.set_trace_result (result);
+
+	auto start = std::chrono::steady_clock::now ();
+	tracer.trace ();
+	auto end = std::chrono::steady_clock::now ();
+
+	refractions = stats.get_count ();
+	return std::chrono::duration<double> (end - start).count ();
+}
+
+int main(int argc, char **argv)
+{
+	// 3 * n * (n + 1) + 1 rays with hexapolar pattern
+	unsigned int density = argc > 1 ? atoi (argv[1]) : 577;
+
+	sys::System sys;
+	auto glass1 = std::make_shared<material::AbbeVd> (1.5168, 64.17);
+	auto glass2 = std::make_shared<material::AbbeVd> (1.6200, 36.37);
+	auto source = std::make_shared<sys::SourcePoint> (sys::SourceAtInfinity,
+	              math::Vector3 (0, 0.05, 1));
+	source->clear_spectrum ();
+	source->add_spectral_line (light::SpectralLine::d);
+	sys.add (source);
+	sys.add (std::make_shared<sys::OpticalSurface> (
+	             math::Vector3 (0, 0, 0), 120, 30, material::none, glass1));
+	sys.add (std::make_shared<sys::OpticalSurface> (
+	             math::Vector3 (0, 0, 8), -90, 30, glass1, glass2));
+	sys.add (std::make_shared<sys::OpticalSurface> (
+	             math::Vector3 (0, 0, 11), -400, 30, glass2, material::none));
+	sys.add (std::make_shared<sys::Image> (math::Vector3 (0, 0, 180), 60));
+
+	sys.get_tracer_params ().set_default_distribution (
+	    trace::Distribution (trace::HexaPolarDist, density));
+	sys.get_tracer_params ().set_sequential_mode (
+	    std::make_shared<trace::Sequence> (sys));
+
+	std::cout << "rays: " << 3 * density * (density + 1) + 1 << std::endl;
+
+	static const struct
+	{
+		const char *name;
+		trace::RefractionLaw law;
+		bool validate;
+	} modes[] =
+	{
+		{ "feder, validation", trace::RefractionFeder, true },
+		{ "feder", trace::RefractionFeder, false },
+		{ "de greve", trace::RefractionDeGreve, false },
+	};
+
+	for (int batch = 0; batch < 2; batch++)
+		for (auto &m : modes)
+		{
+			unsigned long refractions;
+			double t = run (sys, m.law, m.validate, batch, refractions);
+			printf ("%-20s %-6s %8.3f s", m.name, batch ? "batch" : "ray", t);
+			if (m.validate)
+				printf ("  %lu refractions validated", refractions);
+			printf ("\n");
+		}
+
+	return 0;
+}
@@ -0,0 +1,439 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include <goptical/core/analysis/field_sweep.hpp>
+#include <goptical/core/analysis/spot.hpp>
+#include <goptical/core/analysis/through_focus.hpp>
+#include <goptical/core/curve/sphere.hpp>
+#include <goptical/core/data/plot.hpp>
+#include <goptical/core/data/plotdata.hpp>
+#include <goptical/core/data/sample_set.hpp>
+#include <goptical/core/material/sellmeier.hpp>
+#include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/optical_surface.hpp>
+#include <goptical/core/sys/source_point.hpp>
+#include <goptical/core/sys/system.hpp>
+#include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/result.hpp>
+#include <goptical/core/trace/sequence.hpp>
+
+#include <goptical/core/light/spectral_line.hpp>
+
+using namespace goptical;
+
+#define FAIL(x)                                 \
+	{                                               \
+		std::cerr << x << std::endl;                  \
+		std::exit(1);                                 \
+	}
+
+struct Setup
+{
+	std::shared_ptr<sys::System> sys;
+	std::shared_ptr<sys::SourcePoint> source;
+	std::shared_ptr<sys::OpticalSurface> s1;
+	std::shared_ptr<sys::Image> image;
+};
+
+// biconvex singlet with strong spherical aberration
+static Setup
+make_system(double field)
+{
+	Setup r;
+	auto bk7 = std::make_shared<material::Sellmeier> (1.03961212, 6.00069867e-3,
+	           0.231792344, 2.00179144e-2,
+	           1.01046945, 1.03560653e2);
+	r.source = std::make_shared<sys::SourcePoint> (sys::SourceAtInfinity,
+	           math::Vector3 (0, field, 1));
+	r.s1 = std::make_shared<sys::OpticalSurface> (
+	           math::Vector3 (0, 0, 0), 50, 15, material::none, bk7);
+	r.image = std::make_shared<sys::Image> (math::Vector3 (0, 0, 45), 50);
+	r.sys = std::make_shared<sys::System> ();
+	r.sys->add (r.source);
+	r.sys->add (r.s1);
+	r.sys->add (std::make_shared<sys::OpticalSurface> (
+	                math::Vector3 (0, 0, 5), -50, 15, bk7, material::none));
+	r.sys->add (r.image);
+	return r;
+}
+
+// count ray intersections over all ray traces
+struct CountSphere : public curve::Sphere
+{
+	CountSphere(double roc) : curve::Sphere (roc), count (0) {}
+
+	bool intersect(math::Vector3 &point, const math::VectorPair3 &ray) const
+	{
+		count++;
+		return curve::Sphere::intersect (point, ray);
+	}
+
+	mutable std::atomic<size_t> count;
+};
+
+static void
+test_adaptive_spot(double field)
+{
+	Setup s = make_system(field);
+
+	// dense quasi random reference
+	analysis::Spot ref (s.sys);
+	ref.get_tracer ().get_params ().set_default_distribution (
+	    trace::Distribution (trace::SobolDist, 160));
+	double ref_rms = ref.get_rms_radius ();
+	if (ref.get_rms_radius_error () != 0.)
+		FAIL(__LINE__ << " error reported without adaptive sampling");
+
+	const double tol = 1e-3;
+	analysis::Spot spot (s.sys);
+	spot.set_adaptive_sampling (tol);
+	auto traced = std::make_shared<CountSphere> (50);
+	s.s1->set_curve (traced);
+	double rms = spot.get_rms_radius ();
+
+	// only samples of refined groups are traced again, retracing all
+	// samples at each step needs more than 4 intersections per ray
+	if (traced->count > 3 * spot.get_ray_count ())
+		FAIL(__LINE__ << " " << traced->count << " rays traced for "
+		     << spot.get_ray_count ());
+
+	if (spot.get_ray_count () * 4 > ref.get_ray_count ())
+		FAIL(__LINE__ << " too many rays " << spot.get_ray_count ());
+	if (spot.get_rms_radius_error () > tol * rms
+	        || spot.get_centroid_error () > tol * rms)
+		FAIL(__LINE__ << " not converged " << spot.get_rms_radius_error ());
+	if (std::fabs (rms - ref_rms) > 3 * tol * ref_rms)
+		FAIL(__LINE__ << " bad rms " << rms << " " << ref_rms);
+	if ((spot.get_centroid () - ref.get_centroid ()).len () > 3 * tol * ref_rms)
+		FAIL(__LINE__ << " bad centroid " << spot.get_centroid ());
+
+	// pattern override must not leak in tracer parameters
+	const std::vector<math::Vector3> *points;
+	const std::vector<double> *weights;
+	if (spot.get_tracer ().get_params ().get_pattern_points (*s.s1, points, weights))
+		FAIL(__LINE__ << " pattern points left in params");
+
+	// caller pattern points and save states are kept
+	analysis::Spot keep (s.sys);
+	keep.set_adaptive_sampling (tol);
+	auto user = std::make_shared<std::vector<math::Vector3> > (1, math::vector3_0);
+	keep.get_tracer ().get_params ().set_pattern_points (*s.s1, user);
+	keep.get_tracer ().get_trace_result ().set_generated_save_state (*s.source);
+	keep.get_rms_radius ();
+	const analysis::Spot &ckeep = keep;
+	if (!ckeep.get_tracer ().get_params ().get_pattern_points (*s.s1, points, weights)
+	        || points != user.get ())
+		FAIL(__LINE__ << " caller pattern points lost");
+	if (!ckeep.get_tracer ().get_trace_result ().get_generated_save_state (*s.source))
+		FAIL(__LINE__ << " caller save state lost");
+
+	// sample budget is honored, source has a single spectral line
+	analysis::Spot small (s.sys);
+	small.set_adaptive_sampling (1e-9, 500);
+	if (small.get_ray_count () > 500)
+		FAIL(__LINE__ << " sample budget exceeded " << small.get_ray_count ());
+}
+
+static bool
+close(double a, double b)
+{
+	return std::fabs (a - b) <= 1e-9 * std::max (1., std::fabs (b));
+}
+
+static void
+test_spot_stats(double field)
+{
+	Setup s = make_system(field);
+	s.source->add_spectral_line (light::SpectralLine::C);
+	s.source->add_spectral_line (light::SpectralLine::F);
+
+	analysis::Spot spot (s.sys);
+	spot.get_tracer ().get_params ().get_default_distribution ().set_radial_density (20);
+	double rms = spot.get_rms_radius ();
+	const math::Vector3 c = spot.get_centroid ();
+
+	// two pass reference, const tracer access keeps analysis valid
+	const analysis::Spot &cspot = spot;
+	const trace::Result &result = cspot.get_tracer ().get_trace_result ();
+	const trace::rays_queue_t &intercepts = result.get_intercepted (*s.image);
+	math::Vector3 ref_c (0., 0., 0.);
+	for (auto i : intercepts)
+		ref_c += i->get_intercept_point ();
+	ref_c /= intercepts.size ();
+	double ref_ms = 0., ref_max = 0.;
+	for (auto i : intercepts)
+	{
+		double d = (i->get_intercept_point () - ref_c).len ();
+		ref_ms += d * d;
+		ref_max = std::max (ref_max, d);
+	}
+	if ((c - ref_c).len () > 1e-9 * (1. + ref_c.len ()))
+		FAIL(__LINE__ << " bad centroid " << c << ref_c);
+	if (!close (rms, sqrt (ref_ms / intercepts.size ())))
+		FAIL(__LINE__ << " bad rms " << rms);
+	if (!close (spot.get_max_radius (), ref_max))
+		FAIL(__LINE__ << " bad max radius");
+
+	for (double r = 0.; r < ref_max * 1.2; r += ref_max / 37.)
+	{
+		double ee = 0., es = 0.;
+		for (auto i : intercepts)
+		{
+			math::Vector3 d = i->get_intercept_point () - c;
+			if (d.len () <= r)
+				ee += i->get_intensity ();
+			if (std::max (std::fabs (d.x ()), std::fabs (d.y ())) <= r)
+				es += i->get_intensity ();
+		}
+		if (!close (spot.get_encircled_intensity (r), ee))
+			FAIL(__LINE__ << " bad encircled intensity at " << r);
+		if (!close (spot.get_ensquared_intensity (r), es))
+			FAIL(__LINE__ << " bad ensquared intensity at " << r);
+	}
+	const double max = spot.get_max_radius ();
+	if (!close (spot.get_encircled_intensity (max), spot.get_total_intensity ()))
+		FAIL(__LINE__ << " bad total encircled intensity");
+
+	// per wavelength curves, zones as in original binning
+	const int zones = 50;
+	std::shared_ptr<data::Plot> plot = spot.get_encircled_intensity_plot (zones);
+	if (plot->get_plot_count () != 3)
+		FAIL(__LINE__ << " bad plot count " << plot->get_plot_count ());
+	unsigned int k = 0;
+	for (double w : result.get_ray_wavelen_set ())
+	{
+		const data::Set1d &set
+		    = static_cast<const data::Set1d &> (plot->get_plot_data (k++).get_set ());
+		double sum = 0.;
+		for (int z = 1; z <= zones; z++)
+		{
+			double ref = 0.;
+			for (auto i : intercepts)
+			{
+				double d = (i->get_intercept_point () - c).len ();
+				if (i->get_wavelen () == w && d <= max
+				        && (int)((zones - 1) * (d / max)) < z)
+					ref += i->get_intensity ();
+			}
+			if (!close (set.get_y_value (z), ref))
+				FAIL(__LINE__ << " bad plot value " << w << " " << z);
+			sum = ref;
+		}
+		if (sum <= 0.)
+			FAIL(__LINE__ << " empty curve");
+	}
+}
+
+static void
+test_field_sweep(bool sequential)
+{
+	const double angles[] = { 0., 5., 25. };
+	const double wavelens[] = { light::SpectralLine::d, light::SpectralLine::C,
+	                            light::SpectralLine::F
+	                          };
+
+	Setup s = make_system(0.);
+	if (sequential)
+		s.sys->get_tracer_params ().set_sequential_mode (
+		    std::make_shared<trace::Sequence> (*s.sys));
+	const unsigned int count = s.sys->get_element_count ();
+	const unsigned int version = s.sys->get_version ();
+
+	analysis::FieldSweep sweep (s.sys);
+	for (double a : angles)
+		sweep.add_field_angle (a);
+	for (double w : wavelens)
+		sweep.add_wavelen (w);
+	if (sweep.get_field_count () != 3 || sweep.get_wavelen_count () != 3)
+		FAIL(__LINE__ << " bad table size");
+	sweep.get_rms_radius (0, 0);
+
+	// system left untouched
+	if (!s.source->is_enabled () || s.sys->find<sys::SourcePoint> () != s.source.get ())
+		FAIL(__LINE__ << " system sources changed");
+	if (s.sys->get_element_count () != count)
+		FAIL(__LINE__ << " unexpected element count");
+	if (s.sys->get_version () != version)
+		FAIL(__LINE__ << " system version changed");
+	sweep.invalidate ();
+	sweep.get_rms_radius (0, 0);
+	if (s.sys->get_version () != version)
+		FAIL(__LINE__ << " system version changed");
+
+	for (unsigned int f = 0; f < 3; f++)
+		for (unsigned int l = 0; l < 3; l++)
+		{
+			// one trace per field and wavelength
+			const double a = math::degree2rad (angles[f]);
+			Setup r = make_system(0.);
+			r.sys->remove (r.source);
+			r.source = std::make_shared<sys::SourcePoint> (sys::SourceAtInfinity,
+			           math::Vector3 (0., sin (a), cos (a)));
+			r.sys->add (r.source);
+			if (sequential)
+				r.sys->get_tracer_params ().set_sequential_mode (
+				    std::make_shared<trace::Sequence> (*r.sys));
+			r.source->clear_spectrum ();
+			r.source->add_spectral_line (light::SpectralLine (wavelens[l], 1.0));
+			analysis::Spot spot (r.sys);
+			const trace::Params &params = spot.get_tracer ().get_params ();
+			const double generated = r.s1->get_pattern_points (
+			                             params.get_distribution (*r.s1))->size ();
+
+			const double rms = sweep.get_rms_radius (f, l);
+			if (!close (rms, spot.get_rms_radius ()))
+				FAIL(__LINE__ << " bad rms " << f << " " << l << " " << rms);
+			if ((sweep.get_centroid (f, l) - spot.get_centroid ()).len () > 1e-9)
+				FAIL(__LINE__ << " bad centroid " << f << " " << l);
+			if (sweep.get_ray_count (f, l) != spot.get_ray_count ())
+				FAIL(__LINE__ << " bad ray count " << f << " " << l);
+			if (!close (sweep.get_vignetting (f, l),
+			            1. - spot.get_ray_count () / generated))
+				FAIL(__LINE__ << " bad vignetting " << sweep.get_vignetting (f, l));
+
+			// ray through entrance surface center
+			auto points = std::make_shared<std::vector<math::Vector3>> (
+			                  1, math::vector3_0);
+			spot.get_tracer ().get_params ().set_pattern_points (*r.s1, points);
+			const math::Vector3 &chief = sweep.get_chief_intercept (f, l);
+			if ((chief - spot.get_centroid ()).len () > 1e-9)
+				FAIL(__LINE__ << " bad chief intercept " << f << " " << l << chief);
+		}
+	if (sweep.get_vignetting (2, 0) <= 0.)
+		FAIL(__LINE__ << " expected vignetting at large field");
+	if (sweep.get_chief_intercept (1, 0).y () <= 0.)
+		FAIL(__LINE__ << " bad chief ray height sign");
+}
+
+// rms wavefront error of on axis spot traced to the image, reference
+// sphere centered on the image axis
+static double
+image_rms_wavefront(const trace::rays_queue_t &intercepts)
+{
+	double m1 = 0., m2 = 0.;
+	for (auto i : intercepts)
+	{
+		const double wl = i->get_wavelen ();
+		double opl = 0.;
+		for (const trace::Ray *r = i; r; r = r->get_parent ())
+			opl += r->get_len () * r->get_material ()->get_refractive_index (wl);
+		const double n = i->get_material ()->get_refractive_index (wl);
+		const math::Vector3 &p = i->get_intercept_point ();
+		const math::Vector3 u = i->get_direction (i->get_intercept_element ());
+		double w = (opl - n * (p * u)) / (wl * 1e-6);
+		m1 += w;
+		m2 += w * w;
+	}
+	m1 /= intercepts.size ();
+	return sqrt (std::max (0., m2 / intercepts.size () - m1 * m1));
+}
+
+static void
+test_through_focus(double field)
+{
+	Setup s = make_system(field);
+	s.source->add_spectral_line (light::SpectralLine::C);
+	analysis::ThroughFocus focus (s.sys);
+
+	const double zr = focus.get_min_rms_focus ();
+	const double zw = focus.get_min_wavefront_focus ();
+	// spherical aberration, smallest spot is closer to marginal focus
+	if (!(zr > -10. && zr < zw && zw < 10.))
+		FAIL(__LINE__ << " bad focus " << zr << " " << zw);
+
+	const double planes[] = { -3.5, 0., zr, zw, 2., 5. };
+	for (double dz : planes)
+	{
+		// same spot when moving the image and tracing again
+		Setup m = make_system(field);
+		m.source->add_spectral_line (light::SpectralLine::C);
+		m.image->set_plane (focus.get_focus_plane (dz));
+		analysis::Spot spot (m.sys);
+		const double rms = focus.get_rms_radius (dz);
+		if (std::fabs (rms - spot.get_rms_radius ()) > 1e-9 * (1. + rms))
+			FAIL(__LINE__ << " bad rms " << dz << " " << rms << " " << spot.get_rms_radius ());
+		const math::Vector3 c = focus.get_centroid (dz)
+		                        - math::Vector3 (0., 0., dz);
+		if ((c - spot.get_centroid ()).len () > 1e-9)
+			FAIL(__LINE__ << " bad centroid " << dz << c << spot.get_centroid ());
+		if (rms < focus.get_rms_radius (zr))
+			FAIL(__LINE__ << " rms below minimum " << dz);
+		if (focus.get_rms_wavefront (dz) < focus.get_rms_wavefront (zw))
+			FAIL(__LINE__ << " wavefront below minimum " << dz);
+
+		if (field != 0.)
+			continue;
+		// single wavelength, no tilt expected on axis
+		Setup w = make_system(field);
+		w.image->set_plane (focus.get_focus_plane (dz));
+		analysis::Spot ref (w.sys);
+		ref.get_rms_radius ();
+		const analysis::Spot &cref = ref;
+		const double wf = image_rms_wavefront (
+		                      cref.get_tracer ().get_trace_result ().get_intercepted (*w.image));
+		Setup t = make_system(field);
+		analysis::ThroughFocus tf (t.sys);
+		if (std::fabs (tf.get_rms_wavefront (dz) - wf) > 1e-5 * (1. + wf))
+			FAIL(__LINE__ << " bad wavefront " << dz << " " << tf.get_rms_wavefront (dz)
+			     << " " << wf);
+	}
+
+	// system is left untouched
+	if (s.image->get_position ().z () != 45.)
+		FAIL(__LINE__ << " image moved");
+
+	// meridional fan, reference point only moves along y
+	analysis::ThroughFocus fan (s.sys);
+	fan.get_tracer ().get_params ().set_default_distribution (
+	    trace::Distribution (trace::MeridionalDist, 20));
+	if (!(std::fabs (fan.get_min_wavefront_focus () - zw) < 3.))
+		FAIL(__LINE__ << " bad meridional focus " << fan.get_min_wavefront_focus ());
+
+	std::shared_ptr<data::Plot> plot = focus.get_rms_radius_plot (-6., 2., 9);
+	const data::Set1d &set
+	    = static_cast<const data::Set1d &> (plot->get_plot_data (0).get_set ());
+	if (set.get_count () != 9 || !close (set.get_y_value (3), focus.get_rms_radius (-3.)))
+		FAIL(__LINE__ << " bad plot");
+}
+
+int main()
+{
+	test_through_focus(0.);
+	test_through_focus(0.1);
+	test_field_sweep(false);
+	test_field_sweep(true);
+	test_spot_stats(0.);
+	test_spot_stats(0.1);
+	test_adaptive_spot(0.);
+	test_adaptive_spot(0.1);
+	return 0;
+}
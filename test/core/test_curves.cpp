@@ -0,0 +1,388 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+
+#include <goptical/core/curve/array.hpp>
+#include <goptical/core/curve/composer.hpp>
+#include <goptical/core/curve/conic.hpp>
+#include <goptical/core/curve/curve_asphere.hpp>
+#include <goptical/core/curve/dual.hpp>
+#include <goptical/core/curve/flat.hpp>
+#include <goptical/core/curve/grid.hpp>
+#include <goptical/core/curve/intersect_stats.hpp>
+#include <goptical/core/curve/parabola.hpp>
+#include <goptical/core/curve/polynomial.hpp>
+#include <goptical/core/curve/sphere.hpp>
+#include <goptical/core/curve/spline.hpp>
+#include <goptical/core/curve/tabulated.hpp>
+#include <goptical/core/curve/zernike.hpp>
+
+#include <goptical/core/math/dual.hpp>
+#include <goptical/core/math/vector.hpp>
+#include <goptical/core/math/vector_pair.hpp>
+
+using namespace goptical;
+
+#define FAIL(x)                                 \
+	{                                               \
+		std::cerr << x << std::endl;                  \
+		std::exit(1);                                 \
+	}
+
+class Catenary : public curve::DualRotational<Catenary>
+{
+public:
+	Catenary(double a) : _a(a) {}
+
+	template <typename T> T sagitta_t(T r) const
+	{
+		return _a * cosh(r / _a) - _a;
+	}
+
+private:
+	double _a;
+};
+
+class Saddle : public curve::DualBase<Saddle>
+{
+public:
+	template <typename T> T sagitta_t(T x, T y) const
+	{
+		return x * x * y * 1e-3 + sin(x * 0.1) - sqrt(y * y + 100.0);
+	}
+};
+
+/* distant plane with a wrong gradient which defeats Newton iterations */
+class FarPlane : public curve::Base
+{
+public:
+	double sagitta(const math::Vector2 &xy) const
+	{
+		return 3e11;
+	}
+
+	void derivative(const math::Vector2 &xy, math::Vector2 &dxdy) const
+	{
+		dxdy = math::Vector2(1, 0);
+	}
+};
+
+/* compare analytic gradient and normal with the numerical ones */
+static void
+test_curve(const char *name, const curve::Base &c, double radius, double tol)
+{
+	for (double x = -radius; x <= radius; x += radius / 7.3)
+		for (double y = -radius; y <= radius; y += radius / 6.1)
+		{
+			math::Vector2 xy(x, y);
+			if (xy.len() > radius)
+				continue;
+
+			math::Vector2 d, n;
+			c.derivative(xy, d);
+			c.curve::Base::derivative(xy, n);
+			if ((d - n).len() > tol * (1.0 + n.len()))
+				FAIL(name << " derivative at " << xy << ": " << d << " numerical " << n);
+
+			math::Vector3 p(x, y, c.sagitta(xy));
+			math::Vector3 normal, nnormal(n.x(), n.y(), -1.0);
+			c.normal(normal, p);
+			nnormal.normalize();
+			if ((normal - nnormal).len() > tol)
+				FAIL(name << " normal at " << xy << ": " << normal << " numerical " << nnormal);
+		}
+}
+
+/* check generic intersection solver on rays hitting the curve */
+static void
+test_intersect(const char *name, curve::Base &c, double radius,
+               double max_mean_iterations)
+{
+	curve::IntersectStats stats;
+	c.set_intersect_stats(&stats);
+
+	for (double x = -radius; x <= radius; x += radius / 5.3)
+		for (double y = -radius; y <= radius; y += radius / 4.1)
+		{
+			if (math::Vector2(x, y).len() > radius)
+				continue;
+			math::Vector3 dir(-x * 0.002, 0.001 * y + 0.05, 1.0);
+			dir.normalize();
+			math::VectorPair3 ray(math::Vector3(x, y, -50), dir);
+			math::Vector3 p;
+			if (!c.curve::Base::intersect(p, ray))
+				FAIL(name << " no intersection for ray " << ray);
+			if (fabs(p.z() - c.sagitta(p.project_xy())) > 1e-9)
+				FAIL(name << " point " << p << " not on curve");
+			if ((ray.ln_pt_clst_pt(p) - p).len()
+			        > 1e-9)
+				FAIL(name << " point " << p << " not on ray");
+		}
+
+	c.set_intersect_stats(0);
+	if (stats.get_failure_count() || !stats.get_count())
+		FAIL(name << " " << stats.get_failure_count() << " intersection failures");
+	if (stats.get_mean_iterations() > max_mean_iterations)
+		FAIL(name << " " << stats.get_mean_iterations() << " mean iterations");
+}
+
+/* bisection budget must not be consumed by bracketing steps */
+static void
+test_bisect()
+{
+	FarPlane c;
+	c.set_intersect_tolerance(1e-3);
+	curve::IntersectStats stats;
+	c.set_intersect_stats(&stats);
+
+	math::Vector3 dir(1, 0, 1);
+	dir.normalize();
+	math::Vector3 p;
+	if (!c.curve::Base::intersect(p, math::VectorPair3(math::vector3_0, dir)))
+		FAIL("far plane no intersection after " << stats.get_mean_iterations()
+		     << " iterations");
+	if (fabs(p.z() - 3e11) > 1e-2)
+		FAIL("far plane point " << p << " not on curve");
+	c.set_intersect_stats(0);
+}
+
+static void
+test_dual()
+{
+	math::Dual x(0.7, 1.0);
+	math::Dual f = exp(sin(x) * 2.0) / sqrt(x) + pow(x, 3.0) - log(x) * atan(x);
+	double v = 0.7;
+	double df = exp(sin(v) * 2.0) * (2.0 * cos(v) * sqrt(v) - 0.5 / sqrt(v)) / v
+	            + 3.0 * v * v - (atan(v) / v + log(v) / (1.0 + v * v));
+	if (fabs(f.get_derivative() - df) > 1e-12)
+		FAIL("dual derivative " << f.get_derivative() << " expecting " << df);
+
+	Catenary c(-300);
+	for (double r = 0; r < 50; r += 3.3)
+		if (fabs(c.derivative(r) - sinh(r / -300.)) > 1e-15)
+			FAIL("catenary derivative at " << r);
+}
+
+/* check fused grid value and gradient against separate
+   interpolations, with and without patch coefficients table */
+static void
+test_grid_patches()
+{
+	static const data::Interpolation modes[] = {
+		data::Bicubic, data::BicubicDiff, data::BicubicDeriv
+	};
+
+for (data::Interpolation m : modes)
+	{
+		curve::Grid grid(24, 30);
+		grid.get_data().set_interpolation(m);
+		grid.fit(curve::Conic(-120, -0.5));
+
+		for (double x = -28; x <= 28; x += 3.7)
+			for (double y = -28; y <= 28; y += 4.3)
+			{
+				math::Vector2 xy(x, y), d, d0, d1;
+				double z, z1;
+
+				grid.get_data().set_patch_table(true);
+				double z0 = grid.sagitta(xy);
+				grid.derivative(xy, d0);
+				grid.sagitta_derivative(xy, z, d);
+				if (fabs(z - z0) > 1e-12 || (d - d0).len() > 1e-12)
+					FAIL("grid fused interpolation at " << xy << ": " << z << d
+					     << " expecting " << z0 << d0);
+
+				grid.get_data().set_patch_table(false);
+				grid.sagitta_derivative(xy, z1, d1);
+				if (fabs(z1 - z0) > 1e-12 || (d1 - d0).len() > 1e-12)
+					FAIL("grid knot interpolation at " << xy << ": " << z1 << d1
+					     << " expecting " << z0 << d0);
+			}
+	}
+}
+
+/* check zernike polynomials against explicit expressions and
+   least square fit of known coefficients */
+static void
+test_zernike()
+{
+	for (double x = -0.9; x < 1.0; x += 0.23)
+		for (double y = -0.7; y < 0.7; y += 0.17)
+		{
+			math::Vector2 xy(x, y);
+			double r = x * x + y * y;
+			const struct
+			{
+				unsigned int n;
+				double z;
+			} terms[] = {
+				{ 0, 1.0 },
+				{ 2, y },
+				{ 3, 2.0 * r - 1.0 },
+				{ 5, 2.0 * x * y },
+				{ 8, 6.0 * r * r - 6.0 * r + 1.0 },
+				{ 10, y * (3.0 * x * x - y * y) },
+				{ 11, (x * x - y * y) * (4.0 * r - 3.0) },
+				{ 22, x * (35 * r * r * r - 60 * r * r + 30 * r - 4) },
+				{ 27, (x * x * x * x - 6.0 * x * x * y * y + y * y * y * y) * (6.0 * r - 5.0) },
+				{ 30, y * (3.0 * x * x - y * y) * (21 * r * r - 30 * r + 10) },
+				{ 35, 252 * r * r * r * r * r - 630 * r * r * r * r + 560 * r * r * r
+				  - 210 * r * r + 30 * r - 1 },
+			};
+for (auto &t : terms)
+			{
+				double z = curve::Zernike::zernike_poly(t.n, xy);
+				if (fabs(z - t.z) > 1e-12)
+					FAIL("zernike " << t.n << " at " << xy << ": " << z << " expecting " << t.z);
+			}
+		}
+
+	double coefs[curve::Zernike::term_count];
+	for (unsigned int i = 0; i < curve::Zernike::term_count; i++)
+		coefs[i] = sin(i * 1.7) * 1e-3 / (1 + i);
+	curve::Zernike zernike(25, coefs, curve::Zernike::term_count);
+	test_curve("zernike", zernike, 24, 1e-6);
+
+	curve::Zernike fitted(25);
+	unsigned int version = fitted.get_version();
+	double rms = fitted.fit(zernike);
+	if (fitted.get_version() == version)
+		FAIL("zernike fit did not update curve version");
+	if (rms > 1e-12)
+		FAIL("zernike fit rms " << rms);
+	for (unsigned int i = 0; i < curve::Zernike::term_count; i++)
+		if (fabs(fitted.get_coefficient(i) - coefs[i]) > 1e-12)
+			FAIL("zernike fit coefficient " << i << ": " << fitted.get_coefficient(i)
+			     << " expecting " << coefs[i]);
+
+	fitted.set_coefficients_threshold(1e-4);
+	double z = 0;
+	for (unsigned int i = 0; i < curve::Zernike::term_count; i++)
+		if (fabs(coefs[i]) >= 1e-4)
+			z += coefs[i] * curve::Zernike::zernike_poly(i, math::Vector2(0.3, -0.2));
+	if (fabs(fitted.sagitta(math::Vector2(7.5, -5)) - z) > 1e-12)
+		FAIL("zernike threshold sagitta " << fitted.sagitta(math::Vector2(7.5, -5))
+		     << " expecting " << z);
+}
+
+/* check tabulated curve error bounds against original curve */
+static void
+test_tabulated()
+{
+	auto asphere = std::make_shared<curve::Asphere> (
+	                   -280.388, 1.0, -1.45264e-5, -2.74974e-8, 4.08509e-11, -1.22e-13,
+	                   0, 0, false);
+	curve::Tabulated tab(asphere, 25, 1e-10, 1e-9);
+
+	if (tab.get_sag_error() > 1e-10 || tab.get_slope_error() > 1e-9)
+		FAIL("tabulated errors " << tab.get_sag_error() << " " << tab.get_slope_error());
+
+	for (double r = 0; r < 30; r += 0.0137)
+	{
+		double ez = fabs(tab.sagitta(r) - asphere->sagitta(r));
+		double ed = fabs(tab.derivative(r) - asphere->derivative(r));
+		if (ez > 1.5e-10 || ed > 1.5e-9)
+			FAIL("tabulated error at " << r << ": " << ez << " " << ed);
+	}
+
+	test_curve("tabulated", tab, 24, 1e-6);
+	test_intersect("tabulated", tab, 24, 3);
+
+	// original curve changes are tracked
+	auto conic = std::make_shared<curve::Conic> (-150, -0.7);
+	curve::Tabulated ctab(conic, 25, 1e-10, 1e-9);
+	unsigned int v = ctab.get_version();
+	conic->set_eccentricity(0.5);
+	if (ctab.get_version() == v)
+		FAIL("tabulated version not updated");
+	if (ctab.sagitta(10.0) != conic->sagitta(10.0))
+		FAIL("tabulated curve uses outdated samples");
+	v = ctab.get_version();
+	ctab.update();
+	if (ctab.get_version() == v)
+		FAIL("tabulated version not updated on update");
+	for (double r = 0; r < 25; r += 0.0137)
+		if (fabs(ctab.sagitta(r) - conic->sagitta(r)) > 1.5e-10)
+			FAIL("updated tabulated error at " << r);
+
+	// negative radius does not index before first interval
+	if (fabs(ctab.sagitta(-1e-3) - ctab.sagitta(0)) > 1e-12)
+		FAIL("tabulated negative radius");
+}
+
+int main()
+{
+	test_dual();
+
+	test_curve("sphere", curve::Sphere(120), 40, 1e-6);
+	test_curve("conic", curve::Conic(-150, -0.7), 40, 1e-6);
+	test_curve("parabola", curve::Parabola(200), 40, 1e-6);
+	test_curve("flat", *curve::flat, 40, 1e-6);
+	test_curve("asphere", curve::Asphere(131.725, 1.0, 3.38686e-6, -1.03975e-9,
+	                                      5.14761e-11, 1.18e-14), 20, 1e-6);
+	test_curve("asphere_nofeder", curve::Asphere(-280.388, 1.0, -1.45264e-5,
+	           -2.74974e-8, 4.08509e-11, -1.22e-13, 0, 0, false), 20, 1e-6);
+	test_curve("polynomial", curve::Polynomial(2, 6, 1e-3, 2e-5, -1e-7, 3e-9, 1e-10),
+	           40, 1e-6);
+	test_curve("catenary", Catenary(-300), 40, 1e-6);
+	test_curve("saddle", Saddle(), 40, 1e-6);
+
+	curve::Composer composer;
+	composer.add_curve(std::make_shared<curve::Sphere> (100))
+	.xy_scale(math::Vector2(2.0, 0.5)).rotate(30).xy_translate(math::Vector2(3, -1));
+	composer.add_curve(std::make_shared<Saddle> ()).z_scale(0.5);
+	test_curve("composer", composer, 20, 1e-6);
+
+	curve::Array array(std::make_shared<curve::Sphere> (50), 17.3, curve::Array::Hexagonal);
+	test_curve("array", array, 5, 1e-6);
+
+	curve::Spline spline;
+	spline.fit(curve::Sphere(120), 40, 30);
+	test_curve("spline", spline, 39, 1e-5);
+
+	curve::Grid grid(32, 40);
+	grid.fit(curve::Conic(-150, -0.7));
+	test_curve("grid", grid, 30, 1e-5);
+	test_grid_patches();
+	test_zernike();
+	test_tabulated();
+
+	curve::Sphere sphere(120);
+	test_intersect("sphere", sphere, 40, 3);
+	curve::Asphere asphere(-280.388, 1.0, -1.45264e-5, -2.74974e-8, 4.08509e-11,
+	                       -1.22e-13, 0, 0, false);
+	test_intersect("asphere", asphere, 20, 3);
+	curve::Polynomial polynomial(2, 6, 1e-3, 2e-5, -1e-7, 3e-9, 1e-10);
+	test_intersect("polynomial", polynomial, 40, 4);
+	Catenary catenary(-300);
+	test_intersect("catenary", catenary, 40, 3);
+	test_intersect("composer", composer, 20, 4);
+	test_intersect("grid", grid, 30, 4);
+	test_bisect();
+
+	return 0;
+}
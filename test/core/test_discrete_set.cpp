@@ -27,6 +27,8 @@
 
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include <goptical/core/data/discrete_set.hpp>
 
@@ -92,6 +94,37 @@ static void test(const char *name, data::Interpolation i)
 
 #define DO_TEST(i) test(#i, data::i)
 
+/* interpolation data are computed on first use, concurrent first uses
+   must give the same values as a single thread */
+static void test_threads(data::Interpolation i)
+{
+	d.set_interpolation(i);
+	std::vector<double> ref;
+	for (double x = -N/2.0 - 2.0; x < N/2.0 + 2.0; x += 1.0/R)
+		ref.push_back(d.interpolate(x, 1));
+
+	for (int k = 0; k < 20; k++)
+	{
+		d.set_interpolation(i);
+		std::vector<std::thread> t;
+		bool ok[4];
+		for (unsigned int j = 0; j < 4; j++)
+			t.push_back(std::thread([&, j] ()
+		{
+			unsigned int n = 0;
+			ok[j] = true;
+			for (double x = -N/2.0 - 2.0; x < N/2.0 + 2.0; x += 1.0/R)
+				ok[j] &= d.interpolate(x, 1) == ref[n++];
+		}));
+		for (unsigned int j = 0; j < 4; j++)
+		{
+			t[j].join();
+			if (!ok[j])
+				fail("concurrent interpolation differs");
+		}
+	}
+}
+
 int main()
 {
 	srcdir = getenv("srcdir");
@@ -129,6 +162,8 @@ int main()
 	DO_TEST(Cubic2DerivInit);
 	DO_TEST(CubicDeriv);
 	DO_TEST(Cubic2Deriv);
+	test_threads(data::Cubic);
+	test_threads(data::CubicDeriv);
 #ifdef TEST_WRITE
 	std::cerr << "test data written" << std::endl;
 	return 2;
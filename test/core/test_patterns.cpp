@@ -44,6 +44,7 @@
 #include <goptical/core/shape/regular_polygon.hpp>
 #include <goptical/core/shape/ring.hpp>
 
+#include <goptical/core/math/philox.hpp>
 #include <goptical/core/math/vector.hpp>
 
 using namespace goptical;
@@ -52,6 +53,86 @@ using namespace goptical;
 
 size_t err = 0;
 
+static void
+test_philox ()
+{
+	// Random123 known answer tests
+	uint32_t r[4];
+	math::Philox (0, 0).block (0, r);
+	if (r[0] != 0x6627e8d5 || r[1] != 0xe169c58d || r[2] != 0xbc57ac4c
+	        || r[3] != 0x9b00dbd8)
+	{
+		std::cerr << "-- philox kat 0\n";
+		err++;
+	}
+	math::Philox (0xffffffffffffffffULL, 0xffffffffffffffffULL)
+	.block (0xffffffffffffffffULL, r);
+	if (r[0] != 0x408f276d || r[1] != 0x41c83b0e || r[2] != 0xa20bc7c6
+	        || r[3] != 0x6d5451fd)
+	{
+		std::cerr << "-- philox kat 1\n";
+		err++;
+	}
+	math::Philox (0x299f31d0a4093822ULL, 0x0370734413198a2eULL)
+	.block (0x85a308d3243f6a88ULL, r);
+	if (r[0] != 0xd16cfe09 || r[1] != 0x94fdcceb || r[2] != 0x5001e420
+	        || r[3] != 0x24126ea1)
+	{
+		std::cerr << "-- philox kat 2\n";
+		err++;
+	}
+}
+
+static void
+test_convergence ()
+{
+	// mean squared radius over a disk is R^2/2, quasi random patterns
+	// must converge faster than the jittered random grid
+	shape::Disk disk (1.0);
+	double rnd_err = 0;
+	for (int j = trace::RandomDist; j <= trace::StratifiedDist; j++)
+	{
+		double e = 0;
+		for (unsigned int seed = 0; seed < 8; seed++)
+		{
+			trace::Distribution dist ((trace::Pattern)j, 8, 1.0);
+			dist.set_seed (seed);
+			std::vector<math::Vector2> pts[2];
+			for (int k = 0; k < 2; k++)
+				disk.get_pattern ([&] (const math::Vector2 &v) { pts[k].push_back (v); },
+				                  dist, false);
+			if (pts[0].size () != pts[1].size ())
+			{
+				std::cerr << "-- not reproducible " << j << "\n";
+				err++;
+				return;
+			}
+			double m = 0;
+			for (size_t i = 0; i < pts[0].size (); i++)
+			{
+				if (!(pts[0][i] == pts[1][i]))
+				{
+					std::cerr << "-- not reproducible " << j << "\n";
+					err++;
+					return;
+				}
+				m += pts[0][i].len () * pts[0][i].len ();
+			}
+			e += fabs (m / pts[0].size () - .5);
+		}
+		if (j == trace::RandomDist)
+		{
+			rnd_err = e;
+		}
+		else if (e > rnd_err)
+		{
+			std::cerr << "-- slow convergence " << j << " " << e << " " << rnd_err
+			          << "\n";
+			err++;
+		}
+	}
+}
+
 int
 main ()
 {
@@ -92,19 +173,22 @@ main ()
 		{ 0 }
 	};
 	const char *pname[] = { "default", "sagittal",   "tangential", "cross",
-	                        "square",  "triangular", "hexpolar",   "random"
+	                        "square",  "triangular", "hexpolar",   "random",
+	                        "halton",  "sobol",      "stratified"
 	                      };
+	test_philox ();
+	test_convergence ();
 	for (int i = 0; st[i].name; i++)
 	{
 		shape_test_s &s = st[i];
 #ifdef SINGLE_IMAGE
 		char fname[48];
 		std::sprintf (fname, "test_pattern_%s.svg", s.name);
-		io::RendererSvg rsvg (fname, 800, 400, io::rgb_white);
+		io::RendererSvg rsvg (fname, 800, 600, io::rgb_white);
 		io::RendererViewport &r = rsvg;
-		r.set_page_layout (4, 2);
+		r.set_page_layout (4, 3);
 #endif
-		for (int j = 0; j <= trace::RandomDist; j++)
+		for (int j = 0; j <= trace::StratifiedDist; j++)
 		{
 			if (j == trace::SquareDist || j == trace::TriangularDist)
 			{
@@ -147,7 +231,7 @@ for (auto &v : pts)
 				// Chief ray must be the first ray in list, some analysis do rely
 				// on this
 				if (!first && v.close_to (math::vector2_0, 1)
-				        && j != trace::RandomDist)
+				        && j < trace::RandomDist)
 				{
 					std::cerr << "-- chief !first " << v << "\n";
 					err++;
@@ -157,7 +241,7 @@ for (auto &v : pts)
 					std::cerr << "-- !inside " << v << "\n";
 					err++;
 				}
-				if (j != trace::RandomDist)
+				if (j < trace::RandomDist)
 				{
 					// check for duplicates
 for (auto &w : pts)
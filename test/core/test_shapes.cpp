@@ -24,6 +24,9 @@
 
 #include <cstdio>
 #include <ctime>
+#include <iostream>
+#include <memory>
+#include <vector>
 
 #include <goptical/core/io/renderer.hpp>
 #include <goptical/core/io/renderer_svg.hpp>
@@ -47,9 +50,112 @@
 
 using namespace goptical;
 
+/* reference crossing test over all polygon edges */
+static bool
+polygon_inside_ref (const std::vector<math::Vector2> &vs, const math::Vector2 &p)
+{
+	bool res = false;
+	const math::Vector2 *w = &vs.back ();
+for (auto &v : vs)
+	{
+		if (((v.y () <= p.y () && p.y () < w->y ()) || (w->y () <= p.y () && p.y () < v.y ()))
+		        && p.x () < (w->x () - v.x ()) * (p.y () - v.y ()) / (w->y () - v.y ()) + v.x ())
+		{
+			res = !res;
+		}
+		w = &v;
+	}
+	return res;
+}
+
+/* check accelerated inside tests against direct evaluation */
+static bool
+test_inside ()
+{
+	std::vector<math::Vector2> vs;
+	for (unsigned int i = 0; i < 200; i++)
+	{
+		double a = 2.0 * M_PI * i / 200;
+		double r = 10 + 25 * drand48 ();
+		vs.push_back (math::Vector2 (cos (a) * r, sin (a) * r));
+	}
+	auto poly = std::make_shared<shape::Polygon> ();
+for (auto &v : vs)
+	{
+		poly->add_vertex (v);
+	}
+	const shape::Base &p = *poly;
+
+	auto vane = std::make_shared<shape::Rectangle> (80., 2.);
+	shape::Composer comp;
+	shape::Composer::Attributes &a
+	    = comp.add_shape (std::make_shared<shape::Disk> (30.))
+	      .translate (math::Vector2 (5, 0));
+	a.exclude (std::make_shared<shape::Disk> (8.));
+	a.exclude (vane);
+	a.exclude (vane).rotate (60);
+	comp.add_shape (poly).scale (math::Vector2 (0.5, 0.5)).translate (
+	    math::Vector2 (40, 10));
+	const shape::Base &c = comp;
+
+	for (unsigned int i = 0; i < 100000; i++)
+	{
+		math::Vector2 pt ((drand48 () - 0.5) * 120, (drand48 () - 0.5) * 120);
+		if (p.inside (pt) != polygon_inside_ref (vs, pt))
+		{
+			std::cerr << "polygon inside mismatch at " << pt << std::endl;
+			return false;
+		}
+		math::Vector2 q = pt - math::Vector2 (5, 0);
+		math::Vector2 r60 (q.x () * cos (M_PI / 3) + q.y () * sin (M_PI / 3),
+		                   -q.x () * sin (M_PI / 3) + q.y () * cos (M_PI / 3));
+		bool ref = (q.len () <= 30 && q.len () > 8 && !(fabs (q.y ()) <= 1)
+		            && !(fabs (r60.y ()) <= 1))
+		           || polygon_inside_ref (vs, (pt - math::Vector2 (40, 10)) * 2.0);
+		// skip points too close to shape edges
+		if (fabs (q.len () - 30) < 1e-6 || fabs (q.len () - 8) < 1e-6
+		        || fabs (fabs (q.y ()) - 1) < 1e-6 || fabs (fabs (r60.y ()) - 1) < 1e-6)
+		{
+			continue;
+		}
+		if (c.inside (pt) != ref)
+		{
+			std::cerr << "composer inside mismatch at " << pt << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/* check composer bounding boxes follow child shape changes */
+static bool
+test_child_update ()
+{
+	auto disk = std::make_shared<shape::Disk> (10.);
+	shape::Composer comp;
+	comp.add_shape (disk);
+	if (comp.inside (math::Vector2 (15, 0)))
+	{
+		std::cerr << "composer inside before child update" << std::endl;
+		return false;
+	}
+	disk->set_radius (20.);
+	if (!comp.inside (math::Vector2 (15, 0)) || comp.max_radius () != 20.)
+	{
+		std::cerr << "composer not updated after child change" << std::endl;
+		return false;
+	}
+	return true;
+}
+
 int
 main ()
 {
+	if (!test_inside () || !test_child_update ())
+	{
+		return 1;
+	}
+
 	struct shape_test_s
 	{
 		const char *name;
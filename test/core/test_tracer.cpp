@@ -0,0 +1,964 @@
+/*
+
+      This file is part of the Goptical Core library.
+
+      The Goptical library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The Goptical library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the Goptical library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <functional>
+#include <iostream>
+#include <cstdlib>
+#include <limits>
+#include <random>
+
+#include <goptical/core/curve/composer.hpp>
+#include <goptical/core/curve/conic.hpp>
+#include <goptical/core/curve/parabola.hpp>
+#include <goptical/core/curve/sphere.hpp>
+#include <goptical/core/material/mirror.hpp>
+#include <goptical/core/material/proxy.hpp>
+#include <goptical/core/material/sellmeier.hpp>
+
+#include <goptical/core/shape/disk.hpp>
+#include <goptical/core/shape/rectangle.hpp>
+
+#include <goptical/core/sys/compiled_system.hpp>
+#include <goptical/core/sys/group.hpp>
+#include <goptical/core/sys/image.hpp>
+#include <goptical/core/sys/optical_surface.hpp>
+#include <goptical/core/sys/source_point.hpp>
+#include <goptical/core/sys/stop.hpp>
+#include <goptical/core/sys/system.hpp>
+
+#include <goptical/core/trace/distribution.hpp>
+#include <goptical/core/trace/index_table.hpp>
+#include <goptical/core/trace/params.hpp>
+#include <goptical/core/trace/ray.hpp>
+#include <goptical/core/trace/refraction_stats.hpp>
+#include <goptical/core/trace/result.hpp>
+#include <goptical/core/trace/sequence.hpp>
+#include <goptical/core/trace/sink_histogram.hpp>
+#include <goptical/core/trace/sink_stats.hpp>
+#include <goptical/core/trace/tracer.hpp>
+
+#include <goptical/core/light/spectral_line.hpp>
+
+using namespace goptical;
+
+#define FAIL(x)                                 \
+	{                                               \
+		std::cerr << x << std::endl;                  \
+		std::exit (1);                                \
+	}
+
+struct Setup
+{
+	std::shared_ptr<sys::System> sys;
+	std::shared_ptr<sys::SourcePoint> source;
+	std::shared_ptr<sys::OpticalSurface> s1;
+	std::shared_ptr<sys::OpticalSurface> s2;
+	std::shared_ptr<sys::Stop> stop;
+	std::shared_ptr<sys::Image> image;
+	std::shared_ptr<material::Base> glass;
+};
+
+static Setup
+make_system (bool conic = false)
+{
+	Setup r;
+	auto bk7 = std::make_shared<material::Sellmeier> (1.03961212, 6.00069867e-3,
+	           0.231792344, 2.00179144e-2,
+	           1.01046945, 1.03560653e2);
+	bk7->set_internal_transmittance (400, 10, 0.990);
+	bk7->set_internal_transmittance (500, 10, 0.995);
+	bk7->set_internal_transmittance (600, 10, 0.998);
+	bk7->set_internal_transmittance (700, 10, 0.998);
+	r.glass = bk7;
+	r.s1 = std::make_shared<sys::OpticalSurface> (
+	           math::Vector3 (0, 0, 0), 200, 30, material::none, bk7);
+	if (conic)
+		r.s2 = std::make_shared<sys::OpticalSurface> (
+		           math::Vector3 (0, 0, 10), std::make_shared<curve::Conic> (-150, -0.7),
+		           30, bk7, material::none);
+	else
+		r.s2 = std::make_shared<sys::OpticalSurface> (
+		           math::Vector3 (0, 0, 10), -200, 30, bk7, material::none);
+	r.stop = std::make_shared<sys::Stop> (math::Vector3 (0, 0, 50), 12);
+	r.source = std::make_shared<sys::SourcePoint> (sys::SourceAtInfinity,
+	           math::Vector3 (0, 0.1, 1));
+	r.source->add_spectral_line (light::SpectralLine::C);
+	r.source->add_spectral_line (light::SpectralLine::F);
+	r.image = std::make_shared<sys::Image> (math::Vector3 (0, 0, 200), 100);
+	r.sys = std::make_shared<sys::System> ();
+	r.sys->add (r.source);
+	r.sys->add (r.s1);
+	r.sys->add (r.s2);
+	if (conic)
+		r.sys->add (r.stop);
+	r.sys->add (r.image);
+	r.sys->get_tracer_params ().set_default_distribution (
+	    trace::Distribution (trace::HexaPolarDist, 30));
+	return r;
+}
+
+static void
+compare_queues (const trace::rays_queue_t &a, const trace::rays_queue_t &b)
+{
+	if (a.size () != b.size ())
+		FAIL (__LINE__ << " " << b.size () << " rays found, expecting " << a.size ());
+
+	for (unsigned int i = 0; i < a.size (); i++)
+	{
+		if (!(a[i]->origin () == b[i]->origin ())
+		        || !(a[i]->direction () == b[i]->direction ())
+		        || a[i]->get_wavelen () != b[i]->get_wavelen ()
+		        || a[i]->get_intensity () != b[i]->get_intensity ()
+		        || a[i]->is_lost () != b[i]->is_lost ())
+			FAIL (__LINE__ << " ray " << i << " differs");
+
+		if (!a[i]->is_lost ()
+		        && (!(a[i]->get_intercept_point () == b[i]->get_intercept_point ())
+		            || a[i]->get_intercept_intensity () != b[i]->get_intercept_intensity ()))
+			FAIL (__LINE__ << " ray " << i << " intercept differs");
+	}
+}
+
+// rays saved in trace results
+enum
+{
+	SaveS1 = 1,
+	SaveS2 = 2,
+	SaveImage = 4,
+	GenSource = 8,
+	GenS2 = 16
+};
+
+typedef std::function<void (trace::Params &)> params_t;
+
+static void
+save_rays (trace::Result &res, const Setup &s, unsigned int save)
+{
+	if (save & SaveS1)
+		res.set_intercepted_save_state (*s.s1);
+	if (save & SaveS2)
+		res.set_intercepted_save_state (*s.s2);
+	if (save & SaveImage)
+		res.set_intercepted_save_state (*s.image);
+	if (save & GenSource)
+		res.set_generated_save_state (*s.source);
+	if (save & GenS2)
+		res.set_generated_save_state (*s.s2);
+}
+
+static void
+compare_saved (const trace::Result &a, const Setup &sa,
+               const trace::Result &b, const Setup &sb, unsigned int save)
+{
+	if (save & SaveS1)
+		compare_queues (a.get_intercepted (*sa.s1), b.get_intercepted (*sb.s1));
+	if (save & SaveS2)
+		compare_queues (a.get_intercepted (*sa.s2), b.get_intercepted (*sb.s2));
+	if (save & SaveImage)
+		compare_queues (a.get_intercepted (*sa.image), b.get_intercepted (*sb.image));
+	if (save & GenSource)
+		compare_queues (a.get_generated (*sa.source), b.get_generated (*sb.source));
+	if (save & GenS2)
+		compare_queues (a.get_generated (*sa.s2), b.get_generated (*sb.s2));
+}
+
+// trace system with tracer parameters adjusted by the given function
+static void
+trace_system (Setup &s, trace::Result &res, unsigned int save,
+              const params_t &params, bool sequential = true)
+{
+	if (sequential)
+		s.sys->get_tracer_params ().set_sequential_mode (
+		    std::make_shared<trace::Sequence> (*s.sys));
+	trace::Tracer tracer (s.sys.get ());
+	if (params)
+		params (tracer.get_params ());
+	tracer.set_trace_result (res);
+	save_rays (res, s, save);
+	tracer.trace ();
+}
+
+// trace two identical systems, the second one with modified tracer
+// parameters, and check that saved rays are the same
+static void
+trace_compare (Setup s[2], trace::Result res[2], unsigned int save,
+               const params_t &params, const params_t &common = params_t (),
+               bool sequential = true)
+{
+	trace_system (s[0], res[0], save, common, sequential);
+	trace_system (s[1], res[1], save, [&] (trace::Params &p)
+	{
+		if (common)
+			common (p);
+		params (p);
+	}, sequential);
+
+	if ((save & SaveImage) && res[0].get_intercepted (*s[0].image).empty ())
+		FAIL (__LINE__ << " no ray reached the image");
+
+	compare_saved (res[0], s[0], res[1], s[1], save);
+}
+
+static void
+test_sequential (unsigned int threads, bool batch = false, bool conic = false,
+                 bool plan = false)
+{
+	Setup s[2] = { make_system (conic), make_system (conic) };
+	trace::Result res[2];
+
+	trace_compare (s, res, SaveS1 | SaveImage | GenSource, [&] (trace::Params &p)
+	{
+		p.set_thread_count (threads);
+		p.set_batch_mode (batch);
+		p.set_plan_mode (plan);
+	});
+
+	if (res[0].get_max_ray_intensity () != res[1].get_max_ray_intensity ())
+		FAIL (__LINE__ << " max ray intensity differs");
+}
+
+// glass which both transmits and reflects light
+class Splitter : public material::Proxy
+{
+	public:
+		Splitter (const std::shared_ptr<material::Base> &m)
+			: material::Proxy (m)
+		{
+		}
+
+		bool is_reflecting () const
+		{
+			return true;
+		}
+};
+
+static void
+test_batch_fallback ()
+{
+	Setup s[2] = { make_system (), make_system () };
+	trace::Result res[2];
+
+	for (auto &i : s)
+		i.s2->set_material (1, std::make_shared<Splitter> (i.glass));
+
+	// batch mode must fall back to per ray trace
+	trace_compare (s, res, SaveS1 | SaveS2 | GenS2, [] (trace::Params &p)
+	{
+		p.set_batch_mode (true);
+	});
+}
+
+static void
+test_plan_update ()
+{
+	Setup s[2] = { make_system (), make_system () };
+	trace::Result res[2];
+
+	s[1].sys->get_tracer_params ().set_sequential_mode (
+	    std::make_shared<trace::Sequence> (*s[1].sys));
+	trace::Tracer tracer (s[1].sys.get ());
+	tracer.get_params ().set_plan_mode (true);
+	tracer.set_trace_result (res[1]);
+	save_rays (res[1], s[1], SaveImage | GenS2);
+	tracer.trace ();
+
+	// plan must not be reused after material change
+	for (auto &i : s)
+		i.s2->set_material (1, std::make_shared<material::Mirror> ());
+
+	trace_system (s[0], res[0], SaveImage | GenS2, params_t ());
+	tracer.trace ();
+	compare_saved (res[0], s[0], res[1], s[1], SaveImage | GenS2);
+
+	// nor after in place aperture change
+	std::shared_ptr<shape::Disk> disk[2];
+	for (int i = 0; i < 2; i++)
+	{
+		disk[i] = std::make_shared<shape::Disk> (30);
+		s[i].s1->set_shape (disk[i]);
+	}
+	tracer.trace ();
+	for (auto &i : disk)
+		i->set_radius (10);
+	trace_system (s[0], res[0], SaveImage | GenS2, params_t ());
+	tracer.trace ();
+	compare_saved (res[0], s[0], res[1], s[1], SaveImage | GenS2);
+}
+
+static void
+test_refraction (trace::RefractionLaw law)
+{
+	Setup s[2] = { make_system (true), make_system (true) };
+	trace::Result res[2];
+
+	trace_compare (s, res, SaveImage, [] (trace::Params &p)
+	{
+		p.set_batch_mode (true);
+	}, [&] (trace::Params &p)
+	{
+		p.set_refraction_law (law);
+	});
+
+	// same traces with formulas validation
+	trace::RefractionStats stats[2];
+	for (int i = 0; i < 2; i++)
+	{
+		trace::Result check;
+		trace_system (s[i], check, SaveImage, [&] (trace::Params &p)
+		{
+			p.set_batch_mode (i == 1);
+			p.set_refraction_law (law);
+			p.set_refraction_stats (&stats[i]);
+		});
+		compare_saved (res[i], s[i], check, s[i], SaveImage);
+	}
+
+	if (stats[0].get_count () == 0 || stats[0].get_count () != stats[1].get_count ())
+		FAIL (__LINE__ << " bad refraction count");
+
+	if (stats[0].get_max_error () > 1e-12)
+		FAIL (__LINE__ << " refraction formulas disagree " << stats[0].get_max_error ());
+
+	if (stats[0].get_mismatches ().size () > stats[0].get_record_limit ())
+		FAIL (__LINE__ << " too many records");
+}
+
+static void
+test_nonsequential (unsigned int threads, unsigned int max_bounce)
+{
+	Setup s[2] = { make_system (), make_system () };
+	trace::Result res[2];
+
+	for (auto &i : s)
+		i.sys->set_entrance_pupil (i.s1);
+
+	trace_compare (s, res, SaveS1 | SaveS2 | SaveImage | GenS2,
+	               [&] (trace::Params &p)
+	{
+		p.set_thread_count (threads);
+	}, [&] (trace::Params &p)
+	{
+		p.set_intensity_mode (trace::Intensitytrace);
+		p.set_max_bounce (max_bounce);
+	}, false);
+
+	if (res[0].get_bounce_limit_count () != res[1].get_bounce_limit_count ())
+		FAIL (__LINE__ << " bounce limit count differs");
+}
+
+// reference implementation of System::colide_next testing all surfaces
+static sys::Surface *
+colide_all (const sys::System &system, math::VectorPair3 &intersect,
+           const trace::Ray &ray)
+{
+	const sys::Element *origin = ray.get_creator ();
+	sys::Surface *e = 0;
+	math::VectorPair3 inter;
+	double min_dist = std::numeric_limits<double>::max ();
+	// ray goes through global coordinates as in System::colide_next
+	math::VectorPair3 global (origin->get_global_transform ().transform_line (ray));
+
+	for (unsigned int i = 1; i <= system.get_element_count (); i++)
+	{
+		sys::Surface *s = dynamic_cast<sys::Surface *> (&system.get_element (i));
+		if (!s || s == origin || !s->is_enabled ())
+			continue;
+		math::VectorPair3 local (s->get_local_transform ().transform_line (global));
+		if (s->intersect (system.get_tracer_params (), inter, local))
+		{
+			double dist = (inter.origin () - local.origin ()).len ();
+			if (min_dist > dist)
+			{
+				min_dist = dist;
+				intersect = inter;
+				e = s;
+			}
+		}
+	}
+	return e;
+}
+
+static void
+test_colide (unsigned int count)
+{
+	std::mt19937_64 rng (1);
+	std::uniform_real_distribution<double> u (-1, 1);
+	sys::System system;
+	std::vector<std::shared_ptr<sys::Surface> > surfaces;
+	auto group = std::make_shared<sys::Group> (
+	                 math::VectorPair3 (math::Vector3 (5, 0, 0), math::Vector3 (0, 0, 1)));
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		math::Vector3 p (u (rng) * 300, u (rng) * 300, u (rng) * 300);
+		double roc = 20 + (u (rng) + 1) * 100;
+		double r = 5 + (u (rng) + 1) * 20;
+		std::shared_ptr<curve::Base> c;
+		switch (i % 4)
+		{
+		case 0: c = curve::flat; break;
+		case 1: c = std::make_shared<curve::Sphere> (roc); break;
+		case 2: c = std::make_shared<curve::Parabola> (-roc); break;
+		case 3: c = std::make_shared<curve::Conic> (roc, u (rng) * 3); break;
+		}
+		std::shared_ptr<sys::Surface> s;
+		if (i % 17 == 0)
+			s = std::make_shared<sys::Stop> (
+			        math::VectorPair3 (p, math::Vector3 (0, 0, 1)), r);
+		else
+			s = std::make_shared<sys::OpticalSurface> (
+			        p, c, std::make_shared<shape::Rectangle> (r * 1.5, r),
+			        material::mirror, material::mirror);
+		s->rotate (u (rng) * 180, u (rng) * 180, u (rng) * 180);
+		if (i % 3 == 0)
+			group->add (s);
+		else
+			system.add (s);
+		surfaces.push_back (s);
+	}
+	system.add (group);
+
+	for (unsigned int pass = 0; pass < 3; pass++)
+	{
+		// system changes must be taken into account
+		if (pass == 1)
+			group->rotate (10, 20, 30);
+		if (pass == 2)
+			surfaces[1]->set_enable_state (false);
+
+		for (unsigned int i = 0; i < 20000; i++)
+		{
+			trace::Ray ray;
+			ray.set_creator (surfaces[i % count].get ());
+			ray.origin () = math::Vector3 (u (rng) * 300, u (rng) * 300, u (rng) * 300);
+			ray.direction () = math::Vector3 (u (rng), u (rng), i % 7 ? u (rng) : 0);
+			ray.direction ().normalize ();
+
+			math::VectorPair3 a, b;
+			sys::Surface *sa = system.colide_next (system.get_tracer_params (), a, ray);
+			sys::Surface *sb = colide_all (system, b, ray);
+			if (sa != sb || (sa && !(a.origin () == b.origin ()
+			                         && a.normal () == b.normal ())))
+				FAIL (__LINE__ << " ray " << i << " colides with wrong surface");
+		}
+	}
+}
+
+static bool
+same_transform (const math::Transform<3> &a, const math::Transform<3> &b)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (a.get_translation ()[i] != b.get_translation ()[i])
+			return false;
+		for (int j = 0; j < 3; j++)
+			if (a.get_linear ().value (i, j) != b.get_linear ().value (i, j))
+				return false;
+	}
+	return true;
+}
+
+static void
+test_compiled_system ()
+{
+	Setup s = make_system (true);
+	s.s2->rotate (3, 5, 7);
+	s.stop->set_enable_state (false);
+	std::vector<const sys::Element *> list;
+	for (unsigned int i = 1; i <= s.sys->get_element_count (); i++)
+		list.push_back (&s.sys->get_element (i));
+
+	sys::CompiledSystem cs[2] = { sys::CompiledSystem (*s.sys),
+	                              sys::CompiledSystem (*s.sys, list)
+	                            };
+
+	// stop is disabled and skipped
+	if (cs[1].get_transform_count () != list.size () - 2)
+		FAIL (__LINE__ << " bad adjacent transforms count");
+
+	for (int k = 0; k < 2; k++)
+		for (auto from : list)
+		{
+			if (!same_transform (cs[k].get_global_transform (*from),
+			                    from->get_global_transform ())
+			        || !same_transform (cs[k].get_local_transform (*from),
+			                           from->get_local_transform ()))
+				FAIL (__LINE__ << " global transform differs");
+			for (auto to : list)
+				if (from != to
+				        && !same_transform (cs[k].get_transform (*from, *to),
+				                           from->get_transform_to (*to)))
+					FAIL (__LINE__ << " transform differs");
+		}
+
+	if (cs[0].get_transform_count () != 0)
+		FAIL (__LINE__ << " non sequential transforms stored");
+
+	// snapshot is kept across traces until system changes
+	for (int k = 0; k < 2; k++)
+	{
+		if (k)
+			s.sys->get_tracer_params ().set_sequential_mode (
+			    std::make_shared<trace::Sequence> (*s.sys));
+		trace::Tracer tracer (s.sys.get ());
+		tracer.trace ();
+		const sys::CompiledSystem *c = tracer.get_params ().get_compiled_system ();
+		tracer.trace ();
+		if (tracer.get_params ().get_compiled_system () != c)
+			FAIL (__LINE__ << " snapshot not reused");
+		s.s2->rotate (1, 0, 0);
+		tracer.trace ();
+		c = tracer.get_params ().get_compiled_system ();
+		if (c->get_version () != s.sys->get_version ())
+			FAIL (__LINE__ << " snapshot not updated");
+		if (!same_transform (c->get_transform (*s.s1, *s.s2),
+		                     s.s1->get_transform_to (*s.s2)))
+			FAIL (__LINE__ << " stale transform");
+	}
+}
+
+static void
+test_index_table ()
+{
+	Setup s = make_system ();
+	std::set<double> wl = { light::SpectralLine::C, light::SpectralLine::d,
+	                        light::SpectralLine::F
+	                      };
+	trace::IndexTable t (*s.sys, wl);
+
+	if (!t.is_valid (wl) || t.get_wavelen_count () != 3)
+		FAIL (__LINE__ << " bad wavelengths");
+	if (t.get_wavelen_index (light::SpectralLine::e) != 3)
+		FAIL (__LINE__ << " unexpected wavelength found");
+
+	const sys::OpticalSurface *surfaces[2] = { s.s1.get (), s.s2.get () };
+	for (auto surface : surfaces)
+		for (int rtl = 0; rtl < 2; rtl++)
+			for (double w : wl)
+			{
+				double ratio;
+				if (!t.get_index_ratio (*surface, rtl, t.get_wavelen_index (w), ratio))
+					FAIL (__LINE__ << " surface not found");
+				if (ratio != surface->get_material (rtl).get_refractive_index (w)
+				        / surface->get_material (!rtl).get_refractive_index (w))
+					FAIL (__LINE__ << " index ratio differs");
+			}
+}
+
+static void
+test_sinks (unsigned int threads, bool batch, bool plan)
+{
+	Setup ref = make_system ();
+	Setup s = make_system ();
+
+	trace::Result res;
+	trace_system (ref, res, SaveS2 | SaveImage, params_t ());
+
+	// no rays list saved, rays only reach the sinks
+	trace::Result sres;
+	auto stats = std::make_shared<trace::SinkStats> ();
+	auto s2stats = std::make_shared<trace::SinkStats> ();
+	math::VectorPair2 window (math::Vector2 (-2, -2), math::Vector2 (2, 2));
+	auto hist = std::make_shared<trace::SinkHistogram> (window, 8, 8);
+	sres.set_intercept_sink (*s.image, stats);
+	sres.set_intercept_sink (*s.s1, hist);
+	sres.set_intercept_sink (*s.s2, s2stats);
+
+	s.sys->get_tracer_params ().set_sequential_mode (
+	    std::make_shared<trace::Sequence> (*s.sys));
+	trace::Tracer tracer (s.sys.get ());
+	tracer.get_params ().set_thread_count (threads);
+	tracer.get_params ().set_batch_mode (batch);
+	tracer.get_params ().set_plan_mode (plan);
+	tracer.set_trace_result (sres);
+
+	// sinks are cleared on each trace
+	for (int i = 0; i < 2; i++)
+		tracer.trace ();
+
+	const trace::rays_queue_t &intercepts = res.get_intercepted (*ref.image);
+	if (stats->get_count () != intercepts.size ())
+		FAIL (__LINE__ << " " << stats->get_count () << " intercepts, expecting "
+		     << intercepts.size ());
+
+	math::VectorPair3 w = res.get_intercepted_window (*ref.image);
+	math::VectorPair3 sw = stats->get_window ();
+	if (!(sw[0] == w[0]) || !(sw[1] == w[1]))
+		FAIL (__LINE__ << " window differs");
+
+	math::Vector3 c = res.get_intercepted_centroid (*ref.image);
+	if ((stats->get_centroid () - c).len () > 1e-12)
+		FAIL (__LINE__ << " centroid differs");
+
+	unsigned long count = 0;
+	for (unsigned int x = 0; x < hist->get_bin_count (0); x++)
+		for (unsigned int y = 0; y < hist->get_bin_count (1); y++)
+			count += hist->get_ray_count (x, y);
+	if (count == 0 || stats->get_total_intensity () != stats->get_count ())
+		FAIL (__LINE__ << " histogram empty");
+
+	// rms radius is measured in the curved surface plane
+	const trace::rays_queue_t &s2i = res.get_intercepted (*ref.s2);
+	math::Vector3 c2 = res.get_intercepted_centroid (*ref.s2);
+	double ms = 0;
+	for (auto r : s2i)
+	{
+		math::Vector3 d (r->get_intercept_point () - c2);
+		ms += d.x () * d.x () + d.y () * d.y ();
+	}
+	if (fabs (s2stats->get_rms_radius () - sqrt (ms / s2i.size ())) > 1e-12)
+		FAIL (__LINE__ << " rms radius differs");
+}
+
+static void
+test_sink_threads (bool sequential)
+{
+	std::shared_ptr<trace::SinkStats> stats[2];
+	size_t capacity[2];
+
+	for (int k = 0; k < 2; k++)
+	{
+		Setup s = make_system ();
+		s.sys->get_tracer_params ().set_default_distribution (
+		    trace::Distribution (trace::HexaPolarDist, 100));
+		if (sequential)
+			s.sys->get_tracer_params ().set_sequential_mode (
+			    std::make_shared<trace::Sequence> (*s.sys));
+		trace::Tracer tracer (s.sys.get ());
+		tracer.get_params ().set_thread_count (k ? 4 : 1);
+		trace::Result res;
+		stats[k] = std::make_shared<trace::SinkStats> ();
+		res.set_intercept_sink (*s.image, stats[k]);
+		tracer.set_trace_result (res);
+		tracer.trace ();
+		capacity[k] = res.get_ray_capacity ();
+	}
+
+	// sums do not depend on thread count
+	if (stats[0]->get_count () != stats[1]->get_count ()
+	        || !(stats[0]->get_centroid () == stats[1]->get_centroid ())
+	        || stats[0]->get_rms_radius () != stats[1]->get_rms_radius ())
+		FAIL (__LINE__ << " sink results depend on thread count");
+
+	// source rays are generated by blocks in sequential mode
+	for (int k = 0; sequential && k < 2; k++)
+		if (capacity[k] >= stats[0]->get_count ())
+			FAIL (__LINE__ << " " << capacity[k] << " rays allocated for "
+			      << stats[0]->get_count () << " intercepts");
+}
+
+static void
+test_memory_retention (unsigned int threads, bool plan)
+{
+	Setup ref = make_system ();
+	Setup s = make_system ();
+	const unsigned int save = SaveImage | GenSource;
+	auto params = [&] (trace::Params &p)
+	{
+		p.set_thread_count (threads);
+		p.set_plan_mode (plan);
+	};
+
+	trace::Result res[2];
+	trace_system (ref, res[0], save, params);
+
+	// same tracer and result reused for several traces
+	res[1].set_memory_retention (true);
+	s.sys->get_tracer_params ().set_sequential_mode (
+	    std::make_shared<trace::Sequence> (*s.sys));
+	trace::Tracer tracer (s.sys.get ());
+	params (tracer.get_params ());
+	tracer.set_trace_result (res[1]);
+	save_rays (res[1], s, save);
+
+	size_t capacity = 0;
+	const trace::Ray *const *list = 0;
+	size_t list_capacity = 0;
+	for (int j = 0; j < 4; j++)
+	{
+		tracer.trace ();
+
+		// intercepted rays list storage is kept too
+		const trace::rays_queue_t &l = res[1].get_intercepted (*s.image);
+		if (j && (l.data () != list || l.capacity () != list_capacity))
+			FAIL (__LINE__ << " rays list storage not reused");
+		list = l.data ();
+		list_capacity = l.capacity ();
+
+		compare_saved (res[0], ref, res[1], s, save);
+
+		if (res[1].get_ray_count () != res[0].get_ray_count ())
+			FAIL (__LINE__ << " ray count differs");
+		if (res[1].get_ray_high_water_mark () != res[0].get_ray_count ())
+			FAIL (__LINE__ << " bad high water mark");
+		if (j && res[1].get_ray_capacity () != capacity)
+			FAIL (__LINE__ << " rays storage not reused");
+		capacity = res[1].get_ray_capacity ();
+	}
+
+	res[1].release_memory ();
+	if (res[1].get_ray_capacity () != 0 || res[1].get_ray_high_water_mark () != 0)
+		FAIL (__LINE__ << " memory not released");
+}
+
+static void
+test_genealogy (trace::GenealogyMode mode, bool plan, bool batch)
+{
+	Setup s[2] = { make_system (), make_system () };
+	trace::Result res[2];
+
+	trace_compare (s, res, SaveImage, [&] (trace::Params &p)
+	{
+		p.set_plan_mode (plan);
+		p.set_batch_mode (batch);
+		p.set_genealogy_mode (mode);
+	});
+
+	for (auto r : res[1].get_intercepted (*s[1].image))
+	{
+		if (r->get_first_child ())
+			FAIL (__LINE__ << " unexpected child ray link");
+		if (mode == trace::GenealogyNone)
+		{
+			if (r->get_parent ())
+				FAIL (__LINE__ << " unexpected parent ray link");
+			continue;
+		}
+		// source ray is still reachable
+		const trace::Ray *root = r;
+		while (root->get_parent ())
+			root = root->get_parent ();
+		if (root->get_creator () != s[1].source.get ())
+			FAIL (__LINE__ << " source ray not reachable");
+		if ((plan || batch) && r->get_parent () != root)
+			FAIL (__LINE__ << " intermediate ray allocated");
+	}
+
+	// only image intercepted rays are allocated along with source rays
+	if ((plan || batch) && res[1].get_ray_count () * 3 > res[0].get_ray_count () * 2)
+		FAIL (__LINE__ << " " << res[1].get_ray_count () << " rays allocated");
+}
+
+static void
+test_source_merge (unsigned int threads, bool batch)
+{
+	Setup s = make_system ();
+	auto source2 = std::make_shared<sys::SourcePoint> (sys::SourceAtInfinity,
+	               math::Vector3 (0, -0.05, 1));
+	s.sys->add (source2);
+	auto seq = std::make_shared<trace::Sequence> (*s.sys);
+	s.sys->get_tracer_params ().set_sequential_mode (seq);
+
+	// each source alone, in sequence order
+	trace::rays_queue_t ref;
+	trace::Result res[3];
+	for (int i = 0; i < 2; i++)
+	{
+		const sys::Source &source
+		    = dynamic_cast<const sys::Source &> (seq->get_element (i));
+		s.sys->enable_single<sys::Source> (source);
+		trace::Tracer tracer (s.sys.get ());
+		tracer.set_trace_result (res[i]);
+		res[i].set_intercepted_save_state (*s.image);
+		tracer.trace ();
+		const trace::rays_queue_t &q = res[i].get_intercepted (*s.image);
+		ref.insert (ref.end (), q.begin (), q.end ());
+	}
+
+	// consecutive sources are propagated in a single pass
+	s.source->set_enable_state (true);
+	source2->set_enable_state (true);
+	trace::Tracer tracer (s.sys.get ());
+	tracer.get_params ().set_thread_count (threads);
+	tracer.get_params ().set_batch_mode (batch);
+	tracer.set_trace_result (res[2]);
+	res[2].set_intercepted_save_state (*s.image);
+	tracer.trace ();
+
+	compare_queues (ref, res[2].get_intercepted (*s.image));
+}
+
+static void
+test_given_sources (bool sequential, unsigned int threads, bool plan)
+{
+	Setup s[2] = { make_system (), make_system () };
+	trace::Result res[2];
+	auto common = [&] (trace::Params &p)
+	{
+		p.set_thread_count (threads);
+		p.set_plan_mode (plan);
+	};
+	trace_system (s[0], res[0], SaveImage, common, sequential);
+
+	// same source, not part of the system
+	auto source = std::make_shared<sys::SourcePoint> (sys::SourceAtInfinity,
+	              math::Vector3 (0, 0.1, 1));
+	source->add_spectral_line (light::SpectralLine::C);
+	source->add_spectral_line (light::SpectralLine::F);
+	std::vector<const sys::Source *> sources (1, source.get ());
+	if (sequential)
+		s[1].sys->get_tracer_params ().set_sequential_mode (
+		    std::make_shared<trace::Sequence> (*s[1].sys));
+	const unsigned int version = s[1].sys->get_version ();
+	trace::Tracer tracer (s[1].sys.get ());
+	common (tracer.get_params ());
+	tracer.set_trace_result (res[1]);
+	save_rays (res[1], s[1], SaveImage);
+	tracer.trace (sources);
+
+	if (res[0].get_intercepted (*s[0].image).empty ())
+		FAIL (__LINE__ << " no ray reached the image");
+	compare_saved (res[0], s[0], res[1], s[1], SaveImage);
+	if (s[1].sys->get_version () != version)
+		FAIL (__LINE__ << " system version changed");
+	if (!res[1].get_source_list ().empty ())
+		FAIL (__LINE__ << " unexpected source in result");
+
+	// source of an other system
+	sources[0] = s[0].source.get ();
+	try
+	{
+		tracer.trace (sources);
+		FAIL (__LINE__ << " source of other system accepted");
+	}
+	catch (const Error &)
+	{
+	}
+}
+
+static void
+test_pattern_cache ()
+{
+	Setup s = make_system ();
+	trace::Distribution d (trace::HexaPolarDist, 12);
+
+	std::vector<math::Vector3> ref;
+	s.s1->get_pattern ([&ref] (const math::Vector3 &v) { ref.push_back (v); }, d);
+
+	auto p = s.s1->get_pattern_points (d);
+	if (p->size () != ref.size ())
+		FAIL (__LINE__ << " pattern size mismatch");
+	for (size_t i = 0; i < ref.size (); i++)
+		if (!((*p)[i] == ref[i]))
+			FAIL (__LINE__ << " pattern point mismatch");
+
+	if (s.s1->get_pattern_points (d) != p)
+		FAIL (__LINE__ << " pattern not cached");
+	if (s.s1->get_pattern_points (trace::Distribution (trace::HexaPolarDist, 13)) == p)
+		FAIL (__LINE__ << " distribution change ignored");
+	if (s.s1->get_pattern_points (d, true) == p)
+		FAIL (__LINE__ << " unobstructed change ignored");
+	if (s.s1->get_pattern_points (d) != p)
+		FAIL (__LINE__ << " cache entry evicted early");
+
+	// random patterns only depend on seed
+	trace::Distribution rnd (trace::RandomDist, 12);
+	auto r0 = s.s1->get_pattern_points (rnd);
+	rnd.set_seed (1);
+	auto r1 = s.s1->get_pattern_points (rnd);
+	if (r0 == r1 || (*r0)[1] == (*r1)[1])
+		FAIL (__LINE__ << " seed change ignored");
+	s.s1->clear_pattern_cache ();
+	if (!((*s.s1->get_pattern_points (rnd))[1] == (*r1)[1]))
+		FAIL (__LINE__ << " random pattern not reproducible");
+
+	s.s1->set_curve (std::make_shared<curve::Sphere> (100));
+	auto q = s.s1->get_pattern_points (d);
+	if (q == p || q->size () != ref.size () || (*q)[1].z () == ref[1].z ())
+		FAIL (__LINE__ << " cache not invalidated on curve change");
+
+	s.s1->clear_pattern_cache ();
+	if (s.s1->get_pattern_points (d) == q)
+		FAIL (__LINE__ << " cache not cleared");
+
+	// curve and shape objects modified in place
+	auto sphere = std::make_shared<curve::Sphere> (100);
+	auto composer = std::make_shared<curve::Composer> ();
+	auto &attr = composer->add_curve (sphere);
+	auto disk = std::make_shared<shape::Disk> (30);
+	s.s1->set_curve (composer);
+	s.s1->set_shape (disk);
+	auto check = [&] (int line)
+	{
+		std::vector<math::Vector3> pts;
+		s.s1->get_pattern ([&pts] (const math::Vector3 &v) { pts.push_back (v); }, d);
+		auto c = s.s1->get_pattern_points (d);
+		if (c->size () != pts.size () || !((*c)[1] == pts[1]))
+			FAIL (line << " stale cached pattern");
+	};
+	check (__LINE__);
+	sphere->set_roc (120);
+	check (__LINE__);
+	attr.z_scale (2);
+	check (__LINE__);
+	disk->set_radius (20);
+	check (__LINE__);
+}
+
+int
+main ()
+{
+	test_sequential (2);
+	test_sequential (3);
+	test_sequential (16);
+	test_sequential (1, true);
+	test_sequential (3, true);
+	test_sequential (1, true, true);
+	test_sequential (1, false, false, true);
+	test_sequential (3, false, true, true);
+	test_batch_fallback ();
+	test_plan_update ();
+	test_refraction (trace::RefractionFeder);
+	test_refraction (trace::RefractionDeGreve);
+	test_nonsequential (4, 50);
+	test_nonsequential (7, 3);
+	test_colide (200);
+	test_compiled_system ();
+	test_index_table ();
+	test_sinks (1, false, false);
+	test_sinks (1, false, true);
+	test_sinks (1, true, false);
+	test_sinks (4, false, false);
+	test_sinks (4, true, true);
+	test_sink_threads (true);
+	test_sink_threads (false);
+	test_memory_retention (1, false);
+	test_memory_retention (4, false);
+	test_memory_retention (4, true);
+	test_genealogy (trace::GenealogyNone, false, false);
+	test_genealogy (trace::GenealogyNone, true, false);
+	test_genealogy (trace::GenealogyNone, false, true);
+	test_genealogy (trace::GenealogyCompact, false, false);
+	test_genealogy (trace::GenealogyCompact, true, false);
+	test_genealogy (trace::GenealogyCompact, false, true);
+	test_pattern_cache ();
+	test_source_merge (1, false);
+	test_source_merge (4, false);
+	test_source_merge (4, true);
+	test_given_sources (true, 1, false);
+	test_given_sources (true, 4, true);
+	test_given_sources (false, 1, false);
+	test_given_sources (false, 4, false);
+	return 0;
+}